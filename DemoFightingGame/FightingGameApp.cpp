@@ -275,6 +275,12 @@ void FightingGameApp::OnResize(int width, int height)
 
 void FightingGameApp::UpdateUserInput()
 {
+	// Capture profile scopes of the next frames to a Chrome trace
+	if (RInput.GetBufferedKeyState('T') == EBufferedKeyState::Pressed && !GProfiler.IsCapturing())
+	{
+		GProfiler.StartCapture(60, "ProfilerTrace.json");
+	}
+
 	if (RInput.GetBufferedKeyState(VK_TAB) == EBufferedKeyState::Pressed)
 	{
 		m_FreeFlyMode = !m_FreeFlyMode;
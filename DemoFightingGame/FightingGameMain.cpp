@@ -18,14 +18,55 @@ int WINAPI WinMain(HINSTANCE hInstance,
 	REngineInitParam InitParam(&app);
 	//InitParam.WindowWidth = InitParam.WindowHeight = -1;
 	//InitParam.bFullScreen = true;
+	//InitParam.PhysicsSettings.bMultithreaded = true;
+	//InitParam.PhysicsSettings.SimulationMode = EPhysicsSimulationMode::Threaded;
+
+	// "-profile N" captures profile scopes of the first N frames to a Chrome trace
+	if (const char* ProfileArg = strstr(lpCmdLine, "-profile"))
+	{
+		int NumFrames = atoi(ProfileArg + strlen("-profile"));
+		InitParam.ProfilerCaptureFrames = NumFrames > 0 ? NumFrames : 300;
+	}
+
+	// "-benchmark N" runs N fixed-timestep frames without a window or a GPU and writes frame time stats to "-output <file>"
+	RHeadlessRunParams HeadlessParams;
+	if (const char* BenchmarkArg = strstr(lpCmdLine, "-benchmark"))
+	{
+		InitParam.bHeadless = true;
+
+		int NumFrames = atoi(BenchmarkArg + strlen("-benchmark"));
+		if (NumFrames > 0)
+		{
+			HeadlessParams.NumFrames = NumFrames;
+		}
+
+		HeadlessParams.ResultFilePath = "FrameTimes.json";
+		if (const char* OutputArg = strstr(lpCmdLine, "-output "))
+		{
+			std::istringstream(OutputArg + strlen("-output ")) >> HeadlessParams.ResultFilePath;
+		}
+	}
 
 	if (GEngine.Initialize(InitParam))
 	{
-		GEngine.Run();
+		if (InitParam.bHeadless)
+		{
+			GEngine.RunHeadless(HeadlessParams);
+		}
+		else
+		{
+			GEngine.Run();
+		}
 		GEngine.Shutdown();
 	}
 	else
 	{
+		// Headless runs have nobody to close a message box
+		if (InitParam.bHeadless)
+		{
+			return 1;
+		}
+
 		MessageBox(0, L"Failed to initialize REngine.", 0, 0);
 	}
 
@@ -139,8 +139,11 @@ PlayerControllerBase::PlayerControllerBase(const RConstructingParams& Params)
 	GhostObject->setCollisionShape(CapsuleShape.get());
 	GhostObject->setCollisionFlags(btCollisionObject::CF_CHARACTER_OBJECT);
 
-	GPhysicsEngine.GetContext()->DynamicWorld->addCollisionObject(GhostObject.get(), btBroadphaseProxy::CharacterFilter, btBroadphaseProxy::StaticFilter | btBroadphaseProxy::DefaultFilter);
-	GPhysicsEngine.GetContext()->DynamicWorld->addAction(KinematicCharacterController.get());
+	{
+		RScopedPhysicsWorldLock WorldLock;
+		GPhysicsEngine.GetContext()->DynamicWorld->addCollisionObject(GhostObject.get(), btBroadphaseProxy::CharacterFilter, btBroadphaseProxy::StaticFilter | btBroadphaseProxy::DefaultFilter);
+		GPhysicsEngine.GetContext()->DynamicWorld->addAction(KinematicCharacterController.get());
+	}
 
 	if (RAnimGraph* AnimGraph = RResourceManager::Instance().LoadResource<RAnimGraph>("/Maid/Maid_Navigation.ranimgraph", EResourceLoadMode::Immediate))
 	{
@@ -153,6 +156,7 @@ PlayerControllerBase::PlayerControllerBase(const RConstructingParams& Params)
 
 PlayerControllerBase::~PlayerControllerBase()
 {
+	RScopedPhysicsWorldLock WorldLock;
 	GPhysicsEngine.GetContext()->DynamicWorld->removeAction(KinematicCharacterController.get());
 	GPhysicsEngine.GetContext()->DynamicWorld->removeCollisionObject(GhostObject.get());
 
@@ -174,6 +178,9 @@ void PlayerControllerBase::Update(float DeltaTime)
 void PlayerControllerBase::Update_PostPhysics(float DeltaTime)
 {
 	Base::Update_PostPhysics(DeltaTime);
+
+	// The controller is updated by physics steps which may run on the physics thread
+	RScopedPhysicsWorldLock WorldLock;
 	KinematicCharacterController->Update_PostPhysics(DeltaTime);
 
 	RVec3 Position = KinematicCharacterController->GetInterpolatedPosition();
@@ -255,6 +262,8 @@ void PlayerControllerBase::PreUpdate(float DeltaTime)
 
 void PlayerControllerBase::UpdateMovement(float DeltaTime, const RVec3 MoveVec)
 {
+	RScopedPhysicsWorldLock WorldLock;
+
 	bool bCanMovePlayer = CanMovePlayerWithInput();
 	if (bCanMovePlayer)
 	{
@@ -318,24 +327,12 @@ void PlayerControllerBase::PostUpdate(float DeltaTime)
 	PoseData.CopyFinalPose(GetTransformMatrix(), m_BoneMatrices);
 }
 
-void PlayerControllerBase::Draw()
+void PlayerControllerBase::SetupDrawConstantBuffers()
 {
 	// Copy bone transforms to constant buffer
 	memcpy(&RConstantBuffers::cbBoneMatrices.Data.boneMatrix, m_BoneMatrices, sizeof(RMatrix4) * MAX_BONE_COUNT);
 	RConstantBuffers::cbBoneMatrices.UpdateBufferData();
 	RConstantBuffers::cbBoneMatrices.BindBuffer();
-
-	RSMeshObject::Draw();
-}
-
-void PlayerControllerBase::DrawDepthPass()
-{
-	// Copy bone transforms to constant buffer
-	memcpy(&RConstantBuffers::cbBoneMatrices.Data.boneMatrix, m_BoneMatrices, sizeof(RMatrix4) * MAX_BONE_COUNT);
-	RConstantBuffers::cbBoneMatrices.UpdateBufferData();
-	RConstantBuffers::cbBoneMatrices.BindBuffer();
-
-	RSMeshObject::DrawDepthPass();
 }
 
 void PlayerControllerBase::SetMovementInput(const RVec3& Input)
@@ -426,7 +423,10 @@ void PlayerControllerBase::Reset()
 		AINavigationComponent->StopMovement();
 	}
 
-	KinematicCharacterController->ResetTransformInterpolation();
+	{
+		RScopedPhysicsWorldLock WorldLock;
+		KinematicCharacterController->ResetTransformInterpolation();
+	}
 
 	OnPlayerReset.Execute();
 }
@@ -439,6 +439,7 @@ void PlayerControllerBase::OnTransformModified()
 	PhysicsTransform.setOrigin(RVec3TobtVec3(GetWorldPosition() + GetHalfCapsuleOffset()));
 	PhysicsTransform.setRotation(RQuatTobtQuat(GetRotation()));
 
+	RScopedPhysicsWorldLock WorldLock;
 	GhostObject->setWorldTransform(PhysicsTransform);
 }
 
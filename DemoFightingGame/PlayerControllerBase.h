@@ -34,8 +34,8 @@ public:
 	const RVec3& GetRootOffset() const;
 
 	// Overrides RSceneObject render methods
-	virtual void Draw() override;
-	virtual void DrawDepthPass() override;
+	virtual void SetupDrawConstantBuffers() override;
+	virtual bool HasDrawConstantBuffers() const override { return true; }
 
 	/// Set controller input for moving the character
 	void SetMovementInput(const RVec3& Input);
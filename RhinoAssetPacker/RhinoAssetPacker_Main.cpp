@@ -0,0 +1,87 @@
+//=============================================================================
+// RhinoAssetPacker_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Packs an assets folder into an asset archive (.rpak)
+//=============================================================================
+
+#include "Core/CoreTypes.h"
+#include "Core/RFileUtil.h"
+#include "Core/RAssetArchive.h"
+
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		printf("Usage: RhinoAssetPacker <AssetsFolder> <Output.rpak>\n");
+		printf("  Packs all files in the assets folder. Use the folder name with .rpak next to it (e.g. ../Assets.rpak)\n");
+		printf("  so the engine mounts the archive automatically.\n");
+		return 1;
+	}
+
+	const std::string AssetsPath = RFileUtil::TrimTrailingSeperators(RFileUtil::UnifyPathSeperators(argv[1])) + "/";
+	const std::string ArchivePath = argv[2];
+
+	if (!RFileUtil::CheckPathExists(AssetsPath))
+	{
+		printf("Assets folder %s does not exist.\n", AssetsPath.c_str());
+		return 1;
+	}
+
+	std::vector<std::string> AssetFiles = RFileUtil::GetFilesInDirectoryAndSubdirectories(AssetsPath, "*.*");
+	std::set<std::string> StaleBinaryMeshes;
+
+	// Meshes are loaded from cooked .rmesh at runtime. Their .fbx files are only packed as paths, so meshes
+	// are still found by the resource manager.
+	for (const std::string& AssetFile : AssetFiles)
+	{
+		if (RFileUtil::GetExtensionInLowerCase(AssetFile) != "fbx")
+		{
+			continue;
+		}
+
+		const std::string FbxPath = RFileUtil::CombinePath(AssetsPath, AssetFile);
+		const std::string BinaryMeshPath = RFileUtil::ReplaceExtension(FbxPath, "rmesh");
+
+		if (!RFileUtil::CheckPathExists(BinaryMeshPath) ||
+			RFileUtil::CompareFileTimestamp(FbxPath, BinaryMeshPath) == ETimestampComparison::EarlierSecond)
+		{
+			printf("Warning: %s has no up-to-date .rmesh and will be loaded from the loose .fbx file.\n", AssetFile.c_str());
+			StaleBinaryMeshes.insert(RFileUtil::ReplaceExtension(AssetFile, "rmesh"));
+		}
+	}
+
+	RAssetArchiveWriter Writer;
+	int NumStrippedFiles = 0;
+
+	for (const std::string& AssetFile : AssetFiles)
+	{
+		const std::string Ext = RFileUtil::GetExtensionInLowerCase(AssetFile);
+
+		if (Ext == "fbx")
+		{
+			Writer.AddStrippedFile(AssetFile);
+			NumStrippedFiles++;
+		}
+		else if (Ext == "rmesh" && StaleBinaryMeshes.find(AssetFile) != StaleBinaryMeshes.end())
+		{
+			// A packed .rmesh is always trusted at runtime, so outdated ones are left out
+			continue;
+		}
+		else
+		{
+			Writer.AddFile(AssetFile, RFileUtil::CombinePath(AssetsPath, AssetFile));
+		}
+	}
+
+	if (!Writer.Write(ArchivePath))
+	{
+		printf("Failed to write asset archive %s.\n", ArchivePath.c_str());
+		return 1;
+	}
+
+	printf("Packed %d files (%d stripped) from %s into %s, %.2f MB of file data.\n",
+		Writer.GetNumFiles(), NumStrippedFiles, AssetsPath.c_str(), ArchivePath.c_str(),
+		(double)Writer.GetWrittenDataSize() / (1024.0 * 1024.0));
+
+	return 0;
+}
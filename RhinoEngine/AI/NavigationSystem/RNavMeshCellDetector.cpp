@@ -117,6 +117,7 @@ bool RPhysicsNavMeshCellDetector::IsCellOccupied(const RAabb& CellBounds) const
 
 	CellContactResultCallback ContactResult;
 
+	RScopedPhysicsWorldLock WorldLock;
 	GPhysicsEngine.GetContext()->DynamicWorld->contactTest(GhostObject.get(), ContactResult);
 	return ContactResult.bHasContacts;
 }
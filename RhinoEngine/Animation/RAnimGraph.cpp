@@ -10,6 +10,7 @@
 #include "Core/StdHelper.h"
 #include "Core/RLog.h"
 #include "Core/StringUtils.h"
+#include "Core/RVirtualFileSystem.h"
 
 #include "RAnimNode_AnimationPlayer.h"
 #include "RAnimNode_BlendPlayer.h"
@@ -27,6 +28,29 @@ RAnimGraph::RAnimGraph(const std::string& path)
 
 }
 
+void RAnimGraph::Reset()
+{
+	AnimGraphNodes.clear();
+	RootGraphNode = nullptr;
+}
+
+size_t RAnimGraph::GetMemorySize() const
+{
+	size_t Size = sizeof(RAnimGraph);
+
+	for (const auto& GraphNode : AnimGraphNodes)
+	{
+		Size += sizeof(RAnimGraphNode) + GraphNode->NodeName.capacity() + GraphNode->NodeTypeName.capacity();
+
+		for (const std::string& Input : GraphNode->Inputs)
+		{
+			Size += sizeof(std::string) + Input.capacity();
+		}
+	}
+
+	return Size;
+}
+
 const std::vector<std::string>& RAnimGraph::GetSupportedExtensions()
 {
 	static const std::vector<std::string> AnimGraphExts{ ".ranimgraph" };
@@ -109,7 +133,8 @@ void RAnimGraph::RegisterAnimNodeType(const std::string& TypeName, AnimNodeFacto
 bool RAnimGraph::LoadResourceImpl()
 {
 	std::unique_ptr<tinyxml2::XMLDocument> XmlDoc = std::make_unique<tinyxml2::XMLDocument>();
-	if (XmlDoc->LoadFile(GetFileSystemPath().c_str()) == tinyxml2::XML_SUCCESS)
+	RFileData FileData = GVirtualFileSystem.ReadFile(GetFileSystemPath());
+	if (FileData.IsValid() && XmlDoc->Parse(FileData.GetData(), FileData.GetSize()) == tinyxml2::XML_SUCCESS)
 	{
 		// <AnimGraph>
 		tinyxml2::XMLElement* XmlElemAnimGraph = XmlDoc->RootElement();
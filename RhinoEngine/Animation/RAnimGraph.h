@@ -45,6 +45,10 @@ class RAnimGraph : public RResourceBase
 public:
 	RAnimGraph(const std::string& path);
 
+	virtual void Reset() override;
+
+	virtual size_t GetMemorySize() const override;
+
 	// Called by RResourceManager for registering a resource type with its extensions
 	static const std::vector<std::string>& GetSupportedExtensions();
 
@@ -475,6 +475,18 @@ bool RAnimation::IsRootBone(int BoneId) const
 	return SkeletalMesh->GetSkeletalData().FindParentForBone(MeshBoneId) == -1;
 }
 
+size_t RAnimation::GetMemorySize() const
+{
+	size_t Size = sizeof(RAnimation) + m_Name.capacity() + m_RootDisplacement.capacity() * sizeof(RVec3);
+
+	for (const RAnimBoneData& BoneData : BoneNodeData)
+	{
+		Size += BoneData.GetMemorySize();
+	}
+
+	return Size;
+}
+
 void RAnimation::GetNeighborFramesAtTime(float Time, int& OutFrame1, int& OutFrame2, float& OutFactor) const
 {
 	// Make zero based time
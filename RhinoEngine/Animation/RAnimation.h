@@ -83,6 +83,12 @@ struct RAnimBoneData
 		Serializer.SerializeVector(FrameMatrices_LocalSpace);
 	}
 
+	size_t GetMemorySize() const
+	{
+		return sizeof(RAnimBoneData) + BoneName.capacity() +
+			(FrameMatrices_MeshSpace.capacity() + FrameMatrices_LocalSpace.capacity()) * sizeof(RMatrix4);
+	}
+
 	/// Name of the bone node
 	std::string				BoneName;
 
@@ -172,6 +178,9 @@ public:
 	/// Checks if a bone is a root bone
 	bool IsRootBone(int BoneId) const;
 
+	/// Get number of bytes used by frame data of the animation
+	size_t GetMemorySize() const;
+
 private:
 	int GetBitFlags() const;
 
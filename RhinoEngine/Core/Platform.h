@@ -30,9 +30,9 @@
 
 #else
 
-#define FORCEINLINE __attribute__((always_inline))
+#define FORCEINLINE inline __attribute__((always_inline))
 
-void DebugBreak()
+inline void DebugBreak()
 {
     __asm__("int $3");
 }
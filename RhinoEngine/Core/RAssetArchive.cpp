@@ -0,0 +1,329 @@
+//=============================================================================
+// RAssetArchive.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RAssetArchive.h"
+
+#include "Core/RLog.h"
+
+const char RAssetArchive::Magic[4] = { 'R', 'P', 'A', 'K' };
+
+namespace
+{
+	inline char NormalizePathChar(char c)
+	{
+		return c == '\\' ? '/' : (char)tolower((unsigned char)c);
+	}
+
+	/// Make an asset path start with a single '/' and use '/' as separators
+	std::string MakeArchivePath(const std::string& AssetPath)
+	{
+		std::string Result;
+		Result.reserve(AssetPath.size() + 1);
+
+		for (char c : AssetPath)
+		{
+			c = (c == '\\') ? '/' : c;
+			if (c == '/' && Result.size() > 0 && Result.back() == '/')
+			{
+				continue;
+			}
+			Result.push_back(c);
+		}
+
+		if (Result.size() == 0 || Result[0] != '/')
+		{
+			Result.insert(Result.begin(), '/');
+		}
+
+		return Result;
+	}
+}
+
+RAssetArchive::RAssetArchive()
+	: Header(nullptr)
+	, Entries(nullptr)
+	, PathTable(nullptr)
+{
+
+}
+
+bool RAssetArchive::Open(const std::string& InArchivePath)
+{
+	Close();
+
+	if (!MappedFile.Open(InArchivePath))
+	{
+		return false;
+	}
+
+	const char* Data = MappedFile.GetData();
+	const UINT64 Size = MappedFile.GetSize();
+
+	if (Size < sizeof(RAssetArchiveHeader))
+	{
+		RLogError("Asset archive %s is too small to be valid.\n", InArchivePath.c_str());
+		Close();
+		return false;
+	}
+
+	const RAssetArchiveHeader* ArchiveHeader = (const RAssetArchiveHeader*)Data;
+	if (memcmp(ArchiveHeader->Magic, Magic, sizeof(Magic)) != 0 || ArchiveHeader->Version != CurrentVersion)
+	{
+		RLogError("Asset archive %s has an unknown format or version.\n", InArchivePath.c_str());
+		Close();
+		return false;
+	}
+
+	const UINT64 TocSize = (UINT64)ArchiveHeader->NumEntries * sizeof(RAssetArchiveEntry);
+	if (ArchiveHeader->TocOffset % alignof(RAssetArchiveEntry) != 0 ||
+		ArchiveHeader->TocOffset > Size || TocSize > Size - ArchiveHeader->TocOffset ||
+		ArchiveHeader->PathTableOffset > Size || ArchiveHeader->PathTableSize > Size - ArchiveHeader->PathTableOffset)
+	{
+		RLogError("Asset archive %s has a corrupted table of contents.\n", InArchivePath.c_str());
+		Close();
+		return false;
+	}
+
+	const RAssetArchiveEntry* ArchiveEntries = (const RAssetArchiveEntry*)(Data + ArchiveHeader->TocOffset);
+	for (UINT32 i = 0; i < ArchiveHeader->NumEntries; i++)
+	{
+		const RAssetArchiveEntry& Entry = ArchiveEntries[i];
+		bool bValidData = Entry.DataOffset <= Size && Entry.DataSize <= Size - Entry.DataOffset;
+		bool bValidPath = (UINT64)Entry.PathOffset + Entry.PathLength <= ArchiveHeader->PathTableSize;
+		bool bSorted = (i == 0) || ArchiveEntries[i - 1].PathHash <= Entry.PathHash;
+
+		if (!bValidData || !bValidPath || !bSorted)
+		{
+			RLogError("Asset archive %s has a corrupted entry at index %u.\n", InArchivePath.c_str(), i);
+			Close();
+			return false;
+		}
+	}
+
+	ArchivePath = InArchivePath;
+	Header = ArchiveHeader;
+	Entries = ArchiveEntries;
+	PathTable = Data + ArchiveHeader->PathTableOffset;
+
+	return true;
+}
+
+void RAssetArchive::Close()
+{
+	MappedFile.Close();
+	ArchivePath.clear();
+	Header = nullptr;
+	Entries = nullptr;
+	PathTable = nullptr;
+}
+
+bool RAssetArchive::IsOpen() const
+{
+	return Header != nullptr;
+}
+
+const RAssetArchiveEntry* RAssetArchive::FindEntry(const std::string& AssetPath) const
+{
+	if (!IsOpen())
+	{
+		return nullptr;
+	}
+
+	const UINT64 Hash = HashPath(AssetPath.data(), AssetPath.size());
+
+	const RAssetArchiveEntry* EntriesEnd = Entries + Header->NumEntries;
+	const RAssetArchiveEntry* Entry = std::lower_bound(Entries, EntriesEnd, Hash,
+		[](const RAssetArchiveEntry& Entry, UINT64 Hash) { return Entry.PathHash < Hash; });
+
+	// Entries with colliding hashes are next to each other
+	for (; Entry != EntriesEnd && Entry->PathHash == Hash; Entry++)
+	{
+		if (IsSamePath(PathTable + Entry->PathOffset, Entry->PathLength, AssetPath.data(), AssetPath.size()))
+		{
+			return Entry;
+		}
+	}
+
+	return nullptr;
+}
+
+const char* RAssetArchive::GetEntryData(const RAssetArchiveEntry& Entry) const
+{
+	return MappedFile.GetData() + Entry.DataOffset;
+}
+
+std::string RAssetArchive::GetEntryPath(const RAssetArchiveEntry& Entry) const
+{
+	return std::string(PathTable + Entry.PathOffset, Entry.PathLength);
+}
+
+int RAssetArchive::GetNumEntries() const
+{
+	return IsOpen() ? (int)Header->NumEntries : 0;
+}
+
+const RAssetArchiveEntry& RAssetArchive::GetEntry(int Index) const
+{
+	assert(Index >= 0 && Index < GetNumEntries());
+	return Entries[Index];
+}
+
+UINT64 RAssetArchive::HashPath(const char* Path, size_t Length)
+{
+	// 64-bit FNV-1a
+	UINT64 Hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < Length; i++)
+	{
+		Hash ^= (UINT64)(unsigned char)NormalizePathChar(Path[i]);
+		Hash *= 1099511628211ULL;
+	}
+
+	return Hash;
+}
+
+bool RAssetArchive::IsSamePath(const char* First, size_t FirstLength, const char* Second, size_t SecondLength)
+{
+	if (FirstLength != SecondLength)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < FirstLength; i++)
+	{
+		if (NormalizePathChar(First[i]) != NormalizePathChar(Second[i]))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void RAssetArchiveWriter::AddFile(const std::string& AssetPath, const std::string& FileSystemPath)
+{
+	Files.push_back({ MakeArchivePath(AssetPath), FileSystemPath, 0 });
+}
+
+void RAssetArchiveWriter::AddStrippedFile(const std::string& AssetPath)
+{
+	Files.push_back({ MakeArchivePath(AssetPath), std::string(), AEF_Stripped });
+}
+
+bool RAssetArchiveWriter::Write(const std::string& ArchivePath)
+{
+	WrittenDataSize = 0;
+
+	std::ofstream Output(ArchivePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!Output.is_open())
+	{
+		RLogError("Failed to create asset archive %s.\n", ArchivePath.c_str());
+		return false;
+	}
+
+	// Pack files in path order so the same assets always produce the same archive
+	std::vector<const PendingFile*> SortedFiles;
+	for (const PendingFile& File : Files)
+	{
+		SortedFiles.push_back(&File);
+	}
+
+	std::stable_sort(SortedFiles.begin(), SortedFiles.end(), [](const PendingFile* A, const PendingFile* B)
+	{
+		return A->AssetPath < B->AssetPath;
+	});
+
+	RAssetArchiveHeader ArchiveHeader;
+	memset(&ArchiveHeader, 0, sizeof(ArchiveHeader));
+	Output.write((const char*)&ArchiveHeader, sizeof(ArchiveHeader));
+
+	auto AlignOutput = [&Output](UINT64 Alignment)
+	{
+		static const char Padding[RAssetArchive::DataAlignment] = {};
+		UINT64 Offset = (UINT64)Output.tellp();
+		UINT64 PaddingSize = (Alignment - Offset % Alignment) % Alignment;
+		Output.write(Padding, (std::streamsize)PaddingSize);
+		return Offset + PaddingSize;
+	};
+
+	std::vector<RAssetArchiveEntry> Entries;
+	std::string PathTable;
+	std::vector<char> FileContent;
+
+	for (const PendingFile* File : SortedFiles)
+	{
+		RAssetArchiveEntry Entry;
+		memset(&Entry, 0, sizeof(Entry));
+		Entry.PathHash = RAssetArchive::HashPath(File->AssetPath.data(), File->AssetPath.size());
+		Entry.Flags = File->Flags;
+
+		// Paths differing only in case or separators can't be told apart by lookups
+		bool bDuplicate = false;
+		for (auto Iter = Entries.rbegin(); Iter != Entries.rend() && !bDuplicate; Iter++)
+		{
+			bDuplicate = Iter->PathHash == Entry.PathHash &&
+				RAssetArchive::IsSamePath(PathTable.data() + Iter->PathOffset, Iter->PathLength, File->AssetPath.data(), File->AssetPath.size());
+		}
+
+		if (bDuplicate)
+		{
+			RLogWarning("Skipped duplicated file %s in asset archive.\n", File->AssetPath.c_str());
+			continue;
+		}
+
+		if ((File->Flags & AEF_Stripped) == 0)
+		{
+			std::ifstream Input(File->FileSystemPath, std::ios::in | std::ios::binary | std::ios::ate);
+			if (!Input.is_open())
+			{
+				RLogError("Failed to read %s for asset archive.\n", File->FileSystemPath.c_str());
+				return false;
+			}
+
+			FileContent.resize((size_t)Input.tellg());
+			Input.seekg(0);
+			Input.read(FileContent.data(), (std::streamsize)FileContent.size());
+
+			Entry.DataOffset = AlignOutput(RAssetArchive::DataAlignment);
+			Entry.DataSize = FileContent.size();
+			Output.write(FileContent.data(), (std::streamsize)FileContent.size());
+
+			WrittenDataSize += Entry.DataSize;
+		}
+
+		Entry.PathOffset = (UINT32)PathTable.size();
+		Entry.PathLength = (UINT32)File->AssetPath.size();
+		PathTable += File->AssetPath;
+
+		Entries.push_back(Entry);
+	}
+
+	std::stable_sort(Entries.begin(), Entries.end(), [](const RAssetArchiveEntry& A, const RAssetArchiveEntry& B)
+	{
+		return A.PathHash < B.PathHash;
+	});
+
+	memcpy(ArchiveHeader.Magic, RAssetArchive::Magic, sizeof(ArchiveHeader.Magic));
+	ArchiveHeader.Version = RAssetArchive::CurrentVersion;
+	ArchiveHeader.NumEntries = (UINT32)Entries.size();
+
+	ArchiveHeader.TocOffset = AlignOutput(RAssetArchive::DataAlignment);
+	Output.write((const char*)Entries.data(), (std::streamsize)(Entries.size() * sizeof(RAssetArchiveEntry)));
+
+	ArchiveHeader.PathTableOffset = (UINT64)Output.tellp();
+	ArchiveHeader.PathTableSize = PathTable.size();
+	Output.write(PathTable.data(), (std::streamsize)PathTable.size());
+
+	Output.seekp(0);
+	Output.write((const char*)&ArchiveHeader, sizeof(ArchiveHeader));
+
+	if (!Output.good())
+	{
+		RLogError("Failed to write asset archive %s.\n", ArchivePath.c_str());
+		return false;
+	}
+
+	return true;
+}
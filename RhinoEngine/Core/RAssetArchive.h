@@ -0,0 +1,128 @@
+//=============================================================================
+// RAssetArchive.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Packed archive of asset files with a hashed table of contents
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+#include "Core/RMappedFile.h"
+
+// Layout of an asset archive (.rpak):
+//   RAssetArchiveHeader
+//   File contents, each aligned to RAssetArchive::DataAlignment
+//   Table of contents: an array of RAssetArchiveEntry sorted by path hash
+//   Path strings of all entries
+
+struct RAssetArchiveHeader
+{
+	char	Magic[4];
+	UINT32	Version;
+	UINT32	NumEntries;
+	UINT32	Reserved;
+	UINT64	TocOffset;
+	UINT64	PathTableOffset;
+	UINT64	PathTableSize;
+};
+
+enum EAssetArchiveEntryFlag : UINT32
+{
+	AEF_Stripped		= 1 << 0,		// Only the path is packed. The content is replaced by cooked data in another entry (e.g. .fbx by .rmesh)
+};
+
+struct RAssetArchiveEntry
+{
+	UINT64	PathHash;
+	UINT64	DataOffset;
+	UINT64	DataSize;
+	UINT32	PathOffset;
+	UINT32	PathLength;
+	UINT32	Flags;
+	UINT32	Reserved;
+};
+
+static_assert(sizeof(RAssetArchiveHeader) == 40, "Asset archive header must have a fixed layout");
+static_assert(sizeof(RAssetArchiveEntry) == 40, "Asset archive entry must have a fixed layout");
+
+/// A read-only asset archive mapped into memory. Entries are looked up by asset path ("/Dir/File.ext"),
+/// ignoring case and separator style.
+class RAssetArchive
+{
+public:
+	RAssetArchive();
+
+	/// Map an archive file and validate its table of contents
+	bool Open(const std::string& ArchivePath);
+	void Close();
+
+	bool IsOpen() const;
+
+	/// Find an entry by asset path. Returns nullptr if the archive has no such file.
+	const RAssetArchiveEntry* FindEntry(const std::string& AssetPath) const;
+
+	/// Get content of an entry. The memory stays valid until the archive is closed.
+	const char* GetEntryData(const RAssetArchiveEntry& Entry) const;
+
+	/// Get the asset path an entry was packed with
+	std::string GetEntryPath(const RAssetArchiveEntry& Entry) const;
+
+	int GetNumEntries() const;
+	const RAssetArchiveEntry& GetEntry(int Index) const;
+
+	const std::string& GetArchivePath() const		{ return ArchivePath; }
+
+	/// Hash an asset path for lookup. Case-insensitive and '\' is treated as '/'.
+	static UINT64 HashPath(const char* Path, size_t Length);
+
+	/// Compare two asset paths the way lookups do
+	static bool IsSamePath(const char* First, size_t FirstLength, const char* Second, size_t SecondLength);
+
+	static const char	Magic[4];
+	static const UINT32	CurrentVersion = 1;
+
+	/// Alignment of file contents in the archive, so mapped data can be read in place
+	static const UINT64	DataAlignment = 16;
+
+private:
+	RMappedFile					MappedFile;
+	std::string					ArchivePath;
+
+	const RAssetArchiveHeader*	Header;
+	const RAssetArchiveEntry*	Entries;
+	const char*					PathTable;
+};
+
+/// Builds an asset archive file. Used by the offline asset packer.
+class RAssetArchiveWriter
+{
+public:
+	RAssetArchiveWriter()
+		: WrittenDataSize(0)
+	{}
+
+	/// Add a file to the archive. Its content is read when the archive is written.
+	void AddFile(const std::string& AssetPath, const std::string& FileSystemPath);
+
+	/// Add a file without content, so its path can still be found in the archive
+	void AddStrippedFile(const std::string& AssetPath);
+
+	/// Write all added files to an archive. Returns false if any file fails to be read or written.
+	bool Write(const std::string& ArchivePath);
+
+	int GetNumFiles() const							{ return (int)Files.size(); }
+
+	/// Get total bytes of file contents in the last written archive
+	UINT64 GetWrittenDataSize() const				{ return WrittenDataSize; }
+
+private:
+	struct PendingFile
+	{
+		std::string		AssetPath;
+		std::string		FileSystemPath;
+		UINT32			Flags;
+	};
+
+	std::vector<PendingFile>	Files;
+	UINT64						WrittenDataSize;
+};
@@ -0,0 +1,152 @@
+//=============================================================================
+// RChunkedFile.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RChunkedFile.h"
+
+RChunkedFileWriter::RChunkedFileWriter(RSerializer& InSerializer)
+	: Serializer(InSerializer)
+	, bInChunk(false)
+{
+	memset(&Header, 0, sizeof(Header));
+}
+
+void RChunkedFileWriter::Begin(const char* Magic, int MaxChunks)
+{
+	assert(Serializer.IsWriting());
+
+	memcpy(Header.Magic, Magic, sizeof(Header.Magic));
+	Header.FormatVersion = FormatVersion;
+	Header.NumChunks = 0;
+	Header.TocCapacity = (UINT32)MaxChunks;
+
+	Serializer.SerializeData(Header);
+
+	RChunkedFileEntry EmptyEntry;
+	memset(&EmptyEntry, 0, sizeof(EmptyEntry));
+	for (int i = 0; i < MaxChunks; i++)
+	{
+		Serializer.SerializeData(EmptyEntry);
+	}
+}
+
+void RChunkedFileWriter::BeginChunk(UINT32 Id, UINT32 Version)
+{
+	assert(!bInChunk && Chunks.size() < Header.TocCapacity);
+
+	UINT8 Padding = 0;
+	while (Serializer.Tell() % ChunkAlignment != 0)
+	{
+		Serializer.SerializeData(Padding);
+	}
+
+	RChunkedFileEntry Entry;
+	Entry.Id = Id;
+	Entry.Version = Version;
+	Entry.Offset = Serializer.Tell();
+	Entry.Size = 0;
+
+	Chunks.push_back(Entry);
+	bInChunk = true;
+}
+
+void RChunkedFileWriter::EndChunk()
+{
+	assert(bInChunk);
+
+	RChunkedFileEntry& Entry = Chunks.back();
+	Entry.Size = Serializer.Tell() - Entry.Offset;
+	bInChunk = false;
+}
+
+void RChunkedFileWriter::End()
+{
+	assert(!bInChunk);
+
+	const size_t EndOffset = Serializer.Tell();
+
+	Header.NumChunks = (UINT32)Chunks.size();
+	Serializer.Seek(0);
+	Serializer.SerializeData(Header);
+	for (RChunkedFileEntry& Entry : Chunks)
+	{
+		Serializer.SerializeData(Entry);
+	}
+
+	Serializer.Seek(EndOffset);
+}
+
+bool RChunkedFileReader::ReadHeader(RSerializer& Serializer, const char* Magic)
+{
+	assert(Serializer.IsReading());
+
+	Chunks.clear();
+
+	const size_t StartOffset = Serializer.Tell();
+
+	// Check magic first, so files in other formats can be read from the start again
+	if (!Serializer.EnsureHeader(Magic, 4))
+	{
+		Serializer.Seek(StartOffset);
+		return false;
+	}
+
+	RChunkedFileHeader Header;
+	Serializer.SerializeData(Header.FormatVersion);
+	Serializer.SerializeData(Header.NumChunks);
+	Serializer.SerializeData(Header.TocCapacity);
+
+	if (Serializer.HasError() || Header.FormatVersion > RChunkedFileWriter::FormatVersion || Header.NumChunks > Header.TocCapacity)
+	{
+		Serializer.Seek(StartOffset);
+		return false;
+	}
+
+	// Both counts come from the file. Don't trust them for allocating more entries than the file can hold.
+	const UINT64 TocSize = (UINT64)Header.TocCapacity * sizeof(RChunkedFileEntry);
+	if (TocSize > (UINT64)(Serializer.GetReadSize() - Serializer.Tell()))
+	{
+		Serializer.Seek(StartOffset);
+		return false;
+	}
+
+	// Chunks must lie within the file, so a corrupted table of contents never sends reads past the end of data
+	const UINT64 FileSize = (UINT64)Serializer.GetReadSize();
+	bool bChunksInFile = true;
+
+	Chunks.resize(Header.NumChunks);
+	for (RChunkedFileEntry& Entry : Chunks)
+	{
+		Serializer.SerializeData(Entry);
+		bChunksInFile &= Entry.Offset <= FileSize && Entry.Size <= FileSize - Entry.Offset;
+	}
+
+	if (Serializer.HasError() || !bChunksInFile)
+	{
+		Chunks.clear();
+		Serializer.Seek(StartOffset);
+		return false;
+	}
+
+	return true;
+}
+
+const RChunkedFileEntry* RChunkedFileReader::FindChunk(UINT32 Id) const
+{
+	for (const RChunkedFileEntry& Entry : Chunks)
+	{
+		if (Entry.Id == Id)
+		{
+			return &Entry;
+		}
+	}
+
+	return nullptr;
+}
+
+bool RChunkedFileReader::SeekToChunk(RSerializer& Serializer, const RChunkedFileEntry& Chunk)
+{
+	return Serializer.Seek((size_t)Chunk.Offset);
+}
@@ -0,0 +1,86 @@
+//=============================================================================
+// RChunkedFile.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Binary files made of versioned chunks with a table of contents
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+#include "Core/RSerializer.h"
+
+// Layout of a chunked file:
+//   RChunkedFileHeader
+//   Table of contents: TocCapacity entries of RChunkedFileEntry, of which the first NumChunks are used
+//   Chunk data, each aligned to RChunkedFileWriter::ChunkAlignment
+
+struct RChunkedFileHeader
+{
+	char	Magic[4];
+	UINT32	FormatVersion;
+	UINT32	NumChunks;
+	UINT32	TocCapacity;
+};
+
+struct RChunkedFileEntry
+{
+	UINT32	Id;
+	UINT32	Version;
+	UINT64	Offset;
+	UINT64	Size;
+};
+
+static_assert(sizeof(RChunkedFileHeader) == 16, "Chunked file header must have a fixed layout");
+static_assert(sizeof(RChunkedFileEntry) == 24, "Chunked file entry must have a fixed layout");
+
+/// Make a chunk id from four characters
+constexpr UINT32 MakeChunkId(char a, char b, char c, char d)
+{
+	return (UINT32)(UINT8)a | ((UINT32)(UINT8)b << 8) | ((UINT32)(UINT8)c << 16) | ((UINT32)(UINT8)d << 24);
+}
+
+/// Writes chunks to a serializer opened in write mode
+class RChunkedFileWriter
+{
+public:
+	RChunkedFileWriter(RSerializer& InSerializer);
+
+	/// Write the file header and reserve space for the table of contents
+	void Begin(const char* Magic, int MaxChunks);
+
+	/// Start a chunk. Everything serialized until EndChunk is part of the chunk.
+	void BeginChunk(UINT32 Id, UINT32 Version);
+	void EndChunk();
+
+	/// Write the table of contents. The serializer is left at the end of file.
+	void End();
+
+	static const UINT32 FormatVersion = 1;
+	static const size_t ChunkAlignment = 16;
+
+private:
+	RSerializer&					Serializer;
+	RChunkedFileHeader				Header;
+	std::vector<RChunkedFileEntry>	Chunks;
+	bool							bInChunk;
+};
+
+/// Reads the table of contents of a chunked file and locates chunks
+class RChunkedFileReader
+{
+public:
+	/// Read the file header and table of contents. Returns false if the file doesn't start with the magic
+	/// or is corrupted, in which case the serializer is moved back to where it was.
+	bool ReadHeader(RSerializer& Serializer, const char* Magic);
+
+	/// Find a chunk by id. Returns nullptr if the file has no such chunk.
+	const RChunkedFileEntry* FindChunk(UINT32 Id) const;
+
+	/// Move a serializer to the beginning of a chunk
+	static bool SeekToChunk(RSerializer& Serializer, const RChunkedFileEntry& Chunk);
+
+	const std::vector<RChunkedFileEntry>& GetChunks() const		{ return Chunks; }
+
+private:
+	std::vector<RChunkedFileEntry>	Chunks;
+};
@@ -10,6 +10,9 @@
 
 #include "AI/NavigationSystem/RNavigationSystem.h"
 #include "Physics/RPhysicsEngine.h"
+#include "RThreadPool.h"
+#include "RProfiler.h"
+#include "RLog.h"
 
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_win32.h"
@@ -22,11 +25,13 @@
 #include "RenderSystem/RShaderManager.h"
 #include "RenderSystem/RDebugRenderer.h"
 #include "RenderSystem/RPostProcessorManager.h"
+#include "RenderSystem/RNullRenderDevice.h"
 #include "Resource/RResourceManager.h"
 #include "RScriptSystem.h"
 #include "RInput.h"
 #include "IApp.h"
 
+#include <chrono>
 
 static TCHAR szWindowClass[] = _T("rhinoapp");
 
@@ -35,6 +40,7 @@ LRESULT CALLBACK WndProc(HWND, UINT, WPARAM, LPARAM);
 REngine::REngine()
 	: m_bIsEditor					(false),
 	  m_bIsInitialized				(false),
+	  m_bHeadless					(false),
 	  m_hInstance					(nullptr),
 	  m_hWnd						(nullptr),
 	  m_bFullScreen					(false),
@@ -53,6 +59,7 @@ REngine::~REngine()
 bool REngine::Initialize(const REngineInitParam& InitParam /*= REngineInitParam()*/)
 {
 	m_Application = InitParam.Application;
+	m_bHeadless = InitParam.bHeadless;
 
 	RegisterEngineTypes();
 	CreateImGuiContext();
@@ -60,42 +67,86 @@ bool REngine::Initialize(const REngineInitParam& InitParam /*= REngineInitParam(
 	int width = InitParam.WindowWidth;
 	int height = InitParam.WindowHeight;
 
-	if (width == -1 || height == -1)
+	if (m_bHeadless)
 	{
-		width = GetSystemMetrics(SM_CXSCREEN);
-		height = GetSystemMetrics(SM_CYSCREEN);
+		// There's no screen to match, so render at a fixed resolution
+		if (width == -1 || height == -1)
+		{
+			width = 1920;
+			height = 1080;
+		}
 	}
-
-	if (!CreateRenderWindow(width, height, InitParam.bFullScreen))
+	else
 	{
-		return false;
+		if (width == -1 || height == -1)
+		{
+			width = GetSystemMetrics(SM_CXSCREEN);
+			height = GetSystemMetrics(SM_CYSCREEN);
+		}
+
+		if (!CreateRenderWindow(width, height, InitParam.bFullScreen))
+		{
+			return false;
+		}
 	}
 
-	m_bIsInitialized = InitializeSubsystems(width, height);
+	m_bIsInitialized = InitializeSubsystems(InitParam, width, height);
 	return m_bIsInitialized;
 }
 
-bool REngine::InitializeSubsystems(int width, int height)
+bool REngine::InitializeSubsystems(const REngineInitParam& InitParam, int width, int height)
 {
+	if (InitParam.bAsyncLogging)
+	{
+		GLogOutputTargets.StartAsyncOutput();
+	}
+
+	if (!InitParam.LogFilePath.empty())
+	{
+		GLogOutputTargets.AddSink(std::make_shared<RRotatingFileLogSink>(InitParam.LogFilePath));
+	}
+
+	GProfiler.SetThreadName("Main");
+
+	if (InitParam.ProfilerCaptureFrames > 0)
+	{
+		GProfiler.StartCapture(InitParam.ProfilerCaptureFrames, InitParam.ProfilerTraceFilePath);
+	}
+
+	GThreadPool.Initialize(InitParam.NumWorkerThreads);
+
 	if (!RInput.Initialize())
 	{
 		return false;
 	}
 
-	if (!GRenderer.Initialize(m_hWnd, width, height, true))
+	if (m_bHeadless)
 	{
-		return false;
+		if (!GRenderer.InitializeNullDevice(width, height))
+		{
+			return false;
+		}
+
+		ImGui::GetIO().DisplaySize = ImVec2((float)width, (float)height);
 	}
+	else
+	{
+		if (!GRenderer.Initialize(m_hWnd, width, height, true))
+		{
+			return false;
+		}
 
-	InitImGuiWindowAndDevice(m_hWnd);
+		InitImGuiWindowAndDevice(m_hWnd);
+	}
 
-	if (!GPhysicsEngine.Initialize())
+	if (!GPhysicsEngine.Initialize(InitParam.PhysicsSettings))
 	{
 		return false;
 	}
 
 	// Initialize resource manager
-	RResourceManager::Instance().Initialize();
+	RResourceManager::Instance().Initialize(InitParam.NumResourceLoaderThreads);
+	RResourceManager::Instance().SetMemoryBudget(InitParam.ResourceMemoryBudget);
 
 	// Initialize shaders
 	GShaderManager.LoadShaders(RShaderManager::GetShaderRootPath());
@@ -136,6 +187,7 @@ void REngine::Shutdown()
 	RResourceManager::Instance().Destroy();
 
 	GPhysicsEngine.Shutdown();
+	GThreadPool.Shutdown();
 
 	ShutdownImGui();
 
@@ -145,6 +197,8 @@ void REngine::Shutdown()
 	if (m_UseEngineRenderWindow)
 		DestroyRenderWindow();
 
+	GLogOutputTargets.StopAsyncOutput();
+
 	m_bIsInitialized = false;
 }
 
@@ -212,15 +266,25 @@ void REngine::Run()
 
 void REngine::RunOneFrame(bool update_input)
 {
-	// Update the resource manager
-	RResourceManager::Instance().Update();
+	GProfiler.BeginFrame(FrameCounter);
 
-	if (update_input)
 	{
-		RInput._UpdateKeyStates(m_hWnd);
+		RPROFILE_SCOPE("Resource manager update");
+
+		// Update the resource manager
+		RResourceManager::Instance().Update();
 	}
 
-	RInput.CheckAndExecuteKeyBindings();
+	{
+		RPROFILE_SCOPE("Input");
+
+		if (update_input)
+		{
+			RInput._UpdateKeyStates(m_hWnd);
+		}
+
+		RInput.CheckAndExecuteKeyBindings();
+	}
 
 	m_Timer.Tick();
 
@@ -228,33 +292,108 @@ void REngine::RunOneFrame(bool update_input)
 
 	if (m_Application)
 	{
+		RPROFILE_SCOPE("App update");
 		m_Application->UpdateScene(m_Timer);
 	}
 
 	const float DeltaTime = m_Timer.DeltaTime();
 
 	// Update all registered scenes with their objects
-	GSceneManager.Update(DeltaTime);
-	GPhysicsEngine.Simulate(DeltaTime);
-	GSceneManager.Update_PostPhysics(DeltaTime);
+	{
+		RPROFILE_SCOPE("Scene update");
+		GSceneManager.Update(DeltaTime);
+	}
+
+	{
+		RPROFILE_SCOPE("Physics");
+		GPhysicsEngine.Simulate(DeltaTime);
+	}
+
+	{
+		RPROFILE_SCOPE("Scene post-physics update");
+		GSceneManager.Update_PostPhysics(DeltaTime);
+	}
 
 	if (!m_bIsEditor)
 	{
+		RPROFILE_SCOPE("Scripts");
 		GScriptSystem.UpdateScriptableObjects();
 	}
 
-	GRenderer.Stats.Reset();
-	if (m_Application && m_Application->UsingCustomRenderPipeline())
 	{
-		m_Application->RenderScene();
+		RPROFILE_SCOPE("Render");
+
+		GRenderer.Stats.Reset();
+		if (m_Application && m_Application->UsingCustomRenderPipeline())
+		{
+			m_Application->RenderScene();
+		}
+		else
+		{
+			GRenderer.RenderFrame();
+		}
+
+		EndImGuiFrame();
 	}
-	else
+
 	{
-		GRenderer.RenderFrame();
+		RPROFILE_SCOPE("Present");
+		GRenderer.Present();
 	}
 
-	EndImGuiFrame();
-	GRenderer.Present();
+	GProfiler.EndFrame();
+}
+
+RFrameTimeStats REngine::RunHeadless(const RHeadlessRunParams& Params)
+{
+	if (!m_bHeadless)
+	{
+		RLogError("Engine must be initialized headless to run headless frames\n");
+		return RFrameTimeStats();
+	}
+
+	// Commands are only counted, so the command log doesn't grow with every frame
+	if (RRenderCommandLog* CommandLog = GRenderer.Device()->GetCommandLog())
+	{
+		CommandLog->SetRecordCommands(false);
+	}
+
+	m_Timer.SetFixedDeltaTime(Params.FixedDeltaTime);
+	m_Timer.Reset();
+
+	std::vector<float> FrameTimesMs;
+	FrameTimesMs.reserve(RMath::Max(Params.NumFrames, 0));
+
+	for (int FrameIndex = 0; FrameIndex < Params.NumWarmupFrames + Params.NumFrames; FrameIndex++)
+	{
+		auto StartTime = std::chrono::high_resolution_clock::now();
+		RunOneFrame();
+		auto EndTime = std::chrono::high_resolution_clock::now();
+
+		if (FrameIndex < Params.NumWarmupFrames)
+		{
+			// Finish loading before measuring, so measured frames don't depend on how fast loader threads were
+			RResourceManager::Instance().GetLoaderPool().WaitUntilIdle();
+		}
+		else
+		{
+			FrameTimesMs.push_back(std::chrono::duration<float, std::milli>(EndTime - StartTime).count());
+		}
+
+		FrameCounter++;
+	}
+
+	m_Timer.SetFixedDeltaTime(0.0f);
+
+	RFrameTimeStats Stats = RFrameTimeStats::FromFrameTimes(FrameTimesMs);
+	Stats.Log();
+
+	if (!Params.ResultFilePath.empty() && Stats.WriteJson(Params.ResultFilePath))
+	{
+		RLog("Wrote frame time stats to '%s'\n", Params.ResultFilePath.c_str());
+	}
+
+	return Stats;
 }
 
 void REngine::ResizeClientWindow(int width, int height)
@@ -420,9 +559,17 @@ void REngine::CalculateFrameStats()
 
 	static int frameCnt = 0;
 	static float timeElapsed = 0.0f;
+	static int physicsStepCnt = 0;
+	static float physicsStepTime = 0.0f;
+	static float physicsLag = 0.0f;
 
 	frameCnt++;
 
+	const RPhysicsStats& PhysicsStats = GPhysicsEngine.GetStats();
+	physicsStepCnt += PhysicsStats.NumSteps;
+	physicsStepTime += PhysicsStats.TotalStepTimeMs;
+	physicsLag = RMath::Max(physicsLag, PhysicsStats.LagMs);
+
 	// Compute averages over one second period.
 	if ((m_Timer.TotalTime() - timeElapsed) >= 1.0f)
 	{
@@ -434,11 +581,16 @@ void REngine::CalculateFrameStats()
 		outs << GetWindowTitle()
 			<< L" - " << GRenderer.GetAdapterName() << L"    "
 			<< L"FPS: " << fps << L"    "
-			<< L"Frame Time: " << mspf << L" (ms)";
+			<< L"Frame Time: " << mspf << L" (ms)    "
+			<< L"Physics Step: " << (physicsStepCnt > 0 ? physicsStepTime / physicsStepCnt : 0.0f) << L" (ms)    "
+			<< L"Physics Lag: " << physicsLag << L" (ms)";
 		SetWindowText(m_hWnd, outs.str().c_str());
 
 		// Reset for next average.
 		frameCnt = 0;
+		physicsStepCnt = 0;
+		physicsStepTime = 0.0f;
+		physicsLag = 0.0f;
 		timeElapsed += 1.0f;
 	}
 }
@@ -462,23 +614,40 @@ void REngine::InitImGuiWindowAndDevice(HWND hWnd)
 
 void REngine::ShutdownImGui()
 {
-	ImGui_ImplDX11_Shutdown();
-	ImGui_ImplWin32_Shutdown();
+	if (!m_bHeadless)
+	{
+		ImGui_ImplDX11_Shutdown();
+		ImGui_ImplWin32_Shutdown();
+	}
+
 	imnodes::Shutdown();
 	ImGui::DestroyContext();
 }
 
 void REngine::BeginImGuiFrame()
 {
-	ImGui_ImplDX11_NewFrame();
-	ImGui_ImplWin32_NewFrame();
+	if (m_bHeadless)
+	{
+		// No platform backend updates the frame time without a window
+		ImGui::GetIO().DeltaTime = RMath::Max(m_Timer.DeltaTime(), 1e-4f);
+	}
+	else
+	{
+		ImGui_ImplDX11_NewFrame();
+		ImGui_ImplWin32_NewFrame();
+	}
+
 	ImGui::NewFrame();
 }
 
 void REngine::EndImGuiFrame()
 {
 	ImGui::Render();
-	ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+
+	if (!m_bHeadless)
+	{
+		ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+	}
 }
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
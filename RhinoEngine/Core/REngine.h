@@ -7,6 +7,8 @@
 
 #include "RTimer.h"
 #include "RSingleton.h"
+#include "RFrameTimeStats.h"
+#include "Physics/RPhysicsEngine.h"
 
 #include <Windows.h>
 
@@ -31,6 +33,49 @@ struct REngineInitParam
 
 	// If true, the render window will be created in full screen mode
 	bool bFullScreen = false;
+
+	// If true, no window is created and the renderer runs on a null device without a GPU. ImGui frames are built but not drawn.
+	// Frames are run by RunHeadless instead of Run.
+	bool bHeadless = false;
+
+	// Number of engine worker threads. If -1, one worker is created for each hardware thread except the main thread.
+	int NumWorkerThreads = -1;
+
+	// Number of resource loader threads. If -1, one loader is created for each hardware thread except the main thread.
+	int NumResourceLoaderThreads = -1;
+
+	// Number of bytes loaded resources may use before unreferenced ones are evicted. If 0, resources are never evicted.
+	size_t ResourceMemoryBudget = 0;
+
+	// How the physics world is created and stepped
+	RPhysicsSettings PhysicsSettings;
+
+	// If true, logs are formatted and written out on a background thread
+	bool bAsyncLogging = true;
+
+	// If not empty, logs are also written to this file. The file is rotated when it grows large.
+	std::string LogFilePath;
+
+	// If greater than 0, the profiler captures scopes of this many frames from the start and writes them to the trace file
+	int ProfilerCaptureFrames = 0;
+
+	// Chrome trace file written when a profiler capture finishes
+	std::string ProfilerTraceFilePath = "ProfilerTrace.json";
+};
+
+struct RHeadlessRunParams
+{
+	// Number of frames measured
+	int NumFrames = 600;
+
+	// Frames run before measuring. Resources queued for loading are waited for at the end of each of these frames.
+	int NumWarmupFrames = 60;
+
+	// Time passed in every frame, so each run simulates the same frames regardless of how fast they run
+	float FixedDeltaTime = 1.0f / 60.0f;
+
+	// If not empty, frame time stats are written to this file as JSON
+	std::string ResultFilePath;
 };
 
 class REngine : public RSingleton<REngine>
@@ -48,6 +93,9 @@ public:
 
 	void RunOneFrame(bool update_input = false);
 
+	/// Run frames with a fixed time step and measure the time each one takes. The engine must be initialized headless.
+	RFrameTimeStats RunHeadless(const RHeadlessRunParams& Params);
+
 	void ResizeClientWindow(int width, int height);
 	RECT GetWindowRectInfo() const;
 	RECT GetClientRectInfo() const;
@@ -59,6 +107,9 @@ public:
 	/// Has engine been initialized
 	bool IsInitialized() const { return m_bIsInitialized; }
 
+	/// Is engine running without a window and a GPU
+	bool IsHeadless() const { return m_bHeadless; }
+
 	void SetEditorMode(bool editor) { m_bIsEditor = editor; }
 	bool IsEditor() const { return m_bIsEditor; }
 
@@ -71,7 +122,7 @@ protected:
 
 private:
 	// Initialize all subsystems of engine
-	bool InitializeSubsystems(int width, int height);
+	bool InitializeSubsystems(const REngineInitParam& InitParam, int width, int height);
 
 	void RegisterEngineTypes();
 
@@ -88,6 +139,7 @@ private:
 	bool				m_bIsEditor;
 
 	bool				m_bIsInitialized;
+	bool				m_bHeadless;
 	HINSTANCE			m_hInstance;				// Program instance handle
 	HWND				m_hWnd;						// Window handle
 	bool				m_bFullScreen;
@@ -8,8 +8,15 @@
 
 #include "RLog.h"
 
+#if PLATFORM_WINDOWS
 // Win32 file system APIs
 #include <Shlwapi.h>
+#else
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 std::vector<std::string> RFileUtil::WorkingPathStack;
 const std::string RFileUtil::InvalidPath("<InvalidPath>");
@@ -102,6 +109,8 @@ std::string RFileUtil::StripExtension(const std::string& filename)
 	return filename;
 }
 
+#if PLATFORM_WINDOWS
+
 bool RFileUtil::CheckIsRelativePath(const std::string& path)
 {
 	return PathIsRelativeA(path.c_str()) == TRUE;
@@ -218,6 +227,132 @@ std::vector<std::string> RFileUtil::GetFilesInDirectoryAndSubdirectories(const s
 	return SearchResult;
 }
 
+#else
+
+bool RFileUtil::CheckIsRelativePath(const std::string& path)
+{
+	return path.size() == 0 || path[0] != '/';
+}
+
+bool RFileUtil::CheckPathExists(const std::string& Path)
+{
+	struct stat FileStat;
+	return stat(Path.c_str(), &FileStat) == 0;
+}
+
+bool RFileUtil::CreateDirectory(const std::string& PathName)
+{
+	return mkdir(PathName.c_str(), 0755) == 0;
+}
+
+ETimestampComparison RFileUtil::CompareFileTimestamp(const std::string& First, const std::string& Second)
+{
+	struct stat FirstStat, SecondStat;
+	if (stat(First.c_str(), &FirstStat) != 0 || stat(Second.c_str(), &SecondStat) != 0)
+	{
+		return ETimestampComparison::InvalidFile;
+	}
+
+#if PLATFORM_MACOS
+	const struct timespec& FirstTimestamp = FirstStat.st_mtimespec;
+	const struct timespec& SecondTimestamp = SecondStat.st_mtimespec;
+#else
+	const struct timespec& FirstTimestamp = FirstStat.st_mtim;
+	const struct timespec& SecondTimestamp = SecondStat.st_mtim;
+#endif
+
+	if (FirstTimestamp.tv_sec != SecondTimestamp.tv_sec)
+	{
+		return FirstTimestamp.tv_sec < SecondTimestamp.tv_sec ? ETimestampComparison::EarlierFirst : ETimestampComparison::EarlierSecond;
+	}
+	else if (FirstTimestamp.tv_nsec != SecondTimestamp.tv_nsec)
+	{
+		return FirstTimestamp.tv_nsec < SecondTimestamp.tv_nsec ? ETimestampComparison::EarlierFirst : ETimestampComparison::EarlierSecond;
+	}
+	else
+	{
+		return ETimestampComparison::Equal;
+	}
+}
+
+void RFileUtil::PushWorkingPath(const std::string& NewPath)
+{
+	char pWorkingPath[1024] = {};
+	getcwd(pWorkingPath, sizeof(pWorkingPath));
+
+	WorkingPathStack.push_back(std::string(pWorkingPath));
+
+	if (chdir(NewPath.c_str()) == 0 && getcwd(pWorkingPath, sizeof(pWorkingPath)))
+	{
+		RLog("Working path has changed to: %s\n", pWorkingPath);
+	}
+}
+
+void RFileUtil::PopWorkingPath()
+{
+	assert(WorkingPathStack.size() > 0);
+
+	int NumPaths = (int)WorkingPathStack.size();
+	const std::string& PrevPath = WorkingPathStack[NumPaths - 1];
+	if (chdir(PrevPath.c_str()) == 0)
+	{
+		RLog("Working path has changed to: %s\n", PrevPath.c_str());
+	}
+
+	WorkingPathStack.pop_back();
+}
+
+std::vector<std::string> RFileUtil::GetFilesInDirectoryAndSubdirectories(const std::string& SearchPath, const std::string& FilePattern)
+{
+	std::vector<std::string> SearchResult;
+
+	// Load resources including sub-directories
+	std::queue<std::string> dir_queue;
+	dir_queue.push("");
+
+	do
+	{
+		const std::string dir_name = dir_queue.front();
+		dir_queue.pop();
+
+		DIR* Dir = opendir((SearchPath + dir_name).c_str());
+		if (!Dir)
+		{
+			continue;
+		}
+
+		while (dirent* Entry = readdir(Dir))
+		{
+			if (Entry->d_name[0] == '.')
+			{
+				continue;
+			}
+
+			struct stat FileStat;
+			if (stat((SearchPath + dir_name + Entry->d_name).c_str(), &FileStat) != 0)
+			{
+				continue;
+			}
+
+			if (S_ISDIR(FileStat.st_mode))
+			{
+				dir_queue.push(dir_name + std::string(Entry->d_name) + "/");
+			}
+			// "*.*" matches every file as it does on Windows, including those without an extension
+			else if (FilePattern == "*.*" || fnmatch(FilePattern.c_str(), Entry->d_name, 0) == 0)
+			{
+				SearchResult.push_back(std::string("/") + dir_name + Entry->d_name);
+			}
+		}
+
+		closedir(Dir);
+	} while (dir_queue.size());
+
+	return SearchResult;
+}
+
+#endif	// PLATFORM_WINDOWS
+
 std::string RFileUtil::UnifyPathSeperators(const std::string& Path)
 {
 	std::string Result = Path;
@@ -242,10 +377,16 @@ std::string RFileUtil::UnifyPathSeperators(const std::string& Path)
 
 std::string RFileUtil::GetFullPath(const std::string& Path)
 {
+#if PLATFORM_WINDOWS
 	char FullPath[MAX_PATH + 1];
 	GetFullPathNameA(Path.c_str(), MAX_PATH, FullPath, nullptr);
 
 	return std::string(FullPath);
+#else
+	// realpath only resolves existing paths
+	char FullPath[PATH_MAX];
+	return realpath(Path.c_str(), FullPath) ? std::string(FullPath) : Path;
+#endif
 }
 
 std::string RFileUtil::CombinePath(const std::string& First, const std::string& Second)
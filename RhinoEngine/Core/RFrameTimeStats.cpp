@@ -0,0 +1,90 @@
+//=============================================================================
+// RFrameTimeStats.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RFrameTimeStats.h"
+
+#include "Core/RLog.h"
+
+#include <algorithm>
+
+namespace
+{
+	/// Smallest time which at least the percentage of sorted frame times are within
+	float GetPercentile(const std::vector<float>& SortedTimesMs, int Percentage)
+	{
+		const int Rank = ((int)SortedTimesMs.size() * Percentage + 99) / 100;
+		return SortedTimesMs[RMath::Max(Rank, 1) - 1];
+	}
+}
+
+RFrameTimeStats RFrameTimeStats::FromFrameTimes(const std::vector<float>& FrameTimesMs)
+{
+	RFrameTimeStats Stats;
+
+	if (FrameTimesMs.size() == 0)
+	{
+		return Stats;
+	}
+
+	std::vector<float> SortedTimesMs = FrameTimesMs;
+	std::sort(SortedTimesMs.begin(), SortedTimesMs.end());
+
+	double TotalMs = 0.0;
+	for (float TimeMs : SortedTimesMs)
+	{
+		TotalMs += TimeMs;
+	}
+
+	Stats.NumFrames = (int)SortedTimesMs.size();
+	Stats.MinMs = SortedTimesMs.front();
+	Stats.MeanMs = (float)(TotalMs / SortedTimesMs.size());
+	Stats.MaxMs = SortedTimesMs.back();
+	Stats.P50Ms = GetPercentile(SortedTimesMs, 50);
+	Stats.P90Ms = GetPercentile(SortedTimesMs, 90);
+	Stats.P95Ms = GetPercentile(SortedTimesMs, 95);
+	Stats.P99Ms = GetPercentile(SortedTimesMs, 99);
+
+	return Stats;
+}
+
+std::string RFrameTimeStats::ToJson() const
+{
+	char Json[512];
+	snprintf(Json, sizeof(Json),
+		"{\n"
+		"  \"frames\": %d,\n"
+		"  \"min_ms\": %.4f,\n"
+		"  \"mean_ms\": %.4f,\n"
+		"  \"max_ms\": %.4f,\n"
+		"  \"p50_ms\": %.4f,\n"
+		"  \"p90_ms\": %.4f,\n"
+		"  \"p95_ms\": %.4f,\n"
+		"  \"p99_ms\": %.4f\n"
+		"}\n",
+		NumFrames, MinMs, MeanMs, MaxMs, P50Ms, P90Ms, P95Ms, P99Ms);
+
+	return Json;
+}
+
+bool RFrameTimeStats::WriteJson(const std::string& FilePath) const
+{
+	std::ofstream FileStream(FilePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!FileStream.is_open())
+	{
+		RLogError("Failed to open frame time file \'%s\'\n", FilePath.c_str());
+		return false;
+	}
+
+	FileStream << ToJson();
+	return FileStream.good();
+}
+
+void RFrameTimeStats::Log() const
+{
+	RLog("=== Frame times: %d frames ===\n", NumFrames);
+	RLog("  min: %.3f ms, mean: %.3f ms, max: %.3f ms\n", MinMs, MeanMs, MaxMs);
+	RLog("  p50: %.3f ms, p90: %.3f ms, p95: %.3f ms, p99: %.3f ms\n", P50Ms, P90Ms, P95Ms, P99Ms);
+}
@@ -0,0 +1,35 @@
+//=============================================================================
+// RFrameTimeStats.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Percentiles of frame times, for tracking performance of benchmark runs
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+
+struct RFrameTimeStats
+{
+	int		NumFrames = 0;
+
+	float	MinMs = 0.0f;
+	float	MeanMs = 0.0f;
+	float	MaxMs = 0.0f;
+
+	// Nearest-rank percentiles. P99Ms is the time 99% of frames finished within.
+	float	P50Ms = 0.0f;
+	float	P90Ms = 0.0f;
+	float	P95Ms = 0.0f;
+	float	P99Ms = 0.0f;
+
+	/// Compute stats from the time of each frame in milliseconds
+	static RFrameTimeStats FromFrameTimes(const std::vector<float>& FrameTimesMs);
+
+	/// Get the stats as a JSON object
+	std::string ToJson() const;
+
+	/// Write the stats to a JSON file. Returns false if the file can't be written.
+	bool WriteJson(const std::string& FilePath) const;
+
+	void Log() const;
+};
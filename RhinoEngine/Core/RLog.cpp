@@ -8,36 +8,803 @@
 
 #include "Core/CoreTypes.h"
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdarg>
+#include <cctype>
+
+namespace
+{
+	// Size of the ring buffer of each logging thread
+	const size_t LogBufferCapacity = 256 * 1024;
+
+	// Value of NumArgs marking the rest of the buffer as unused before wrapping around
+	const UINT32 PaddingRecord = 0xFFFFFFFF;
+
+	struct RLogRecordHeader
+	{
+		UINT32	Size;			// Size of the record including its header, a multiple of 8
+		UINT32	NumArgs;
+		UINT64	Sequence;		// Orders records from different threads
+		UINT32	FormatLength;
+	};
+
+	/// Ring buffer of log records with one writing thread and one reading thread
+	struct RLogThreadBuffer
+	{
+		RLogThreadBuffer()
+			: Data(new UINT8[LogBufferCapacity])
+			, WritePos(0)
+			, ReadPos(0)
+			, bThreadExited(false)
+			, PendingWritePos(0)
+		{}
+
+		std::unique_ptr<UINT8[]>	Data;
+
+		// Total number of bytes written by the owning thread and consumed by the output thread.
+		// Positions in the buffer are these modulo the capacity.
+		std::atomic<size_t>			WritePos;
+		std::atomic<size_t>			ReadPos;
+
+		std::atomic<bool>			bThreadExited;
+
+		// End of the record between BeginRecord and EndRecord. Only used by the owning thread.
+		size_t						PendingWritePos;
+	};
+
+	/// Buffers of the calling thread, one for each output targets instance it has logged to.
+	/// Lets output threads know the buffers can be freed once they're empty.
+	struct RLogThreadBufferOwner
+	{
+		~RLogThreadBufferOwner()
+		{
+			for (const auto& Entry : Entries)
+			{
+				Entry.Buffer->bThreadExited = true;
+			}
+		}
+
+		RLogThreadBuffer* Find(UINT64 ContextId) const
+		{
+			for (const auto& Entry : Entries)
+			{
+				if (Entry.ContextId == ContextId)
+				{
+					return Entry.Buffer.get();
+				}
+			}
+
+			return nullptr;
+		}
+
+		struct REntry
+		{
+			UINT64								ContextId;
+
+			// Shared with the context, so a context destroyed before the thread exits leaves nothing dangling
+			std::shared_ptr<RLogThreadBuffer>	Buffer;
+		};
+
+		std::vector<REntry> Entries;
+	};
+
+	thread_local RLogThreadBufferOwner ThreadBufferOwner;
+
+	// Identifies output contexts in thread buffer owners. Addresses of destroyed contexts may be reused.
+	std::atomic<UINT64> NextContextId(0);
+
+	FORCEINLINE size_t AlignRecordSize(size_t Size)
+	{
+		return (Size + 7) & ~(size_t)7;
+	}
+}
+
+struct RLogOutputContext
+{
+	RLogOutputContext()
+		: ContextId(NextContextId++)
+		, NextSequence(0)
+		, bStopOutputThread(false)
+		, bWakeRequested(false)
+		, NumDrainsStarted(0)
+		, NumDrainsFinished(0)
+	{}
+
+	const UINT64 ContextId;
+
+	// Ring buffers of all threads that have logged in async mode
+	std::mutex BuffersMutex;
+	std::vector<std::shared_ptr<RLogThreadBuffer>> Buffers;
+
+	std::atomic<UINT64> NextSequence;
+
+	// Guards sinks and serializes writing to them
+	mutable std::mutex SinkMutex;
+	std::vector<std::shared_ptr<ILogSink>> Sinks;
+
+	// Background thread formatting records and writing them to sinks
+	std::thread OutputThread;
+	std::mutex OutputMutex;
+	std::condition_variable OutputCondition;
+	std::condition_variable DrainFinishedCondition;
+	bool bStopOutputThread;
+	bool bWakeRequested;
+	UINT64 NumDrainsStarted;
+	UINT64 NumDrainsFinished;
+
+	RLogThreadBuffer* GetThreadBuffer();
+	void WakeOutputThread();
+
+	void OutputThreadMain();
+
+	/// Format all committed records in the order they were logged and write them to sinks
+	void DrainBuffers();
+
+	void WriteToSinks(const char* Text, size_t Length, bool bFlush);
+};
+
+
+namespace RLogArgs
+{
+	void Encode(UINT8*& Dest, const char* Value)
+	{
+		if (!Value)
+		{
+			Value = "";
+		}
+
+		UINT32 Length = (UINT32)strlen(Value);
+		*Dest = (UINT8)EArgType::String;
+		memcpy(Dest + 1, &Length, sizeof(Length));
+		memcpy(Dest + 1 + sizeof(Length), Value, Length + 1);
+		Dest += 1 + sizeof(Length) + Length + 1;
+	}
+
+	void Encode(UINT8*& Dest, const wchar_t* Value)
+	{
+		if (!Value)
+		{
+			Value = L"";
+		}
+
+		UINT32 Length = (UINT32)wcslen(Value);
+		*Dest = (UINT8)EArgType::WideString;
+		memcpy(Dest + 1, &Length, sizeof(Length));
+		memcpy(Dest + 1 + sizeof(Length), Value, (Length + 1) * sizeof(wchar_t));
+		Dest += 1 + sizeof(Length) + (Length + 1) * sizeof(wchar_t);
+	}
+
+	/// An argument decoded from a log record
+	struct RDecodedArg
+	{
+		EArgType		Type;
+		int				Int32;
+		long long		Int64;
+		double			Double;
+		const void*		Pointer;
+		const char*		String;
+		std::wstring	WideString;		// Copied out since it may not be aligned in the record
+	};
+
+	const UINT8* Decode(const UINT8* Src, RDecodedArg& OutArg)
+	{
+		OutArg.Type = (EArgType)*Src++;
+
+		switch (OutArg.Type)
+		{
+		case EArgType::Int32:		memcpy(&OutArg.Int32, Src, sizeof(int));			return Src + 8;
+		case EArgType::Int64:		memcpy(&OutArg.Int64, Src, sizeof(long long));		return Src + 8;
+		case EArgType::Double:		memcpy(&OutArg.Double, Src, sizeof(double));		return Src + 8;
+		case EArgType::Pointer:		memcpy(&OutArg.Pointer, Src, sizeof(void*));		return Src + 8;
+		case EArgType::String:
+			{
+				UINT32 Length;
+				memcpy(&Length, Src, sizeof(Length));
+				OutArg.String = (const char*)(Src + sizeof(Length));
+				return Src + sizeof(Length) + Length + 1;
+			}
+		case EArgType::WideString:
+			{
+				UINT32 Length;
+				memcpy(&Length, Src, sizeof(Length));
+				OutArg.WideString.resize(Length);
+				memcpy(&OutArg.WideString[0], Src + sizeof(Length), Length * sizeof(wchar_t));
+				return Src + sizeof(Length) + (Length + 1) * sizeof(wchar_t);
+			}
+		}
+
+		assert(0);
+		return Src;
+	}
+
+	template<typename T>
+	int FormatValue(char* Buffer, size_t BufferSize, const char* Spec, const int* Stars, int NumStars, T Value)
+	{
+		switch (NumStars)
+		{
+		case 0:		return snprintf(Buffer, BufferSize, Spec, Value);
+		case 1:		return snprintf(Buffer, BufferSize, Spec, Stars[0], Value);
+		default:	return snprintf(Buffer, BufferSize, Spec, Stars[0], Stars[1], Value);
+		}
+	}
+
+	int FormatArg(char* Buffer, size_t BufferSize, const char* Spec, const int* Stars, int NumStars, const RDecodedArg& Arg)
+	{
+		switch (Arg.Type)
+		{
+		case EArgType::Int32:		return FormatValue(Buffer, BufferSize, Spec, Stars, NumStars, Arg.Int32);
+		case EArgType::Int64:		return FormatValue(Buffer, BufferSize, Spec, Stars, NumStars, Arg.Int64);
+		case EArgType::Double:		return FormatValue(Buffer, BufferSize, Spec, Stars, NumStars, Arg.Double);
+		case EArgType::Pointer:		return FormatValue(Buffer, BufferSize, Spec, Stars, NumStars, Arg.Pointer);
+		case EArgType::String:		return FormatValue(Buffer, BufferSize, Spec, Stars, NumStars, Arg.String);
+		case EArgType::WideString:	return FormatValue(Buffer, BufferSize, Spec, Stars, NumStars, Arg.WideString.c_str());
+		}
+
+		return 0;
+	}
+
+	/// Check if an argument can be passed for a conversion without reading it as a different kind of value
+	bool IsArgCompatible(char Conversion, EArgType Type)
+	{
+		switch (Conversion)
+		{
+		case 's': case 'S':
+			return Type == EArgType::String || Type == EArgType::WideString;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			return Type == EArgType::Double;
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': case 'C': case 'p':
+			return Type == EArgType::Int32 || Type == EArgType::Int64 || Type == EArgType::Pointer;
+		}
+
+		return false;
+	}
+
+	/// printf-style formatting of decoded arguments. Each conversion is formatted by snprintf with its own spec.
+	void FormatRecord(const char* Format, const UINT8* ArgData, int NumArgs, std::string& Out)
+	{
+		int NextArg = 0;
+		RDecodedArg Arg;
+
+		auto TakeArg = [&]() -> bool
+		{
+			if (NextArg >= NumArgs)
+			{
+				return false;
+			}
+
+			ArgData = Decode(ArgData, Arg);
+			NextArg++;
+			return true;
+		};
+
+		const char* Cursor = Format;
+		while (*Cursor)
+		{
+			if (*Cursor != '%')
+			{
+				const char* TextEnd = strchr(Cursor, '%');
+				if (!TextEnd)
+				{
+					Out.append(Cursor);
+					break;
+				}
+
+				Out.append(Cursor, TextEnd);
+				Cursor = TextEnd;
+				continue;
+			}
+
+			if (Cursor[1] == '%')
+			{
+				Out.push_back('%');
+				Cursor += 2;
+				continue;
+			}
+
+			// Parse a conversion spec: %[flags][width][.precision][length]conversion
+			const char* SpecBegin = Cursor++;
+			int Stars[2];
+			int NumStars = 0;
+
+			auto ParseNumber = [&]()
+			{
+				if (*Cursor == '*')
+				{
+					Stars[NumStars++] = TakeArg() ? (Arg.Type == EArgType::Int64 ? (int)Arg.Int64 : Arg.Int32) : 0;
+					Cursor++;
+				}
+				else
+				{
+					while (isdigit((unsigned char)*Cursor)) Cursor++;
+				}
+			};
+
+			while (*Cursor && strchr("-+ #0", *Cursor)) Cursor++;
+			ParseNumber();
+			if (*Cursor == '.')
+			{
+				Cursor++;
+				ParseNumber();
+			}
+
+			while (*Cursor && strchr("hljztLI", *Cursor))
+			{
+				// MSVC I32 and I64 prefixes
+				if (*Cursor++ == 'I')
+				{
+					while (isdigit((unsigned char)*Cursor)) Cursor++;
+				}
+			}
+
+			const char Conversion = *Cursor;
+			if (!Conversion)
+			{
+				Out.append(SpecBegin);
+				break;
+			}
+			Cursor++;
+
+			const std::string Spec(SpecBegin, Cursor);
+			if (Conversion == 'n')
+			{
+				continue;
+			}
+
+			if (!TakeArg() || !IsArgCompatible(Conversion, Arg.Type))
+			{
+				Out.append(Spec);
+				continue;
+			}
+
+			char Buffer[256];
+			int Length = FormatArg(Buffer, sizeof(Buffer), Spec.c_str(), Stars, NumStars, Arg);
+			if (Length >= (int)sizeof(Buffer))
+			{
+				std::vector<char> LargeBuffer(Length + 1);
+				FormatArg(LargeBuffer.data(), LargeBuffer.size(), Spec.c_str(), Stars, NumStars, Arg);
+				Out.append(LargeBuffer.data(), Length);
+			}
+			else if (Length > 0)
+			{
+				Out.append(Buffer, Length);
+			}
+		}
+	}
+}
+
+
+RLogThreadBuffer* RLogOutputContext::GetThreadBuffer()
+{
+	if (RLogThreadBuffer* Buffer = ThreadBufferOwner.Find(ContextId))
+	{
+		return Buffer;
+	}
+
+	std::shared_ptr<RLogThreadBuffer> Buffer = std::make_shared<RLogThreadBuffer>();
+	{
+		std::unique_lock<std::mutex> Lock(BuffersMutex);
+		Buffers.push_back(Buffer);
+	}
+
+	ThreadBufferOwner.Entries.push_back({ ContextId, Buffer });
+	return Buffer.get();
+}
+
+void RLogOutputContext::WakeOutputThread()
+{
+	{
+		std::unique_lock<std::mutex> Lock(OutputMutex);
+		bWakeRequested = true;
+	}
+
+	OutputCondition.notify_one();
+}
+
+void RLogOutputContext::OutputThreadMain()
+{
+	std::unique_lock<std::mutex> Lock(OutputMutex);
+	while (true)
+	{
+		// Records are picked up periodically. Writers only wake us up when a buffer is getting full or on flush.
+		OutputCondition.wait_for(Lock, std::chrono::milliseconds(10), [this] { return bStopOutputThread || bWakeRequested; });
+
+		const bool bStop = bStopOutputThread;
+		bWakeRequested = false;
+		NumDrainsStarted++;
+		Lock.unlock();
+
+		DrainBuffers();
+
+		Lock.lock();
+		NumDrainsFinished++;
+		DrainFinishedCondition.notify_all();
+
+		if (bStop)
+		{
+			break;
+		}
+	}
+}
+
+void RLogOutputContext::DrainBuffers()
+{
+	struct RFormattedRecord
+	{
+		UINT64 Sequence;
+		size_t Offset;
+		size_t Length;
+	};
+
+	std::string Text;
+	std::vector<RFormattedRecord> Records;
+
+	{
+		std::unique_lock<std::mutex> Lock(BuffersMutex);
+
+		for (auto Iter = Buffers.begin(); Iter != Buffers.end();)
+		{
+			RLogThreadBuffer* Buffer = Iter->get();
+
+			// Check thread exit before reading so no record can be committed after the last read
+			const bool bThreadExited = Buffer->bThreadExited.load(std::memory_order_acquire);
+			const size_t WritePos = Buffer->WritePos.load(std::memory_order_acquire);
+			size_t ReadPos = Buffer->ReadPos.load(std::memory_order_relaxed);
+
+			while (ReadPos < WritePos)
+			{
+				const size_t Offset = ReadPos % LogBufferCapacity;
+				if (LogBufferCapacity - Offset < sizeof(RLogRecordHeader))
+				{
+					ReadPos += LogBufferCapacity - Offset;
+					continue;
+				}
+
+				const UINT8* RecordData = Buffer->Data.get() + Offset;
+				const RLogRecordHeader* Header = (const RLogRecordHeader*)RecordData;
+				if (Header->NumArgs != PaddingRecord)
+				{
+					const char* Format = (const char*)(RecordData + sizeof(RLogRecordHeader));
+					const UINT8* ArgData = (const UINT8*)Format + Header->FormatLength + 1;
+
+					const size_t TextOffset = Text.size();
+					RLogArgs::FormatRecord(Format, ArgData, (int)Header->NumArgs, Text);
+					Records.push_back({ Header->Sequence, TextOffset, Text.size() - TextOffset });
+				}
+
+				ReadPos += Header->Size;
+			}
+
+			Buffer->ReadPos.store(ReadPos, std::memory_order_release);
+
+			if (bThreadExited && ReadPos == WritePos)
+			{
+				Iter = Buffers.erase(Iter);
+			}
+			else
+			{
+				++Iter;
+			}
+		}
+	}
+
+	if (Records.empty())
+	{
+		return;
+	}
+
+	std::sort(Records.begin(), Records.end(), [](const RFormattedRecord& A, const RFormattedRecord& B)
+	{
+		return A.Sequence < B.Sequence;
+	});
+
+	std::string SortedText;
+	SortedText.reserve(Text.size());
+	for (const auto& Record : Records)
+	{
+		SortedText.append(Text, Record.Offset, Record.Length);
+	}
+
+	WriteToSinks(SortedText.c_str(), SortedText.size(), true);
+}
+
+void RLogOutputContext::WriteToSinks(const char* Text, size_t Length, bool bFlush)
+{
+	std::unique_lock<std::mutex> Lock(SinkMutex);
+
+	for (const auto& Sink : Sinks)
+	{
+		if (Length > 0)
+		{
+			Sink->Write(Text, Length);
+		}
+
+		if (bFlush)
+		{
+			Sink->Flush();
+		}
+	}
+}
+
+
+void RDebugOutputLogSink::Write(const char* Text, size_t Length)
+{
+#if PLATFORM_WINDOWS
+	// Print to Visual Studio output window
+	OutputDebugStringA(Text);
+#endif
+
+	// Print to console output
+	std::cout.write(Text, Length);
+}
+
+void RDebugOutputLogSink::Flush()
+{
+	std::cout.flush();
+}
+
+RFileLogSink::RFileLogSink(const std::string& InFilePath, bool bAppend /*= false*/)
+	: FileStream(InFilePath, std::ios::out | std::ios::binary | (bAppend ? std::ios::app : std::ios::trunc))
+{
+}
+
+void RFileLogSink::Write(const char* Text, size_t Length)
+{
+	FileStream.write(Text, Length);
+}
+
+void RFileLogSink::Flush()
+{
+	FileStream.flush();
+}
+
+RRotatingFileLogSink::RRotatingFileLogSink(const std::string& InFilePath, size_t InMaxFileSize /*= 4 * 1024 * 1024*/, int InMaxBackupFiles /*= 4*/)
+	: FilePath(InFilePath)
+	, FileStream(InFilePath, std::ios::out | std::ios::binary | std::ios::app)
+	, FileSize(0)
+	, MaxFileSize(InMaxFileSize)
+	, MaxBackupFiles(InMaxBackupFiles)
+{
+	FileStream.seekp(0, std::ios::end);
+	FileSize = (size_t)FileStream.tellp();
+}
+
+void RRotatingFileLogSink::Write(const char* Text, size_t Length)
+{
+	if (FileSize > 0 && FileSize + Length > MaxFileSize)
+	{
+		Rotate();
+	}
+
+	FileStream.write(Text, Length);
+	FileSize += Length;
+}
+
+void RRotatingFileLogSink::Flush()
+{
+	FileStream.flush();
+}
+
+void RRotatingFileLogSink::Rotate()
+{
+	FileStream.close();
+
+	if (MaxBackupFiles > 0)
+	{
+		std::remove(GetBackupFilePath(MaxBackupFiles).c_str());
+		for (int i = MaxBackupFiles - 1; i >= 1; i--)
+		{
+			std::rename(GetBackupFilePath(i).c_str(), GetBackupFilePath(i + 1).c_str());
+		}
+		std::rename(FilePath.c_str(), GetBackupFilePath(1).c_str());
+	}
+
+	FileStream.open(FilePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	FileSize = 0;
+}
+
+std::string RRotatingFileLogSink::GetBackupFilePath(int Index) const
+{
+	// Split the path by hand so logging doesn't depend on the Win32 file system helpers
+	const size_t SlashPos = FilePath.find_last_of("/\\");
+	const size_t DotPos = FilePath.find_last_of('.');
+	const size_t ExtensionPos = (DotPos != std::string::npos && (SlashPos == std::string::npos || DotPos > SlashPos)) ? DotPos : FilePath.size();
+
+	return FilePath.substr(0, ExtensionPos) + "." + std::to_string(Index) + FilePath.substr(ExtensionPos);
+}
+
 
 RLogOutputTargets::RLogOutputTargets()
 	: LogVerbosity(ELogVerbosity::Log)
+	, bAsyncOutput(false)
+	, Context(std::make_unique<RLogOutputContext>())
+{
+	Context->Sinks.push_back(std::make_shared<RDebugOutputLogSink>());
+}
+
+RLogOutputTargets::~RLogOutputTargets()
+{
+	StopAsyncOutput();
+}
+
+void RLogOutputTargets::StartAsyncOutput()
 {
+	if (Context->OutputThread.joinable())
+	{
+		return;
+	}
 
+	Context->bStopOutputThread = false;
+	Context->OutputThread = std::thread(&RLogOutputContext::OutputThreadMain, Context.get());
+	bAsyncOutput = true;
 }
 
-void RLogOutputTargets::Print(const char* Format, ...)
+void RLogOutputTargets::StopAsyncOutput()
+{
+	if (!Context->OutputThread.joinable())
+	{
+		return;
+	}
+
+	bAsyncOutput = false;
+
+	// Pairs with the fence in EndRecord. A writer either sees async output stopped, or its record is seen by the drains below.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	{
+		std::unique_lock<std::mutex> Lock(Context->OutputMutex);
+		Context->bStopOutputThread = true;
+	}
+
+	Context->OutputCondition.notify_one();
+	Context->OutputThread.join();
+
+	// Pick up records of threads which were still writing when the thread stopped
+	Context->DrainBuffers();
+}
+
+void RLogOutputTargets::Flush()
+{
+	if (!IsAsyncOutput())
+	{
+		Context->WriteToSinks("", 0, true);
+		return;
+	}
+
+	std::unique_lock<std::mutex> Lock(Context->OutputMutex);
+
+	// Wait for a drain started after this point, which sees everything this thread has committed
+	const UINT64 TargetDrain = Context->NumDrainsStarted + 1;
+	Context->bWakeRequested = true;
+	Context->OutputCondition.notify_one();
+
+	Context->DrainFinishedCondition.wait(Lock, [this, TargetDrain]
+	{
+		return Context->NumDrainsFinished >= TargetDrain || Context->bStopOutputThread;
+	});
+}
+
+void RLogOutputTargets::AddSink(std::shared_ptr<ILogSink> Sink)
+{
+	std::unique_lock<std::mutex> Lock(Context->SinkMutex);
+	Context->Sinks.push_back(Sink);
+}
+
+void RLogOutputTargets::RemoveSink(const std::shared_ptr<ILogSink>& Sink)
+{
+	std::unique_lock<std::mutex> Lock(Context->SinkMutex);
+	Context->Sinks.erase(std::remove(Context->Sinks.begin(), Context->Sinks.end(), Sink), Context->Sinks.end());
+}
+
+std::vector<std::shared_ptr<ILogSink>> RLogOutputTargets::GetSinks() const
+{
+	std::unique_lock<std::mutex> Lock(Context->SinkMutex);
+	return Context->Sinks;
+}
+
+void RLogOutputTargets::PrintImmediate(const char* Format, ...)
 {
 	va_list Args;
 	va_start(Args, Format);
 
-	// Measure the size of output buffer
-	int BufferSize = vsnprintf(nullptr, 0, Format, Args);
+	char StackBuffer[1024];
+	std::vector<char> HeapBuffer;
+	char* Buffer = StackBuffer;
+
+	va_list ArgsCopy;
+	va_copy(ArgsCopy, Args);
+	int Length = vsnprintf(StackBuffer, sizeof(StackBuffer), Format, ArgsCopy);
+	va_end(ArgsCopy);
 
-	char* Buffer = new char[BufferSize + 1];
-	vsnprintf(Buffer, BufferSize + 1, Format, Args);
+	// Only allocate for long messages
+	if (Length >= (int)sizeof(StackBuffer))
+	{
+		HeapBuffer.resize(Length + 1);
+		Buffer = HeapBuffer.data();
+		vsnprintf(Buffer, Length + 1, Format, Args);
+	}
 
 	va_end(Args);
 
-	OutputInternal(Buffer);
+	if (Length > 0)
+	{
+		Context->WriteToSinks(Buffer, Length, false);
+	}
+}
+
+UINT8* RLogOutputTargets::BeginRecord(const char* Format, size_t FormatLength, int NumArgs, size_t ArgsSize)
+{
+	const size_t RecordSize = AlignRecordSize(sizeof(RLogRecordHeader) + FormatLength + 1 + ArgsSize);
+	if (RecordSize > LogBufferCapacity / 2)
+	{
+		return nullptr;
+	}
+
+	RLogThreadBuffer* Buffer = Context->GetThreadBuffer();
+	const size_t WritePos = Buffer->WritePos.load(std::memory_order_relaxed);
+
+	// Records are contiguous. Skip to the beginning if there isn't enough room left at the end.
+	size_t Offset = WritePos % LogBufferCapacity;
+	const size_t SkipSize = (LogBufferCapacity - Offset < RecordSize) ? LogBufferCapacity - Offset : 0;
+
+	// Wait for the output thread if the buffer is full
+	while (LogBufferCapacity - (WritePos - Buffer->ReadPos.load(std::memory_order_acquire)) < SkipSize + RecordSize)
+	{
+		// Async output was stopped meanwhile, and nothing may drain the buffer any more.
+		// Write out queued records here, and let the caller write this one immediately.
+		if (!IsAsyncOutput())
+		{
+			Context->DrainBuffers();
+			return nullptr;
+		}
+
+		Context->WakeOutputThread();
+		std::this_thread::yield();
+	}
+
+	if (SkipSize >= sizeof(RLogRecordHeader))
+	{
+		RLogRecordHeader* Padding = (RLogRecordHeader*)(Buffer->Data.get() + Offset);
+		Padding->Size = (UINT32)SkipSize;
+		Padding->NumArgs = PaddingRecord;
+	}
+
+	Offset = (WritePos + SkipSize) % LogBufferCapacity;
+	UINT8* RecordData = Buffer->Data.get() + Offset;
 
-	delete[] Buffer;
+	RLogRecordHeader* Header = (RLogRecordHeader*)RecordData;
+	Header->Size = (UINT32)RecordSize;
+	Header->NumArgs = (UINT32)NumArgs;
+	Header->Sequence = Context->NextSequence.fetch_add(1, std::memory_order_relaxed);
+	Header->FormatLength = (UINT32)FormatLength;
+
+	char* FormatData = (char*)(RecordData + sizeof(RLogRecordHeader));
+	memcpy(FormatData, Format, FormatLength + 1);
+
+	Buffer->PendingWritePos = WritePos + SkipSize + RecordSize;
+	return (UINT8*)FormatData + FormatLength + 1;
 }
 
-void RLogOutputTargets::OutputInternal(const char* Buffer)
+void RLogOutputTargets::EndRecord()
 {
-	// Print to Visual Studio output window
-	OutputDebugStringA(Buffer);
+	RLogThreadBuffer* Buffer = Context->GetThreadBuffer();
+	const size_t LastWritePos = Buffer->WritePos.load(std::memory_order_relaxed);
+	Buffer->WritePos.store(Buffer->PendingWritePos, std::memory_order_release);
 
-	// Print to console output
-	std::cout << Buffer;
+	// Async output may have stopped after Print checked it, and the final drain may have missed this record.
+	// Nothing else reads the buffer any more, so write the record out here.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!IsAsyncOutput())
+	{
+		Context->DrainBuffers();
+		return;
+	}
+
+	// Don't let the buffer fill up while the output thread is sleeping. Wake it up once when half of the buffer is used.
+	const size_t ReadPos = Buffer->ReadPos.load(std::memory_order_relaxed);
+	if (LastWritePos - ReadPos <= LogBufferCapacity / 2 && Buffer->PendingWritePos - ReadPos > LogBufferCapacity / 2)
+	{
+		Context->WakeOutputThread();
+	}
 }
@@ -8,6 +8,9 @@
 #include "CoreTypes.h"
 #include "RSingleton.h"
 
+#include <atomic>
+#include <type_traits>
+
 // Enum for log verbosity level
 enum class ELogVerbosity : UINT8
 {
@@ -16,26 +19,235 @@ enum class ELogVerbosity : UINT8
 	Verbose,
 };
 
-/// A helper class that outputs logs to multiple targets
+// Logs more verbose than this level are stripped at compile time. 0: Log, 1: Debug, 2: Verbose
+#ifndef RLOG_COMPILE_TIME_VERBOSITY
+	#if defined(NDEBUG)
+		#define RLOG_COMPILE_TIME_VERBOSITY 1
+	#else
+		#define RLOG_COMPILE_TIME_VERBOSITY 2
+	#endif
+#endif
+
+/// Destination of formatted log text
+class ILogSink
+{
+public:
+	virtual ~ILogSink() {}
+
+	/// Write a block of formatted text. Called by one thread at a time.
+	virtual void Write(const char* Text, size_t Length) = 0;
+
+	virtual void Flush() {}
+};
+
+/// Prints to Visual Studio output window and console output
+class RDebugOutputLogSink : public ILogSink
+{
+public:
+	virtual void Write(const char* Text, size_t Length) override;
+	virtual void Flush() override;
+};
+
+/// Writes logs to a file
+class RFileLogSink : public ILogSink
+{
+public:
+	RFileLogSink(const std::string& InFilePath, bool bAppend = false);
+
+	virtual void Write(const char* Text, size_t Length) override;
+	virtual void Flush() override;
+
+private:
+	std::ofstream FileStream;
+};
+
+/// Writes logs to a file and rotates it once it grows larger than MaxFileSize.
+/// 'Game.log' is moved to 'Game.1.log', 'Game.1.log' to 'Game.2.log' and so on. At most MaxBackupFiles are kept.
+class RRotatingFileLogSink : public ILogSink
+{
+public:
+	RRotatingFileLogSink(const std::string& InFilePath, size_t InMaxFileSize = 4 * 1024 * 1024, int InMaxBackupFiles = 4);
+
+	virtual void Write(const char* Text, size_t Length) override;
+	virtual void Flush() override;
+
+private:
+	void Rotate();
+	std::string GetBackupFilePath(int Index) const;
+
+	std::string		FilePath;
+	std::ofstream	FileStream;
+	size_t			FileSize;
+	size_t			MaxFileSize;
+	int				MaxBackupFiles;
+};
+
+namespace RLogArgs
+{
+	/// Type of an argument stored in a log record
+	enum class EArgType : UINT8
+	{
+		Int32,
+		Int64,
+		Double,
+		Pointer,
+		String,
+		WideString,
+	};
+
+	struct IntegerTag {};
+	struct FloatTag {};
+	struct PointerTag {};
+
+	template<typename T>
+	using TArgCategory = typename std::conditional<std::is_floating_point<T>::value, FloatTag,
+						 typename std::conditional<std::is_pointer<T>::value, PointerTag, IntegerTag>::type>::type;
+
+	// Scalars are stored as a type byte followed by 8 bytes of value
+	template<typename T>
+	FORCEINLINE size_t GetEncodedSize(T)							{ return 1 + 8; }
+
+	FORCEINLINE size_t GetEncodedSize(const char* Value)			{ return 1 + sizeof(UINT32) + (Value ? strlen(Value) : 0) + 1; }
+	FORCEINLINE size_t GetEncodedSize(char* Value)					{ return GetEncodedSize((const char*)Value); }
+	FORCEINLINE size_t GetEncodedSize(const wchar_t* Value)			{ return 1 + sizeof(UINT32) + ((Value ? wcslen(Value) : 0) + 1) * sizeof(wchar_t); }
+	FORCEINLINE size_t GetEncodedSize(wchar_t* Value)				{ return GetEncodedSize((const wchar_t*)Value); }
+
+	FORCEINLINE void EncodeScalar(UINT8*& Dest, EArgType Type, const void* Value, size_t Size)
+	{
+		*Dest = (UINT8)Type;
+		memcpy(Dest + 1, Value, Size);
+		Dest += 1 + 8;
+	}
+
+	template<typename T>
+	FORCEINLINE void EncodeValue(UINT8*& Dest, T Value, IntegerTag)
+	{
+		if (sizeof(T) > 4)
+		{
+			long long Int64 = (long long)Value;
+			EncodeScalar(Dest, EArgType::Int64, &Int64, sizeof(Int64));
+		}
+		else
+		{
+			// Smaller types are promoted to int by variadic calls
+			int Int32 = (int)Value;
+			EncodeScalar(Dest, EArgType::Int32, &Int32, sizeof(Int32));
+		}
+	}
+
+	template<typename T>
+	FORCEINLINE void EncodeValue(UINT8*& Dest, T Value, FloatTag)
+	{
+		double Double = (double)Value;
+		EncodeScalar(Dest, EArgType::Double, &Double, sizeof(Double));
+	}
+
+	template<typename T>
+	FORCEINLINE void EncodeValue(UINT8*& Dest, T Value, PointerTag)
+	{
+		const void* Pointer = Value;
+		EncodeScalar(Dest, EArgType::Pointer, &Pointer, sizeof(Pointer));
+	}
+
+	template<typename T>
+	FORCEINLINE void Encode(UINT8*& Dest, T Value)					{ EncodeValue(Dest, Value, TArgCategory<T>()); }
+
+	// Strings are copied since they may be gone by the time the record is formatted
+	void Encode(UINT8*& Dest, const char* Value);
+	void Encode(UINT8*& Dest, const wchar_t* Value);
+	FORCEINLINE void Encode(UINT8*& Dest, char* Value)				{ Encode(Dest, (const char*)Value); }
+	FORCEINLINE void Encode(UINT8*& Dest, wchar_t* Value)			{ Encode(Dest, (const wchar_t*)Value); }
+
+	FORCEINLINE size_t GetTotalEncodedSize()						{ return 0; }
+
+	template<typename T, typename... ArgTypes>
+	FORCEINLINE size_t GetTotalEncodedSize(T Value, ArgTypes... Args)
+	{
+		return GetEncodedSize(Value) + GetTotalEncodedSize(Args...);
+	}
+
+	FORCEINLINE void EncodeAll(UINT8*&)								{}
+
+	template<typename T, typename... ArgTypes>
+	FORCEINLINE void EncodeAll(UINT8*& Dest, T Value, ArgTypes... Args)
+	{
+		Encode(Dest, Value);
+		EncodeAll(Dest, Args...);
+	}
+}
+
+struct RLogOutputContext;
+
+/// A helper class that outputs logs to multiple targets.
+/// With async output enabled, each thread appends unformatted records to its own ring buffer and a background
+/// thread formats them and writes them to sinks. Otherwise logs are formatted and written on the calling thread.
+/// Engine logs go to the global instance. Other instances have their own sinks and output thread.
 class RLogOutputTargets : public RSingleton<RLogOutputTargets>
 {
 	friend class RSingleton<RLogOutputTargets>;
 public:
-	void Print(const char* Format, ...);
+	RLogOutputTargets();
+	~RLogOutputTargets();
+
+	template<typename... ArgTypes>
+	void Print(const char* Format, ArgTypes... Args);
 
 	void SetVerbosity(ELogVerbosity Verbosity);
 	ELogVerbosity GetVerbosity() const;
 
+	/// Start the background thread formatting and writing logs
+	void StartAsyncOutput();
+
+	/// Write out pending logs and stop the background thread. Logs are written on the calling thread afterwards.
+	void StopAsyncOutput();
+
+	bool IsAsyncOutput() const;
+
+	/// Block until all logs printed by this thread so far are written to sinks
+	void Flush();
+
+	/// Sinks receiving formatted logs. A RDebugOutputLogSink is added by default.
+	void AddSink(std::shared_ptr<ILogSink> Sink);
+	void RemoveSink(const std::shared_ptr<ILogSink>& Sink);
+	std::vector<std::shared_ptr<ILogSink>> GetSinks() const;
+
 private:
-	RLogOutputTargets();
+	/// Format and output on the calling thread
+	void PrintImmediate(const char* Format, ...);
 
-	// Output a string buffer
-	void OutputInternal(const char* Buffer);
+	/// Reserve a record in the ring buffer of the calling thread and write the format string to it.
+	/// Returns where arguments should be encoded, or nullptr if the record doesn't fit in the buffer
+	/// or async output has stopped while waiting for room.
+	UINT8* BeginRecord(const char* Format, size_t FormatLength, int NumArgs, size_t ArgsSize);
+	void EndRecord();
 
 private:
-	ELogVerbosity LogVerbosity;
+	ELogVerbosity						LogVerbosity;
+	std::atomic<bool>					bAsyncOutput;
+	std::unique_ptr<RLogOutputContext>	Context;
 };
 
+template<typename... ArgTypes>
+void RLogOutputTargets::Print(const char* Format, ArgTypes... Args)
+{
+	if (bAsyncOutput.load(std::memory_order_relaxed))
+	{
+		const size_t FormatLength = strlen(Format);
+		const size_t ArgsSize = RLogArgs::GetTotalEncodedSize(Args...);
+
+		if (UINT8* Dest = BeginRecord(Format, FormatLength, (int)sizeof...(Args), ArgsSize))
+		{
+			RLogArgs::EncodeAll(Dest, Args...);
+			EndRecord();
+			return;
+		}
+
+		// Too large for the ring buffer, or async output has stopped. Keep order with logs queued before it.
+		Flush();
+	}
+
+	PrintImmediate(Format, Args...);
+}
 
 FORCEINLINE void RLogOutputTargets::SetVerbosity(ELogVerbosity Verbosity)
 {
@@ -47,13 +259,28 @@ FORCEINLINE ELogVerbosity RLogOutputTargets::GetVerbosity() const
 	return LogVerbosity;
 }
 
+FORCEINLINE bool RLogOutputTargets::IsAsyncOutput() const
+{
+	return bAsyncOutput.load(std::memory_order_relaxed);
+}
+
 #define GLogOutputTargets RLogOutputTargets::Instance()
 
 
 /// Log with variable number of arguments
 #define RLog(...)							{ RLogWithVerbosity(ELogVerbosity::Log, __VA_ARGS__); }
+
+#if RLOG_COMPILE_TIME_VERBOSITY >= 1
 #define RLogDebug(...)						{ RLogWithVerbosity(ELogVerbosity::Debug, __VA_ARGS__); }
+#else
+#define RLogDebug(...)						{}
+#endif
+
+#if RLOG_COMPILE_TIME_VERBOSITY >= 2
 #define RLogVerbose(...)					{ RLogWithVerbosity(ELogVerbosity::Verbose, __VA_ARGS__); }
+#else
+#define RLogVerbose(...)					{}
+#endif
 
 /// Log with a verbosity level
 #define RLogWithVerbosity(Verbosity, ...)	{ if (GLogOutputTargets.GetVerbosity() >= Verbosity) { GLogOutputTargets.Print(__VA_ARGS__); } }
@@ -61,5 +288,5 @@ FORCEINLINE ELogVerbosity RLogOutputTargets::GetVerbosity() const
 /// Log with warning prefix
 #define RLogWarning(...)					{ GLogOutputTargets.Print("[Warning] "); RLog(__VA_ARGS__); }
 
-/// Log with error prefix
-#define RLogError(...)						{ GLogOutputTargets.Print("***Error*** "); RLog(__VA_ARGS__); }
+/// Log with error prefix. Errors are written out before returning.
+#define RLogError(...)						{ GLogOutputTargets.Print("***Error*** "); RLog(__VA_ARGS__); GLogOutputTargets.Flush(); }
@@ -0,0 +1,138 @@
+//=============================================================================
+// RMappedFile.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RMappedFile.h"
+
+#if !PLATFORM_WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+RMappedFile::RMappedFile()
+	: Data(nullptr)
+	, Size(0)
+	, bOpenedEmpty(false)
+#if PLATFORM_WINDOWS
+	, FileHandle(INVALID_HANDLE_VALUE)
+	, MappingHandle(NULL)
+#endif
+{
+
+}
+
+RMappedFile::~RMappedFile()
+{
+	Close();
+}
+
+bool RMappedFile::Open(const std::string& Filename)
+{
+	Close();
+
+#if PLATFORM_WINDOWS
+	FileHandle = CreateFileA(Filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (FileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER FileSize;
+	if (!GetFileSizeEx(FileHandle, &FileSize))
+	{
+		Close();
+		return false;
+	}
+
+	if (FileSize.QuadPart == 0)
+	{
+		bOpenedEmpty = true;
+		return true;
+	}
+
+	MappingHandle = CreateFileMappingA(FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (MappingHandle == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	Data = (const char*)MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (Data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	Size = (size_t)FileSize.QuadPart;
+#else
+	int FileDescriptor = open(Filename.c_str(), O_RDONLY);
+	if (FileDescriptor == -1)
+	{
+		return false;
+	}
+
+	struct stat FileStat;
+	if (fstat(FileDescriptor, &FileStat) != 0)
+	{
+		close(FileDescriptor);
+		return false;
+	}
+
+	if (FileStat.st_size == 0)
+	{
+		close(FileDescriptor);
+		bOpenedEmpty = true;
+		return true;
+	}
+
+	// The mapping stays valid after the descriptor is closed
+	void* MappedData = mmap(nullptr, (size_t)FileStat.st_size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+	close(FileDescriptor);
+
+	if (MappedData == MAP_FAILED)
+	{
+		return false;
+	}
+
+	Data = (const char*)MappedData;
+	Size = (size_t)FileStat.st_size;
+#endif
+
+	return true;
+}
+
+void RMappedFile::Close()
+{
+#if PLATFORM_WINDOWS
+	if (Data)
+	{
+		UnmapViewOfFile(Data);
+	}
+
+	if (MappingHandle != NULL)
+	{
+		CloseHandle(MappingHandle);
+		MappingHandle = NULL;
+	}
+
+	if (FileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(FileHandle);
+		FileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (Data)
+	{
+		munmap((void*)Data, Size);
+	}
+#endif
+
+	Data = nullptr;
+	Size = 0;
+	bOpenedEmpty = false;
+}
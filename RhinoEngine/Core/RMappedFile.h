@@ -0,0 +1,43 @@
+//=============================================================================
+// RMappedFile.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Read-only memory-mapped files
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+
+/// A file mapped into memory for reading. Pages are loaded by the OS on first access, so nothing is copied.
+class RMappedFile
+{
+public:
+	RMappedFile();
+	~RMappedFile();
+
+	RMappedFile(const RMappedFile&) = delete;
+	RMappedFile& operator=(const RMappedFile&) = delete;
+
+	/// Map a whole file into memory. Returns false if the file can't be opened or mapped.
+	bool Open(const std::string& Filename);
+
+	/// Unmap the file. Pointers to its content are no longer valid.
+	void Close();
+
+	bool IsOpen() const						{ return Data != nullptr || bOpenedEmpty; }
+
+	const char* GetData() const				{ return Data; }
+	size_t GetSize() const					{ return Size; }
+
+private:
+	const char*	Data;
+	size_t		Size;
+
+	// Empty files can't be mapped but are still opened successfully
+	bool		bOpenedEmpty;
+
+#if PLATFORM_WINDOWS
+	HANDLE		FileHandle;
+	HANDLE		MappingHandle;
+#endif
+};
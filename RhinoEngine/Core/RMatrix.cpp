@@ -7,6 +7,7 @@
 #include "RMatrix.h"
 #include <iomanip>
 #include <assert.h>
+#include <string.h>
 
 RMatrix4 RMatrix4::IDENTITY = RMatrix4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
 
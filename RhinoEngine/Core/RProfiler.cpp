@@ -0,0 +1,509 @@
+//=============================================================================
+// RProfiler.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RProfiler.h"
+
+#include "Core/RLog.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+
+namespace
+{
+	// Number of scopes each thread can record before the oldest ones are overwritten. Must be a power of two.
+	const UINT64 ProfileBufferCapacity = 1 << 14;
+
+	/// A scope in a ring buffer. Fields are atomic, so the main thread can read a slot while its thread
+	/// overwrites it without a data race. Relaxed atomic loads and stores are plain moves on x86.
+	struct RProfileEventSlot
+	{
+		std::atomic<const char*>	Name;
+		std::atomic<UINT64>			BeginTime;
+		std::atomic<UINT64>			EndTime;
+	};
+
+	struct RProfileEvent
+	{
+		const char*	Name;
+		UINT64		BeginTime;
+		UINT64		EndTime;
+	};
+
+	/// Ring buffer of scopes with one writing thread and the main thread reading
+	struct RProfileThreadBuffer
+	{
+		RProfileThreadBuffer(int InThreadId)
+			: Events(new RProfileEventSlot[ProfileBufferCapacity]())
+			, NumStarted(0)
+			, NumCommitted(0)
+			, ReadPos(0)
+			, ThreadId(InThreadId)
+			, bThreadExited(false)
+		{}
+
+		std::unique_ptr<RProfileEventSlot[]>	Events;
+
+		// Number of scopes the owning thread has started writing, and finished writing. Positions in the
+		// buffer are these modulo the capacity. Reading both tells which slots may have been overwritten.
+		std::atomic<UINT64>		NumStarted;
+		std::atomic<UINT64>		NumCommitted;
+
+		// Number of scopes collected. Only used by the main thread.
+		UINT64					ReadPos;
+
+		int						ThreadId;
+		std::string				ThreadName;
+		std::atomic<bool>		bThreadExited;
+	};
+
+	/// Lets the main thread know the buffer can be freed once it's collected
+	struct RProfileThreadBufferOwner
+	{
+		~RProfileThreadBufferOwner()
+		{
+			if (Buffer)
+			{
+				Buffer->bThreadExited = true;
+			}
+		}
+
+		RProfileThreadBuffer* Buffer = nullptr;
+	};
+
+	thread_local RProfileThreadBufferOwner ThreadBufferOwner;
+
+	/// A scope captured for a trace
+	struct RCapturedEvent
+	{
+		const char*	Name;
+		int			ThreadId;
+		UINT64		BeginTime;
+		UINT64		EndTime;
+	};
+
+	bool IsSameScopeName(const char* Lhs, const char* Rhs)
+	{
+		// The same literal may have different addresses in different translation units
+		return Lhs == Rhs || strcmp(Lhs, Rhs) == 0;
+	}
+
+	void AppendJsonString(std::string& Out, const char* String)
+	{
+		Out += '\"';
+		for (const char* c = String; *c; c++)
+		{
+			if (*c == '\"' || *c == '\\')
+			{
+				Out += '\\';
+				Out += *c;
+			}
+			else if ((unsigned char)*c < 0x20)
+			{
+				char Escaped[8];
+				snprintf(Escaped, sizeof(Escaped), "\\u%04x", (unsigned int)(unsigned char)*c);
+				Out += Escaped;
+			}
+			else
+			{
+				Out += *c;
+			}
+		}
+		Out += '\"';
+	}
+
+	void LogStatNode(const RProfileThreadStats& ThreadStats, int NodeIndex)
+	{
+		const RProfileStatNode& Node = ThreadStats.Nodes[NodeIndex];
+
+		RLog("  %*s%-*s %8.3f ms  self %8.3f ms  calls %d\n", Node.Depth * 2, "", RMath::Max(40 - Node.Depth * 2, 1), Node.Name,
+			Node.TotalMs, Node.SelfMs, Node.CallCount);
+
+		for (int ChildIndex : Node.Children)
+		{
+			LogStatNode(ThreadStats, ChildIndex);
+		}
+	}
+}
+
+struct RProfilerContext
+{
+	RProfilerContext()
+		: NextThreadId(1)
+		, StartTimestamp(0)
+		, TicksPerMs(1.0)
+		, FrameNumber(0)
+		, FrameBeginTime(0)
+		, NumCaptureFramesLeft(0)
+	{}
+
+	// Ring buffers of all threads that have recorded scopes
+	std::mutex BuffersMutex;
+	std::vector<std::unique_ptr<RProfileThreadBuffer>> Buffers;
+	int NextThreadId;
+
+	// Timestamp and clock time when the profiler was created, for converting timestamps to time
+	UINT64 StartTimestamp;
+	std::chrono::steady_clock::time_point StartTime;
+	double TicksPerMs;
+
+	UINT64 FrameNumber;
+	UINT64 FrameBeginTime;
+	RProfileFrameStats LastFrameStats;
+
+	// Scopes of a thread being collected, and open scopes while building stats from them
+	std::vector<RProfileEvent> ThreadEvents;
+	std::vector<std::pair<UINT64, int>> OpenScopes;
+
+	int NumCaptureFramesLeft;
+	std::string CaptureFilePath;
+	std::vector<RCapturedEvent> CapturedEvents;
+	std::map<int, std::string> CapturedThreadNames;
+
+	RProfileThreadBuffer* GetThreadBuffer();
+};
+
+RProfileThreadBuffer* RProfilerContext::GetThreadBuffer()
+{
+	if (!ThreadBufferOwner.Buffer)
+	{
+		std::unique_lock<std::mutex> Lock(BuffersMutex);
+		Buffers.push_back(std::make_unique<RProfileThreadBuffer>(NextThreadId++));
+		ThreadBufferOwner.Buffer = Buffers.back().get();
+	}
+
+	return ThreadBufferOwner.Buffer;
+}
+
+
+RProfiler::RProfiler()
+	: Context(std::make_unique<RProfilerContext>())
+{
+	Context->StartTimestamp = ReadTimestamp();
+	Context->StartTime = std::chrono::steady_clock::now();
+
+	// Spin for a moment to get a first estimate of the clock rate. It's refined every frame.
+	while (std::chrono::steady_clock::now() - Context->StartTime < std::chrono::milliseconds(2)) {}
+	CalibrateClock();
+}
+
+RProfiler::~RProfiler()
+{
+}
+
+void RProfiler::RecordScope(const char* Name, UINT64 BeginTime)
+{
+	const UINT64 EndTime = ReadTimestamp();
+
+	RProfileThreadBuffer* Buffer = ThreadBufferOwner.Buffer;
+	if (!Buffer)
+	{
+		Buffer = GProfiler.Context->GetThreadBuffer();
+	}
+
+	// Announce the slot before writing it, so the main thread can tell if it's overwritten while being read
+	const UINT64 Pos = Buffer->NumCommitted.load(std::memory_order_relaxed);
+	Buffer->NumStarted.store(Pos + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	RProfileEventSlot& Slot = Buffer->Events[Pos & (ProfileBufferCapacity - 1)];
+	Slot.Name.store(Name, std::memory_order_relaxed);
+	Slot.BeginTime.store(BeginTime, std::memory_order_relaxed);
+	Slot.EndTime.store(EndTime, std::memory_order_relaxed);
+
+	Buffer->NumCommitted.store(Pos + 1, std::memory_order_release);
+}
+
+void RProfiler::SetThreadName(const std::string& Name)
+{
+	RProfileThreadBuffer* Buffer = Context->GetThreadBuffer();
+
+	std::unique_lock<std::mutex> Lock(Context->BuffersMutex);
+	Buffer->ThreadName = Name;
+}
+
+void RProfiler::BeginFrame(UINT64 FrameNumber)
+{
+	Context->FrameNumber = FrameNumber;
+	Context->FrameBeginTime = ReadTimestamp();
+}
+
+void RProfiler::EndFrame()
+{
+	// The frame is the root scope of the main thread
+	RecordScope("Frame", Context->FrameBeginTime);
+	CollectFrame(ReadTimestamp());
+
+	if (Context->NumCaptureFramesLeft > 0 && --Context->NumCaptureFramesLeft == 0)
+	{
+		if (WriteChromeTrace(Context->CaptureFilePath))
+		{
+			RLog("Profiler: wrote %d scopes to trace \'%s\'\n", (int)Context->CapturedEvents.size(), Context->CaptureFilePath.c_str());
+		}
+
+		LogFrameStats(Context->LastFrameStats);
+
+		Context->CapturedEvents.clear();
+		Context->CapturedThreadNames.clear();
+	}
+}
+
+const RProfileFrameStats& RProfiler::GetLastFrameStats() const
+{
+	return Context->LastFrameStats;
+}
+
+void RProfiler::LogFrameStats(const RProfileFrameStats& Stats)
+{
+	RLog("=== Profiler: frame %llu, %.3f ms ===\n", (unsigned long long)Stats.FrameNumber, Stats.FrameMs);
+
+	for (const auto& ThreadStats : Stats.Threads)
+	{
+		RLog(" Thread %d %s\n", ThreadStats.ThreadId, ThreadStats.ThreadName.c_str());
+
+		for (int RootIndex : ThreadStats.Roots)
+		{
+			LogStatNode(ThreadStats, RootIndex);
+		}
+	}
+
+	if (Stats.NumDroppedEvents > 0)
+	{
+		RLogWarning(" %d scopes were dropped because ring buffers were full\n", Stats.NumDroppedEvents);
+	}
+}
+
+void RProfiler::StartCapture(int NumFrames, const std::string& FilePath)
+{
+	if (IsCapturing())
+	{
+		RLogWarning("Profiler: a capture is already running\n");
+		return;
+	}
+
+	Context->NumCaptureFramesLeft = NumFrames;
+	Context->CaptureFilePath = FilePath;
+	Context->CapturedEvents.clear();
+	Context->CapturedThreadNames.clear();
+
+	RLog("Profiler: capturing %d frames\n", NumFrames);
+}
+
+bool RProfiler::IsCapturing() const
+{
+	return Context->NumCaptureFramesLeft > 0;
+}
+
+bool RProfiler::WriteChromeTrace(const std::string& FilePath) const
+{
+	std::ofstream FileStream(FilePath, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!FileStream.is_open())
+	{
+		RLogError("Profiler: failed to open trace file \'%s\'\n", FilePath.c_str());
+		return false;
+	}
+
+	// Times in traces are in microseconds from the first scope captured
+	UINT64 TraceStartTime = Context->CapturedEvents.size() > 0 ? Context->CapturedEvents[0].BeginTime : 0;
+	for (const auto& Event : Context->CapturedEvents)
+	{
+		TraceStartTime = RMath::Min(TraceStartTime, Event.BeginTime);
+	}
+
+	std::string Json;
+	Json.reserve(Context->CapturedEvents.size() * 96 + 256);
+	Json += "{\"traceEvents\":[\n";
+	Json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"Rhino Engine\"}}";
+
+	for (const auto& ThreadName : Context->CapturedThreadNames)
+	{
+		const std::string Name = ThreadName.second.size() > 0 ? ThreadName.second : "Thread " + std::to_string(ThreadName.first);
+		Json += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(ThreadName.first) + ",\"args\":{\"name\":";
+		AppendJsonString(Json, Name.c_str());
+		Json += "}}";
+	}
+
+	for (const auto& Event : Context->CapturedEvents)
+	{
+		char Buffer[128];
+
+		Json += ",\n{\"name\":";
+		AppendJsonString(Json, Event.Name);
+		snprintf(Buffer, sizeof(Buffer), ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			Event.ThreadId, TicksToMs(Event.BeginTime - TraceStartTime) * 1000.0, TicksToMs(Event.EndTime - Event.BeginTime) * 1000.0);
+		Json += Buffer;
+	}
+
+	Json += "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+	FileStream.write(Json.data(), Json.size());
+	return !FileStream.fail();
+}
+
+double RProfiler::TicksToMs(UINT64 Ticks) const
+{
+	return (double)Ticks / Context->TicksPerMs;
+}
+
+void RProfiler::CollectFrame(UINT64 FrameEndTime)
+{
+	CalibrateClock();
+
+	RProfileFrameStats& Stats = Context->LastFrameStats;
+	Stats.FrameNumber = Context->FrameNumber;
+	Stats.FrameMs = TicksToMs(FrameEndTime - Context->FrameBeginTime);
+	Stats.Threads.clear();
+	Stats.NumDroppedEvents = 0;
+
+	std::vector<RProfileEvent>& Events = Context->ThreadEvents;
+	std::vector<std::pair<UINT64, int>>& OpenScopes = Context->OpenScopes;
+
+	std::unique_lock<std::mutex> Lock(Context->BuffersMutex);
+
+	for (auto Iter = Context->Buffers.begin(); Iter != Context->Buffers.end();)
+	{
+		RProfileThreadBuffer* Buffer = Iter->get();
+
+		// Check thread exit before reading so no scope can be recorded after the last read
+		const bool bThreadExited = Buffer->bThreadExited.load(std::memory_order_acquire);
+		const UINT64 NumCommitted = Buffer->NumCommitted.load(std::memory_order_acquire);
+
+		UINT64 ReadPos = Buffer->ReadPos;
+		if (NumCommitted - ReadPos > ProfileBufferCapacity)
+		{
+			Stats.NumDroppedEvents += (int)(NumCommitted - ProfileBufferCapacity - ReadPos);
+			ReadPos = NumCommitted - ProfileBufferCapacity;
+		}
+
+		// Scopes are recorded in order of their end times. Scopes of other threads ending after the frame
+		// are left for the next frame.
+		Events.clear();
+		UINT64 Pos = ReadPos;
+		for (; Pos < NumCommitted; Pos++)
+		{
+			const RProfileEventSlot& Slot = Buffer->Events[Pos & (ProfileBufferCapacity - 1)];
+			const RProfileEvent Event = { Slot.Name.load(std::memory_order_relaxed), Slot.BeginTime.load(std::memory_order_relaxed), Slot.EndTime.load(std::memory_order_relaxed) };
+
+			if (Event.EndTime > FrameEndTime)
+			{
+				break;
+			}
+
+			Events.push_back(Event);
+		}
+
+		// Drop slots which the thread may have started overwriting while they were read
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const UINT64 NumStarted = Buffer->NumStarted.load(std::memory_order_relaxed);
+		if (NumStarted > ReadPos + ProfileBufferCapacity)
+		{
+			const size_t NumOverwritten = (size_t)RMath::Min(NumStarted - ProfileBufferCapacity - ReadPos, (UINT64)Events.size());
+			Events.erase(Events.begin(), Events.begin() + NumOverwritten);
+			Stats.NumDroppedEvents += (int)NumOverwritten;
+		}
+
+		Buffer->ReadPos = Pos;
+
+		if (Events.size() > 0)
+		{
+			Stats.Threads.emplace_back();
+			RProfileThreadStats& ThreadStats = Stats.Threads.back();
+			ThreadStats.ThreadId = Buffer->ThreadId;
+			ThreadStats.ThreadName = Buffer->ThreadName;
+
+			// Parents come before their children when sorted by begin time, with longer scopes first on ties
+			std::sort(Events.begin(), Events.end(), [](const RProfileEvent& Lhs, const RProfileEvent& Rhs)
+			{
+				return Lhs.BeginTime < Rhs.BeginTime || (Lhs.BeginTime == Rhs.BeginTime && Lhs.EndTime > Rhs.EndTime);
+			});
+
+			OpenScopes.clear();
+			for (const RProfileEvent& Event : Events)
+			{
+				// Close scopes which the event is not inside of
+				while (OpenScopes.size() > 0 && (Event.BeginTime >= OpenScopes.back().first || Event.EndTime > OpenScopes.back().first))
+				{
+					OpenScopes.pop_back();
+				}
+
+				const int ParentIndex = OpenScopes.size() > 0 ? OpenScopes.back().second : -1;
+				const std::vector<int>& Siblings = ParentIndex >= 0 ? ThreadStats.Nodes[ParentIndex].Children : ThreadStats.Roots;
+
+				int NodeIndex = -1;
+				for (int SiblingIndex : Siblings)
+				{
+					if (IsSameScopeName(ThreadStats.Nodes[SiblingIndex].Name, Event.Name))
+					{
+						NodeIndex = SiblingIndex;
+						break;
+					}
+				}
+
+				if (NodeIndex == -1)
+				{
+					NodeIndex = (int)ThreadStats.Nodes.size();
+					ThreadStats.Nodes.emplace_back();
+					ThreadStats.Nodes[NodeIndex].Name = Event.Name;
+					ThreadStats.Nodes[NodeIndex].Depth = (int)OpenScopes.size();
+
+					if (ParentIndex >= 0)
+					{
+						ThreadStats.Nodes[ParentIndex].Children.push_back(NodeIndex);
+					}
+					else
+					{
+						ThreadStats.Roots.push_back(NodeIndex);
+					}
+				}
+
+				RProfileStatNode& Node = ThreadStats.Nodes[NodeIndex];
+				Node.CallCount++;
+				Node.TotalMs += TicksToMs(Event.EndTime - Event.BeginTime);
+
+				OpenScopes.push_back(std::make_pair(Event.EndTime, NodeIndex));
+			}
+
+			for (auto& Node : ThreadStats.Nodes)
+			{
+				Node.SelfMs = Node.TotalMs;
+				for (int ChildIndex : Node.Children)
+				{
+					Node.SelfMs -= ThreadStats.Nodes[ChildIndex].TotalMs;
+				}
+			}
+
+			if (IsCapturing())
+			{
+				for (const RProfileEvent& Event : Events)
+				{
+					Context->CapturedEvents.push_back({ Event.Name, Buffer->ThreadId, Event.BeginTime, Event.EndTime });
+				}
+
+				Context->CapturedThreadNames[Buffer->ThreadId] = Buffer->ThreadName;
+			}
+		}
+
+		if (bThreadExited && Pos == NumCommitted)
+		{
+			Iter = Context->Buffers.erase(Iter);
+		}
+		else
+		{
+			++Iter;
+		}
+	}
+}
+
+void RProfiler::CalibrateClock()
+{
+	const UINT64 Ticks = ReadTimestamp() - Context->StartTimestamp;
+	const double ElapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Context->StartTime).count();
+
+	if (ElapsedMs > 0.0 && Ticks > 0)
+	{
+		Context->TicksPerMs = (double)Ticks / ElapsedMs;
+	}
+}
@@ -0,0 +1,158 @@
+//=============================================================================
+// RProfiler.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Scoped CPU timers with per-frame stats and Chrome trace export
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+#include "Core/RSingleton.h"
+
+#include <atomic>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+	#define RPROFILER_USE_TSC 1
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <x86intrin.h>
+	#endif
+#else
+	#define RPROFILER_USE_TSC 0
+	#include <chrono>
+#endif
+
+// Profile scopes are compiled out when this is 0
+#ifndef RPROFILER_ENABLED
+	#define RPROFILER_ENABLED 1
+#endif
+
+/// Time spent in a scope in one frame, summed over all its calls under the same parent scope
+struct RProfileStatNode
+{
+	const char*			Name = nullptr;
+	int					Depth = 0;
+	int					CallCount = 0;
+	double				TotalMs = 0.0;
+
+	// Time not spent in child scopes
+	double				SelfMs = 0.0;
+
+	std::vector<int>	Children;
+};
+
+/// Scopes of one thread in a frame, as trees of nodes
+struct RProfileThreadStats
+{
+	int								ThreadId = 0;
+	std::string						ThreadName;
+	std::vector<RProfileStatNode>	Nodes;
+	std::vector<int>				Roots;
+};
+
+struct RProfileFrameStats
+{
+	UINT64							FrameNumber = 0;
+	double							FrameMs = 0.0;
+	std::vector<RProfileThreadStats>	Threads;
+
+	// Scopes lost because a ring buffer was full before they were collected
+	int								NumDroppedEvents = 0;
+};
+
+struct RProfilerContext;
+
+/// Collects timings of profile scopes from all threads. Each thread records finished scopes into its own
+/// ring buffer without locking, and the main thread collects them at the end of every frame.
+/// Scopes are nested by their time ranges on each thread, so no call stack is tracked while recording.
+class RProfiler : public RSingleton<RProfiler>
+{
+	friend class RSingleton<RProfiler>;
+public:
+	~RProfiler();
+
+	/// Read the timestamp of the profiler clock
+	static FORCEINLINE UINT64 ReadTimestamp()
+	{
+#if RPROFILER_USE_TSC
+		return __rdtsc();
+#else
+		return (UINT64)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+	}
+
+	/// Record a scope which ends now on the calling thread. The name must outlive the profiler (e.g. a string literal).
+	static void RecordScope(const char* Name, UINT64 BeginTime);
+
+	/// Name the calling thread in stats and traces
+	void SetThreadName(const std::string& Name);
+
+	/// Called by the engine on the main thread around each frame. Everything below is called on the main thread.
+	void BeginFrame(UINT64 FrameNumber);
+	void EndFrame();
+
+	/// Stats of the last frame ended
+	const RProfileFrameStats& GetLastFrameStats() const;
+
+	/// Log stats of a frame as indented trees of scopes
+	static void LogFrameStats(const RProfileFrameStats& Stats);
+
+	/// Record scopes of the next frames, then write them to a file in Chrome trace event format
+	/// (viewable in chrome://tracing or Perfetto) and log stats of the last frame captured.
+	void StartCapture(int NumFrames, const std::string& FilePath);
+	bool IsCapturing() const;
+
+	/// Write scopes captured so far to a Chrome trace file
+	bool WriteChromeTrace(const std::string& FilePath) const;
+
+	/// Convert a difference of timestamps to milliseconds
+	double TicksToMs(UINT64 Ticks) const;
+
+private:
+	RProfiler();
+
+	/// Take scopes which ended before the frame end from all ring buffers, and build stats of the frame
+	void CollectFrame(UINT64 FrameEndTime);
+
+	/// Update the number of clock ticks per millisecond from the time passed since the profiler was created
+	void CalibrateClock();
+
+	std::unique_ptr<RProfilerContext>	Context;
+};
+
+#define GProfiler RProfiler::Instance()
+
+/// Times the enclosing scope
+class RProfileScope
+{
+public:
+	FORCEINLINE RProfileScope(const char* InName)
+		: Name(InName)
+		, BeginTime(RProfiler::ReadTimestamp())
+	{}
+
+	FORCEINLINE ~RProfileScope()
+	{
+		RProfiler::RecordScope(Name, BeginTime);
+	}
+
+	RProfileScope(const RProfileScope&) = delete;
+	RProfileScope& operator=(const RProfileScope&) = delete;
+
+private:
+	const char*	Name;
+	UINT64		BeginTime;
+};
+
+#define RPROFILE_JOIN_INNER(A, B)	A##B
+#define RPROFILE_JOIN(A, B)			RPROFILE_JOIN_INNER(A, B)
+
+#if RPROFILER_ENABLED
+/// Time the rest of the current scope under a name with static storage, such as a string literal
+#define RPROFILE_SCOPE(Name)		RProfileScope RPROFILE_JOIN(ProfileScope_, __LINE__)(Name)
+#define RPROFILE_FUNCTION()			RPROFILE_SCOPE(__FUNCTION__)
+#else
+#define RPROFILE_SCOPE(Name)
+#define RPROFILE_FUNCTION()
+#endif
@@ -74,6 +74,46 @@ bool RRay::TestIntersectionWithAabb(const RAabb& aabb, float* t/*=nullptr*/) con
 	return false;
 }
 
+bool RRay::TestSegmentIntersectionWithAabb(const RAabb& aabb, float* t /*= nullptr*/) const
+{
+	if (!aabb.IsValid())
+		return false;
+
+	const float RayOrigin[3] = { Origin.X(), Origin.Y(), Origin.Z() };
+	const float RayDir[3] = { Direction.X(), Direction.Y(), Direction.Z() };
+	const float BoundsMin[3] = { aabb.pMin.X(), aabb.pMin.Y(), aabb.pMin.Z() };
+	const float BoundsMax[3] = { aabb.pMax.X(), aabb.pMax.Y(), aabb.pMax.Z() };
+
+	float tmin = 0.0f, tmax = Distance;
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (FLT_EQUAL_ZERO(RayDir[i]))
+		{
+			// Ray is parallel to the slab and has to start between its planes
+			if (RayOrigin[i] < BoundsMin[i] || RayOrigin[i] > BoundsMax[i])
+				return false;
+		}
+		else
+		{
+			float t1 = (BoundsMin[i] - RayOrigin[i]) / RayDir[i];
+			float t2 = (BoundsMax[i] - RayOrigin[i]) / RayDir[i];
+
+			tmin = RMath::Max(tmin, RMath::Min(t1, t2));
+			tmax = RMath::Min(tmax, RMath::Max(t1, t2));
+		}
+	}
+
+	if (tmax >= tmin)
+	{
+		if (t)
+			*t = tmin;
+		return true;
+	}
+
+	return false;
+}
+
 bool RRay::TestIntersectionWithPlane(const RPlane& Plane, float* t /*= nullptr*/) const
 {
 	float d = RVec3::Dot(Plane.normal, Direction);
@@ -30,6 +30,10 @@ public:
 	//		t: If intersects, fill the value with the time of intersection
 	bool TestIntersectionWithAabb(const RAabb& aabb, float* t = nullptr) const;
 
+	// Test for intersection with an AABB between ray origin and Distance.
+	//		t: If intersects, fill the value with the distance where the ray enters the AABB, or 0 if it starts inside
+	bool TestSegmentIntersectionWithAabb(const RAabb& aabb, float* t = nullptr) const;
+
 	// Test for ray intersection with a plane
 	bool TestIntersectionWithPlane(const RPlane& Plane, float* t = nullptr) const;
 };
@@ -6,32 +6,113 @@
 
 #include "RSerializer.h"
 
+#include "Core/RVirtualFileSystem.h"
+#include "Core/RLog.h"
+
+RSerializer::RSerializer()
+	: OperationMode(ESerializeMode::Read)
+	, m_ReadData(nullptr)
+	, m_ReadSize(0)
+	, m_ReadOffset(0)
+	, m_bOpen(false)
+	, m_bReadFromMemory(false)
+	, m_bReadError(false)
+{
+
+}
+
 RSerializer::~RSerializer()
 {
 	Close();
 }
 
-void RSerializer::Open(const std::string& filename, ESerializeMode mode)
+void RSerializer::Open(const std::string& filename, ESerializeMode mode, ESerializeSource Source /*= ESerializeSource::MappedFile*/)
 {
+	Close();
+
 	OperationMode = mode;
 
-	m_FileStream.open(filename, (mode == ESerializeMode::Read ? std::ios::in : std::ios::out) | std::ios::binary);
+	if (mode == ESerializeMode::Read)
+	{
+		// Archive data stays mapped while the archive is mounted, so it is read in place
+		if (GVirtualFileSystem.IsInArchive(filename))
+		{
+			RFileData FileData = GVirtualFileSystem.ReadFile(filename);
+			if (FileData.IsValid())
+			{
+				BeginMemoryRead(FileData.GetData(), FileData.GetSize());
+			}
+			return;
+		}
+
+		if (Source == ESerializeSource::MappedFile)
+		{
+			if (m_MappedFile.Open(filename))
+			{
+				BeginMemoryRead(m_MappedFile.GetData(), m_MappedFile.GetSize());
+			}
+			return;
+		}
+	}
+
+	m_FileStream.clear();
+	m_FileStream.open(filename, (mode == ESerializeMode::Read ? std::ios::in | std::ios::ate : std::ios::out) | std::ios::binary);
 
 	if (!m_FileStream.is_open())
 		return;
+
+	if (mode == ESerializeMode::Read)
+	{
+		m_ReadSize = (size_t)m_FileStream.tellg();
+		m_FileStream.seekg(0);
+	}
+
+	m_bOpen = true;
+}
+
+void RSerializer::OpenMemory(const void* Data, size_t Size)
+{
+	Close();
+	BeginMemoryRead(Data, Size);
+}
+
+void RSerializer::BeginMemoryRead(const void* Data, size_t Size)
+{
+	OperationMode = ESerializeMode::Read;
+
+	m_ReadData = (const char*)Data;
+	m_ReadSize = Size;
+	m_ReadOffset = 0;
+	m_bReadFromMemory = true;
+	m_bReadError = false;
+	m_bOpen = true;
+}
+
+void RSerializer::Close()
+{
+	if (m_FileStream.is_open())
+		m_FileStream.close();
+
+	m_MappedFile.Close();
+
+	m_ReadData = nullptr;
+	m_ReadSize = 0;
+	m_ReadOffset = 0;
+	m_bOpen = false;
+	m_bReadFromMemory = false;
+	m_bReadError = false;
 }
 
 bool RSerializer::EnsureHeader(const char* header, UINT size)
 {
 	if (OperationMode == ESerializeMode::Write)
 	{
-		m_FileStream.write(header, size);
+		WriteBytes(header, size);
 	}
 	else
 	{
-		assert(!m_FileStream.eof());
 		char* pBuf = new char[size];
-		m_FileStream.read(pBuf, size);
+		ReadBytes(pBuf, size);
 
 		for (UINT i = 0; i < size; i++)
 		{
@@ -47,3 +128,86 @@ bool RSerializer::EnsureHeader(const char* header, UINT size)
 
 	return true;
 }
+
+size_t RSerializer::Tell()
+{
+	if (OperationMode == ESerializeMode::Write)
+	{
+		return (size_t)m_FileStream.tellp();
+	}
+
+	return m_bReadFromMemory ? m_ReadOffset : (size_t)m_FileStream.tellg();
+}
+
+bool RSerializer::Seek(size_t Offset)
+{
+	if (OperationMode == ESerializeMode::Write)
+	{
+		m_FileStream.seekp(Offset);
+		return true;
+	}
+
+	if (Offset > m_ReadSize)
+	{
+		OnReadOverflow();
+		return false;
+	}
+
+	if (m_bReadFromMemory)
+	{
+		m_ReadOffset = Offset;
+	}
+	else
+	{
+		m_FileStream.clear();
+		m_FileStream.seekg(Offset);
+	}
+
+	return true;
+}
+
+const void* RSerializer::BorrowBytes(size_t Size, size_t Alignment)
+{
+	if (!m_bReadFromMemory || Size > m_ReadSize - m_ReadOffset)
+	{
+		return nullptr;
+	}
+
+	const char* Data = m_ReadData + m_ReadOffset;
+	if ((size_t)Data % Alignment != 0)
+	{
+		return nullptr;
+	}
+
+	m_ReadOffset += Size;
+	return Data;
+}
+
+UINT RSerializer::ReadArraySize(size_t ElementSize)
+{
+	UINT Size = 0;
+	if (!ReadBytes(&Size, sizeof(Size)))
+	{
+		return 0;
+	}
+
+	size_t ReadOffset = m_bReadFromMemory ? m_ReadOffset : (size_t)m_FileStream.tellg();
+	if ((UINT64)Size * ElementSize > (UINT64)(m_ReadSize - ReadOffset))
+	{
+		OnReadOverflow();
+		return 0;
+	}
+
+	return Size;
+}
+
+void RSerializer::OnReadOverflow()
+{
+	if (!m_bReadError)
+	{
+		RLogError("Serializer read past the end of data. The file may be corrupted.\n");
+	}
+
+	m_bReadError = true;
+	m_ReadOffset = m_ReadSize;
+}
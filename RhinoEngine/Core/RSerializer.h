@@ -7,6 +7,7 @@
 #pragma once
 
 #include "Core/CoreTypes.h"
+#include "Core/RMappedFile.h"
 
 enum class ESerializeMode : uint8_t
 {
@@ -14,25 +15,64 @@ enum class ESerializeMode : uint8_t
 	Write,
 };
 
+/// Where a serializer in read mode gets its data from
+enum class ESerializeSource : uint8_t
+{
+	MappedFile,				// Map the whole file into memory, or use archive data in place
+	FileStream,				// Read through a buffered file stream with one call per serialized item
+};
+
+/// A read-only array of plain data in serialized data. When reading from memory, the view borrows the
+/// serializer's data without copying, which stays valid until the serializer is closed (or, for files in
+/// mounted asset archives, until the archive is unmounted). Otherwise the view keeps its own copy.
+template<typename T>
+class RSerializedView
+{
+	friend class RSerializer;
+public:
+	RSerializedView()
+		: Data(nullptr)
+		, Size(0)
+	{}
+
+	/// Make a view of existing data for writing
+	RSerializedView(const T* InData, UINT InSize)
+		: Data(InData)
+		, Size(InSize)
+	{}
+
+	const T* GetData() const				{ return Data; }
+	UINT GetSize() const					{ return Size; }
+	bool IsBorrowed() const					{ return Data != nullptr && Data != OwnedData.data(); }
+
+	const T& operator[](UINT Index) const	{ assert(Index < Size); return Data[Index]; }
+
+private:
+	const T*		Data;
+	UINT			Size;
+	std::vector<T>	OwnedData;
+};
+
 class RSerializer
 {
 public:
+	RSerializer();
 	~RSerializer();
 
-	/// Open a file for serialization
-	void Open(const std::string& filename, ESerializeMode mode);
+	/// Open a file for serialization. Files in mounted asset archives are read from archive memory
+	/// regardless of the source.
+	void Open(const std::string& filename, ESerializeMode mode, ESerializeSource Source = ESerializeSource::MappedFile);
+
+	/// Open a buffer in memory for reading. The buffer must stay valid while the serializer is open.
+	void OpenMemory(const void* Data, size_t Size);
 
 	/// Close file stream of serializer
-	FORCEINLINE void Close()
-	{
-		if (m_FileStream.is_open())
-			m_FileStream.close();
-	}
+	void Close();
 
 	/// Check if file stream is open
 	FORCEINLINE bool IsOpen() const
 	{
-		return m_FileStream.is_open();
+		return m_bOpen;
 	}
 
 	/// Check if serializer is in reading mode
@@ -47,6 +87,24 @@ public:
 		return OperationMode == ESerializeMode::Write;
 	}
 
+	/// Check if reading has run past the end of data. Values read since then are zero.
+	FORCEINLINE bool HasError() const
+	{
+		return m_bReadError;
+	}
+
+	/// Get current position in the file or buffer
+	size_t Tell();
+
+	/// Get size of the file or buffer being read
+	FORCEINLINE size_t GetReadSize() const
+	{
+		return m_ReadSize;
+	}
+
+	/// Move to a position in the file or buffer. Returns false if reading and the position is past the end of data.
+	bool Seek(size_t Offset);
+
 	/// Serialize a string file header
 	///   Write mode : Write header string to file stream.
 	///                Always returns true
@@ -62,18 +120,16 @@ public:
 		if (OperationMode == ESerializeMode::Write)
 		{
 			UINT size = (UINT)vec.size();
-			m_FileStream.write((char*)&size, sizeof(size));
+			WriteBytes(&size, sizeof(size));
 			if (size)
-				m_FileStream.write((char*)vec.data(), sizeof(T) * size);
+				WriteBytes(vec.data(), sizeof(T) * size);
 		}
 		else
 		{
-			assert(!m_FileStream.eof());
-			UINT size;
-			m_FileStream.read((char*)&size, sizeof(size));
+			UINT size = ReadArraySize(sizeof(T));
 			vec.resize(size);
 			if (size)
-				m_FileStream.read((char*)vec.data(), sizeof(T) * size);
+				ReadBytes(vec.data(), sizeof(T) * size);
 		}
 	}
 
@@ -85,12 +141,12 @@ public:
 		if (OperationMode == ESerializeMode::Write)
 		{
 			size = (UINT)vec.size();
-			m_FileStream.write((char*)&size, sizeof(size));
+			WriteBytes(&size, sizeof(size));
 		}
 		else
 		{
-			assert(!m_FileStream.eof());
-			m_FileStream.read((char*)&size, sizeof(size));
+			// Each element takes at least one byte
+			size = ReadArraySize(1);
 			vec.resize(size);
 		}
 
@@ -100,40 +156,67 @@ public:
 		}
 	}
 
+	/// Serialize an array of plain data type in the same format as SerializeVector. When reading from
+	/// memory, the view borrows serialized data instead of copying it.
+	template<typename T>
+	void SerializeView(RSerializedView<T>& view)
+	{
+		if (OperationMode == ESerializeMode::Write)
+		{
+			WriteBytes(&view.Size, sizeof(view.Size));
+			if (view.Size)
+				WriteBytes(view.Data, sizeof(T) * view.Size);
+		}
+		else
+		{
+			view.OwnedData.clear();
+			view.Size = ReadArraySize(sizeof(T));
+
+			const void* Borrowed = view.Size ? BorrowBytes(sizeof(T) * view.Size, alignof(T)) : nullptr;
+			if (Borrowed)
+			{
+				view.Data = (const T*)Borrowed;
+			}
+			else
+			{
+				view.OwnedData.resize(view.Size);
+				if (view.Size)
+					ReadBytes(view.OwnedData.data(), sizeof(T) * view.Size);
+				view.Data = view.OwnedData.data();
+			}
+		}
+	}
+
 	/// Serialize a plain data type
 	template<typename T>
 	void SerializeData(T& data)
 	{
 		if (OperationMode == ESerializeMode::Write)
 		{
-			m_FileStream.write((char*)&data, sizeof(T));
+			WriteBytes(&data, sizeof(T));
 		}
 		else
 		{
-			assert(!m_FileStream.eof());
-			m_FileStream.read((char*)&data, sizeof(T));
+			ReadBytes(&data, sizeof(T));
 		}
 	}
 
-	/// Serialize a string
-	template<>
-	void SerializeData<std::string>(std::string& str)
+	/// Serialize a string. Chosen over the plain data template for strings.
+	void SerializeData(std::string& str)
 	{
 		if (OperationMode == ESerializeMode::Write)
 		{
 			UINT size = (UINT)str.size();
-			m_FileStream.write((char*)&size, sizeof(size));
+			WriteBytes(&size, sizeof(size));
 			if (size)
-				m_FileStream.write((char*)str.data(), size);
+				WriteBytes(str.data(), size);
 		}
 		else
 		{
-			assert(!m_FileStream.eof());
-			UINT size;
-			m_FileStream.read((char*)&size, sizeof(size));
+			UINT size = ReadArraySize(1);
 			str.resize(size);
 			if (size)
-				m_FileStream.read((char*)str.data(), size);
+				ReadBytes(&str[0], size);
 		}
 	}
 
@@ -144,12 +227,11 @@ public:
 		if (size)
 		{
 			if (OperationMode == ESerializeMode::Write)
-				m_FileStream.write((char*)*arr, sizeof(T) * size);
+				WriteBytes(*arr, sizeof(T) * size);
 			else
 			{
-				assert(!m_FileStream.eof());
 				*arr = new T[size];
-				m_FileStream.read((char*)*arr, sizeof(T) * size);
+				ReadBytes(*arr, sizeof(T) * size);
 			}
 		}
 	}
@@ -172,7 +254,6 @@ public:
 		{
 			if (OperationMode == ESerializeMode::Read)
 			{
-				assert(!m_FileStream.eof());
 				*pObj = new T();
 			}
 			(*pObj)->Serialize(*this);
@@ -180,8 +261,64 @@ public:
 	}
 
 private:
+	void BeginMemoryRead(const void* Data, size_t Size);
+
+	FORCEINLINE void WriteBytes(const void* Data, size_t Size)
+	{
+		m_FileStream.write((const char*)Data, Size);
+	}
+
+	/// Copy bytes at the read cursor. Fills the destination with zeros if there isn't enough data left.
+	FORCEINLINE bool ReadBytes(void* Dest, size_t Size)
+	{
+		if (m_bReadFromMemory)
+		{
+			if (Size > m_ReadSize - m_ReadOffset)
+			{
+				OnReadOverflow();
+				memset(Dest, 0, Size);
+				return false;
+			}
+
+			memcpy(Dest, m_ReadData + m_ReadOffset, Size);
+			m_ReadOffset += Size;
+			return true;
+		}
+
+		if (m_bReadError || !m_FileStream.read((char*)Dest, Size))
+		{
+			m_bReadError = true;
+			memset(Dest, 0, Size);
+			return false;
+		}
+
+		return true;
+	}
+
+	/// Get bytes at the read cursor without copying and advance the cursor. Returns nullptr if reading
+	/// from a stream, if the data is not aligned for the requested type, or if there isn't enough data left.
+	const void* BorrowBytes(size_t Size, size_t Alignment);
+
+	/// Read number of elements of an array. Returns zero if the remaining data can't hold that many elements,
+	/// so corrupted files never cause huge allocations.
+	UINT ReadArraySize(size_t ElementSize);
+
+	void OnReadOverflow();
+
 	/// Current operation mode (read or write)
 	ESerializeMode	OperationMode;
 	std::fstream	m_FileStream;
+
+	/// Loose files read from memory are mapped by the serializer
+	RMappedFile		m_MappedFile;
+
+	/// Memory being read and the read cursor
+	const char*		m_ReadData;
+	size_t			m_ReadSize;
+	size_t			m_ReadOffset;
+
+	bool			m_bOpen;
+	bool			m_bReadFromMemory;
+	bool			m_bReadError;
 };
 
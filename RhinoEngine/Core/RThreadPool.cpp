@@ -0,0 +1,196 @@
+//=============================================================================
+// RThreadPool.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RThreadPool.h"
+#include "RProfiler.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+struct RThreadPoolContext
+{
+	RThreadPoolContext()
+		: bShouldQuit(false)
+	{}
+
+	std::vector<std::thread>			WorkerThreads;
+
+	std::mutex							TaskQueueMutex;
+	std::condition_variable				TaskQueueCondition;
+	std::queue<std::function<void()>>	TaskQueue;
+	bool								bShouldQuit;
+};
+
+namespace
+{
+	void WorkerThreadMain(RThreadPoolContext* Context, int WorkerIndex)
+	{
+		GProfiler.SetThreadName("Worker " + std::to_string(WorkerIndex));
+
+		while (1)
+		{
+			std::function<void()> Task;
+
+			{
+				std::unique_lock<std::mutex> UniqueLock(Context->TaskQueueMutex);
+
+				// Block thread until we get another task or need to quit. Remaining tasks are drained before quitting.
+				Context->TaskQueueCondition.wait(UniqueLock, [Context] { return Context->TaskQueue.size() != 0 || Context->bShouldQuit; });
+
+				if (Context->TaskQueue.size() == 0)
+					break;
+
+				Task = std::move(Context->TaskQueue.front());
+				Context->TaskQueue.pop();
+			}
+
+			RPROFILE_SCOPE("Worker task");
+			Task();
+		}
+	}
+
+	/// Shared state of one ParallelFor call. Kept alive by helper tasks that may start after the call has returned.
+	struct ParallelForState
+	{
+		ParallelForState(int InBegin, int InEnd, int InGrainSize, const std::function<void(int, int)>& InBody)
+			: Begin(InBegin)
+			, End(InEnd)
+			, GrainSize(InGrainSize)
+			, NumChunks((InEnd - InBegin + InGrainSize - 1) / InGrainSize)
+			, Body(InBody)
+			, NextChunk(0)
+			, NumFinishedChunks(0)
+		{}
+
+		/// Execute chunks until none is left
+		void RunChunks()
+		{
+			int NumExecuted = 0;
+			for (int Chunk = NextChunk++; Chunk < NumChunks; Chunk = NextChunk++)
+			{
+				int ChunkBegin = Begin + Chunk * GrainSize;
+				int ChunkEnd = RMath::Min(ChunkBegin + GrainSize, End);
+				Body(ChunkBegin, ChunkEnd);
+				NumExecuted++;
+			}
+
+			if (NumExecuted > 0 && (NumFinishedChunks += NumExecuted) == NumChunks)
+			{
+				std::unique_lock<std::mutex> UniqueLock(DoneMutex);
+				DoneCondition.notify_all();
+			}
+		}
+
+		const int Begin;
+		const int End;
+		const int GrainSize;
+		const int NumChunks;
+
+		// Body is owned by the caller, which is blocked until all chunks are done
+		const std::function<void(int, int)>& Body;
+
+		std::atomic<int>		NextChunk;
+		std::atomic<int>		NumFinishedChunks;
+		std::mutex				DoneMutex;
+		std::condition_variable	DoneCondition;
+	};
+}
+
+RThreadPool::RThreadPool()
+	: Context(std::make_unique<RThreadPoolContext>())
+{
+
+}
+
+RThreadPool::~RThreadPool()
+{
+	Shutdown();
+}
+
+void RThreadPool::Initialize(int NumThreads /*= -1*/)
+{
+	assert(Context->WorkerThreads.size() == 0);
+
+	if (NumThreads < 0)
+	{
+		NumThreads = RMath::Max((int)std::thread::hardware_concurrency() - 1, 0);
+	}
+
+	Context->bShouldQuit = false;
+	for (int i = 0; i < NumThreads; i++)
+	{
+		Context->WorkerThreads.emplace_back(WorkerThreadMain, Context.get(), i);
+	}
+}
+
+void RThreadPool::Shutdown()
+{
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->TaskQueueMutex);
+		Context->bShouldQuit = true;
+	}
+	Context->TaskQueueCondition.notify_all();
+
+	for (auto& WorkerThread : Context->WorkerThreads)
+	{
+		WorkerThread.join();
+	}
+	Context->WorkerThreads.clear();
+}
+
+int RThreadPool::GetNumWorkerThreads() const
+{
+	return (int)Context->WorkerThreads.size();
+}
+
+void RThreadPool::EnqueueTask(std::function<void()> Task)
+{
+	// Run the task in place if there's no worker to pick it up
+	if (Context->WorkerThreads.size() == 0)
+	{
+		Task();
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->TaskQueueMutex);
+		Context->TaskQueue.push(std::move(Task));
+	}
+	Context->TaskQueueCondition.notify_one();
+}
+
+void RThreadPool::ParallelFor(int Begin, int End, int GrainSize, const std::function<void(int, int)>& Body)
+{
+	if (End <= Begin)
+		return;
+
+	GrainSize = RMath::Max(GrainSize, 1);
+	auto State = std::make_shared<ParallelForState>(Begin, End, GrainSize, Body);
+
+	if (State->NumChunks == 1 || Context->WorkerThreads.size() == 0)
+	{
+		State->RunChunks();
+		return;
+	}
+
+	// The calling thread takes a share of the chunks, so we need one helper less than the number of chunks
+	int NumHelpers = RMath::Min(State->NumChunks - 1, (int)Context->WorkerThreads.size());
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->TaskQueueMutex);
+		for (int i = 0; i < NumHelpers; i++)
+		{
+			Context->TaskQueue.push([State]() { State->RunChunks(); });
+		}
+	}
+	Context->TaskQueueCondition.notify_all();
+
+	State->RunChunks();
+
+	std::unique_lock<std::mutex> UniqueLock(State->DoneMutex);
+	State->DoneCondition.wait(UniqueLock, [&State] { return State->NumFinishedChunks == State->NumChunks; });
+}
@@ -0,0 +1,42 @@
+//=============================================================================
+// RThreadPool.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Engine worker thread pool
+//=============================================================================
+
+#pragma once
+
+#include "Core/RSingleton.h"
+#include "Core/CoreTypes.h"
+
+struct RThreadPoolContext;
+
+/// A pool of worker threads shared by engine subsystems
+class RThreadPool : public RSingleton<RThreadPool>
+{
+	friend class RSingleton<RThreadPool>;
+public:
+	RThreadPool();
+	~RThreadPool();
+
+	/// Create worker threads. If NumThreads is negative, one worker is created for each hardware thread except the calling one.
+	void Initialize(int NumThreads = -1);
+
+	/// Wait for queued tasks to finish and destroy all worker threads
+	void Shutdown();
+
+	/// Get number of worker threads in the pool. The calling thread is not counted.
+	int GetNumWorkerThreads() const;
+
+	/// Push a task to the queue. The task will be executed by the first available worker.
+	void EnqueueTask(std::function<void()> Task);
+
+	/// Split [Begin, End) into chunks of at least GrainSize elements and run them on worker threads.
+	/// The calling thread also executes chunks and returns when all of them are done.
+	void ParallelFor(int Begin, int End, int GrainSize, const std::function<void(int, int)>& Body);
+
+private:
+	std::unique_ptr<RThreadPoolContext>	Context;
+};
+
+#define GThreadPool RThreadPool::Instance()
@@ -9,7 +9,7 @@
 #include <Windows.h>	// QueryPerformanceFrequency, QueryPerformanceCounter
 
 RTimer::RTimer()
-	: m_SecondsPerCount(0.0), m_DeltaTime(-1.0), m_BaseTime(0),
+	: m_SecondsPerCount(0.0), m_DeltaTime(-1.0), m_FixedDeltaTime(0.0), m_BaseTime(0),
 	  m_PausedTime(0), m_PrevTime(0), m_CurrTime(0), m_Stopped(false)
 {
 	__int64 countsPerSec;
@@ -97,7 +97,14 @@ void RTimer::Tick()
 
 	// Get the time this frame.
 	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	if (m_FixedDeltaTime > 0.0)
+	{
+		currTime = m_PrevTime + (__int64)(m_FixedDeltaTime / m_SecondsPerCount);
+	}
+	else
+	{
+		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	}
 	m_CurrTime = currTime;
 
 	// Time difference between this frame and the previous.
@@ -112,3 +119,8 @@ void RTimer::Tick()
 		m_DeltaTime = 0.0f;
 	}
 }
+
+void RTimer::SetFixedDeltaTime(float Seconds)
+{
+	m_FixedDeltaTime = Seconds;
+}
@@ -19,9 +19,13 @@ public:
 	void Stop();
 	void Tick();
 
+	// If greater than 0, every tick advances the timer by this many seconds instead of the real time passed
+	void SetFixedDeltaTime(float Seconds);
+
 private:
 	double		m_SecondsPerCount;
 	double		m_DeltaTime;
+	double		m_FixedDeltaTime;
 
 	__int64		m_BaseTime;
 	__int64		m_PausedTime;
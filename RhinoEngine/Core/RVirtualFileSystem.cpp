@@ -0,0 +1,237 @@
+//=============================================================================
+// RVirtualFileSystem.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RVirtualFileSystem.h"
+
+#include "Core/RFileUtil.h"
+#include "Core/RLog.h"
+
+RVirtualFileSystem::RVirtualFileSystem()
+	: NumArchiveReads(0)
+	, NumLooseFileReads(0)
+{
+
+}
+
+bool RVirtualFileSystem::MountArchive(const std::string& ArchivePath, const std::string& MountPath)
+{
+	std::unique_ptr<MountedArchive> NewArchive(new MountedArchive);
+	if (!NewArchive->Archive.Open(ArchivePath))
+	{
+		RLogError("Failed to mount asset archive %s.\n", ArchivePath.c_str());
+		return false;
+	}
+
+	NewArchive->MountPath = NormalizePath(MountPath);
+	if (NewArchive->MountPath.size() == 0 || NewArchive->MountPath.back() != '/')
+	{
+		NewArchive->MountPath += "/";
+	}
+
+	RLog("Mounted asset archive %s (%d files) at %s\n", ArchivePath.c_str(), NewArchive->Archive.GetNumEntries(), MountPath.c_str());
+
+	MountedArchives.push_back(std::move(NewArchive));
+	return true;
+}
+
+void RVirtualFileSystem::UnmountAll()
+{
+	MountedArchives.clear();
+
+	std::lock_guard<std::mutex> Lock(LooseFileNewerCacheMutex);
+	LooseFileNewerCache.clear();
+}
+
+void RVirtualFileSystem::InvalidateLooseFile(const std::string& Path)
+{
+	std::lock_guard<std::mutex> Lock(LooseFileNewerCacheMutex);
+	LooseFileNewerCache.erase(NormalizePath(Path));
+}
+
+bool RVirtualFileSystem::FileExists(const std::string& Path) const
+{
+	const RAssetArchive* Archive;
+	if (FindArchiveEntry(Path, &Archive))
+	{
+		return true;
+	}
+
+	return RFileUtil::CheckPathExists(Path);
+}
+
+bool RVirtualFileSystem::IsInArchive(const std::string& Path) const
+{
+	const RAssetArchive* Archive;
+	const RAssetArchiveEntry* Entry = FindArchiveEntry(Path, &Archive);
+	return Entry && (Entry->Flags & AEF_Stripped) == 0;
+}
+
+RFileData RVirtualFileSystem::ReadFile(const std::string& Path) const
+{
+	RFileData FileData;
+
+	const RAssetArchive* Archive;
+	const RAssetArchiveEntry* Entry = FindArchiveEntry(Path, &Archive);
+
+	// Stripped files have no content in the archive, but may still exist on disk
+	if (Entry && (Entry->Flags & AEF_Stripped) == 0)
+	{
+		// Empty entries still need a non-null pointer to be recognized as archive data
+		static const char EmptyData = 0;
+
+		FileData.ArchiveData = Entry->DataSize > 0 ? Archive->GetEntryData(*Entry) : &EmptyData;
+		FileData.Size = (size_t)Entry->DataSize;
+		FileData.bValid = true;
+
+		NumArchiveReads++;
+		return FileData;
+	}
+
+	std::ifstream FileStream(Path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!FileStream.is_open())
+	{
+		return FileData;
+	}
+
+	FileData.Size = (size_t)FileStream.tellg();
+	FileData.OwnedData.resize(FileData.Size);
+	FileStream.seekg(0);
+	FileStream.read(FileData.OwnedData.data(), (std::streamsize)FileData.Size);
+	FileData.bValid = !FileStream.fail();
+
+	NumLooseFileReads++;
+	return FileData;
+}
+
+std::vector<std::string> RVirtualFileSystem::EnumerateFiles(const std::string& MountPath) const
+{
+	std::vector<std::string> Files;
+
+	// Keep one path for files both packed and on disk. Lower-cased paths are used as keys.
+	std::set<std::string> AddedFiles;
+	auto AddFile = [&Files, &AddedFiles](const std::string& FilePath)
+	{
+		std::string Key = RFileUtil::UnifyPathSeperators(FilePath);
+		std::transform(Key.begin(), Key.end(), Key.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+
+		if (AddedFiles.insert(Key).second)
+		{
+			Files.push_back(FilePath);
+		}
+	};
+
+	std::string NormalizedMountPath = NormalizePath(MountPath);
+	if (NormalizedMountPath.size() == 0 || NormalizedMountPath.back() != '/')
+	{
+		NormalizedMountPath += "/";
+	}
+
+	for (auto Iter = MountedArchives.rbegin(); Iter != MountedArchives.rend(); Iter++)
+	{
+		const MountedArchive& Mounted = **Iter;
+		if (!RAssetArchive::IsSamePath(Mounted.MountPath.data(), Mounted.MountPath.size(), NormalizedMountPath.data(), NormalizedMountPath.size()))
+		{
+			continue;
+		}
+
+		for (int i = 0; i < Mounted.Archive.GetNumEntries(); i++)
+		{
+			AddFile(Mounted.Archive.GetEntryPath(Mounted.Archive.GetEntry(i)));
+		}
+	}
+
+	if (RFileUtil::CheckPathExists(MountPath))
+	{
+		for (const std::string& FilePath : RFileUtil::GetFilesInDirectoryAndSubdirectories(MountPath, "*.*"))
+		{
+			AddFile(FilePath);
+		}
+	}
+
+	return Files;
+}
+
+const RAssetArchiveEntry* RVirtualFileSystem::FindArchiveEntry(const std::string& Path, const RAssetArchive** OutArchive) const
+{
+	if (MountedArchives.size() == 0)
+	{
+		return nullptr;
+	}
+
+	const std::string NormalizedPath = NormalizePath(Path);
+
+	for (auto Iter = MountedArchives.rbegin(); Iter != MountedArchives.rend(); Iter++)
+	{
+		const MountedArchive& Mounted = **Iter;
+		const size_t MountPathLength = Mounted.MountPath.size();
+
+		// Paths in archives are relative to the mount path and start with '/'
+		if (NormalizedPath.size() <= MountPathLength ||
+			!RAssetArchive::IsSamePath(NormalizedPath.data(), MountPathLength, Mounted.MountPath.data(), MountPathLength))
+		{
+			continue;
+		}
+
+		const RAssetArchiveEntry* Entry = Mounted.Archive.FindEntry(NormalizedPath.substr(MountPathLength - 1));
+		if (Entry)
+		{
+#if !defined(RHINO_SHIPPING)
+			// Let assets edited after packing take effect without repacking
+			if (IsLooseFileNewer(NormalizedPath, Mounted.Archive))
+			{
+				return nullptr;
+			}
+#endif
+
+			*OutArchive = &Mounted.Archive;
+			return Entry;
+		}
+	}
+
+	return nullptr;
+}
+
+bool RVirtualFileSystem::IsLooseFileNewer(const std::string& Path, const RAssetArchive& Archive) const
+{
+	std::lock_guard<std::mutex> Lock(LooseFileNewerCacheMutex);
+
+	auto Iter = LooseFileNewerCache.find(Path);
+	if (Iter != LooseFileNewerCache.end())
+	{
+		return Iter->second;
+	}
+
+	// Files missing on disk compare as invalid and keep using the archive
+	const bool bNewer = RFileUtil::CompareFileTimestamp(Archive.GetArchivePath(), Path) == ETimestampComparison::EarlierFirst;
+	if (bNewer)
+	{
+		RLogWarning("Loose file %s is newer than its packed copy in %s. Reading the loose file; repack the archive to update it.\n",
+			Path.c_str(), Archive.GetArchivePath().c_str());
+	}
+
+	LooseFileNewerCache[Path] = bNewer;
+	return bNewer;
+}
+
+std::string RVirtualFileSystem::NormalizePath(const std::string& Path)
+{
+	std::string Result = RFileUtil::UnifyPathSeperators(Path);
+
+	// Remove references to current directory
+	size_t Pos = Result.find("/./");
+	while (Pos != std::string::npos)
+	{
+		Result.replace(Pos, 3, "/");
+		Pos = Result.find("/./");
+	}
+
+	while (Result.compare(0, 2, "./") == 0)
+	{
+		Result.erase(0, 2);
+	}
+
+	return Result;
+}
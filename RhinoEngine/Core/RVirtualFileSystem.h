@@ -0,0 +1,111 @@
+//=============================================================================
+// RVirtualFileSystem.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Reads files from mounted asset archives, falling back to loose files
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+#include "Core/RSingleton.h"
+#include "Core/RAssetArchive.h"
+
+#include <atomic>
+#include <mutex>
+
+/// Content of a file read through the virtual file system. Files from an archive point directly into
+/// the mapped archive and are not copied. Loose files are read into memory owned by this object.
+class RFileData
+{
+	friend class RVirtualFileSystem;
+public:
+	RFileData()
+		: ArchiveData(nullptr)
+		, Size(0)
+		, bValid(false)
+	{}
+
+	RFileData(RFileData&&) = default;
+	RFileData& operator=(RFileData&&) = default;
+
+	RFileData(const RFileData&) = delete;
+	RFileData& operator=(const RFileData&) = delete;
+
+	const char* GetData() const			{ return ArchiveData ? ArchiveData : OwnedData.data(); }
+	size_t GetSize() const				{ return Size; }
+
+	/// Check if the file has been read successfully
+	bool IsValid() const				{ return bValid; }
+
+	bool IsFromArchive() const			{ return ArchiveData != nullptr; }
+
+private:
+	const char*			ArchiveData;
+	std::vector<char>	OwnedData;
+	size_t				Size;
+	bool				bValid;
+};
+
+class RVirtualFileSystem : public RSingleton<RVirtualFileSystem>
+{
+	friend class RSingleton<RVirtualFileSystem>;
+public:
+	/// Mount an asset archive so files under MountPath are read from it. Archives mounted later take
+	/// precedence over earlier ones. Mount archives before any resource starts loading, since lookups
+	/// are not locked.
+	bool MountArchive(const std::string& ArchivePath, const std::string& MountPath);
+
+	/// Unmount all archives. Data returned by previous reads from archives is no longer valid.
+	void UnmountAll();
+
+	int GetNumMountedArchives() const		{ return (int)MountedArchives.size(); }
+
+	/// Forget whether a loose file is newer than its packed copy. Call it after writing a file, so the next read
+	/// compares timestamps again and picks up the new content.
+	void InvalidateLooseFile(const std::string& Path);
+
+	/// Check if a file exists either in a mounted archive or on disk
+	bool FileExists(const std::string& Path) const;
+
+	/// Check if content of a file can be read from a mounted archive. Outside shipping builds, a loose file
+	/// newer than the archive is read instead of its packed copy, so it's not counted as in the archive.
+	bool IsInArchive(const std::string& Path) const;
+
+	/// Read a whole file. Files in archives are returned without copying.
+	RFileData ReadFile(const std::string& Path) const;
+
+	/// Get paths ("/Dir/File.ext") of all files under a directory, from both mounted archives and disk
+	std::vector<std::string> EnumerateFiles(const std::string& MountPath) const;
+
+	int GetNumArchiveReads() const			{ return NumArchiveReads; }
+	int GetNumLooseFileReads() const		{ return NumLooseFileReads; }
+
+private:
+	RVirtualFileSystem();
+
+	struct MountedArchive
+	{
+		RAssetArchive	Archive;
+		std::string		MountPath;
+	};
+
+	/// Find an archive entry of a file. Returns nullptr if the file is not in any mounted archive.
+	const RAssetArchiveEntry* FindArchiveEntry(const std::string& Path, const RAssetArchive** OutArchive) const;
+
+	/// Check if a loose file has been modified after the archive packing it. The result is cached per path until
+	/// InvalidateLooseFile is called, and a warning is logged the first time a file is found to be newer.
+	bool IsLooseFileNewer(const std::string& Path, const RAssetArchive& Archive) const;
+
+	/// Convert a path to the form used in archive lookups
+	static std::string NormalizePath(const std::string& Path);
+
+	std::vector<std::unique_ptr<MountedArchive>>	MountedArchives;
+
+	mutable std::unordered_map<std::string, bool>	LooseFileNewerCache;
+	mutable std::mutex								LooseFileNewerCacheMutex;
+
+	mutable std::atomic<int>	NumArchiveReads;
+	mutable std::atomic<int>	NumLooseFileReads;
+};
+
+#define GVirtualFileSystem RVirtualFileSystem::Instance()
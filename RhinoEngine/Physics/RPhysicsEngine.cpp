@@ -7,40 +7,247 @@
 #include "RPhysicsEngine.h"
 
 #include "RPhysicsPrivate.h"
+#include "RPhysicsTaskScheduler.h"
+
+#include "Core/RLog.h"
+#include "Resource/RResourceManager.h"
+
+void RPhysicsEngineContext::CreateWorld(bool bInMultithreaded)
+{
+	bMultithreaded = bInMultithreaded;
+
+	CollisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>();
+	Broadphase = std::make_unique<btDbvtBroadphase>();
+
+	if (bMultithreaded)
+	{
+		const int NumThreads = btGetTaskScheduler()->getNumThreads();
+
+		// Each solver in the pool handles a batch of small islands while the Mt solver handles large islands on its own
+		std::vector<btConstraintSolver*> PoolSolvers(NumThreads);
+		for (int i = 0; i < NumThreads; i++)
+		{
+			PoolSolvers[i] = new btSequentialImpulseConstraintSolver();
+		}
+
+		Dispatcher = std::make_unique<btCollisionDispatcherMt>(CollisionConfiguration.get());
+		SolverPool = std::make_unique<btConstraintSolverPoolMt>(PoolSolvers.data(), NumThreads);
+		Solver = std::make_unique<btSequentialImpulseConstraintSolverMt>();
+		DynamicWorld = std::make_unique<btDiscreteDynamicsWorldMt>(Dispatcher.get(), Broadphase.get(), SolverPool.get(), Solver.get(), CollisionConfiguration.get());
+	}
+	else
+	{
+		Dispatcher = std::make_unique<btCollisionDispatcher>(CollisionConfiguration.get());
+		Solver = std::make_unique<btSequentialImpulseConstraintSolver>();
+		DynamicWorld = std::make_unique<btDiscreteDynamicsWorld>(Dispatcher.get(), Broadphase.get(), Solver.get(), CollisionConfiguration.get());
+	}
+
+	// Set up pair callback for default collision behavior on character controllers
+	GhostPairCallback = std::make_unique<btGhostPairCallback>();
+	Broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(GhostPairCallback.get());
+
+	DynamicWorld->setGravity(btVector3(0, -1000, 0));
+}
+
+void RPhysicsEngineContext::DestroyWorld()
+{
+	if (Broadphase)
+	{
+		Broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(nullptr);
+	}
+
+	DynamicWorld.reset();
+	Solver.reset();
+	SolverPool.reset();
+	GhostPairCallback.reset();
+	Dispatcher.reset();
+	Broadphase.reset();
+	CollisionConfiguration.reset();
+}
+
+void RPhysicsEngineContext::ResizeSnapshots(size_t NumBodies)
+{
+	BackSnapshot.States.resize(NumBodies);
+	PreviousSnapshot.States.resize(NumBodies);
+	CurrentSnapshot.States.resize(NumBodies);
+	InterpolatedStates.resize(NumBodies);
+}
+
+void RPhysicsEngineContext::CaptureBackSnapshot()
+{
+	for (size_t i = 0; i < SnapshotBodies.size(); i++)
+	{
+		if (const btRigidBody* Body = SnapshotBodies[i])
+		{
+			const btTransform& Transform = Body->getWorldTransform();
+			BackSnapshot.States[i].Position = btVec3ToRVec3(Transform.getOrigin());
+			BackSnapshot.States[i].Rotation = btQuatToRQuat(Transform.getRotation());
+		}
+	}
+}
+
+void RPhysicsEngineContext::PublishBackSnapshot()
+{
+	std::swap(PreviousSnapshot, CurrentSnapshot);
+	std::swap(CurrentSnapshot, BackSnapshot);
+}
 
 RPhysicsEngine::RPhysicsEngine()
 	: Context(std::make_unique<RPhysicsEngineContext>())
+	, bMultithreaded(false)
 {
 
 }
 
 RPhysicsEngine::~RPhysicsEngine() = default;
 
-bool RPhysicsEngine::Initialize()
+bool RPhysicsEngine::Initialize(const RPhysicsSettings& InSettings /*= RPhysicsSettings()*/)
 {
-	Context->CollisionConfiguration = std::make_unique<btDefaultCollisionConfiguration>();
-	Context->Dispatcher = std::make_unique<btCollisionDispatcher>(Context->CollisionConfiguration.get());
-	Context->Broadphase = std::make_unique<btDbvtBroadphase>();
-	Context->Solver = std::make_unique<btSequentialImpulseConstraintSolver>();
-	Context->DynamicWorld = std::make_unique<btDiscreteDynamicsWorld>(Context->Dispatcher.get(), Context->Broadphase.get(), Context->Solver.get(), Context->CollisionConfiguration.get());
+	Settings = InSettings;
+	bMultithreaded = Settings.bMultithreaded;
 
-	// Set up pair callback for default collision behavior on character controllers
-	Context->GhostPairCallback = std::make_unique<btGhostPairCallback>();
-	Context->Broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(Context->GhostPairCallback.get());
+	if (bMultithreaded && !RPhysicsTaskScheduler::Install())
+	{
+		RLogWarning("Multithreaded physics requires Bullet to be built with BT_THREADSAFE. Falling back to single-threaded world.\n");
+		bMultithreaded = false;
+	}
+
+	Context->CreateWorld(bMultithreaded);
+
+	// Shapes built from a mesh are rebuilt after the mesh is evicted or reloaded
+	RResourceManager::Instance().OnResourceUnloaded.Bind(&Context->TriangleMeshShapes, &RTriangleMeshShapeCache::OnResourceUnloaded);
+
+	if (bMultithreaded)
+	{
+		RLog("Physics world is running on %d threads\n", btGetTaskScheduler()->getNumThreads());
+	}
 
-	Context->DynamicWorld->setGravity(btVector3(0, -1000, 0));
+	if (Settings.SimulationMode == EPhysicsSimulationMode::Threaded)
+	{
+		// The physics thread counts game time from zero. Count it from zero here too, so snapshot times compare.
+		Context->bStopPhysicsThread = false;
+		Context->PendingThreadTime = 0.0;
+		Context->GameTime = 0.0;
+		Context->PhysicsThread = std::thread(&RPhysicsEngine::PhysicsThreadMain, this);
+
+		RLog("Physics is stepped on its own thread at %.0f Hz of game time\n", GetFixedFrameRate());
+	}
 
 	return true;
 }
 
 void RPhysicsEngine::Shutdown()
 {
+	if (Context->PhysicsThread.joinable())
+	{
+		{
+			std::unique_lock<std::mutex> Lock(Context->PhysicsThreadMutex);
+			Context->bStopPhysicsThread = true;
+		}
+
+		Context->PhysicsThreadCondition.notify_one();
+		Context->PhysicsThread.join();
+	}
+
 	Context->Broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(nullptr);
 }
 
 void RPhysicsEngine::Simulate(float DeltaTime)
 {
-	Context->DynamicWorld->stepSimulation(DeltaTime, 10, GetFixedTimeStep());
+	const double FixedTimeStep = GetFixedTimeStep();
+
+	if (Settings.SimulationMode == EPhysicsSimulationMode::Threaded)
+	{
+		// The physics thread only steps by game time handed to it, so it pauses and scales with the game
+		Context->GameTime += DeltaTime;
+		if (DeltaTime > 0.0f)
+		{
+			{
+				std::unique_lock<std::mutex> ThreadLock(Context->PhysicsThreadMutex);
+				Context->PendingThreadTime += DeltaTime;
+			}
+			Context->PhysicsThreadCondition.notify_one();
+		}
+
+		std::unique_lock<std::mutex> Lock(Context->SnapshotMutex);
+
+		Stats = Context->PendingStats;
+		Context->PendingStats = RPhysicsStats();
+
+		const double TimeSinceLastStep = Context->GameTime - Context->CurrentSnapshot.Time;
+		Stats.LagMs = (float)(TimeSinceLastStep * 1000.0);
+
+		UpdateInterpolatedTransforms((float)(TimeSinceLastStep / FixedTimeStep));
+	}
+	else
+	{
+		Stats = RPhysicsStats();
+
+		Context->AccumulatedTime += DeltaTime;
+		Context->GameTime += DeltaTime;
+		StepFixed(Context->AccumulatedTime, Context->GameTime, Stats);
+
+		std::unique_lock<std::mutex> Lock(Context->SnapshotMutex);
+		UpdateInterpolatedTransforms((float)(Context->AccumulatedTime / FixedTimeStep));
+	}
+}
+
+void RPhysicsEngine::LockWorld()
+{
+	Context->WorldMutex.lock();
+}
+
+void RPhysicsEngine::UnlockWorld()
+{
+	Context->WorldMutex.unlock();
+}
+
+int RPhysicsEngine::RegisterRigidBody(btRigidBody* Body)
+{
+	std::unique_lock<std::recursive_mutex> WorldLock(Context->WorldMutex);
+	std::unique_lock<std::mutex> SnapshotLock(Context->SnapshotMutex);
+
+	int Slot;
+	if (!Context->FreeSnapshotSlots.empty())
+	{
+		Slot = Context->FreeSnapshotSlots.back();
+		Context->FreeSnapshotSlots.pop_back();
+	}
+	else
+	{
+		Slot = (int)Context->SnapshotBodies.size();
+		Context->SnapshotBodies.push_back(nullptr);
+		Context->ResizeSnapshots(Context->SnapshotBodies.size());
+	}
+
+	Context->SnapshotBodies[Slot] = Body;
+
+	// Start from the current transform in every snapshot so there is nothing to interpolate from until the next step
+	const btTransform& Transform = Body->getWorldTransform();
+	RPhysicsBodyState State = { btVec3ToRVec3(Transform.getOrigin()), btQuatToRQuat(Transform.getRotation()) };
+
+	Context->BackSnapshot.States[Slot] = State;
+	Context->PreviousSnapshot.States[Slot] = State;
+	Context->CurrentSnapshot.States[Slot] = State;
+	Context->InterpolatedStates[Slot] = State;
+
+	return Slot;
+}
+
+void RPhysicsEngine::UnregisterRigidBody(int Slot)
+{
+	std::unique_lock<std::recursive_mutex> WorldLock(Context->WorldMutex);
+
+	assert(Context->SnapshotBodies[Slot] != nullptr);
+	Context->SnapshotBodies[Slot] = nullptr;
+	Context->FreeSnapshotSlots.push_back(Slot);
+}
+
+void RPhysicsEngine::GetRigidBodyTransform(int Slot, RVec3& OutPosition, RQuat& OutRotation) const
+{
+	const RPhysicsBodyState& State = Context->InterpolatedStates[Slot];
+	OutPosition = State.Position;
+	OutRotation = State.Rotation;
 }
 
 float RPhysicsEngine::GetFixedFrameRate()
@@ -53,3 +260,110 @@ float RPhysicsEngine::GetFixedTimeStep()
 	const float FixedTimeStep = 1.0f / GetFixedFrameRate();
 	return FixedTimeStep;
 }
+
+void RPhysicsEngine::PhysicsThreadMain()
+{
+	// Time not yet simulated, and game time simulated so far. Only advanced by time the game thread hands over.
+	double AccumulatedTime = 0.0;
+	double ThreadGameTime = 0.0;
+
+	std::unique_lock<std::mutex> Lock(Context->PhysicsThreadMutex);
+	while (true)
+	{
+		// Sleep until the game thread has passed more time, so nothing is stepped while the game is paused
+		Context->PhysicsThreadCondition.wait(Lock, [this] { return Context->bStopPhysicsThread || Context->PendingThreadTime > 0.0; });
+		if (Context->bStopPhysicsThread)
+		{
+			break;
+		}
+
+		AccumulatedTime += Context->PendingThreadTime;
+		ThreadGameTime += Context->PendingThreadTime;
+		Context->PendingThreadTime = 0.0;
+
+		Lock.unlock();
+
+		RPhysicsStats StepStats;
+		StepFixed(AccumulatedTime, ThreadGameTime, StepStats);
+
+		{
+			std::unique_lock<std::mutex> SnapshotLock(Context->SnapshotMutex);
+
+			RPhysicsStats& PendingStats = Context->PendingStats;
+			PendingStats.NumSteps += StepStats.NumSteps;
+			PendingStats.TotalStepTimeMs += StepStats.TotalStepTimeMs;
+			PendingStats.MaxStepTimeMs = RMath::Max(PendingStats.MaxStepTimeMs, StepStats.MaxStepTimeMs);
+			PendingStats.DroppedTimeMs += StepStats.DroppedTimeMs;
+		}
+
+		Lock.lock();
+	}
+}
+
+void RPhysicsEngine::StepFixed(double& AccumulatedTime, double CurrentTime, RPhysicsStats& OutStats)
+{
+	using Clock = std::chrono::high_resolution_clock;
+
+	const double FixedTimeStep = GetFixedTimeStep();
+	const int MaxSubSteps = RMath::Max(Settings.MaxSubSteps, 1);
+
+	int NumSteps = (int)(AccumulatedTime / FixedTimeStep);
+	if (NumSteps > MaxSubSteps)
+	{
+		NumSteps = MaxSubSteps;
+
+		// Decide how much of the time beyond MaxSubSteps we keep. The fraction of a step is always kept
+		// so interpolation stays continuous.
+		const double RemainingTime = AccumulatedTime - NumSteps * FixedTimeStep;
+		const double KeptTime = (Settings.CatchUpPolicy == EPhysicsCatchUpPolicy::CarryOver) ?
+			RMath::Min(RemainingTime, MaxSubSteps * FixedTimeStep) :
+			fmod(RemainingTime, FixedTimeStep);
+
+		AccumulatedTime -= RemainingTime - KeptTime;
+		OutStats.DroppedTimeMs += (float)((RemainingTime - KeptTime) * 1000.0);
+	}
+
+	for (int i = 0; i < NumSteps; i++)
+	{
+		std::unique_lock<std::recursive_mutex> WorldLock(Context->WorldMutex);
+
+		auto StartTime = Clock::now();
+		Context->DynamicWorld->stepSimulation((btScalar)FixedTimeStep, 0, (btScalar)FixedTimeStep);
+		auto EndTime = Clock::now();
+
+		const float StepMs = std::chrono::duration<float, std::milli>(EndTime - StartTime).count();
+		OutStats.NumSteps++;
+		OutStats.TotalStepTimeMs += StepMs;
+		OutStats.MaxStepTimeMs = RMath::Max(OutStats.MaxStepTimeMs, StepMs);
+
+		AccumulatedTime -= FixedTimeStep;
+
+		Context->CaptureBackSnapshot();
+		Context->BackSnapshot.Time = CurrentTime - AccumulatedTime;
+
+		std::unique_lock<std::mutex> SnapshotLock(Context->SnapshotMutex);
+		Context->PublishBackSnapshot();
+	}
+
+	OutStats.LagMs = (float)(AccumulatedTime * 1000.0);
+}
+
+void RPhysicsEngine::UpdateInterpolatedTransforms(float Alpha)
+{
+	const std::vector<RPhysicsBodyState>& PreviousStates = Context->PreviousSnapshot.States;
+	const std::vector<RPhysicsBodyState>& CurrentStates = Context->CurrentSnapshot.States;
+	std::vector<RPhysicsBodyState>& InterpolatedStates = Context->InterpolatedStates;
+
+	Alpha = RMath::Clamp(Alpha, 0.0f, 1.0f);
+	if (!Settings.bInterpolateTransforms || Alpha == 1.0f)
+	{
+		InterpolatedStates = CurrentStates;
+		return;
+	}
+
+	for (size_t i = 0; i < InterpolatedStates.size(); i++)
+	{
+		InterpolatedStates[i].Position = RVec3::Lerp(PreviousStates[i].Position, CurrentStates[i].Position, Alpha);
+		InterpolatedStates[i].Rotation = RQuat::Slerp(PreviousStates[i].Rotation, CurrentStates[i].Rotation, Alpha);
+	}
+}
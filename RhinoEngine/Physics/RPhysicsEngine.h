@@ -10,6 +10,56 @@
 #include "Core/CoreTypes.h"
 
 struct RPhysicsEngineContext;
+class btRigidBody;
+
+/// Where the physics world is stepped
+enum class EPhysicsSimulationMode : UINT8
+{
+	Inline,			// Stepped on the game thread from Simulate()
+	Threaded,		// Stepped on a dedicated physics thread by the game time passed to Simulate()
+};
+
+/// What to do with the remaining time when more than MaxSubSteps fixed steps are due at once
+enum class EPhysicsCatchUpPolicy : UINT8
+{
+	DropExcessTime,	// Discard the remaining time. Simulation falls behind real time but never spirals.
+	CarryOver,		// Keep up to MaxSubSteps steps of remaining time and catch up in the following updates
+};
+
+struct RPhysicsSettings
+{
+	// If true, the world is stepped in parallel on engine worker threads. Requires Bullet built with BT_THREADSAFE.
+	bool bMultithreaded = false;
+
+	EPhysicsSimulationMode SimulationMode = EPhysicsSimulationMode::Inline;
+	EPhysicsCatchUpPolicy CatchUpPolicy = EPhysicsCatchUpPolicy::DropExcessTime;
+
+	// Max number of fixed steps taken in one update
+	int MaxSubSteps = 10;
+
+	// If true, rigid body transforms are interpolated between the last two fixed steps.
+	// Otherwise the result of the last step is used as is.
+	bool bInterpolateTransforms = true;
+};
+
+/// Physics statistics of the last frame
+struct RPhysicsStats
+{
+	// Number of fixed steps taken
+	int NumSteps = 0;
+
+	// Total and longest time spent on fixed steps
+	float TotalStepTimeMs = 0.0f;
+	float MaxStepTimeMs = 0.0f;
+
+	// Time the simulation is behind, not yet covered by a fixed step
+	float LagMs = 0.0f;
+
+	// Time discarded by the catch-up policy
+	float DroppedTimeMs = 0.0f;
+
+	float GetAverageStepTimeMs() const { return NumSteps > 0 ? TotalStepTimeMs / NumSteps : 0.0f; }
+};
 
 class RPhysicsEngine : public RSingleton<RPhysicsEngine>
 {
@@ -18,12 +68,35 @@ public:
 	RPhysicsEngine();
 	~RPhysicsEngine();
 
-	bool Initialize();
+	/// Initialize the physics world and start the physics thread if SimulationMode is Threaded
+	bool Initialize(const RPhysicsSettings& InSettings = RPhysicsSettings());
 	void Shutdown();
 
-	/// Simulate the physics world
+	/// Check if physics world is a multithreaded one
+	bool IsMultithreaded() const;
+
+	const RPhysicsSettings& GetSettings() const;
+
+	/// Advance the physics world by DeltaTime in fixed steps, then update interpolated rigid body transforms.
+	/// In threaded mode DeltaTime is handed to the physics thread, which steps the world by it, and only the
+	/// transforms are updated here. Either way physics pauses and scales with game time.
 	void Simulate(float DeltaTime);
 
+	/// Get statistics of the last call to Simulate
+	const RPhysicsStats& GetStats() const;
+
+	/// Lock the dynamics world against the physics thread. Any direct access to the world from other
+	/// threads must hold the lock while physics runs in threaded mode. The lock is recursive.
+	void LockWorld();
+	void UnlockWorld();
+
+	/// Add a rigid body to the transform snapshot and return its slot
+	int RegisterRigidBody(btRigidBody* Body);
+	void UnregisterRigidBody(int Slot);
+
+	/// Get the interpolated transform of a registered rigid body
+	void GetRigidBodyTransform(int Slot, RVec3& OutPosition, RQuat& OutRotation) const;
+
 	/// Get context for physics engine
 	RPhysicsEngineContext* GetContext() const;
 
@@ -31,12 +104,48 @@ public:
 	static float GetFixedTimeStep();
 
 private:
+	/// Entry of the physics thread in threaded mode
+	void PhysicsThreadMain();
+
+	/// Take as many fixed steps as the accumulated time allows within the catch-up policy and publish a snapshot
+	/// after each one. CurrentTime is the time at which AccumulatedTime was measured.
+	void StepFixed(double& AccumulatedTime, double CurrentTime, RPhysicsStats& OutStats);
+
+	/// Blend the published transforms into the ones read by rigid body components
+	void UpdateInterpolatedTransforms(float Alpha);
+
 	std::unique_ptr<RPhysicsEngineContext>	Context;
+	RPhysicsSettings						Settings;
+	RPhysicsStats							Stats;
+	bool									bMultithreaded;
 };
 
+FORCEINLINE bool RPhysicsEngine::IsMultithreaded() const
+{
+	return bMultithreaded;
+}
+
+FORCEINLINE const RPhysicsSettings& RPhysicsEngine::GetSettings() const
+{
+	return Settings;
+}
+
+FORCEINLINE const RPhysicsStats& RPhysicsEngine::GetStats() const
+{
+	return Stats;
+}
+
 FORCEINLINE RPhysicsEngineContext* RPhysicsEngine::GetContext() const
 {
 	return Context.get();
 }
 
 #define GPhysicsEngine RPhysicsEngine::Instance()
+
+/// Holds the physics world lock in a scope
+class RScopedPhysicsWorldLock
+{
+public:
+	RScopedPhysicsWorldLock()		{ GPhysicsEngine.LockWorld(); }
+	~RScopedPhysicsWorldLock()		{ GPhysicsEngine.UnlockWorld(); }
+};
@@ -8,12 +8,50 @@
 
 #include "btBulletDynamicsCommon.h"
 #include "BulletCollision/CollisionDispatch/btGhostObject.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+#include "BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h"
+
+#include "RTriangleMeshShapeCache.h"
+#include "RPhysicsEngine.h"
+
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+struct RPhysicsBodyState
+{
+	RVec3 Position;
+	RQuat Rotation;
+};
+
+/// Transforms of all registered rigid bodies after a fixed step
+struct RPhysicsTransformSnapshot
+{
+	std::vector<RPhysicsBodyState> States;
+
+	// Game time at which the step was due
+	double Time = 0.0;
+};
 
 struct RPhysicsEngineContext
 {
 	RPhysicsEngineContext()
+		: bMultithreaded(false)
+		, AccumulatedTime(0.0)
+		, GameTime(0.0)
+		, bStopPhysicsThread(false)
+		, PendingThreadTime(0.0)
 	{}
 
+	/// Create the dynamics world and everything it depends on.
+	/// A multithreaded world requires RPhysicsTaskScheduler to be installed.
+	void CreateWorld(bool bInMultithreaded);
+
+	/// Destroy the dynamics world in reverse order of creation
+	void DestroyWorld();
+
 	std::unique_ptr<btDefaultCollisionConfiguration> CollisionConfiguration;
 
 	// The default collision dispatcher
@@ -25,11 +63,64 @@ struct RPhysicsEngineContext
 	// The default behavior for ghost object collisions
 	std::unique_ptr<btGhostPairCallback> GhostPairCallback;
 
-	// The default constraint solver
-	std::unique_ptr<btSequentialImpulseConstraintSolver> Solver;
+	// The default constraint solver. A btSequentialImpulseConstraintSolverMt for large islands in a multithreaded world.
+	std::unique_ptr<btConstraintSolver> Solver;
+
+	// Solvers for small islands running in parallel. Only used by a multithreaded world.
+	std::unique_ptr<btConstraintSolverPoolMt> SolverPool;
 
 	// The physics world of simulation
 	std::unique_ptr<btDiscreteDynamicsWorld> DynamicWorld;
+
+	// Whether the world is a btDiscreteDynamicsWorldMt
+	bool bMultithreaded;
+
+	// Triangle mesh collision shapes shared by rigid bodies
+	RTriangleMeshShapeCache TriangleMeshShapes;
+
+	/// Resize all snapshots to hold the given number of rigid bodies
+	void ResizeSnapshots(size_t NumBodies);
+
+	/// Copy transforms of registered rigid bodies to the back snapshot. World lock must be held.
+	void CaptureBackSnapshot();
+
+	/// Make the back snapshot current and the current one previous. World lock and snapshot lock must be held.
+	void PublishBackSnapshot();
+
+	// Guards the dynamics world against the physics thread. Always taken before SnapshotMutex.
+	std::recursive_mutex WorldMutex;
+
+	// Rigid bodies whose transforms are captured after each step. Free slots are null. Guarded by WorldMutex.
+	std::vector<btRigidBody*> SnapshotBodies;
+	std::vector<int> FreeSnapshotSlots;
+
+	// Written by the stepping thread after each step, then published. Guarded by WorldMutex.
+	RPhysicsTransformSnapshot BackSnapshot;
+
+	// The last two published steps. Guarded by SnapshotMutex.
+	RPhysicsTransformSnapshot PreviousSnapshot;
+	RPhysicsTransformSnapshot CurrentSnapshot;
+
+	// Stats of the physics thread not yet picked up by the game thread. Guarded by SnapshotMutex.
+	RPhysicsStats PendingStats;
+
+	std::mutex SnapshotMutex;
+
+	// Transforms blended from the published steps. Only accessed by the game thread.
+	std::vector<RPhysicsBodyState> InterpolatedStates;
+
+	// Time not yet simulated in inline mode, and total game time passed to Simulate
+	double AccumulatedTime;
+	double GameTime;
+
+	// Physics thread in threaded mode. Guarded by PhysicsThreadMutex.
+	std::thread PhysicsThread;
+	std::mutex PhysicsThreadMutex;
+	std::condition_variable PhysicsThreadCondition;
+	bool bStopPhysicsThread;
+
+	// Game time passed to Simulate and not yet taken by the physics thread. Guarded by PhysicsThreadMutex.
+	double PendingThreadTime;
 };
 
 struct RPhysicsObjectContext
@@ -37,14 +128,16 @@ struct RPhysicsObjectContext
 	RPhysicsObjectContext()
 		: BoxHalfSize(-0.5f, -0.5f, -0.5f)
 		, BoxOffset(0.0f, 0.0f, 0.0f)
+		, Shape(nullptr)
 		, Mass(-1)
+		, SnapshotSlot(-1)
 	{}
 
-	// Triangle mesh data for collision. Used when object has a triangle mesh shape of collision
-	std::unique_ptr<btTriangleMesh> TriangleMesh;
-	
-	// The collision shape
-	std::unique_ptr<btCollisionShape> Shape;
+	// The collision shape. Either points to OwnedShape, or a shape from the triangle mesh shape cache.
+	btCollisionShape* Shape;
+
+	// The collision shape created for this object only
+	std::unique_ptr<btCollisionShape> OwnedShape;
 
 	// The state of motion
 	std::unique_ptr<btMotionState> MotionState;
@@ -55,6 +148,9 @@ struct RPhysicsObjectContext
 	RVec3 BoxHalfSize;
 	RVec3 BoxOffset;
 	float Mass;
+
+	// Slot of the rigid body in physics transform snapshots
+	int SnapshotSlot;
 };
 
 FORCEINLINE RVec3 btVec3ToRVec3(const btVector3& InVec)
@@ -0,0 +1,113 @@
+//=============================================================================
+// RPhysicsTaskScheduler.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RPhysicsTaskScheduler.h"
+
+#include "Core/RThreadPool.h"
+
+#include <mutex>
+
+#if BT_THREADSAFE
+// Defined in btThreads.cpp. Used by Bullet to validate thread indices while parallel loops are running.
+void btPushThreadsAreRunning();
+void btPopThreadsAreRunning();
+#endif	// BT_THREADSAFE
+
+RPhysicsTaskScheduler::RPhysicsTaskScheduler()
+	: btITaskScheduler("RThreadPool")
+	, NumThreads(1)
+{
+}
+
+int RPhysicsTaskScheduler::getMaxNumThreads() const
+{
+	// Bullet hands out thread indices on first use and sizes per-thread data by thread count.
+	// Reserve one for each worker, the game thread and the physics thread.
+	return RMath::Min(GThreadPool.GetNumWorkerThreads() + 2, (int)BT_MAX_THREAD_COUNT);
+}
+
+int RPhysicsTaskScheduler::getNumThreads() const
+{
+	return NumThreads;
+}
+
+void RPhysicsTaskScheduler::setNumThreads(int numThreads)
+{
+	// Thread count is owned by the engine thread pool, we only keep it in range
+	NumThreads = RMath::Max(1, RMath::Min(numThreads, getMaxNumThreads()));
+}
+
+void RPhysicsTaskScheduler::parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	btPushThreadsAreRunning();
+#endif	// BT_THREADSAFE
+
+	GThreadPool.ParallelFor(iBegin, iEnd, grainSize,
+		[&body](int ChunkBegin, int ChunkEnd)
+		{
+			body.forLoop(ChunkBegin, ChunkEnd);
+		});
+
+#if BT_THREADSAFE
+	btPopThreadsAreRunning();
+#endif	// BT_THREADSAFE
+}
+
+btScalar RPhysicsTaskScheduler::parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body)
+{
+	std::mutex SumMutex;
+	btScalar Sum(0);
+
+#if BT_THREADSAFE
+	btPushThreadsAreRunning();
+#endif	// BT_THREADSAFE
+
+	GThreadPool.ParallelFor(iBegin, iEnd, grainSize,
+		[&body, &SumMutex, &Sum](int ChunkBegin, int ChunkEnd)
+		{
+			btScalar ChunkSum = body.sumLoop(ChunkBegin, ChunkEnd);
+
+			std::unique_lock<std::mutex> UniqueLock(SumMutex);
+			Sum += ChunkSum;
+		});
+
+#if BT_THREADSAFE
+	btPopThreadsAreRunning();
+#endif	// BT_THREADSAFE
+
+	return Sum;
+}
+
+bool RPhysicsTaskScheduler::Install()
+{
+	if (!IsMultithreadingSupported())
+	{
+		return false;
+	}
+
+	static RPhysicsTaskScheduler TaskScheduler;
+
+	if (btGetTaskScheduler() != &TaskScheduler)
+	{
+		// Bullet treats the first thread asking for an index as its main thread
+		btGetCurrentThreadIndex();
+
+		TaskScheduler.setNumThreads(TaskScheduler.getMaxNumThreads());
+		btSetTaskScheduler(&TaskScheduler);
+	}
+
+	return true;
+}
+
+bool RPhysicsTaskScheduler::IsMultithreadingSupported()
+{
+#if BT_THREADSAFE
+	return true;
+#else
+	return false;
+#endif	// BT_THREADSAFE
+}
@@ -0,0 +1,32 @@
+//=============================================================================
+// RPhysicsTaskScheduler.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Bullet task scheduler running on the engine worker thread pool
+//=============================================================================
+
+#pragma once
+
+#include "LinearMath/btThreads.h"
+
+/// Bullet task scheduler which dispatches parallel loops of the multithreaded dynamics world to RThreadPool
+class RPhysicsTaskScheduler : public btITaskScheduler
+{
+public:
+	RPhysicsTaskScheduler();
+
+	virtual int getMaxNumThreads() const override;
+	virtual int getNumThreads() const override;
+	virtual void setNumThreads(int numThreads) override;
+	virtual void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) override;
+	virtual btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) override;
+
+	/// Make the scheduler current for Bullet. Must be called from the game thread before any multithreaded
+	/// world is created. The world may be stepped by either the game thread or the physics thread.
+	static bool Install();
+
+	/// Check if Bullet has been built with thread safety (BT_THREADSAFE)
+	static bool IsMultithreadingSupported();
+
+private:
+	int NumThreads;
+};
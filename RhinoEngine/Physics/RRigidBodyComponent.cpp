@@ -27,7 +27,17 @@ RRigidBodyComponent::~RRigidBodyComponent()
 
 	if (Context->Body)
 	{
+		RScopedPhysicsWorldLock WorldLock;
+
+		GPhysicsEngine.UnregisterRigidBody(Context->SnapshotSlot);
 		PhysicsEngineContext->DynamicWorld->removeCollisionObject(Context->Body.get());
+		Context->Body.reset();
+	}
+
+	// Give back the shared shape
+	if (Context->Shape && !Context->OwnedShape)
+	{
+		PhysicsEngineContext->TriangleMeshShapes.ReleaseShape(Context->Shape);
 	}
 }
 
@@ -38,18 +48,16 @@ void RRigidBodyComponent::Update(float DeltaTime)
 	{
 		RScopeInternalTransformUpdate InternalTransformUpdate(Owner);
 
-		btTransform PhysicsTransform;
-		if (Context->Body && Context->MotionState)
-		{
-			Context->MotionState->getWorldTransform(PhysicsTransform);
-		}
-		else
+		// Physics may be stepped on another thread. Read the transform interpolated by the physics engine instead of the motion state.
+		RVec3 Position = RVec3::Zero();
+		RQuat Rotation = RQuat::IDENTITY;
+		if (Context->Body)
 		{
-			PhysicsTransform.setIdentity();
+			GPhysicsEngine.GetRigidBodyTransform(Context->SnapshotSlot, Position, Rotation);
 		}
 
 		// Half box size already contains scale transform so the transform has scales of 1 for debug rendering
-		RTransform Transform(btVec3ToRVec3(PhysicsTransform.getOrigin()), btQuatToRQuat(PhysicsTransform.getRotation()));
+		RTransform Transform(Position, Rotation);
 		//GDebugRenderer.DrawBox(Context->BoxHalfSize * 2.0f, Transform.GetMatrix());
 
 		// Now we apply the scale to the object and translate it back by its offset to the box center
@@ -103,7 +111,8 @@ void RRigidBodyComponent::OnComponentAdded()
 				Context->BoxOffset = Mesh->GetLocalSpaceAabb().GetCenter();
 		
 				btVector3 BoxHalfSize(RVec3TobtVec3(Context->BoxHalfSize));
-				Context->Shape = std::make_unique<btBoxShape>(BoxHalfSize);
+				Context->OwnedShape = std::make_unique<btBoxShape>(BoxHalfSize);
+				Context->Shape = Context->OwnedShape.get();
 
 				Context->Mass = 1.0f;
 			}
@@ -114,7 +123,8 @@ void RRigidBodyComponent::OnComponentAdded()
 			Context->BoxOffset = Owner->GetAabb().GetCenter() - Owner->GetWorldPosition();
 
 			btVector3 BoxHalfSize(RVec3TobtVec3(Context->BoxHalfSize));
-			Context->Shape = std::make_unique<btBoxShape>(BoxHalfSize);
+			Context->OwnedShape = std::make_unique<btBoxShape>(BoxHalfSize);
+			Context->Shape = Context->OwnedShape.get();
 
 			Context->Mass = 1.0f;
 		}
@@ -130,10 +140,12 @@ void RRigidBodyComponent::OnComponentAdded()
 		}
 
 		Context->MotionState = std::make_unique<btDefaultMotionState>(InitTransform);
-		btRigidBody::btRigidBodyConstructionInfo BodyInfo(Context->Mass, Context->MotionState.get(), Context->Shape.get(), LocalInertia);
+		btRigidBody::btRigidBodyConstructionInfo BodyInfo(Context->Mass, Context->MotionState.get(), Context->Shape, LocalInertia);
 		Context->Body = std::make_unique<btRigidBody>(BodyInfo);
 
+		RScopedPhysicsWorldLock WorldLock;
 		PhysicsEngineContext->DynamicWorld->addRigidBody(Context->Body.get());
+		Context->SnapshotSlot = GPhysicsEngine.RegisterRigidBody(Context->Body.get());
 	}
 }
 
@@ -147,32 +159,13 @@ void RRigidBodyComponent::SetPhysicsBodyMass(float InMass)
 		Context->Shape->calculateLocalInertia(Mass, LocalInertia);
 	}
 
+	RScopedPhysicsWorldLock WorldLock;
 	Context->Body->setMassProps(Mass, LocalInertia);
 }
 
 void RRigidBodyComponent::BuildTriangleMeshCollision(RMesh* Mesh)
 {
-	// Physics bodies CAN'T be scaled so we must create triangle meshes for objects with each scale
-	// TODO: Reuse triangle meshes for multiple rigid bodies with the same scale
-	Context->TriangleMesh = std::make_unique<btTriangleMesh>();
-	RVec3 Scale = GetOwner()->GetScale();
-
-	for (int ElemIdx = 0; ElemIdx < Mesh->GetMeshElementCount(); ElemIdx++)
-	{
-		const RMeshElement& MeshElement = Mesh->GetMeshElement(ElemIdx);
-		for (int i = 0; i < MeshElement.TriangleIndices.size(); i += 3)
-		{
-			int idx0 = MeshElement.TriangleIndices[i];
-			int idx1 = MeshElement.TriangleIndices[i + 1];
-			int idx2 = MeshElement.TriangleIndices[i + 2];
-
-			Context->TriangleMesh->addTriangle(
-				RVec3TobtVec3(RVec3(&MeshElement.PositionArray[idx0].x) * Scale),
-				RVec3TobtVec3(RVec3(&MeshElement.PositionArray[idx1].x) * Scale),
-				RVec3TobtVec3(RVec3(&MeshElement.PositionArray[idx2].x) * Scale)
-			);
-		}
-	}
-
-	Context->Shape = std::make_unique<btBvhTriangleMeshShape>(Context->TriangleMesh.get(), true, true);
+	// Physics bodies CAN'T be scaled. Objects with the same mesh share a BVH, and objects with the same scale share a scaled shape on top of it.
+	RPhysicsEngineContext* PhysicsEngineContext = GPhysicsEngine.GetContext();
+	Context->Shape = PhysicsEngineContext->TriangleMeshShapes.AcquireShape(Mesh, GetOwner()->GetScale());
 }
@@ -0,0 +1,306 @@
+//=============================================================================
+// RTriangleMeshShapeCache.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RTriangleMeshShapeCache.h"
+
+#include "RPhysicsPrivate.h"
+
+#include "RenderSystem/RMesh.h"
+#include "Core/RSerializer.h"
+#include "Core/RFileUtil.h"
+#include "Core/RLog.h"
+#include "Resource/RResourceManager.h"
+
+// Whether to save built BVH of triangle meshes to file and load it next time instead of rebuilding
+#define SERIALIZE_TRIANGLE_MESH_BVH 1
+
+// Increase this when layout of the BVH file changes
+static const UINT32 BvhFileVersion = 1;
+
+RTriangleMeshShapeCache::MeshCollisionData::MeshCollisionData()
+	: SerializedBvhBuffer(nullptr)
+	, RefCount(0)
+{
+}
+
+RTriangleMeshShapeCache::MeshCollisionData::~MeshCollisionData()
+{
+	// The shape must go before the buffer holding its BVH
+	BvhShape.reset();
+
+	if (SerializedBvhBuffer)
+	{
+		btAlignedFree(SerializedBvhBuffer);
+	}
+}
+
+bool RTriangleMeshShapeCache::ScaledShapeKey::operator<(const ScaledShapeKey& Other) const
+{
+	if (MeshPath != Other.MeshPath)
+		return MeshPath < Other.MeshPath;
+
+	return std::lexicographical_compare(Scale, Scale + 3, Other.Scale, Other.Scale + 3);
+}
+
+RTriangleMeshShapeCache::RTriangleMeshShapeCache()
+{
+}
+
+RTriangleMeshShapeCache::~RTriangleMeshShapeCache()
+{
+	Clear();
+}
+
+btCollisionShape* RTriangleMeshShapeCache::AcquireShape(RMesh* Mesh, const RVec3& Scale)
+{
+	ScaledShapeKey Key = { Mesh->GetAssetPath(), { Scale.X(), Scale.Y(), Scale.Z() } };
+
+	auto CachedIter = CachedScaledShapes.find(Key);
+	if (CachedIter != CachedScaledShapes.end())
+	{
+		CachedIter->second->RefCount++;
+		return CachedIter->second->Shape.get();
+	}
+
+	std::shared_ptr<MeshCollisionData>& MeshData = MeshShapes[Key.MeshPath];
+	if (!MeshData)
+	{
+		MeshData = CreateMeshCollisionData(Mesh);
+	}
+	MeshData->RefCount++;
+
+	std::unique_ptr<ScaledShapeData> ScaledData = std::make_unique<ScaledShapeData>();
+	ScaledData->Key = Key;
+	ScaledData->Shape = std::make_unique<btScaledBvhTriangleMeshShape>(MeshData->BvhShape.get(), RVec3TobtVec3(Scale));
+	ScaledData->RefCount = 1;
+	ScaledData->MeshData = MeshData;
+	ScaledData->bInCache = true;
+
+	btCollisionShape* Shape = ScaledData->Shape.get();
+	CachedScaledShapes[Key] = ScaledData.get();
+	ScaledShapes[Shape] = std::move(ScaledData);
+
+	return Shape;
+}
+
+void RTriangleMeshShapeCache::ReleaseShape(btCollisionShape* Shape)
+{
+	auto Iter = ScaledShapes.find(Shape);
+	if (Iter == ScaledShapes.end())
+	{
+		assert(!"Releasing a shape which is not in the cache");
+		return;
+	}
+
+	ScaledShapeData& ScaledData = *Iter->second;
+	if (--ScaledData.RefCount > 0)
+	{
+		return;
+	}
+
+	if (ScaledData.bInCache)
+	{
+		CachedScaledShapes.erase(ScaledData.Key);
+	}
+
+	// Release the mesh BVH once no scaled shape is using it
+	ReleaseMeshData(ScaledData);
+	ScaledShapes.erase(Iter);
+}
+
+void RTriangleMeshShapeCache::Clear()
+{
+	CachedScaledShapes.clear();
+	ScaledShapes.clear();
+	MeshShapes.clear();
+}
+
+void RTriangleMeshShapeCache::OnResourceUnloaded(RResourceBase* Resource)
+{
+	auto MeshIter = MeshShapes.find(Resource->GetAssetPath());
+	if (MeshIter == MeshShapes.end())
+	{
+		return;
+	}
+
+	// Scaled shapes in use keep the old BVH alive through their mesh data until they are released
+	MeshShapes.erase(MeshIter);
+
+	for (auto Iter = CachedScaledShapes.begin(); Iter != CachedScaledShapes.end();)
+	{
+		if (Iter->first.MeshPath == Resource->GetAssetPath())
+		{
+			Iter->second->bInCache = false;
+			Iter = CachedScaledShapes.erase(Iter);
+		}
+		else
+		{
+			++Iter;
+		}
+	}
+}
+
+void RTriangleMeshShapeCache::ReleaseMeshData(const ScaledShapeData& ScaledData)
+{
+	if (--ScaledData.MeshData->RefCount > 0)
+	{
+		return;
+	}
+
+	// The mesh may have been unloaded and built again since, in which case the cached data is not this one
+	auto MeshIter = MeshShapes.find(ScaledData.Key.MeshPath);
+	if (MeshIter != MeshShapes.end() && MeshIter->second == ScaledData.MeshData)
+	{
+		MeshShapes.erase(MeshIter);
+	}
+}
+
+std::unique_ptr<RTriangleMeshShapeCache::MeshCollisionData> RTriangleMeshShapeCache::CreateMeshCollisionData(RMesh* Mesh) const
+{
+	std::unique_ptr<MeshCollisionData> Data = std::make_unique<MeshCollisionData>();
+	Data->TriangleMesh = std::make_unique<btTriangleMesh>();
+
+	// Triangles are added in unscaled mesh space. Scaling is applied by btScaledBvhTriangleMeshShape.
+	for (int ElemIdx = 0; ElemIdx < Mesh->GetMeshElementCount(); ElemIdx++)
+	{
+		const RMeshElement& MeshElement = Mesh->GetMeshElement(ElemIdx);
+		for (int i = 0; i < (int)MeshElement.TriangleIndices.size(); i += 3)
+		{
+			int idx0 = MeshElement.TriangleIndices[i];
+			int idx1 = MeshElement.TriangleIndices[i + 1];
+			int idx2 = MeshElement.TriangleIndices[i + 2];
+
+			Data->TriangleMesh->addTriangle(
+				RVec3TobtVec3(RVec3(&MeshElement.PositionArray[idx0].x)),
+				RVec3TobtVec3(RVec3(&MeshElement.PositionArray[idx1].x)),
+				RVec3TobtVec3(RVec3(&MeshElement.PositionArray[idx2].x))
+			);
+		}
+	}
+
+#if SERIALIZE_TRIANGLE_MESH_BVH == 1
+	if (LoadBvhFromFile(Mesh, *Data))
+	{
+		return Data;
+	}
+#endif
+
+	Data->BvhShape = std::make_unique<btBvhTriangleMeshShape>(Data->TriangleMesh.get(), true, true);
+
+#if SERIALIZE_TRIANGLE_MESH_BVH == 1
+	SaveBvhToFile(Mesh, *Data);
+#endif
+
+	return Data;
+}
+
+std::string RTriangleMeshShapeCache::GetBvhFilePath(const RMesh* Mesh)
+{
+	// Asset paths are unique, so a flattened asset path names the file
+	std::string FileName = RFileUtil::ReplaceExtension(Mesh->GetAssetPath(), "rbvh");
+	std::replace_if(FileName.begin(), FileName.end(), [](char c) { return c == '/' || c == '\\' || c == ':'; }, '_');
+
+	return RResourceManager::GetCacheBasePath() + "Collision/" + FileName;
+}
+
+bool RTriangleMeshShapeCache::LoadBvhFromFile(RMesh* Mesh, MeshCollisionData& Data) const
+{
+	const std::string BvhPath = GetBvhFilePath(Mesh);
+	if (!RFileUtil::CheckPathExists(BvhPath))
+	{
+		return false;
+	}
+
+	// Mesh source is newer than the BVH. It must be rebuilt.
+	ETimestampComparison Result = RFileUtil::CompareFileTimestamp(Mesh->GetFileSystemPath(), BvhPath);
+	if (Result == ETimestampComparison::EarlierSecond || Result == ETimestampComparison::InvalidFile)
+	{
+		return false;
+	}
+
+	RSerializer Serializer;
+	Serializer.Open(BvhPath, ESerializeMode::Read);
+	if (!Serializer.IsOpen() || !Serializer.EnsureHeader("RBVH", 4))
+	{
+		return false;
+	}
+
+	UINT32 Version = 0;
+	int NumTriangles = 0;
+	RSerializedView<UINT8> BvhData;
+
+	Serializer.SerializeData(Version);
+	Serializer.SerializeData(NumTriangles);
+	if (Version != BvhFileVersion || NumTriangles != Data.TriangleMesh->getNumTriangles())
+	{
+		return false;
+	}
+
+	// Borrow BVH data from the mapped file. It is copied only once into the aligned buffer below.
+	Serializer.SerializeView(BvhData);
+	if (Serializer.HasError())
+	{
+		return false;
+	}
+
+	// BVH nodes are used in place and require 16-byte alignment
+	void* Buffer = btAlignedAlloc(BvhData.GetSize(), 16);
+	memcpy(Buffer, BvhData.GetData(), BvhData.GetSize());
+	Serializer.Close();
+
+	btOptimizedBvh* Bvh = btOptimizedBvh::deSerializeInPlace(Buffer, (unsigned int)BvhData.GetSize(), false);
+	if (!Bvh)
+	{
+		btAlignedFree(Buffer);
+		RLogWarning("Failed to load collision BVH from \'%s\', rebuilding it.\n", BvhPath.c_str());
+		return false;
+	}
+
+	Data.SerializedBvhBuffer = Buffer;
+	Data.BvhShape = std::make_unique<btBvhTriangleMeshShape>(Data.TriangleMesh.get(), true, false);
+	Data.BvhShape->setOptimizedBvh(Bvh);
+
+	return true;
+}
+
+void RTriangleMeshShapeCache::SaveBvhToFile(RMesh* Mesh, const MeshCollisionData& Data) const
+{
+	const btOptimizedBvh* Bvh = Data.BvhShape->getOptimizedBvh();
+	if (!Bvh)
+	{
+		return;
+	}
+
+	const std::string BvhPath = GetBvhFilePath(Mesh);
+
+	// Cooked data isn't written next to assets, which may be packed or read-only
+	RFileUtil::CreateDirectory(RResourceManager::GetCacheBasePath());
+	RFileUtil::CreateDirectory(RResourceManager::GetCacheBasePath() + "Collision/");
+
+	unsigned int BufferSize = Bvh->calculateSerializeBufferSize();
+	void* Buffer = btAlignedAlloc(BufferSize, 16);
+	bool bSerialized = Bvh->serializeInPlace(Buffer, BufferSize, false);
+
+	if (bSerialized)
+	{
+		RSerializer Serializer;
+		Serializer.Open(BvhPath, ESerializeMode::Write);
+		if (Serializer.IsOpen())
+		{
+			UINT32 Version = BvhFileVersion;
+			int NumTriangles = Data.TriangleMesh->getNumTriangles();
+			std::vector<UINT8> BvhData((UINT8*)Buffer, (UINT8*)Buffer + BufferSize);
+
+			Serializer.EnsureHeader("RBVH", 4);
+			Serializer.SerializeData(Version);
+			Serializer.SerializeData(NumTriangles);
+			Serializer.SerializeVector(BvhData);
+			Serializer.Close();
+		}
+	}
+
+	btAlignedFree(Buffer);
+}
@@ -0,0 +1,102 @@
+//=============================================================================
+// RTriangleMeshShapeCache.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Shared triangle mesh collision shapes
+//=============================================================================
+
+#pragma once
+
+#include "btBulletDynamicsCommon.h"
+
+#include "Core/CoreTypes.h"
+
+class RMesh;
+class RResourceBase;
+
+/// Cache of triangle mesh collision shapes, keyed by asset paths of meshes.
+/// Each mesh builds its BVH only once. Objects using the same mesh at the same scale share one
+/// btScaledBvhTriangleMeshShape on top of it. Shapes are reference counted and released when
+/// the last user is gone.
+/// When a mesh is evicted or reloaded its shapes are taken out of the cache, so the next user builds
+/// them again from the new content. Shapes already handed out stay valid until they are released.
+/// Note: The cache is not thread-safe and should be accessed from the game thread only.
+class RTriangleMeshShapeCache
+{
+public:
+	RTriangleMeshShapeCache();
+	~RTriangleMeshShapeCache();
+
+	/// Get a shape for a mesh at given scale, building the mesh BVH if it doesn't exist yet.
+	/// Each call must be paired with a call to ReleaseShape.
+	btCollisionShape* AcquireShape(RMesh* Mesh, const RVec3& Scale);
+
+	/// Release a shape returned by AcquireShape
+	void ReleaseShape(btCollisionShape* Shape);
+
+	/// Destroy all cached shapes. Shapes still in use become invalid.
+	void Clear();
+
+	/// Take shapes of an unloaded mesh out of the cache. Bound to RResourceManager::OnResourceUnloaded.
+	void OnResourceUnloaded(RResourceBase* Resource);
+
+private:
+	/// Collision data shared by all instances of a mesh
+	struct MeshCollisionData
+	{
+		MeshCollisionData();
+		~MeshCollisionData();
+
+		std::unique_ptr<btTriangleMesh>				TriangleMesh;
+		std::unique_ptr<btBvhTriangleMeshShape>		BvhShape;
+
+		// Aligned memory of a BVH loaded from file. The BVH lives in this buffer and is not owned by the shape.
+		void*										SerializedBvhBuffer;
+
+		// Number of scaled shapes using the data
+		int											RefCount;
+	};
+
+	/// Key of a scaled shape. Scales are compared exactly.
+	struct ScaledShapeKey
+	{
+		std::string		MeshPath;
+		float			Scale[3];
+
+		bool operator<(const ScaledShapeKey& Other) const;
+	};
+
+	struct ScaledShapeData
+	{
+		ScaledShapeKey									Key;
+		std::unique_ptr<btScaledBvhTriangleMeshShape>	Shape;
+		int												RefCount;
+
+		// Keeps the mesh BVH alive while the shape is in use, even after the mesh has left the cache
+		std::shared_ptr<MeshCollisionData>				MeshData;
+
+		// False once the mesh has been unloaded. The shape is destroyed when its last user releases it.
+		bool											bInCache;
+	};
+
+	/// Build collision data from mesh triangles, loading the BVH from file if possible
+	std::unique_ptr<MeshCollisionData> CreateMeshCollisionData(RMesh* Mesh) const;
+
+	/// Load a BVH from the cache directory. Returns false if the file is missing or outdated.
+	bool LoadBvhFromFile(RMesh* Mesh, MeshCollisionData& Data) const;
+
+	/// Save BVH of the mesh to the cache directory
+	void SaveBvhToFile(RMesh* Mesh, const MeshCollisionData& Data) const;
+
+	/// Path of the BVH file of a mesh in the cache directory
+	static std::string GetBvhFilePath(const RMesh* Mesh);
+
+	/// Drop a reference of a scaled shape to its mesh data, and take the data out of the cache if it was the last one
+	void ReleaseMeshData(const ScaledShapeData& ScaledData);
+
+	// Collision data of meshes in the cache, by asset path
+	std::unordered_map<std::string, std::shared_ptr<MeshCollisionData>>		MeshShapes;
+
+	// Scaled shapes in the cache, and all scaled shapes in use by the shapes handed out
+	std::map<ScaledShapeKey, ScaledShapeData*>										CachedScaledShapes;
+	std::unordered_map<const btCollisionShape*, std::unique_ptr<ScaledShapeData>>	ScaledShapes;
+};
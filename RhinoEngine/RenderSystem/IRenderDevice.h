@@ -0,0 +1,97 @@
+//=============================================================================
+// IRenderDevice.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Interface of the device all render system resources and commands go through
+//=============================================================================
+
+#pragma once
+
+#include <d3d11.h>
+#include <tchar.h>
+
+class RRenderCommandLog;
+
+/// Device creating GPU resources and submitting commands for the render system.
+/// Methods mirror ID3D11Device and ID3D11DeviceContext, so the render system can run on
+/// a hardware D3D11 device or on a null device that only records what is submitted.
+class IRenderDevice
+{
+public:
+	virtual ~IRenderDevice() {}
+
+	// Resource creation
+	virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Buffer** ppBuffer) = 0;
+	virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture2D** ppTexture2D) = 0;
+	virtual HRESULT CreateShaderResourceView(ID3D11Resource* pResource, const D3D11_SHADER_RESOURCE_VIEW_DESC* pDesc, ID3D11ShaderResourceView** ppSRView) = 0;
+	virtual HRESULT CreateRenderTargetView(ID3D11Resource* pResource, const D3D11_RENDER_TARGET_VIEW_DESC* pDesc, ID3D11RenderTargetView** ppRTView) = 0;
+	virtual HRESULT CreateDepthStencilView(ID3D11Resource* pResource, const D3D11_DEPTH_STENCIL_VIEW_DESC* pDesc, ID3D11DepthStencilView** ppDepthStencilView) = 0;
+	virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pInputElementDescs, UINT NumElements, const void* pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, ID3D11InputLayout** ppInputLayout) = 0;
+	virtual HRESULT CreateVertexShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11VertexShader** ppVertexShader) = 0;
+	virtual HRESULT CreatePixelShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11PixelShader** ppPixelShader) = 0;
+	virtual HRESULT CreateGeometryShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11GeometryShader** ppGeometryShader) = 0;
+	virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC* pBlendStateDesc, ID3D11BlendState** ppBlendState) = 0;
+	virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* pSamplerDesc, ID3D11SamplerState** ppSamplerState) = 0;
+	virtual HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* pRasterizerDesc, ID3D11RasterizerState** ppRasterizerState) = 0;
+
+	virtual HRESULT CheckFormatSupport(DXGI_FORMAT Format, UINT* pFormatSupport) = 0;
+	virtual HRESULT CheckMultisampleQualityLevels(DXGI_FORMAT Format, UINT SampleCount, UINT* pNumQualityLevels) = 0;
+
+	// Resource updates
+	virtual HRESULT Map(ID3D11Resource* pResource, UINT Subresource, D3D11_MAP MapType, UINT MapFlags, D3D11_MAPPED_SUBRESOURCE* pMappedResource) = 0;
+	virtual void Unmap(ID3D11Resource* pResource, UINT Subresource) = 0;
+
+	// Pipeline states
+	virtual void IASetInputLayout(ID3D11InputLayout* pInputLayout) = 0;
+	virtual void IASetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT* pStrides, const UINT* pOffsets) = 0;
+	virtual void IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset) = 0;
+	virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology) = 0;
+
+	virtual void VSSetShader(ID3D11VertexShader* pVertexShader) = 0;
+	virtual void PSSetShader(ID3D11PixelShader* pPixelShader) = 0;
+	virtual void GSSetShader(ID3D11GeometryShader* pGeometryShader) = 0;
+
+	virtual void VSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) = 0;
+	virtual void PSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) = 0;
+	virtual void GSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) = 0;
+
+	/// Bind ranges of constant buffers (D3D11.1). First constant and number of constants are counted in
+	/// 16-byte constants and must be multiples of 16. Only valid if SupportsConstantBufferOffsets() is true.
+	virtual void VSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) = 0;
+	virtual void PSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) = 0;
+
+	virtual void PSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) = 0;
+	virtual void PSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) = 0;
+
+	virtual void OMSetRenderTargets(UINT NumViews, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView) = 0;
+	virtual void OMSetBlendState(ID3D11BlendState* pBlendState, const FLOAT BlendFactor[4], UINT SampleMask) = 0;
+	virtual void RSSetState(ID3D11RasterizerState* pRasterizerState) = 0;
+	virtual void RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports) = 0;
+
+	// Drawing
+	virtual void ClearRenderTargetView(ID3D11RenderTargetView* pRenderTargetView, const FLOAT ColorRGBA[4]) = 0;
+	virtual void ClearDepthStencilView(ID3D11DepthStencilView* pDepthStencilView, UINT ClearFlags, FLOAT Depth, UINT8 Stencil) = 0;
+
+	virtual void Draw(UINT VertexCount, UINT StartVertexLocation) = 0;
+	virtual void DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation) = 0;
+	virtual void DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation) = 0;
+	virtual void DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation) = 0;
+
+	// Swap chain
+	virtual HRESULT CreateBackBufferRenderTargetView(ID3D11RenderTargetView** ppRTView) = 0;
+	virtual HRESULT ResizeBackBuffer(UINT Width, UINT Height) = 0;
+	virtual HRESULT Present(UINT SyncInterval) = 0;
+
+	/// Name of the adapter the device is created on
+	virtual const TCHAR* GetAdapterName() const = 0;
+
+	/// Native D3D11 device and context for code that talks to D3D11 directly (ImGui, DDS loader). Null for devices without a GPU.
+	virtual ID3D11Device* GetD3DDevice() const				{ return nullptr; }
+	virtual ID3D11DeviceContext* GetD3DDeviceContext() const	{ return nullptr; }
+
+	/// If true, ranges of constant buffers can be bound with offsets, and dynamic constant buffers can be
+	/// mapped with D3D11_MAP_WRITE_NO_OVERWRITE
+	virtual bool SupportsConstantBufferOffsets() const		{ return false; }
+
+	/// Log of submitted commands, if the device records them
+	virtual RRenderCommandLog* GetCommandLog()				{ return nullptr; }
+};
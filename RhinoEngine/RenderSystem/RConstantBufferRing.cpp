@@ -0,0 +1,110 @@
+//=============================================================================
+// RConstantBufferRing.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RConstantBufferRing.h"
+
+#include "RRenderSystem.h"
+#include "D3DUtil.h"
+
+RConstantBufferRing::RConstantBufferRing()
+	: Buffer(nullptr)
+	, Size(0)
+	, WriteOffset(0)
+	, bMapped(false)
+{
+}
+
+RConstantBufferRing::~RConstantBufferRing()
+{
+	Release();
+}
+
+bool RConstantBufferRing::Initialize(UINT InSize)
+{
+	Release();
+
+	Size = AlignSliceSize(InSize);
+
+	D3D11_BUFFER_DESC cbDesc;
+	ZeroMemory(&cbDesc, sizeof(cbDesc));
+	cbDesc.ByteWidth = Size;
+	cbDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+	cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	cbDesc.Usage = D3D11_USAGE_DYNAMIC;
+
+	if (FAILED(GRenderer.Device()->CreateBuffer(&cbDesc, nullptr, &Buffer)))
+	{
+		Buffer = nullptr;
+		Size = 0;
+		return false;
+	}
+
+	// The first map of a dynamic buffer has to discard it
+	WriteOffset = Size;
+	return true;
+}
+
+void RConstantBufferRing::Release()
+{
+	SAFE_RELEASE(Buffer);
+	Size = 0;
+	WriteOffset = 0;
+	bMapped = false;
+}
+
+void* RConstantBufferRing::Map(UINT SizeInBytes, UINT& OutOffset)
+{
+	assert(Buffer && !bMapped);
+
+	const UINT AlignedSize = AlignSliceSize(SizeInBytes);
+	if (AlignedSize > Size)
+	{
+		return nullptr;
+	}
+
+	// Slices written before are never overwritten. If the new slices don't fit after them, start over
+	// in a new buffer which the driver renames for us.
+	D3D11_MAP MapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (WriteOffset + AlignedSize > Size)
+	{
+		MapType = D3D11_MAP_WRITE_DISCARD;
+		WriteOffset = 0;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE MappedResource;
+	if (FAILED(GRenderer.Device()->Map(Buffer, 0, MapType, 0, &MappedResource)))
+	{
+		return nullptr;
+	}
+
+	bMapped = true;
+	OutOffset = WriteOffset;
+	WriteOffset += AlignedSize;
+
+	return (BYTE*)MappedResource.pData + OutOffset;
+}
+
+void RConstantBufferRing::Unmap()
+{
+	assert(bMapped);
+
+	GRenderer.Device()->Unmap(Buffer, 0);
+	bMapped = false;
+}
+
+void RConstantBufferRing::BindVS(UINT Slot, UINT Offset, UINT SizeInBytes)
+{
+	const UINT FirstConstant = Offset / 16;
+	const UINT NumConstants = AlignSliceSize(SizeInBytes) / 16;
+	GRenderer.Device()->VSSetConstantBuffers1(Slot, 1, &Buffer, &FirstConstant, &NumConstants);
+}
+
+void RConstantBufferRing::BindPS(UINT Slot, UINT Offset, UINT SizeInBytes)
+{
+	const UINT FirstConstant = Offset / 16;
+	const UINT NumConstants = AlignSliceSize(SizeInBytes) / 16;
+	GRenderer.Device()->PSSetConstantBuffers1(Slot, 1, &Buffer, &FirstConstant, &NumConstants);
+}
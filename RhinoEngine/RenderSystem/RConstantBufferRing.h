@@ -0,0 +1,53 @@
+//=============================================================================
+// RConstantBufferRing.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Large dynamic constant buffer which slices of constants are sub-allocated from
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+
+#include <d3d11.h>
+
+/// A large dynamic constant buffer used as a ring. Space for slices of many draws is mapped at once
+/// after the last written slice with a no-overwrite map, and slices are bound with offsets instead
+/// of mapping a constant buffer for every draw. When the ring wraps around, the buffer is discarded,
+/// so slices still read by draws in flight are never overwritten.
+/// Needs a render device which supports constant buffer offsets.
+class RConstantBufferRing
+{
+public:
+	/// Slices start at 256-byte (16-constant) boundaries, and are bound in multiples of 256 bytes
+	static const UINT SliceAlignment = 256;
+
+	RConstantBufferRing();
+	~RConstantBufferRing();
+
+	/// Create the buffer with a size in bytes
+	bool Initialize(UINT InSize);
+	void Release();
+
+	bool IsInitialized() const			{ return Buffer != nullptr; }
+	UINT GetSize() const				{ return Size; }
+
+	/// Map space for slices with a total size. Returns the write pointer, and the offset of the space in the
+	/// buffer. Returns null if the size is larger than the ring.
+	void* Map(UINT SizeInBytes, UINT& OutOffset);
+	void Unmap();
+
+	/// Bind a slice at a byte offset to a vertex or pixel shader constant buffer slot
+	void BindVS(UINT Slot, UINT Offset, UINT SizeInBytes);
+	void BindPS(UINT Slot, UINT Offset, UINT SizeInBytes);
+
+	/// Size of a slice holding some bytes of constants
+	static UINT AlignSliceSize(UINT SizeInBytes)	{ return (SizeInBytes + SliceAlignment - 1) & ~(SliceAlignment - 1); }
+
+private:
+	ID3D11Buffer*	Buffer;
+	UINT			Size;
+
+	// Offset of the first byte not written since the buffer was last discarded
+	UINT			WriteOffset;
+	bool			bMapped;
+};
@@ -0,0 +1,426 @@
+//=============================================================================
+// RD3D11RenderDevice.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RD3D11RenderDevice.h"
+
+#include "D3DCommonPrivate.h"
+#include "D3DUtil.h"
+
+#include "Core/CoreTypes.h"
+#include "Core/RLog.h"
+
+RD3D11RenderDevice::RD3D11RenderDevice()
+	: AdapterName(nullptr)
+	, D3DDevice(nullptr)
+	, D3DImmediateContext(nullptr)
+	, SwapChain(nullptr)
+	, D3DImmediateContext1(nullptr)
+{
+}
+
+RD3D11RenderDevice::~RD3D11RenderDevice()
+{
+	SAFE_RELEASE(SwapChain);
+	SAFE_RELEASE(D3DImmediateContext1);
+	SAFE_RELEASE(D3DImmediateContext);
+	SAFE_RELEASE(D3DDevice);
+
+	delete[] AdapterName;
+}
+
+bool RD3D11RenderDevice::Initialize(HWND hWnd, int ClientWidth, int ClientHeight, bool bEnable4xMsaa, bool bEnableGammaCorrection)
+{
+	UINT createDeviceFlags = 0;
+
+#if defined(DEBUG) || defined(_DEBUG)
+	createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
+#endif
+
+	// Enumerate adaptors
+	IDXGIFactory1* dxgiFactory = 0;
+	HR(CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&dxgiFactory));
+
+	IDXGIAdapter* dxgiAdapter = 0;
+	std::vector<IDXGIAdapter*> vAdapters;
+
+	// Select best adapter with most VRAM
+	UINT bestAdapterIndex = 0;
+	size_t bestAdapterMem = 0;
+
+	for (UINT i = 0;
+		dxgiFactory->EnumAdapters(i, &dxgiAdapter) != DXGI_ERROR_NOT_FOUND;
+		++i)
+	{
+		vAdapters.push_back(dxgiAdapter);
+		DXGI_ADAPTER_DESC desc;
+		dxgiAdapter->GetDesc(&desc);
+
+		if (desc.DedicatedVideoMemory > bestAdapterMem)
+		{
+			bestAdapterIndex = i;
+			bestAdapterMem = desc.DedicatedVideoMemory;
+		}
+	}
+
+	// Store adapter's name
+	DXGI_ADAPTER_DESC desc;
+	vAdapters[bestAdapterIndex]->GetDesc(&desc);
+	size_t desc_len = _tcslen(desc.Description);
+	AdapterName = new TCHAR[desc_len + 1];
+	_tcscpy_s(AdapterName, desc_len + 1, desc.Description);
+
+	// Create d3d11 device
+	D3D_FEATURE_LEVEL featureLevel;
+	HRESULT hr = D3D11CreateDevice(
+		vAdapters[bestAdapterIndex],
+		D3D_DRIVER_TYPE_UNKNOWN,
+		0,
+		createDeviceFlags,
+		0, 0,
+		D3D11_SDK_VERSION,
+		&D3DDevice,
+		&featureLevel,
+		&D3DImmediateContext);
+
+	if (FAILED(hr))
+	{
+		// D3D11 SDK layers are not present while creating a debug device. Try creating a device without debugging features.
+		if (hr == DXGI_ERROR_SDK_COMPONENT_MISSING)
+		{
+			RLogWarning("D3D11 SDK Layers for Windows 10 is not found on the system. The D3D11 device will be created without debugging features.\n");
+
+			createDeviceFlags = 0;
+
+			hr = D3D11CreateDevice(
+				vAdapters[bestAdapterIndex],
+				D3D_DRIVER_TYPE_UNKNOWN,
+				0,
+				createDeviceFlags,
+				0, 0,
+				D3D11_SDK_VERSION,
+				&D3DDevice,
+				&featureLevel,
+				&D3DImmediateContext);
+		}
+
+		if (FAILED(hr))
+		{
+			TCHAR* szErrMsg;
+
+			if (FormatMessage(
+				FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM,
+				NULL, hr, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+				(LPTSTR)&szErrMsg, 0, NULL) != 0)
+			{
+				TCHAR buffer[1024];
+				_snwprintf_s(buffer, sizeof(buffer) / sizeof(TCHAR), 1024, L"Failed to create D3D11 device: %s", szErrMsg);
+
+				MessageBox(0, buffer, 0, MB_ICONERROR);
+
+				LocalFree(szErrMsg);
+			}
+			else
+			{
+				MessageBox(0, L"Failed to create D3D11 device: Unknown error.", 0, MB_ICONERROR);
+			}
+
+			return false;
+		}
+	}
+
+#if _DEBUG
+	static const char DeviceContextName[] = "Device Context";
+	D3DImmediateContext->SetPrivateData(WKPDID_D3DDebugObjectName, (UINT)strlen(DeviceContextName), DeviceContextName);
+#endif
+
+	if (featureLevel != D3D_FEATURE_LEVEL_11_0)
+	{
+		MessageBox(0, L"Direct3D Feature Level 11 unsupported.", 0, MB_ICONERROR);
+		return false;
+	}
+
+	// Constant buffer ranges need a D3D11.1 context, and a driver which supports offsets and
+	// no-overwrite maps on dynamic constant buffers
+	D3D11_FEATURE_DATA_D3D11_OPTIONS Options = {};
+	if (SUCCEEDED(D3DDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &Options, sizeof(Options))) &&
+		Options.ConstantBufferOffsetting && Options.MapNoOverwriteOnDynamicConstantBuffer)
+	{
+		D3DImmediateContext->QueryInterface(__uuidof(ID3D11DeviceContext1), (void**)&D3DImmediateContext1);
+	}
+
+	if (!D3DImmediateContext1)
+	{
+		RLogWarning("Constant buffer offsets are not supported by the device. Constant buffers will be updated for each draw.\n");
+	}
+
+	DXGI_FORMAT backbuffer_format = bEnableGammaCorrection ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+
+	// Check 4X MSAA quality support
+	UINT Msaa4xQuality;
+	HR(D3DDevice->CheckMultisampleQualityLevels(
+		backbuffer_format, 4, &Msaa4xQuality));
+	assert(Msaa4xQuality > 0);
+
+	DXGI_SWAP_CHAIN_DESC sd;
+	sd.BufferDesc.Width = ClientWidth;
+	sd.BufferDesc.Height = ClientHeight;
+	sd.BufferDesc.RefreshRate.Numerator = 60;
+	sd.BufferDesc.RefreshRate.Denominator = 1;
+	sd.BufferDesc.Format = backbuffer_format;
+	sd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
+	sd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
+
+	if (bEnable4xMsaa)
+	{
+		sd.SampleDesc.Count = 4;
+		sd.SampleDesc.Quality = Msaa4xQuality - 1;
+	}
+	else
+	{
+		sd.SampleDesc.Count = 1;
+		sd.SampleDesc.Quality = 0;
+	}
+
+	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	sd.BufferCount = 1;
+	sd.OutputWindow = hWnd;
+	sd.Windowed = true;
+	sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+	sd.Flags = 0;
+
+	// Create swap chain
+	HR(dxgiFactory->CreateSwapChain(D3DDevice, &sd, &SwapChain));
+
+	// Release COM objects
+	dxgiFactory->Release();
+
+	return true;
+}
+
+HRESULT RD3D11RenderDevice::CreateBuffer(const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Buffer** ppBuffer)
+{
+	return D3DDevice->CreateBuffer(pDesc, pInitialData, ppBuffer);
+}
+
+HRESULT RD3D11RenderDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture2D** ppTexture2D)
+{
+	return D3DDevice->CreateTexture2D(pDesc, pInitialData, ppTexture2D);
+}
+
+HRESULT RD3D11RenderDevice::CreateShaderResourceView(ID3D11Resource* pResource, const D3D11_SHADER_RESOURCE_VIEW_DESC* pDesc, ID3D11ShaderResourceView** ppSRView)
+{
+	return D3DDevice->CreateShaderResourceView(pResource, pDesc, ppSRView);
+}
+
+HRESULT RD3D11RenderDevice::CreateRenderTargetView(ID3D11Resource* pResource, const D3D11_RENDER_TARGET_VIEW_DESC* pDesc, ID3D11RenderTargetView** ppRTView)
+{
+	return D3DDevice->CreateRenderTargetView(pResource, pDesc, ppRTView);
+}
+
+HRESULT RD3D11RenderDevice::CreateDepthStencilView(ID3D11Resource* pResource, const D3D11_DEPTH_STENCIL_VIEW_DESC* pDesc, ID3D11DepthStencilView** ppDepthStencilView)
+{
+	return D3DDevice->CreateDepthStencilView(pResource, pDesc, ppDepthStencilView);
+}
+
+HRESULT RD3D11RenderDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pInputElementDescs, UINT NumElements, const void* pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, ID3D11InputLayout** ppInputLayout)
+{
+	return D3DDevice->CreateInputLayout(pInputElementDescs, NumElements, pShaderBytecodeWithInputSignature, BytecodeLength, ppInputLayout);
+}
+
+HRESULT RD3D11RenderDevice::CreateVertexShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11VertexShader** ppVertexShader)
+{
+	return D3DDevice->CreateVertexShader(pShaderBytecode, BytecodeLength, nullptr, ppVertexShader);
+}
+
+HRESULT RD3D11RenderDevice::CreatePixelShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11PixelShader** ppPixelShader)
+{
+	return D3DDevice->CreatePixelShader(pShaderBytecode, BytecodeLength, nullptr, ppPixelShader);
+}
+
+HRESULT RD3D11RenderDevice::CreateGeometryShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11GeometryShader** ppGeometryShader)
+{
+	return D3DDevice->CreateGeometryShader(pShaderBytecode, BytecodeLength, nullptr, ppGeometryShader);
+}
+
+HRESULT RD3D11RenderDevice::CreateBlendState(const D3D11_BLEND_DESC* pBlendStateDesc, ID3D11BlendState** ppBlendState)
+{
+	return D3DDevice->CreateBlendState(pBlendStateDesc, ppBlendState);
+}
+
+HRESULT RD3D11RenderDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* pSamplerDesc, ID3D11SamplerState** ppSamplerState)
+{
+	return D3DDevice->CreateSamplerState(pSamplerDesc, ppSamplerState);
+}
+
+HRESULT RD3D11RenderDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* pRasterizerDesc, ID3D11RasterizerState** ppRasterizerState)
+{
+	return D3DDevice->CreateRasterizerState(pRasterizerDesc, ppRasterizerState);
+}
+
+HRESULT RD3D11RenderDevice::CheckFormatSupport(DXGI_FORMAT Format, UINT* pFormatSupport)
+{
+	return D3DDevice->CheckFormatSupport(Format, pFormatSupport);
+}
+
+HRESULT RD3D11RenderDevice::CheckMultisampleQualityLevels(DXGI_FORMAT Format, UINT SampleCount, UINT* pNumQualityLevels)
+{
+	return D3DDevice->CheckMultisampleQualityLevels(Format, SampleCount, pNumQualityLevels);
+}
+
+HRESULT RD3D11RenderDevice::Map(ID3D11Resource* pResource, UINT Subresource, D3D11_MAP MapType, UINT MapFlags, D3D11_MAPPED_SUBRESOURCE* pMappedResource)
+{
+	return D3DImmediateContext->Map(pResource, Subresource, MapType, MapFlags, pMappedResource);
+}
+
+void RD3D11RenderDevice::Unmap(ID3D11Resource* pResource, UINT Subresource)
+{
+	D3DImmediateContext->Unmap(pResource, Subresource);
+}
+
+void RD3D11RenderDevice::IASetInputLayout(ID3D11InputLayout* pInputLayout)
+{
+	D3DImmediateContext->IASetInputLayout(pInputLayout);
+}
+
+void RD3D11RenderDevice::IASetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT* pStrides, const UINT* pOffsets)
+{
+	D3DImmediateContext->IASetVertexBuffers(StartSlot, NumBuffers, ppVertexBuffers, pStrides, pOffsets);
+}
+
+void RD3D11RenderDevice::IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset)
+{
+	D3DImmediateContext->IASetIndexBuffer(pIndexBuffer, Format, Offset);
+}
+
+void RD3D11RenderDevice::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology)
+{
+	D3DImmediateContext->IASetPrimitiveTopology(Topology);
+}
+
+void RD3D11RenderDevice::VSSetShader(ID3D11VertexShader* pVertexShader)
+{
+	D3DImmediateContext->VSSetShader(pVertexShader, nullptr, 0);
+}
+
+void RD3D11RenderDevice::PSSetShader(ID3D11PixelShader* pPixelShader)
+{
+	D3DImmediateContext->PSSetShader(pPixelShader, nullptr, 0);
+}
+
+void RD3D11RenderDevice::GSSetShader(ID3D11GeometryShader* pGeometryShader)
+{
+	D3DImmediateContext->GSSetShader(pGeometryShader, nullptr, 0);
+}
+
+void RD3D11RenderDevice::VSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+{
+	D3DImmediateContext->VSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+}
+
+void RD3D11RenderDevice::PSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+{
+	D3DImmediateContext->PSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+}
+
+void RD3D11RenderDevice::GSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+{
+	D3DImmediateContext->GSSetConstantBuffers(StartSlot, NumBuffers, ppConstantBuffers);
+}
+
+void RD3D11RenderDevice::VSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+{
+	D3DImmediateContext1->VSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+}
+
+void RD3D11RenderDevice::PSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+{
+	D3DImmediateContext1->PSSetConstantBuffers1(StartSlot, NumBuffers, ppConstantBuffers, pFirstConstant, pNumConstants);
+}
+
+void RD3D11RenderDevice::PSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+{
+	D3DImmediateContext->PSSetShaderResources(StartSlot, NumViews, ppShaderResourceViews);
+}
+
+void RD3D11RenderDevice::PSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+{
+	D3DImmediateContext->PSSetSamplers(StartSlot, NumSamplers, ppSamplers);
+}
+
+void RD3D11RenderDevice::OMSetRenderTargets(UINT NumViews, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView)
+{
+	D3DImmediateContext->OMSetRenderTargets(NumViews, ppRenderTargetViews, pDepthStencilView);
+}
+
+void RD3D11RenderDevice::OMSetBlendState(ID3D11BlendState* pBlendState, const FLOAT BlendFactor[4], UINT SampleMask)
+{
+	D3DImmediateContext->OMSetBlendState(pBlendState, BlendFactor, SampleMask);
+}
+
+void RD3D11RenderDevice::RSSetState(ID3D11RasterizerState* pRasterizerState)
+{
+	D3DImmediateContext->RSSetState(pRasterizerState);
+}
+
+void RD3D11RenderDevice::RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports)
+{
+	D3DImmediateContext->RSSetViewports(NumViewports, pViewports);
+}
+
+void RD3D11RenderDevice::ClearRenderTargetView(ID3D11RenderTargetView* pRenderTargetView, const FLOAT ColorRGBA[4])
+{
+	D3DImmediateContext->ClearRenderTargetView(pRenderTargetView, ColorRGBA);
+}
+
+void RD3D11RenderDevice::ClearDepthStencilView(ID3D11DepthStencilView* pDepthStencilView, UINT ClearFlags, FLOAT Depth, UINT8 Stencil)
+{
+	D3DImmediateContext->ClearDepthStencilView(pDepthStencilView, ClearFlags, Depth, Stencil);
+}
+
+void RD3D11RenderDevice::Draw(UINT VertexCount, UINT StartVertexLocation)
+{
+	D3DImmediateContext->Draw(VertexCount, StartVertexLocation);
+}
+
+void RD3D11RenderDevice::DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation)
+{
+	D3DImmediateContext->DrawIndexed(IndexCount, StartIndexLocation, BaseVertexLocation);
+}
+
+void RD3D11RenderDevice::DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation)
+{
+	D3DImmediateContext->DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
+}
+
+void RD3D11RenderDevice::DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation)
+{
+	D3DImmediateContext->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
+}
+
+HRESULT RD3D11RenderDevice::CreateBackBufferRenderTargetView(ID3D11RenderTargetView** ppRTView)
+{
+	ID3D11Texture2D* backBuffer;
+	HRESULT hr = SwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&backBuffer));
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	hr = D3DDevice->CreateRenderTargetView(backBuffer, 0, ppRTView);
+	backBuffer->Release();
+
+	return hr;
+}
+
+HRESULT RD3D11RenderDevice::ResizeBackBuffer(UINT Width, UINT Height)
+{
+	return SwapChain->ResizeBuffers(0, Width, Height, DXGI_FORMAT_UNKNOWN, 0);
+}
+
+HRESULT RD3D11RenderDevice::Present(UINT SyncInterval)
+{
+	return SwapChain->Present(SyncInterval, 0);
+}
@@ -0,0 +1,92 @@
+//=============================================================================
+// RD3D11RenderDevice.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Render device on a hardware D3D11 device and a swap chain
+//=============================================================================
+
+#pragma once
+
+#include "IRenderDevice.h"
+
+#include <d3d11_1.h>
+
+class RD3D11RenderDevice : public IRenderDevice
+{
+public:
+	RD3D11RenderDevice();
+	virtual ~RD3D11RenderDevice();
+
+	/// Create the device on the adapter with the most video memory, and a swap chain for the window
+	bool Initialize(HWND hWnd, int ClientWidth, int ClientHeight, bool bEnable4xMsaa, bool bEnableGammaCorrection);
+
+	virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Buffer** ppBuffer) override;
+	virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture2D** ppTexture2D) override;
+	virtual HRESULT CreateShaderResourceView(ID3D11Resource* pResource, const D3D11_SHADER_RESOURCE_VIEW_DESC* pDesc, ID3D11ShaderResourceView** ppSRView) override;
+	virtual HRESULT CreateRenderTargetView(ID3D11Resource* pResource, const D3D11_RENDER_TARGET_VIEW_DESC* pDesc, ID3D11RenderTargetView** ppRTView) override;
+	virtual HRESULT CreateDepthStencilView(ID3D11Resource* pResource, const D3D11_DEPTH_STENCIL_VIEW_DESC* pDesc, ID3D11DepthStencilView** ppDepthStencilView) override;
+	virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pInputElementDescs, UINT NumElements, const void* pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, ID3D11InputLayout** ppInputLayout) override;
+	virtual HRESULT CreateVertexShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11VertexShader** ppVertexShader) override;
+	virtual HRESULT CreatePixelShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11PixelShader** ppPixelShader) override;
+	virtual HRESULT CreateGeometryShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11GeometryShader** ppGeometryShader) override;
+	virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC* pBlendStateDesc, ID3D11BlendState** ppBlendState) override;
+	virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC* pSamplerDesc, ID3D11SamplerState** ppSamplerState) override;
+	virtual HRESULT CreateRasterizerState(const D3D11_RASTERIZER_DESC* pRasterizerDesc, ID3D11RasterizerState** ppRasterizerState) override;
+
+	virtual HRESULT CheckFormatSupport(DXGI_FORMAT Format, UINT* pFormatSupport) override;
+	virtual HRESULT CheckMultisampleQualityLevels(DXGI_FORMAT Format, UINT SampleCount, UINT* pNumQualityLevels) override;
+
+	virtual HRESULT Map(ID3D11Resource* pResource, UINT Subresource, D3D11_MAP MapType, UINT MapFlags, D3D11_MAPPED_SUBRESOURCE* pMappedResource) override;
+	virtual void Unmap(ID3D11Resource* pResource, UINT Subresource) override;
+
+	virtual void IASetInputLayout(ID3D11InputLayout* pInputLayout) override;
+	virtual void IASetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT* pStrides, const UINT* pOffsets) override;
+	virtual void IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset) override;
+	virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology) override;
+
+	virtual void VSSetShader(ID3D11VertexShader* pVertexShader) override;
+	virtual void PSSetShader(ID3D11PixelShader* pPixelShader) override;
+	virtual void GSSetShader(ID3D11GeometryShader* pGeometryShader) override;
+
+	virtual void VSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	virtual void PSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	virtual void GSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers) override;
+	virtual void VSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+	virtual void PSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants) override;
+
+	virtual void PSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews) override;
+	virtual void PSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers) override;
+
+	virtual void OMSetRenderTargets(UINT NumViews, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView) override;
+	virtual void OMSetBlendState(ID3D11BlendState* pBlendState, const FLOAT BlendFactor[4], UINT SampleMask) override;
+	virtual void RSSetState(ID3D11RasterizerState* pRasterizerState) override;
+	virtual void RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports) override;
+
+	virtual void ClearRenderTargetView(ID3D11RenderTargetView* pRenderTargetView, const FLOAT ColorRGBA[4]) override;
+	virtual void ClearDepthStencilView(ID3D11DepthStencilView* pDepthStencilView, UINT ClearFlags, FLOAT Depth, UINT8 Stencil) override;
+
+	virtual void Draw(UINT VertexCount, UINT StartVertexLocation) override;
+	virtual void DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation) override;
+	virtual void DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation) override;
+	virtual void DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation) override;
+
+	virtual HRESULT CreateBackBufferRenderTargetView(ID3D11RenderTargetView** ppRTView) override;
+	virtual HRESULT ResizeBackBuffer(UINT Width, UINT Height) override;
+	virtual HRESULT Present(UINT SyncInterval) override;
+
+	virtual const TCHAR* GetAdapterName() const override		{ return AdapterName; }
+
+	virtual ID3D11Device* GetD3DDevice() const override				{ return D3DDevice; }
+	virtual ID3D11DeviceContext* GetD3DDeviceContext() const override	{ return D3DImmediateContext; }
+
+	virtual bool SupportsConstantBufferOffsets() const override		{ return D3DImmediateContext1 != nullptr; }
+
+private:
+	TCHAR*					AdapterName;
+
+	ID3D11Device*			D3DDevice;
+	ID3D11DeviceContext*	D3DImmediateContext;
+	IDXGISwapChain*			SwapChain;
+
+	// D3D11.1 context for binding constant buffer ranges. Null if the runtime or driver doesn't support it.
+	ID3D11DeviceContext1*	D3DImmediateContext1;
+};
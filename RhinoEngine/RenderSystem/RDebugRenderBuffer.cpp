@@ -44,7 +44,7 @@ void RDebugRenderBuffer::Render()
 		RConstantBuffers::cbPerObject.BindBuffer();
 
 		m_ColorShader->Bind();
-		GRenderer.D3DImmediateContext()->IASetInputLayout(m_PrimitiveInputLayout);
+		GRenderer.Device()->IASetInputLayout(m_PrimitiveInputLayout);
 
 		UINT StartIndex = 0;
 
@@ -72,7 +72,7 @@ void RDebugRenderBuffer::Render()
 			RConstantBuffers::cbPerObject.BindBuffer();
 
 			m_ColorShader->Bind();
-			GRenderer.D3DImmediateContext()->IASetInputLayout(m_PrimitiveInputLayout);
+			GRenderer.Device()->IASetInputLayout(m_PrimitiveInputLayout);
 			m_PrimitiveMeshBuffer->Draw();
 		}
 	}
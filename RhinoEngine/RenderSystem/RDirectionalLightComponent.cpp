@@ -156,7 +156,7 @@ void RDirectionalLightComponent::PrepareDepthPass(int PassIndex, const RenderVie
 	RConstantBuffers::cbScene.BindBuffer();
 
 	ID3D11ShaderResourceView* nullSRV[] = { nullptr };
-	GRenderer.D3DImmediateContext()->PSSetShaderResources(RShadowMap::ShaderResourceSlot(), 1, nullSRV);
+	GRenderer.Device()->PSSetShaderResources(RShadowMap::ShaderResourceSlot(), 1, nullSRV);
 
 	m_ShadowMap[PassIndex].SetupRenderTarget();
 }
@@ -0,0 +1,352 @@
+//=============================================================================
+// RLightClusterGrid.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RLightClusterGrid.h"
+
+namespace
+{
+	/// Distance from a value to a range, zero if it's inside
+	FORCEINLINE float AxisDistance(float Value, float Min, float Max)
+	{
+		return Value < Min ? Min - Value : (Value > Max ? Value - Max : 0.0f);
+	}
+}
+
+RLightClusterGrid::RLightClusterGrid()
+	: NumClustersX(16)
+	, NumClustersY(9)
+	, NumClustersZ(24)
+	, bIsValid(false)
+	, BoundsFovY(0.0f)
+	, BoundsAspectRatio(0.0f)
+	, BoundsNearZ(0.0f)
+	, BoundsFarZ(0.0f)
+	, bClusterBoundsDirty(true)
+	, CurrentGatherStamp(0)
+{
+}
+
+void RLightClusterGrid::SetGridSize(int InNumClustersX, int InNumClustersY, int InNumClustersZ)
+{
+	assert(InNumClustersX > 0 && InNumClustersY > 0 && InNumClustersZ > 0);
+
+	NumClustersX = InNumClustersX;
+	NumClustersY = InNumClustersY;
+	NumClustersZ = InNumClustersZ;
+	bClusterBoundsDirty = true;
+	bIsValid = false;
+}
+
+void RLightClusterGrid::Build(const RLightClusterView& View, const RLightSphere* Lights, int NumLights)
+{
+	BuildClusterBounds(View);
+	TransformLights(View, Lights, NumLights);
+
+	LightClusterPairs.clear();
+
+	for (int LightIndex = 0; LightIndex < NumLights; LightIndex++)
+	{
+		const RVec3& Center = ViewSpaceLights[LightIndex].Center;
+		const float Radius = ViewSpaceLights[LightIndex].Radius;
+
+		int FirstZ, LastZ;
+		if (!FindSphereExtentRange(Center.Z(), Radius, SliceExtents.data(), NumClustersZ, FirstZ, LastZ))
+		{
+			continue;
+		}
+
+		for (int z = FirstZ; z <= LastZ; z++)
+		{
+			// Tiles get wider with depth, so the range of tiles is found for each slice
+			int FirstX, LastX, FirstY, LastY;
+			if (!FindSphereExtentRange(Center.X(), Radius, &TileExtentsX[z * NumClustersX], NumClustersX, FirstX, LastX) ||
+				!FindSphereExtentRange(Center.Y(), Radius, &TileExtentsY[z * NumClustersY], NumClustersY, FirstY, LastY))
+			{
+				continue;
+			}
+
+			for (int y = FirstY; y <= LastY; y++)
+			{
+				for (int x = FirstX; x <= LastX; x++)
+				{
+					const int ClusterIndex = GetClusterIndex(x, y, z);
+					if (TestSphereIntersectsAabb(Center, Radius, ClusterBounds[ClusterIndex]))
+					{
+						LightClusterPairs.push_back(std::make_pair((UINT)ClusterIndex, (UINT)LightIndex));
+					}
+				}
+			}
+		}
+	}
+
+	BuildLightLists(NumLights);
+}
+
+void RLightClusterGrid::BuildBruteForce(const RLightClusterView& View, const RLightSphere* Lights, int NumLights)
+{
+	BuildClusterBounds(View);
+	TransformLights(View, Lights, NumLights);
+
+	LightClusterPairs.clear();
+
+	const int NumClusters = GetNumClusters();
+	for (int ClusterIndex = 0; ClusterIndex < NumClusters; ClusterIndex++)
+	{
+		for (int LightIndex = 0; LightIndex < NumLights; LightIndex++)
+		{
+			if (TestSphereIntersectsAabb(ViewSpaceLights[LightIndex].Center, ViewSpaceLights[LightIndex].Radius, ClusterBounds[ClusterIndex]))
+			{
+				LightClusterPairs.push_back(std::make_pair((UINT)ClusterIndex, (UINT)LightIndex));
+			}
+		}
+	}
+
+	BuildLightLists(NumLights);
+}
+
+void RLightClusterGrid::Reset()
+{
+	ClusterLightOffsets.clear();
+	ClusterLightIndices.clear();
+	bIsValid = false;
+}
+
+void RLightClusterGrid::GatherLightsInBounds(const RAabb& WorldBounds, std::vector<UINT>& OutLightIndices)
+{
+	OutLightIndices.clear();
+
+	if (!bIsValid)
+	{
+		return;
+	}
+
+	const RAabb ViewBounds = WorldBounds.GetTransformedAabb(ViewMatrix);
+
+	int FirstZ, LastZ;
+	if (!FindOverlapExtentRange(ViewBounds.pMin.Z(), ViewBounds.pMax.Z(), SliceExtents.data(), NumClustersZ, FirstZ, LastZ))
+	{
+		return;
+	}
+
+	// Stamps mark lights which have been added already. They are cleared when the stamp wraps around.
+	CurrentGatherStamp++;
+	if (CurrentGatherStamp == 0)
+	{
+		std::fill(LightGatherStamps.begin(), LightGatherStamps.end(), 0);
+		CurrentGatherStamp = 1;
+	}
+
+	for (int z = FirstZ; z <= LastZ; z++)
+	{
+		int FirstX, LastX, FirstY, LastY;
+		if (!FindOverlapExtentRange(ViewBounds.pMin.X(), ViewBounds.pMax.X(), &TileExtentsX[z * NumClustersX], NumClustersX, FirstX, LastX) ||
+			!FindOverlapExtentRange(ViewBounds.pMin.Y(), ViewBounds.pMax.Y(), &TileExtentsY[z * NumClustersY], NumClustersY, FirstY, LastY))
+		{
+			continue;
+		}
+
+		for (int y = FirstY; y <= LastY; y++)
+		{
+			for (int x = FirstX; x <= LastX; x++)
+			{
+				const int ClusterIndex = GetClusterIndex(x, y, z);
+				const UINT* ClusterLights = GetClusterLights(ClusterIndex);
+				const UINT NumClusterLights = GetClusterLightCount(ClusterIndex);
+
+				for (UINT i = 0; i < NumClusterLights; i++)
+				{
+					const UINT LightIndex = ClusterLights[i];
+					if (LightGatherStamps[LightIndex] != CurrentGatherStamp)
+					{
+						LightGatherStamps[LightIndex] = CurrentGatherStamp;
+						OutLightIndices.push_back(LightIndex);
+					}
+				}
+			}
+		}
+	}
+
+	std::sort(OutLightIndices.begin(), OutLightIndices.end());
+}
+
+bool RLightClusterGrid::TestSphereIntersectsAabb(const RVec3& Center, float Radius, const RAabb& Aabb)
+{
+	const float DistX = AxisDistance(Center.X(), Aabb.pMin.X(), Aabb.pMax.X());
+	const float DistY = AxisDistance(Center.Y(), Aabb.pMin.Y(), Aabb.pMax.Y());
+	const float DistZ = AxisDistance(Center.Z(), Aabb.pMin.Z(), Aabb.pMax.Z());
+
+	if (DistX > Radius || DistY > Radius || DistZ > Radius)
+	{
+		return false;
+	}
+
+	return DistX * DistX + DistY * DistY + DistZ * DistZ <= Radius * Radius;
+}
+
+void RLightClusterGrid::BuildClusterBounds(const RLightClusterView& View)
+{
+	ViewMatrix = View.ViewMatrix;
+
+	if (!bClusterBoundsDirty && BoundsFovY == View.FovY && BoundsAspectRatio == View.AspectRatio &&
+		BoundsNearZ == View.NearZ && BoundsFarZ == View.FarZ)
+	{
+		return;
+	}
+
+	BoundsFovY = View.FovY;
+	BoundsAspectRatio = View.AspectRatio;
+	BoundsNearZ = View.NearZ;
+	BoundsFarZ = View.FarZ;
+	bClusterBoundsDirty = false;
+
+	const float TanHalfFovY = tanf(DEG_TO_RAD(View.FovY) * 0.5f);
+	const float TanHalfFovX = TanHalfFovY * View.AspectRatio;
+
+	// Exponential slices keep clusters close to cubes at all depths
+	std::vector<float> SliceDepths(NumClustersZ + 1);
+	for (int z = 0; z <= NumClustersZ; z++)
+	{
+		SliceDepths[z] = View.NearZ * powf(View.FarZ / View.NearZ, (float)z / NumClustersZ);
+	}
+	SliceDepths[NumClustersZ] = View.FarZ;
+
+	SliceExtents.resize(NumClustersZ);
+	TileExtentsX.resize(NumClustersZ * NumClustersX);
+	TileExtentsY.resize(NumClustersZ * NumClustersY);
+
+	// A tile between two NDC coordinates is widest at one end of the slice, depending on which side of the view it's on
+	auto MakeTileExtent = [](float NdcMin, float NdcMax, float TanHalfFov, float SliceNear, float SliceFar)
+	{
+		RAxisExtent Extent;
+		Extent.Min = RMath::Min(NdcMin * SliceNear, NdcMin * SliceFar) * TanHalfFov;
+		Extent.Max = RMath::Max(NdcMax * SliceNear, NdcMax * SliceFar) * TanHalfFov;
+		return Extent;
+	};
+
+	for (int z = 0; z < NumClustersZ; z++)
+	{
+		const float SliceNear = SliceDepths[z];
+		const float SliceFar = SliceDepths[z + 1];
+		SliceExtents[z] = { SliceNear, SliceFar };
+
+		for (int x = 0; x < NumClustersX; x++)
+		{
+			const float NdcMin = -1.0f + 2.0f * x / NumClustersX;
+			const float NdcMax = -1.0f + 2.0f * (x + 1) / NumClustersX;
+			TileExtentsX[z * NumClustersX + x] = MakeTileExtent(NdcMin, NdcMax, TanHalfFovX, SliceNear, SliceFar);
+		}
+
+		for (int y = 0; y < NumClustersY; y++)
+		{
+			const float NdcMin = -1.0f + 2.0f * y / NumClustersY;
+			const float NdcMax = -1.0f + 2.0f * (y + 1) / NumClustersY;
+			TileExtentsY[z * NumClustersY + y] = MakeTileExtent(NdcMin, NdcMax, TanHalfFovY, SliceNear, SliceFar);
+		}
+	}
+
+	ClusterBounds.resize(GetNumClusters());
+	for (int z = 0; z < NumClustersZ; z++)
+	{
+		for (int y = 0; y < NumClustersY; y++)
+		{
+			for (int x = 0; x < NumClustersX; x++)
+			{
+				const RAxisExtent& ExtentX = TileExtentsX[z * NumClustersX + x];
+				const RAxisExtent& ExtentY = TileExtentsY[z * NumClustersY + y];
+				const RAxisExtent& ExtentZ = SliceExtents[z];
+
+				ClusterBounds[GetClusterIndex(x, y, z)] = RAabb(RVec3(ExtentX.Min, ExtentY.Min, ExtentZ.Min), RVec3(ExtentX.Max, ExtentY.Max, ExtentZ.Max));
+			}
+		}
+	}
+}
+
+void RLightClusterGrid::TransformLights(const RLightClusterView& View, const RLightSphere* Lights, int NumLights)
+{
+	ViewSpaceLights.resize(NumLights);
+	for (int i = 0; i < NumLights; i++)
+	{
+		ViewSpaceLights[i].Center = View.ViewMatrix.Transform(Lights[i].Center);
+		ViewSpaceLights[i].Radius = Lights[i].Radius;
+	}
+}
+
+bool RLightClusterGrid::FindSphereExtentRange(float Center, float Radius, const RAxisExtent* Extents, int NumExtents, int& OutFirst, int& OutLast)
+{
+	OutFirst = 0;
+	while (OutFirst < NumExtents && AxisDistance(Center, Extents[OutFirst].Min, Extents[OutFirst].Max) > Radius)
+	{
+		OutFirst++;
+	}
+
+	if (OutFirst == NumExtents)
+	{
+		return false;
+	}
+
+	OutLast = NumExtents - 1;
+	while (AxisDistance(Center, Extents[OutLast].Min, Extents[OutLast].Max) > Radius)
+	{
+		OutLast--;
+	}
+
+	return true;
+}
+
+bool RLightClusterGrid::FindOverlapExtentRange(float Min, float Max, const RAxisExtent* Extents, int NumExtents, int& OutFirst, int& OutLast)
+{
+	OutFirst = 0;
+	while (OutFirst < NumExtents && (Extents[OutFirst].Max < Min || Extents[OutFirst].Min > Max))
+	{
+		OutFirst++;
+	}
+
+	if (OutFirst == NumExtents)
+	{
+		return false;
+	}
+
+	OutLast = NumExtents - 1;
+	while (Extents[OutLast].Max < Min || Extents[OutLast].Min > Max)
+	{
+		OutLast--;
+	}
+
+	return true;
+}
+
+void RLightClusterGrid::BuildLightLists(int NumLights)
+{
+	const int NumClusters = GetNumClusters();
+
+	// Count lights of each cluster, then turn counts into offsets
+	ClusterLightOffsets.assign(NumClusters + 1, 0);
+	for (const auto& Pair : LightClusterPairs)
+	{
+		ClusterLightOffsets[Pair.first + 1]++;
+	}
+
+	for (int i = 0; i < NumClusters; i++)
+	{
+		ClusterLightOffsets[i + 1] += ClusterLightOffsets[i];
+	}
+
+	// Pairs are added in order of light index for each cluster, so light lists come out sorted
+	ClusterWriteOffsets.assign(ClusterLightOffsets.begin(), ClusterLightOffsets.end() - 1);
+	ClusterLightIndices.resize(LightClusterPairs.size());
+	for (const auto& Pair : LightClusterPairs)
+	{
+		ClusterLightIndices[ClusterWriteOffsets[Pair.first]++] = Pair.second;
+	}
+
+	if ((int)LightGatherStamps.size() != NumLights)
+	{
+		LightGatherStamps.assign(NumLights, 0);
+		CurrentGatherStamp = 0;
+	}
+
+	bIsValid = true;
+}
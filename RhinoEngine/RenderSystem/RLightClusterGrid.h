@@ -0,0 +1,133 @@
+//=============================================================================
+// RLightClusterGrid.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Point lights binned into a 3D grid of clusters covering the view frustum
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+
+/// A point light as a sphere in world space
+struct RLightSphere
+{
+	RVec3	Center;
+	float	Radius;
+};
+
+/// The camera which clusters are built for
+struct RLightClusterView
+{
+	RMatrix4	ViewMatrix;
+
+	// Vertical field of view in degrees, as set up in RCamera
+	float		FovY;
+	float		AspectRatio;
+	float		NearZ;
+	float		FarZ;
+};
+
+/// Splits the view frustum into a grid of clusters (froxels) and finds the lights which touch each cluster.
+/// Clusters are tiles of the screen, counted from the bottom left, split into depth slices whose depths
+/// grow exponentially from the near plane to the far plane.
+/// Light lists of all clusters are stored compactly in one array of light indices: lights of a cluster
+/// start at its offset, and are sorted by light index.
+class RLightClusterGrid
+{
+public:
+	RLightClusterGrid();
+
+	/// Set the number of clusters along each axis of the grid. Takes effect in the next build.
+	void SetGridSize(int InNumClustersX, int InNumClustersY, int InNumClustersZ);
+
+	/// Bin lights into clusters of a view. Each light is only tested against clusters in the range
+	/// covered by its bounds.
+	void Build(const RLightClusterView& View, const RLightSphere* Lights, int NumLights);
+
+	/// Bin lights into clusters by testing every light against every cluster. Gives the same result as
+	/// Build, and is used to validate it.
+	void BuildBruteForce(const RLightClusterView& View, const RLightSphere* Lights, int NumLights);
+
+	/// Remove all lights. The grid is invalid until it's built again.
+	void Reset();
+
+	bool IsValid() const										{ return bIsValid; }
+
+	int GetNumClustersX() const									{ return NumClustersX; }
+	int GetNumClustersY() const									{ return NumClustersY; }
+	int GetNumClustersZ() const									{ return NumClustersZ; }
+	int GetNumClusters() const									{ return NumClustersX * NumClustersY * NumClustersZ; }
+	int GetClusterIndex(int X, int Y, int Z) const				{ return (Z * NumClustersY + Y) * NumClustersX + X; }
+
+	/// Bounds of a cluster in view space
+	const RAabb& GetClusterBounds(int ClusterIndex) const		{ return ClusterBounds[ClusterIndex]; }
+
+	/// Lights touching a cluster, as indices into the lights the grid was built with
+	UINT GetClusterLightCount(int ClusterIndex) const			{ return ClusterLightOffsets[ClusterIndex + 1] - ClusterLightOffsets[ClusterIndex]; }
+	const UINT* GetClusterLights(int ClusterIndex) const		{ return ClusterLightIndices.data() + ClusterLightOffsets[ClusterIndex]; }
+
+	/// Offsets of light lists of all clusters, with the total number of light indices at the end
+	const std::vector<UINT>& GetClusterLightOffsets() const		{ return ClusterLightOffsets; }
+	const std::vector<UINT>& GetClusterLightIndices() const		{ return ClusterLightIndices; }
+
+	/// Find lights in all clusters overlapping world space bounds. Each light is added once, in order of light index.
+	void GatherLightsInBounds(const RAabb& WorldBounds, std::vector<UINT>& OutLightIndices);
+
+	/// Test a sphere against a box. Rejects the sphere if it's farther than its radius from the box on any axis
+	/// before measuring its distance to the box.
+	static bool TestSphereIntersectsAabb(const RVec3& Center, float Radius, const RAabb& Aabb);
+
+private:
+	/// Compute depths of slices and view space bounds of all clusters
+	void BuildClusterBounds(const RLightClusterView& View);
+
+	/// Transform lights to view space
+	void TransformLights(const RLightClusterView& View, const RLightSphere* Lights, int NumLights);
+
+	/// Extent of a row of clusters along one axis
+	struct RAxisExtent
+	{
+		float Min;
+		float Max;
+	};
+
+	/// Find the first and last extents which a sphere is within its radius of along their axis.
+	/// Clusters outside the range can't touch the sphere. Returns false if there are none.
+	static bool FindSphereExtentRange(float Center, float Radius, const RAxisExtent* Extents, int NumExtents, int& OutFirst, int& OutLast);
+
+	/// Find the first and last extents which overlap an interval. Returns false if there are none.
+	static bool FindOverlapExtentRange(float Min, float Max, const RAxisExtent* Extents, int NumExtents, int& OutFirst, int& OutLast);
+
+	/// Turn lights added to clusters in order of light index into compact light lists
+	void BuildLightLists(int NumLights);
+
+	int								NumClustersX;
+	int								NumClustersY;
+	int								NumClustersZ;
+	bool							bIsValid;
+
+	RMatrix4						ViewMatrix;
+
+	// Projection which cluster bounds were computed for
+	float							BoundsFovY;
+	float							BoundsAspectRatio;
+	float							BoundsNearZ;
+	float							BoundsFarZ;
+	bool							bClusterBoundsDirty;
+
+	// Depth range of each slice, and x and y ranges of tiles in each slice
+	std::vector<RAxisExtent>		SliceExtents;
+	std::vector<RAxisExtent>		TileExtentsX;
+	std::vector<RAxisExtent>		TileExtentsY;
+	std::vector<RAabb>				ClusterBounds;
+
+	std::vector<UINT>				ClusterLightOffsets;
+	std::vector<UINT>				ClusterLightIndices;
+
+	// Scratch memory kept between builds
+	std::vector<RLightSphere>		ViewSpaceLights;
+	std::vector<std::pair<UINT, UINT>>	LightClusterPairs;
+	std::vector<UINT>				ClusterWriteOffsets;
+	std::vector<UINT>				LightGatherStamps;
+	UINT							CurrentGatherStamp;
+};
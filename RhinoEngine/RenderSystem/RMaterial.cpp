@@ -7,11 +7,21 @@
 #include "RMaterial.h"
 
 #include "tinyxml2/tinyxml2.h"
+#include "Core/RLog.h"
 #include "Core/RSerializer.h"
+#include "Core/RVirtualFileSystem.h"
 #include "Resource/RResourceManager.h"
 #include "RShaderManager.h"
+#include "RRenderSystem.h"
 #include "RTexture.h"
 
+#include <atomic>
+
+namespace
+{
+	// Materials are created on loader threads
+	std::atomic<UINT> NextMaterialSortId(0);
+}
 
 const char* RMaterial::KeyName_BlendMode = "BlendMode";
 const char* RMaterial::KeyName_UVTiling = "UVTiling";
@@ -51,6 +61,9 @@ std::string RTextureSlotData::GetTextureAssetPath() const
 RMaterial::RMaterial(const std::string& Path)
 	: RResourceBase(Path)
 	, Shader(nullptr)
+	, SortId(NextMaterialSortId++)
+	, Textures()
+	, TextureSlotMask(0)
 	, BlendMode(BlendState::Opaque)
 	, UVTiling(1.0f)
 	, bDoubleSided(false)
@@ -59,6 +72,36 @@ RMaterial::RMaterial(const std::string& Path)
 
 }
 
+void RMaterial::Reset()
+{
+	// Shaders are owned by the shader manager. Keep the shader so stale users still render something.
+	std::fill(std::begin(Textures), std::end(Textures), nullptr);
+	TextureSlotMask = 0;
+}
+
+size_t RMaterial::GetMemorySize() const
+{
+	return sizeof(RMaterial);
+}
+
+std::vector<RResourceBase*> RMaterial::EnumerateReferencedResources() const
+{
+	std::vector<RResourceBase*> ReferencedResources;
+
+	for (RTexture* Texture : Textures)
+	{
+		if (Texture != nullptr)
+		{
+			if (find(ReferencedResources.begin(), ReferencedResources.end(), Texture) == ReferencedResources.end())
+			{
+				ReferencedResources.push_back(Texture);
+			}
+		}
+	}
+
+	return ReferencedResources;
+}
+
 std::vector<std::string> RMaterial::GetSupportedExtensions()
 {
 	static const std::vector<std::string> MaterialExts{ ".material" };
@@ -93,7 +136,18 @@ void RMaterial::Serialize(RSerializer& serializer)
 		serializer.SerializeData(shaderName);
 	}
 
+	// Slots are serialized as a list of slots which are set
+	std::vector<RTextureSlotData> TextureSlots = GetTextureSlots();
 	serializer.SerializeVector(TextureSlots, &RSerializer::SerializeObject);
+
+	if (serializer.IsReading())
+	{
+		for (const RTextureSlotData& SlotData : TextureSlots)
+		{
+			AssignTextureSlot(SlotData.SlotId, SlotData.Texture);
+		}
+	}
+
 	serializer.SerializeData(BlendMode);
 }
 
@@ -102,7 +156,8 @@ std::vector<std::string> RMaterial::LoadNameListFromXml(const std::string& Filen
 	std::vector<std::string> MaterialList;
 
 	std::unique_ptr<tinyxml2::XMLDocument> XmlDoc(new tinyxml2::XMLDocument());
-	if (XmlDoc->LoadFile(Filename.c_str()) == tinyxml2::XML_SUCCESS)
+	RFileData FileData = GVirtualFileSystem.ReadFile(Filename);
+	if (FileData.IsValid() && XmlDoc->Parse(FileData.GetData(), FileData.GetSize()) == tinyxml2::XML_SUCCESS)
 	{
 		tinyxml2::XMLElement* root = XmlDoc->RootElement();
 		tinyxml2::XMLElement* elem = root->FirstChildElement("MeshElement");
@@ -123,18 +178,40 @@ std::vector<std::string> RMaterial::LoadNameListFromXml(const std::string& Filen
 	return MaterialList;
 }
 
-void RMaterial::SetTextureSlot(int Slot, RTexture* Texture)
+std::vector<RTextureSlotData> RMaterial::GetTextureSlots() const
 {
-	for (int i = 0; i < (int)TextureSlots.size(); i++)
+	std::vector<RTextureSlotData> TextureSlots;
+
+	for (int SlotId = 0; SlotId < MaxTextureSlots; SlotId++)
 	{
-		if (TextureSlots[i].SlotId == Slot)
+		if (HasTextureSlot(SlotId))
 		{
-			TextureSlots[i].Texture = Texture;
-			return;
+			TextureSlots.push_back(RTextureSlotData(Textures[SlotId], SlotId));
 		}
 	}
 
-	TextureSlots.push_back(RTextureSlotData(Texture, Slot));
+	return TextureSlots;
+}
+
+void RMaterial::SetTextureSlot(int Slot, RTexture* Texture)
+{
+	if (AssignTextureSlot(Slot, Texture))
+	{
+		UpdateReferencedResources();
+	}
+}
+
+bool RMaterial::AssignTextureSlot(int SlotId, RTexture* Texture)
+{
+	if (SlotId < 0 || SlotId >= MaxTextureSlots)
+	{
+		RLogWarning("Material \'%s\': texture slot %d is out of range, materials have %d slots.\n", GetAssetPath().c_str(), SlotId, MaxTextureSlots);
+		return false;
+	}
+
+	Textures[SlotId] = Texture;
+	TextureSlotMask |= 1u << SlotId;
+	return true;
 }
 
 RMaterial* RMaterial::GetDefault()
@@ -142,10 +219,12 @@ RMaterial* RMaterial::GetDefault()
 	static RMaterial* DefaultMaterial = nullptr;
 	if (DefaultMaterial == nullptr)
 	{
-		RShader* DefaultShader = GShaderManager.GetDefaultShader();
+		// Without a renderer (e.g. in offline cooking tools) no shader is loaded, and the default material
+		// is only referenced by its asset path
+		RShader* DefaultShader = GRenderer.HasInitialized() ? GShaderManager.GetDefaultShader() : nullptr;
 
 		// Make sure we're not getting the default material before the default shader is loaded
-		assert(DefaultShader);
+		assert(DefaultShader || !GRenderer.HasInitialized());
 
 		DefaultMaterial = RResourceManager::Instance().CreateNewResource<RMaterial>("DefaultMaterial");
 		DefaultMaterial->SetAssetPath("DefaultMaterial");
@@ -177,7 +256,8 @@ RMaterial* RMaterial::GetDepthOnly()
 bool RMaterial::LoadResourceImpl()
 {
 	std::unique_ptr<tinyxml2::XMLDocument> XmlDoc = std::make_unique<tinyxml2::XMLDocument>();
-	if (XmlDoc->LoadFile(GetFileSystemPath().c_str()) == tinyxml2::XML_SUCCESS)
+	RFileData FileData = GVirtualFileSystem.ReadFile(GetFileSystemPath());
+	if (FileData.IsValid() && XmlDoc->Parse(FileData.GetData(), FileData.GetSize()) == tinyxml2::XML_SUCCESS)
 	{
 		// <Material Shader="MyShaderName">
 		tinyxml2::XMLElement* RootElem = XmlDoc->RootElement();
@@ -224,7 +304,7 @@ bool RMaterial::LoadResourceImpl()
 					}
 				}
 
-				TextureSlots.push_back(RTextureSlotData(texture, SlotId));
+				AssignTextureSlot(SlotId, texture);
 			}
 			TextureElem = TextureElem->NextSiblingElement();
 		}
@@ -267,16 +347,8 @@ bool RMaterial::SaveResourceImpl()
 		XmlElemMaterial->SetAttribute("DoubleSided", true);
 	}
 
-	struct TextureSlotSorter
-	{
-		bool operator() (const RTextureSlotData& Lhs, const RTextureSlotData& Rhs)
-		{
-			return Lhs.SlotId < Rhs.SlotId;
-		}
-	};
-
-	// Sort texture slots before saving
-	std::sort(TextureSlots.begin(), TextureSlots.end(), TextureSlotSorter());
+	// Texture slots are saved in order of slot id
+	const std::vector<RTextureSlotData> TextureSlots = GetTextureSlots();
 
 	for (int i = 0; i < (int)TextureSlots.size(); i++)
 	{
@@ -37,8 +37,15 @@ class RMaterial : public RResourceBase
 {
 	DECLARE_RUNTIME_TYPE(RMaterial, RResourceBase)
 public:
+	/// Number of texture slots of a material. Slot ids index textures directly.
+	static const int MaxTextureSlots = 8;
+
 	RMaterial(const std::string& Path);
 
+	virtual void Reset() override;
+
+	virtual size_t GetMemorySize() const override;
+
 	/// Required by RResourceManager::RegisterResourceType
 	static std::vector<std::string> GetSupportedExtensions();
 
@@ -48,8 +55,12 @@ public:
 	void SetShader(RShader* InShader);
 	RShader* GetShader() const;
 
-	const std::vector<RTextureSlotData>& GetTextureSlots() const;
-	std::vector<RTextureSlotData>& GetTextureSlots();
+	/// Id unique to this material, for ordering draws by material
+	UINT GetSortId() const { return SortId; }
+
+	/// Get all slots which are set, in order of slot id. Slots can be set without a texture.
+	std::vector<RTextureSlotData> GetTextureSlots() const;
+	bool HasTextureSlot(int SlotId) const;
 
 	void SetTextureSlot(int Slot, RTexture* Texture);
 	RTexture* GetTextureBySlot(int SlotId) const;
@@ -80,12 +91,22 @@ public:
 	static std::vector<std::string> LoadNameListFromXml(const std::string& Filename);
 
 protected:
+	virtual std::vector<RResourceBase*> EnumerateReferencedResources() const override;
+
 	virtual bool LoadResourceImpl() override;
 	virtual bool SaveResourceImpl() override;
 
 private:
+	/// Set a slot without updating referenced resources. Returns false if the slot id is out of range.
+	bool AssignTextureSlot(int SlotId, RTexture* Texture);
+
 	RShader* Shader;
-	std::vector<RTextureSlotData> TextureSlots;
+	UINT SortId;
+
+	// Textures indexed by slot id, and a bit for each slot which is set
+	RTexture* Textures[MaxTextureSlots];
+	UINT TextureSlotMask;
+
 	BlendState BlendMode;
 	bool bDoubleSided;
 	float UVTiling;
@@ -107,38 +128,23 @@ FORCEINLINE RShader* RMaterial::GetShader() const
 	return Shader;
 }
 
-FORCEINLINE const std::vector<RTextureSlotData>& RMaterial::GetTextureSlots() const
-{
-	return TextureSlots;
-}
-
-FORCEINLINE std::vector<RTextureSlotData>& RMaterial::GetTextureSlots()
+FORCEINLINE bool RMaterial::HasTextureSlot(int SlotId) const
 {
-	return TextureSlots;
+	return (UINT)SlotId < (UINT)MaxTextureSlots && (TextureSlotMask & (1u << SlotId)) != 0;
 }
 
 FORCEINLINE RTexture* RMaterial::GetTextureBySlot(int SlotId) const
 {
-	for (int i = 0; i < TextureSlots.size(); i++)
-	{
-		if (TextureSlots[i].SlotId == SlotId)
-		{
-			return TextureSlots[i].Texture;
-		}
-	}
-
-	return nullptr;
+	return (UINT)SlotId < (UINT)MaxTextureSlots ? Textures[SlotId] : nullptr;
 }
 
 FORCEINLINE void RMaterial::RemoveTextureSlot(int SlotId)
 {
-	for (int i = 0; i < TextureSlots.size(); i++)
+	if (HasTextureSlot(SlotId))
 	{
-		if (TextureSlots[i].SlotId == SlotId)
-		{
-			TextureSlots.erase(TextureSlots.begin() + i);
-			break;
-		}
+		Textures[SlotId] = nullptr;
+		TextureSlotMask &= ~(1u << SlotId);
+		UpdateReferencedResources();
 	}
 }
 
@@ -12,6 +12,7 @@
 #include "RTexture.h"
 
 #include "Core/RLog.h"
+#include "Core/RVirtualFileSystem.h"
 
 #include "tinyxml2/tinyxml2.h"
 #include "D3DUtil.h"
@@ -19,9 +20,71 @@
 // Whether to export .fbx as .rmesh after loading
 #define EXPORT_FBX_AS_BINARY_MESH 1
 
+#include <mutex>
+
+namespace
+{
+	// Latest versions of binary mesh chunks. A chunk with a newer version can't be read and the mesh is imported again.
+	const UINT32 MeshElementsChunkVersion = 1;
+	const UINT32 MaterialsChunkVersion = 1;
+	const UINT32 SkeletonChunkVersion = 1;
+	const UINT32 AnimationChunkVersion = 1;
+	const UINT32 TriangleBVHChunkVersion = 1;
+
+	const int NumMeshChunkTypes = 5;
+}
+
+const char* RMesh::BinaryMeshFileMagic = "RMCH";
+
+/// Location of chunks not loaded with the rest of a binary mesh
+struct RMesh::RDeferredChunks
+{
+	std::mutex			Mutex;
+	std::string			BinaryMeshPath;
+
+	// Size of the binary mesh when the mesh was loaded
+	size_t				FileSize = 0;
+
+	RChunkedFileEntry	SkeletonChunk;
+	RChunkedFileEntry	AnimationChunk;
+
+	bool				bHasTriangleBVHChunk = false;
+	RChunkedFileEntry	TriangleBVHChunk;
+
+	/// Open the binary mesh and move to a chunk. Fails if the file has been rewritten since the mesh was loaded
+	/// (e.g. cooked again), as the chunk locations cached then may be stale.
+	bool OpenChunk(RSerializer& Serializer, const RChunkedFileEntry& Chunk) const;
+};
+
+bool RMesh::RDeferredChunks::OpenChunk(RSerializer& Serializer, const RChunkedFileEntry& Chunk) const
+{
+	Serializer.Open(BinaryMeshPath, ESerializeMode::Read);
+	if (!Serializer.IsOpen())
+	{
+		return false;
+	}
+
+	RChunkedFileReader ChunkReader;
+	const RChunkedFileEntry* CurrentChunk = nullptr;
+	if (Serializer.GetReadSize() == FileSize && ChunkReader.ReadHeader(Serializer, BinaryMeshFileMagic))
+	{
+		CurrentChunk = ChunkReader.FindChunk(Chunk.Id);
+	}
+
+	if (!CurrentChunk || memcmp(CurrentChunk, &Chunk, sizeof(Chunk)) != 0)
+	{
+		RLogWarning("Binary mesh %s has changed since it was loaded. Reload the mesh to read it again.\n", BinaryMeshPath.c_str());
+		return false;
+	}
+
+	return RChunkedFileReader::SeekToChunk(Serializer, Chunk);
+}
+
 RMesh::RMesh(const std::string& Path)
 	: RResourceBase(Path),
-	  m_Animation(nullptr)
+	  m_Animation(nullptr),
+	  m_bSkeletonLoaded(true),
+	  m_bAnimationLoaded(true)
 {
 }
 
@@ -56,6 +119,56 @@ RMesh::~RMesh()
 	SAFE_DELETE(m_Animation);
 }
 
+void RMesh::Reset()
+{
+	m_DeferredChunks.reset();
+	m_bSkeletonLoaded = true;
+	m_bAnimationLoaded = true;
+
+	m_MeshElements.clear();
+	m_Materials.clear();
+	m_Aabb = RAabb::Default;
+
+	{
+		std::unique_lock<std::mutex> Lock(m_TriangleBVHMutex);
+		m_TriangleBVH.reset();
+	}
+
+	SAFE_DELETE(m_Animation);
+	m_BoneInitInvMatrices.clear();
+	m_BoneIdToName.clear();
+	MeshSkeletalData = SkeletalData();
+	m_AnimationNodeCache.clear();
+}
+
+size_t RMesh::GetMemorySize() const
+{
+	size_t Size = sizeof(RMesh) + m_Materials.capacity() * sizeof(RMaterial*);
+
+	for (const auto& MeshElement : m_MeshElements)
+	{
+		Size += MeshElement->GetMemorySize();
+	}
+
+	if (m_Animation)
+	{
+		Size += m_Animation->GetMemorySize();
+	}
+
+	if (m_TriangleBVH)
+	{
+		Size += m_TriangleBVH->GetMemorySize();
+	}
+
+	Size += m_BoneInitInvMatrices.capacity() * sizeof(RMatrix4);
+	for (const std::string& BoneName : m_BoneIdToName)
+	{
+		Size += sizeof(std::string) + BoneName.capacity();
+	}
+
+	return Size;
+}
+
 std::vector<std::string> RMesh::GetSupportedExtensions()
 {
 	static const std::vector<std::string> MeshExts{ ".fbx"/*, ".rmesh"*/ };
@@ -67,6 +180,30 @@ void RMesh::Serialize(RSerializer& serializer)
 	if (!serializer.EnsureHeader("RMSH", 4))
 		return;
 
+	SerializeMeshElements(serializer);
+	SerializeMaterials(serializer);
+	SerializeAnimation(serializer);
+	SerializeSkeleton(serializer);
+
+	if (serializer.IsReading())
+	{
+		UpdateAabb();
+	}
+}
+
+bool RMesh::HasDeferredChunks() const
+{
+	return !m_bSkeletonLoaded.load() || !m_bAnimationLoaded.load();
+}
+
+void RMesh::LoadDeferredChunks() const
+{
+	EnsureSkeletonLoaded();
+	EnsureAnimationLoaded();
+}
+
+void RMesh::SerializeMeshElements(RSerializer& serializer)
+{
 	if (serializer.IsReading())
 	{
 		UINT NumElements = 0;
@@ -87,7 +224,10 @@ void RMesh::Serialize(RSerializer& serializer)
 			serializer.SerializeObject(*m_MeshElements[i]);
 		}
 	}
+}
 
+void RMesh::SerializeMaterials(RSerializer& serializer)
+{
 	if (serializer.IsReading())
 	{
 		size_t NumMaterials = 0;
@@ -133,22 +273,127 @@ void RMesh::Serialize(RSerializer& serializer)
 			serializer.SerializeData(AssetPath);
 		}
 	}
+}
 
+void RMesh::SerializeSkeleton(RSerializer& serializer)
+{
+	serializer.SerializeVector(m_BoneInitInvMatrices);
+	serializer.SerializeVector(m_BoneIdToName, &RSerializer::SerializeData);
+	serializer.SerializeObject(MeshSkeletalData);
+}
+
+void RMesh::SerializeAnimation(RSerializer& serializer)
+{
 	serializer.SerializeObjectPtr(&m_Animation);
 	if (serializer.IsReading() && m_Animation)
 	{
 		m_Animation->SetName(GetAssetPath());
 		m_Animation->InitFromMetaData(GetMetaData());
 	}
+}
 
-	serializer.SerializeVector(m_BoneInitInvMatrices);
-	serializer.SerializeVector(m_BoneIdToName, &RSerializer::SerializeData);
-	serializer.SerializeObject(MeshSkeletalData);
+bool RMesh::LoadChunkedMesh(RSerializer& Serializer, const RChunkedFileReader& ChunkReader, const std::string& BinaryMeshPath)
+{
+	const RChunkedFileEntry* ElementsChunk = ChunkReader.FindChunk(MCI_MeshElements);
+	const RChunkedFileEntry* MaterialsChunk = ChunkReader.FindChunk(MCI_Materials);
+	const RChunkedFileEntry* SkeletonChunk = ChunkReader.FindChunk(MCI_Skeleton);
+	const RChunkedFileEntry* AnimationChunk = ChunkReader.FindChunk(MCI_Animation);
+	const RChunkedFileEntry* TriangleBVHChunk = ChunkReader.FindChunk(MCI_TriangleBVH);
 
-	if (serializer.IsReading())
+	// Chunks written by a newer version of the engine can't be read
+	if (!ElementsChunk || ElementsChunk->Version > MeshElementsChunkVersion ||
+		(MaterialsChunk && MaterialsChunk->Version > MaterialsChunkVersion) ||
+		(SkeletonChunk && SkeletonChunk->Version > SkeletonChunkVersion) ||
+		(AnimationChunk && AnimationChunk->Version > AnimationChunkVersion))
 	{
-		UpdateAabb();
+		return false;
+	}
+
+	// A newer triangle BVH is built again instead
+	if (TriangleBVHChunk && TriangleBVHChunk->Version > TriangleBVHChunkVersion)
+	{
+		TriangleBVHChunk = nullptr;
+	}
+
+	// Only data needed for rendering is read now
+	RChunkedFileReader::SeekToChunk(Serializer, *ElementsChunk);
+	SerializeMeshElements(Serializer);
+
+	if (MaterialsChunk)
+	{
+		RChunkedFileReader::SeekToChunk(Serializer, *MaterialsChunk);
+		SerializeMaterials(Serializer);
+	}
+
+	UpdateAabb();
+
+	if (SkeletonChunk || AnimationChunk || TriangleBVHChunk)
+	{
+		m_DeferredChunks.reset(new RDeferredChunks);
+		m_DeferredChunks->BinaryMeshPath = BinaryMeshPath;
+		m_DeferredChunks->FileSize = Serializer.GetReadSize();
+
+		if (TriangleBVHChunk)
+		{
+			m_DeferredChunks->TriangleBVHChunk = *TriangleBVHChunk;
+			m_DeferredChunks->bHasTriangleBVHChunk = true;
+		}
+
+		if (SkeletonChunk)
+		{
+			m_DeferredChunks->SkeletonChunk = *SkeletonChunk;
+			m_bSkeletonLoaded = false;
+		}
+
+		if (AnimationChunk)
+		{
+			m_DeferredChunks->AnimationChunk = *AnimationChunk;
+			m_bAnimationLoaded = false;
+		}
 	}
+
+	return !Serializer.HasError();
+}
+
+void RMesh::LoadDeferredChunk(EMeshChunkId ChunkId) const
+{
+	assert(m_DeferredChunks);
+	std::unique_lock<std::mutex> Lock(m_DeferredChunks->Mutex);
+
+	std::atomic<bool>& bLoaded = (ChunkId == MCI_Skeleton) ? m_bSkeletonLoaded : m_bAnimationLoaded;
+	if (bLoaded.load())
+	{
+		return;
+	}
+
+	// Deferred data is filled in once, guarded by the mutex and published by the loaded flag
+	RMesh* MutableThis = const_cast<RMesh*>(this);
+
+	const RChunkedFileEntry& Chunk = (ChunkId == MCI_Skeleton) ? m_DeferredChunks->SkeletonChunk : m_DeferredChunks->AnimationChunk;
+
+	RSerializer serializer;
+	const bool bOpened = m_DeferredChunks->OpenChunk(serializer, Chunk);
+	if (bOpened)
+	{
+		if (ChunkId == MCI_Skeleton)
+		{
+			MutableThis->SerializeSkeleton(serializer);
+		}
+		else
+		{
+			MutableThis->SerializeAnimation(serializer);
+		}
+	}
+
+	if (!bOpened || serializer.HasError())
+	{
+		RLogError("Failed to load %s of mesh %s from %s.\n", ChunkId == MCI_Skeleton ? "skeleton" : "animation",
+			GetAssetPath().c_str(), m_DeferredChunks->BinaryMeshPath.c_str());
+	}
+
+	bLoaded.store(true, std::memory_order_release);
+
+	MutableThis->UpdateLoadedMemorySize();
 }
 
 bool RMesh::LoadResourceImpl()
@@ -185,12 +430,14 @@ void RMesh::SetMaterialSlot(int SlotId, RMaterial* Material)
 	}
 
 	m_Materials[SlotId] = Material;
+	UpdateReferencedResources();
 }
 
 void RMesh::SetMaterials(const std::vector<RMaterial*> NewMaterials)
 {
 	//assert(NewMaterials.size() > 0);
 	m_Materials = NewMaterials;
+	UpdateReferencedResources();
 }
 
 void RMesh::SaveMaterialsToDiskAsDefaults()
@@ -229,11 +476,13 @@ const RAabb& RMesh::GetMeshElementAabb(int index) const
 
 void RMesh::SetAnimation(RAnimation* anim)
 {
+	EnsureAnimationLoaded();
 	m_Animation = anim;
 }
 
 RAnimation* RMesh::GetAnimation() const
 {
+	EnsureAnimationLoaded();
 	return m_Animation;
 }
 
@@ -252,6 +501,8 @@ bool RMesh::HasAnySkinnedMeshElements() const
 
 void RMesh::SetSkeletalData(const SkeletalData& InMeshSkeletalData)
 {
+	EnsureSkeletonLoaded();
+
 	if (MeshSkeletalData.SkeletalBones.size() == 0)
 	{
 		MeshSkeletalData = InMeshSkeletalData;
@@ -264,26 +515,32 @@ void RMesh::SetSkeletalData(const SkeletalData& InMeshSkeletalData)
 
 const SkeletalData& RMesh::GetSkeletalData() const
 {
+	EnsureSkeletonLoaded();
 	return MeshSkeletalData;
 }
 
 void RMesh::SetBoneInitInvMatrices(std::vector<RMatrix4>& bonePoses)
 {
+	EnsureSkeletonLoaded();
 	m_BoneInitInvMatrices = move(bonePoses);
 }
 
 void RMesh::SetBoneNameList(const std::vector<std::string>& boneNameList)
 {
+	EnsureSkeletonLoaded();
 	m_BoneIdToName = boneNameList;
 }
 
 const std::string& RMesh::GetBoneName(int BoneId) const
 {
+	EnsureSkeletonLoaded();
 	return m_BoneIdToName[BoneId];
 }
 
 int RMesh::FindBoneByName(const std::string& BoneName) const
 {
+	EnsureSkeletonLoaded();
+
 	auto Iter = std::find(m_BoneIdToName.begin(), m_BoneIdToName.end(), BoneName);
 	if (Iter == m_BoneIdToName.end())
 	{
@@ -295,6 +552,7 @@ int RMesh::FindBoneByName(const std::string& BoneName) const
 
 int RMesh::GetBoneCount() const
 {
+	EnsureSkeletonLoaded();
 	return (int)m_BoneIdToName.size();
 }
 
@@ -311,6 +569,8 @@ void RMesh::CacheAnimation(RAnimation* Animation)
 		// The resource has not finished loading, skip caching the animation
 		return;
 	}
+
+	EnsureSkeletonLoaded();
 		
 	if (!m_BoneIdToName.size())
 	{
@@ -361,6 +621,8 @@ bool RMesh::HasCachedAnimation(RAnimation* anim) const
 
 int RMesh::ConvertBoneIndex_MeshToAnimation(const RAnimation* Animation, int MeshBoneId) const
 {
+	EnsureSkeletonLoaded();
+
 	if (Animation && m_BoneIdToName.size())
 	{
 		auto Iter = m_AnimationNodeCache.find(Animation);
@@ -375,6 +637,8 @@ int RMesh::ConvertBoneIndex_MeshToAnimation(const RAnimation* Animation, int Mes
 
 int RMesh::ConvertBoneIndex_AnimationToMesh(const RAnimation* Animation, int AnimBoneId) const
 {
+	EnsureSkeletonLoaded();
+
 	if (Animation && m_BoneIdToName.size())
 	{
 		auto Iter = m_AnimationNodeCache.find(Animation);
@@ -389,6 +653,8 @@ int RMesh::ConvertBoneIndex_AnimationToMesh(const RAnimation* Animation, int Ani
 
 const RBoneIdMap* RMesh::GetBoneIdMapForAnimation(const RAnimation* Animation) const
 {
+	EnsureSkeletonLoaded();
+
 	if (Animation && m_BoneIdToName.size())
 	{
 		auto Iter = m_AnimationNodeCache.find(Animation);
@@ -419,6 +685,16 @@ std::vector<RResourceBase*> RMesh::EnumerateReferencedResources() const
 
 	for (const auto& Material : m_Materials)
 	{
+		if (Material == nullptr)
+		{
+			continue;
+		}
+
+		if (find(ReferencedResources.begin(), ReferencedResources.end(), Material) == ReferencedResources.end())
+		{
+			ReferencedResources.push_back(Material);
+		}
+
 		for (const RTextureSlotData& SlotData : Material->GetTextureSlots())
 		{
 			RTexture* Texture = SlotData.Texture;
@@ -457,22 +733,26 @@ bool RMesh::TryLoadAsRmesh()
 	std::vector<RMeshElement> meshElements;
 	const std::string BinaryMeshPath = RFileUtil::ReplaceExtension(GetFileSystemPath(), "rmesh");
 
-	// Binary mesh file doesn't exist, load fbx instead
-	if (!RFileUtil::CheckPathExists(BinaryMeshPath))
+	// Binary meshes in asset archives were cooked from up-to-date .fbx when the archive was packed
+	if (!GVirtualFileSystem.IsInArchive(BinaryMeshPath))
 	{
-		return false;
-	}
+		// Binary mesh file doesn't exist, load fbx instead
+		if (!RFileUtil::CheckPathExists(BinaryMeshPath))
+		{
+			return false;
+		}
 
-	// Compare timestamps of .fbx and .rmesh
-	ETimestampComparison Result = RFileUtil::CompareFileTimestamp(GetFileSystemPath(), BinaryMeshPath);
+		// Compare timestamps of .fbx and .rmesh
+		ETimestampComparison Result = RFileUtil::CompareFileTimestamp(GetFileSystemPath(), BinaryMeshPath);
 
-	// Both files should be valid
-	assert(Result != ETimestampComparison::InvalidFile);
+		// Both files should be valid
+		assert(Result != ETimestampComparison::InvalidFile);
 
-	// If .fbx is newer than binary mesh, stop here. We will load the fbx and regenerate the binary mesh.
-	if (Result == ETimestampComparison::EarlierSecond)
-	{
-		return false;
+		// If .fbx is newer than binary mesh, stop here. We will load the fbx and regenerate the binary mesh.
+		if (Result == ETimestampComparison::EarlierSecond)
+		{
+			return false;
+		}
 	}
 
 	// The binary mesh is up-to-date, load it now
@@ -480,7 +760,29 @@ bool RMesh::TryLoadAsRmesh()
 	serializer.Open(BinaryMeshPath, ESerializeMode::Read);
 	if (!serializer.IsOpen())
 		return false;
-	Serialize(serializer);
+
+	bool bLoaded = false;
+	RChunkedFileReader ChunkReader;
+	if (ChunkReader.ReadHeader(serializer, BinaryMeshFileMagic))
+	{
+		// Skeleton and animation chunks are loaded on first use
+		bLoaded = LoadChunkedMesh(serializer, ChunkReader, BinaryMeshPath);
+	}
+	else if (serializer.EnsureHeader("RMSH", 4) && serializer.Seek(0))
+	{
+		// Binary meshes saved before chunks were introduced are read as a whole
+		Serialize(serializer);
+		bLoaded = !serializer.HasError();
+	}
+
+	// Truncated, corrupted or newer binary mesh, import the fbx again
+	if (!bLoaded)
+	{
+		RLogWarning("Binary mesh %s can't be read, reimporting from source.\n", BinaryMeshPath.c_str());
+		Reset();
+		return false;
+	}
+
 	serializer.Close();
 
 	//RAnimation* animation = new RAnimation();
@@ -519,16 +821,116 @@ bool RMesh::TryLoadAsRmesh()
 	return true;
 }
 
-void RMesh::SaveBinaryMesh()
+bool RMesh::CookBinaryMesh(bool bCacheTriangleBVH /*= false*/)
+{
+	RFbxMeshLoader FbxMeshLoader;
+	FbxMeshLoader.SetApplyMetaData(false);
+
+	if (!FbxMeshLoader.LoadDataForMeshResource(this, GetFileSystemPath()))
+	{
+		return false;
+	}
+
+	// SaveBinaryMesh writes the triangle BVH if it exists
+	if (bCacheTriangleBVH)
+	{
+		GetTriangleBVH();
+	}
+
+	return SaveBinaryMesh();
+}
+
+const RMeshBVH& RMesh::GetTriangleBVH() const
 {
+	std::unique_lock<std::mutex> Lock(m_TriangleBVHMutex);
+
+	if (!m_TriangleBVH)
+	{
+		m_TriangleBVH.reset(new RMeshBVH());
+
+		bool bLoaded = false;
+		if (m_DeferredChunks && m_DeferredChunks->bHasTriangleBVHChunk)
+		{
+			RSerializer serializer;
+			if (m_DeferredChunks->OpenChunk(serializer, m_DeferredChunks->TriangleBVHChunk))
+			{
+				m_TriangleBVH->Serialize(serializer);
+				bLoaded = !serializer.HasError();
+			}
+		}
+
+		if (!bLoaded)
+		{
+			m_TriangleBVH->Build(m_MeshElements);
+		}
+
+		const_cast<RMesh*>(this)->UpdateLoadedMemorySize();
+	}
+
+	return *m_TriangleBVH;
+}
+
+bool RMesh::Raycast(const RVec3& Origin, const RVec3& Direction, float MaxDistance, RMeshRaycastHit& OutHit) const
+{
+	if (!IsLoaded())
+	{
+		return false;
+	}
+
+	return GetTriangleBVH().Raycast(Origin, Direction, MaxDistance, OutHit);
+}
+
+bool RMesh::SaveBinaryMesh()
+{
+	// Deferred chunks are rewritten, so they must be in memory
+	LoadDeferredChunks();
+
 	std::string rmeshName = RFileUtil::ReplaceExtension(GetFileSystemPath(), "rmesh");
 	RSerializer serializer;
 	serializer.Open(rmeshName, ESerializeMode::Write);
-	if (serializer.IsOpen())
+	if (!serializer.IsOpen())
 	{
-		Serialize(serializer);
-		serializer.Close();
+		RLogError("Failed to save binary mesh %s.\n", rmeshName.c_str());
+		return false;
+	}
+
+	// Render data goes first, so it is read from the beginning of the file
+	RChunkedFileWriter ChunkWriter(serializer);
+	ChunkWriter.Begin(BinaryMeshFileMagic, NumMeshChunkTypes);
+
+	ChunkWriter.BeginChunk(MCI_MeshElements, MeshElementsChunkVersion);
+	SerializeMeshElements(serializer);
+	ChunkWriter.EndChunk();
+
+	ChunkWriter.BeginChunk(MCI_Materials, MaterialsChunkVersion);
+	SerializeMaterials(serializer);
+	ChunkWriter.EndChunk();
+
+	if (m_BoneIdToName.size() > 0 || MeshSkeletalData.SkeletalBones.size() > 0)
+	{
+		ChunkWriter.BeginChunk(MCI_Skeleton, SkeletonChunkVersion);
+		SerializeSkeleton(serializer);
+		ChunkWriter.EndChunk();
 	}
+
+	if (m_Animation)
+	{
+		ChunkWriter.BeginChunk(MCI_Animation, AnimationChunkVersion);
+		SerializeAnimation(serializer);
+		ChunkWriter.EndChunk();
+	}
+
+	if (m_TriangleBVH)
+	{
+		ChunkWriter.BeginChunk(MCI_TriangleBVH, TriangleBVHChunkVersion);
+		m_TriangleBVH->Serialize(serializer);
+		ChunkWriter.EndChunk();
+	}
+
+	ChunkWriter.End();
+	serializer.Close();
+
+	return true;
 }
 
 void SerializeXmlMaterials_Save(const std::vector<RMaterial*>& Materials, tinyxml2::XMLDocument* XmlDoc, tinyxml2::XMLElement* XmlElemMaterial)
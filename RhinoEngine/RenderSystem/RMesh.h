@@ -11,6 +11,11 @@
 
 #include "RMaterial.h"
 #include "RMeshElement.h"
+#include "RMeshBVH.h"
+#include "Core/RChunkedFile.h"
+
+#include <atomic>
+#include <mutex>
 
 class RAnimation;
 
@@ -135,6 +140,17 @@ struct SkeletalData
 };
 
 
+// Chunks of binary mesh files (.rmesh)
+enum EMeshChunkId : UINT32
+{
+	MCI_MeshElements	= MakeChunkId('E', 'L', 'E', 'M'),		// Vertex and index data of mesh elements
+	MCI_Materials		= MakeChunkId('M', 'T', 'L', 'S'),		// Asset paths of materials
+	MCI_Skeleton		= MakeChunkId('S', 'K', 'E', 'L'),		// Bone matrices, bone names and hierarchy. Loaded on first use.
+	MCI_Animation		= MakeChunkId('A', 'N', 'I', 'M'),		// Embedded animation. Loaded on first use.
+	MCI_TriangleBVH		= MakeChunkId('T', 'B', 'V', 'H'),		// Triangle BVH for raycasts, saved by offline cooking. Loaded on first use.
+};
+
+
 // A two-way bone id map (mesh bone id <-> animation bone id)
 struct RBoneIdMap
 {
@@ -152,11 +168,37 @@ public:
 	//RMesh(const std::string& Path, const RMeshElement* meshElements, int numElement, const RMeshMaterialData* materials, int numMaterial);
 	~RMesh();
 
+	virtual void Reset() override;
+
+	virtual size_t GetMemorySize() const override;
+
 	/// Required by RResourceManager::RegisterResourceType
 	static std::vector<std::string> GetSupportedExtensions();
 
+	/// Serialize all mesh data as a single stream. Used by binary meshes saved before chunks were introduced.
 	void Serialize(RSerializer& serializer);
 
+	/// Check if skeleton or animation chunks of the binary mesh haven't been loaded yet
+	bool HasDeferredChunks() const;
+
+	/// Load skeleton and animation chunks deferred when the mesh was loaded
+	void LoadDeferredChunks() const;
+
+	/// Magic of chunked binary mesh files
+	static const char* BinaryMeshFileMagic;
+
+	/// Import the mesh from its fbx file and save it as a binary mesh (.rmesh), without loading the
+	/// resource. Used by offline cooking, so metadata is applied later when the binary mesh is loaded.
+	/// If bCacheTriangleBVH is true, the triangle BVH is built and saved with the mesh.
+	bool CookBinaryMesh(bool bCacheTriangleBVH = false);
+
+	/// Get the BVH of triangles in all mesh elements, in bind pose for skinned meshes. Loaded from the
+	/// binary mesh if it was cached there, otherwise built on first use.
+	const RMeshBVH& GetTriangleBVH() const;
+
+	/// Find the closest triangle hit by a ray in mesh space
+	bool Raycast(const RVec3& Origin, const RVec3& Direction, float MaxDistance, RMeshRaycastHit& OutHit) const;
+
 	const RMaterial* GetMaterial(int index) const;
 	const std::vector<RMaterial*>& GetMaterials() const;
 
@@ -185,7 +227,7 @@ public:
 	const SkeletalData& GetSkeletalData() const;
 
 	void SetBoneInitInvMatrices(std::vector<RMatrix4>& bonePoses);
-	const RMatrix4& GetBoneInitInvMatrices(int index) const { return m_BoneInitInvMatrices[index]; }
+	const RMatrix4& GetBoneInitInvMatrices(int index) const { EnsureSkeletonLoaded(); return m_BoneInitInvMatrices[index]; }
 
 	void SetBoneNameList(const std::vector<std::string>& boneNameList);
 	const std::string& GetBoneName(int BoneId) const;
@@ -212,11 +254,32 @@ protected:
 	bool TryLoadAsRmesh();
 
 	// Save mesh data as binary rmesh format
-	void SaveBinaryMesh();
+	bool SaveBinaryMesh();
 
 private:
+	void SerializeMeshElements(RSerializer& Serializer);
+	void SerializeMaterials(RSerializer& Serializer);
+	void SerializeSkeleton(RSerializer& Serializer);
+	void SerializeAnimation(RSerializer& Serializer);
+
+	/// Load render data from a chunked binary mesh and remember where skeleton and animation chunks are
+	bool LoadChunkedMesh(RSerializer& Serializer, const RChunkedFileReader& ChunkReader, const std::string& BinaryMeshPath);
+
+	void EnsureSkeletonLoaded() const;
+	void EnsureAnimationLoaded() const;
+	void LoadDeferredChunk(EMeshChunkId ChunkId) const;
+
+	struct RDeferredChunks;
+	std::unique_ptr<RDeferredChunks>	m_DeferredChunks;
+
+	mutable std::atomic<bool>		m_bSkeletonLoaded;
+	mutable std::atomic<bool>		m_bAnimationLoaded;
+
 	std::vector<std::unique_ptr<RMeshElement>>	m_MeshElements;
 
+	mutable std::unique_ptr<RMeshBVH>	m_TriangleBVH;
+	mutable std::mutex					m_TriangleBVHMutex;
+
 	std::vector<RMaterial*>			m_Materials;
 	RAabb							m_Aabb;
 
@@ -249,3 +312,19 @@ FORCEINLINE int RMesh::GetMeshElementCount() const
 	return (int)m_MeshElements.size();
 }
 
+FORCEINLINE void RMesh::EnsureSkeletonLoaded() const
+{
+	if (!m_bSkeletonLoaded.load(std::memory_order_acquire))
+	{
+		LoadDeferredChunk(MCI_Skeleton);
+	}
+}
+
+FORCEINLINE void RMesh::EnsureAnimationLoaded() const
+{
+	if (!m_bAnimationLoaded.load(std::memory_order_acquire))
+	{
+		LoadDeferredChunk(MCI_Animation);
+	}
+}
+
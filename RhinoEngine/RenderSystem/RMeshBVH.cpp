@@ -0,0 +1,453 @@
+//=============================================================================
+// RMeshBVH.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RMeshBVH.h"
+
+#include "RMeshElement.h"
+#include "Core/RSerializer.h"
+
+namespace
+{
+	// Number of bins candidate splits are evaluated at along the longest axis
+	const int NumSplitBins = 12;
+
+	// Deeper nodes become leaves, so traversal stacks have a fixed size
+	const int MaxTreeDepth = 48;
+
+	FORCEINLINE void Subtract3(const float* A, const float* B, float* Result)
+	{
+		Result[0] = A[0] - B[0];
+		Result[1] = A[1] - B[1];
+		Result[2] = A[2] - B[2];
+	}
+
+	FORCEINLINE void Cross3(const float* A, const float* B, float* Result)
+	{
+		Result[0] = A[1] * B[2] - A[2] * B[1];
+		Result[1] = A[2] * B[0] - A[0] * B[2];
+		Result[2] = A[0] * B[1] - A[1] * B[0];
+	}
+
+	FORCEINLINE float Dot3(const float* A, const float* B)
+	{
+		return A[0] * B[0] + A[1] * B[1] + A[2] * B[2];
+	}
+
+	/// Half of the surface area of a box, which is all SAH needs
+	FORCEINLINE float GetBoxHalfArea(const float* BoundsMin, const float* BoundsMax)
+	{
+		float dx = BoundsMax[0] - BoundsMin[0];
+		float dy = BoundsMax[1] - BoundsMin[1];
+		float dz = BoundsMax[2] - BoundsMin[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	struct RBinBounds
+	{
+		RBinBounds()
+		{
+			Reset();
+		}
+
+		void Reset()
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				BoundsMin[i] = FLT_MAX;
+				BoundsMax[i] = -FLT_MAX;
+			}
+		}
+
+		void Expand(const float* InMin, const float* InMax)
+		{
+			for (int i = 0; i < 3; i++)
+			{
+				BoundsMin[i] = RMath::Min(BoundsMin[i], InMin[i]);
+				BoundsMax[i] = RMath::Max(BoundsMax[i], InMax[i]);
+			}
+		}
+
+		float GetHalfArea() const
+		{
+			return BoundsMin[0] <= BoundsMax[0] ? GetBoxHalfArea(BoundsMin, BoundsMax) : 0.0f;
+		}
+
+		float BoundsMin[3];
+		float BoundsMax[3];
+	};
+}
+
+struct RMeshBVH::RBuildTriangle
+{
+	float	BoundsMin[3];
+	float	BoundsMax[3];
+	float	Centroid[3];
+	UINT	SourceIndex;
+};
+
+RMeshBVH::RMeshBVH()
+{
+}
+
+void RMeshBVH::Build(const std::vector<std::unique_ptr<RMeshElement>>& MeshElements)
+{
+	Nodes.clear();
+	Triangles.clear();
+
+	std::vector<RTriangle> SourceTriangles;
+	std::vector<RBuildTriangle> BuildTriangles;
+
+	for (UINT ElementIndex = 0; ElementIndex < (UINT)MeshElements.size(); ElementIndex++)
+	{
+		const RMeshElement& Element = *MeshElements[ElementIndex];
+		const UINT NumVertices = (UINT)Element.PositionArray.size();
+		const UINT NumElementTriangles = (UINT)Element.TriangleIndices.size() / 3;
+
+		for (UINT TriangleIndex = 0; TriangleIndex < NumElementTriangles; TriangleIndex++)
+		{
+			const UINT* Indices = &Element.TriangleIndices[TriangleIndex * 3];
+			if (Indices[0] >= NumVertices || Indices[1] >= NumVertices || Indices[2] >= NumVertices)
+			{
+				continue;
+			}
+
+			const float* Vertices[3] =
+			{
+				&Element.PositionArray[Indices[0]].x,
+				&Element.PositionArray[Indices[1]].x,
+				&Element.PositionArray[Indices[2]].x,
+			};
+
+			RTriangle Triangle;
+			memcpy(Triangle.Vertex0, Vertices[0], sizeof(Triangle.Vertex0));
+			Subtract3(Vertices[1], Vertices[0], Triangle.Edge1);
+			Subtract3(Vertices[2], Vertices[0], Triangle.Edge2);
+			Triangle.MeshElementIndex = ElementIndex;
+			Triangle.TriangleIndex = TriangleIndex;
+
+			RBuildTriangle BuildTriangle;
+			for (int Axis = 0; Axis < 3; Axis++)
+			{
+				BuildTriangle.BoundsMin[Axis] = RMath::Min(Vertices[0][Axis], RMath::Min(Vertices[1][Axis], Vertices[2][Axis]));
+				BuildTriangle.BoundsMax[Axis] = RMath::Max(Vertices[0][Axis], RMath::Max(Vertices[1][Axis], Vertices[2][Axis]));
+				BuildTriangle.Centroid[Axis] = (BuildTriangle.BoundsMin[Axis] + BuildTriangle.BoundsMax[Axis]) * 0.5f;
+			}
+			BuildTriangle.SourceIndex = (UINT)SourceTriangles.size();
+
+			SourceTriangles.push_back(Triangle);
+			BuildTriangles.push_back(BuildTriangle);
+		}
+	}
+
+	if (BuildTriangles.size() == 0)
+	{
+		return;
+	}
+
+	Nodes.reserve(BuildTriangles.size() * 2 / MaxTrianglesPerLeaf + 1);
+	BuildNode(BuildTriangles, 0, (UINT)BuildTriangles.size(), 0);
+	Nodes.shrink_to_fit();
+
+	// Store triangles in the order leaves reference them
+	Triangles.resize(BuildTriangles.size());
+	for (size_t i = 0; i < BuildTriangles.size(); i++)
+	{
+		Triangles[i] = SourceTriangles[BuildTriangles[i].SourceIndex];
+	}
+}
+
+UINT RMeshBVH::BuildNode(std::vector<RBuildTriangle>& BuildTriangles, UINT Begin, UINT End, int Depth)
+{
+	const UINT NodeIndex = (UINT)Nodes.size();
+	Nodes.push_back(RNode());
+
+	RBinBounds NodeBounds, CentroidBounds;
+	for (UINT i = Begin; i < End; i++)
+	{
+		NodeBounds.Expand(BuildTriangles[i].BoundsMin, BuildTriangles[i].BoundsMax);
+		CentroidBounds.Expand(BuildTriangles[i].Centroid, BuildTriangles[i].Centroid);
+	}
+
+	RNode Node;
+	memcpy(Node.BoundsMin, NodeBounds.BoundsMin, sizeof(Node.BoundsMin));
+	memcpy(Node.BoundsMax, NodeBounds.BoundsMax, sizeof(Node.BoundsMax));
+	Node.Offset = Begin;
+	Node.NumTriangles = End - Begin;
+
+	if (End - Begin <= (UINT)MaxTrianglesPerLeaf || Depth >= MaxTreeDepth)
+	{
+		Nodes[NodeIndex] = Node;
+		return NodeIndex;
+	}
+
+	// Split along the axis where centroids spread the most
+	int Axis = 0;
+	float Extents[3];
+	for (int i = 0; i < 3; i++)
+	{
+		Extents[i] = CentroidBounds.BoundsMax[i] - CentroidBounds.BoundsMin[i];
+		if (Extents[i] > Extents[Axis])
+		{
+			Axis = i;
+		}
+	}
+
+	UINT Mid = Begin;
+	if (Extents[Axis] > 0.0f)
+	{
+		const float AxisMin = CentroidBounds.BoundsMin[Axis];
+		const float BinScale = NumSplitBins / Extents[Axis];
+		auto GetBin = [&](const RBuildTriangle& Triangle)
+		{
+			return RMath::Min((int)((Triangle.Centroid[Axis] - AxisMin) * BinScale), NumSplitBins - 1);
+		};
+
+		RBinBounds Bins[NumSplitBins];
+		UINT BinCounts[NumSplitBins] = {};
+		for (UINT i = Begin; i < End; i++)
+		{
+			int Bin = GetBin(BuildTriangles[i]);
+			Bins[Bin].Expand(BuildTriangles[i].BoundsMin, BuildTriangles[i].BoundsMax);
+			BinCounts[Bin]++;
+		}
+
+		// Cost of splitting after each bin, with areas of the right side accumulated backwards
+		float RightCosts[NumSplitBins];
+		RBinBounds RightBounds;
+		UINT RightCount = 0;
+		for (int Bin = NumSplitBins - 1; Bin > 0; Bin--)
+		{
+			RightBounds.Expand(Bins[Bin].BoundsMin, Bins[Bin].BoundsMax);
+			RightCount += BinCounts[Bin];
+			RightCosts[Bin - 1] = RightCount * RightBounds.GetHalfArea();
+		}
+
+		int BestSplit = -1;
+		float BestCost = FLT_MAX;
+		RBinBounds LeftBounds;
+		UINT LeftCount = 0;
+		for (int Bin = 0; Bin < NumSplitBins - 1; Bin++)
+		{
+			LeftBounds.Expand(Bins[Bin].BoundsMin, Bins[Bin].BoundsMax);
+			LeftCount += BinCounts[Bin];
+
+			float Cost = LeftCount * LeftBounds.GetHalfArea() + RightCosts[Bin];
+			if (LeftCount > 0 && LeftCount < End - Begin && Cost < BestCost)
+			{
+				BestCost = Cost;
+				BestSplit = Bin;
+			}
+		}
+
+		if (BestSplit >= 0)
+		{
+			Mid = (UINT)(std::partition(BuildTriangles.begin() + Begin, BuildTriangles.begin() + End,
+				[&](const RBuildTriangle& Triangle) { return GetBin(Triangle) <= BestSplit; }) - BuildTriangles.begin());
+		}
+	}
+
+	// Centroids are too close to separate, split in the middle
+	if (Mid == Begin || Mid == End)
+	{
+		Mid = (Begin + End) / 2;
+		std::nth_element(BuildTriangles.begin() + Begin, BuildTriangles.begin() + Mid, BuildTriangles.begin() + End,
+			[Axis](const RBuildTriangle& A, const RBuildTriangle& B) { return A.Centroid[Axis] < B.Centroid[Axis]; });
+	}
+
+	BuildNode(BuildTriangles, Begin, Mid, Depth + 1);
+	Node.Offset = BuildNode(BuildTriangles, Mid, End, Depth + 1);
+	Node.NumTriangles = 0;
+
+	Nodes[NodeIndex] = Node;
+	return NodeIndex;
+}
+
+bool RMeshBVH::Raycast(const RVec3& Origin, const RVec3& Direction, float MaxDistance, RMeshRaycastHit& OutHit) const
+{
+	if (Nodes.size() == 0)
+	{
+		return false;
+	}
+
+	const float RayOrigin[3] = { Origin.X(), Origin.Y(), Origin.Z() };
+	const float RayDirection[3] = { Direction.X(), Direction.Y(), Direction.Z() };
+	float InvDirection[3];
+	for (int i = 0; i < 3; i++)
+	{
+		InvDirection[i] = fabsf(RayDirection[i]) > 1e-30f ? 1.0f / RayDirection[i] : (RayDirection[i] >= 0.0f ? 1e30f : -1e30f);
+	}
+
+	// Get distance at which the ray enters a node, if it does before the closest hit
+	auto IntersectNode = [&](const RNode& Node, float ClosestDistance, float& EntryDistance)
+	{
+		float tmin = 0.0f, tmax = ClosestDistance;
+		for (int i = 0; i < 3; i++)
+		{
+			float t1 = (Node.BoundsMin[i] - RayOrigin[i]) * InvDirection[i];
+			float t2 = (Node.BoundsMax[i] - RayOrigin[i]) * InvDirection[i];
+			tmin = RMath::Max(tmin, RMath::Min(t1, t2));
+			tmax = RMath::Min(tmax, RMath::Max(t1, t2));
+		}
+
+		EntryDistance = tmin;
+		return tmin <= tmax;
+	};
+
+	struct RStackEntry
+	{
+		UINT	NodeIndex;
+		float	EntryDistance;
+	};
+
+	RStackEntry Stack[MaxTreeDepth + 1];
+	int StackSize = 0;
+
+	float ClosestDistance = MaxDistance;
+	const RTriangle* ClosestTriangle = nullptr;
+	float ClosestU = 0.0f, ClosestV = 0.0f;
+
+	float RootDistance;
+	if (!IntersectNode(Nodes[0], ClosestDistance, RootDistance))
+	{
+		return false;
+	}
+
+	UINT NodeIndex = 0;
+	while (true)
+	{
+		const RNode& Node = Nodes[NodeIndex];
+		bool bHasNextNode = false;
+
+		if (Node.NumTriangles > 0)
+		{
+			// Moller-Trumbore intersection with both sides of each triangle
+			for (UINT i = Node.Offset; i < Node.Offset + Node.NumTriangles; i++)
+			{
+				const RTriangle& Triangle = Triangles[i];
+
+				float p[3], s[3], q[3];
+				Cross3(RayDirection, Triangle.Edge2, p);
+				float Det = Dot3(Triangle.Edge1, p);
+				if (fabsf(Det) < 1e-20f)
+				{
+					continue;
+				}
+
+				float InvDet = 1.0f / Det;
+				Subtract3(RayOrigin, Triangle.Vertex0, s);
+				float u = Dot3(s, p) * InvDet;
+				if (u < 0.0f || u > 1.0f)
+				{
+					continue;
+				}
+
+				Cross3(s, Triangle.Edge1, q);
+				float v = Dot3(RayDirection, q) * InvDet;
+				if (v < 0.0f || u + v > 1.0f)
+				{
+					continue;
+				}
+
+				float t = Dot3(Triangle.Edge2, q) * InvDet;
+				if (t >= 0.0f && t < ClosestDistance)
+				{
+					ClosestDistance = t;
+					ClosestTriangle = &Triangle;
+					ClosestU = u;
+					ClosestV = v;
+				}
+			}
+		}
+		else
+		{
+			// Visit the nearer child first and the other one later, unless a closer hit is found by then
+			UINT Child0 = NodeIndex + 1, Child1 = Node.Offset;
+			float Distance0, Distance1;
+			bool bHit0 = IntersectNode(Nodes[Child0], ClosestDistance, Distance0);
+			bool bHit1 = IntersectNode(Nodes[Child1], ClosestDistance, Distance1);
+
+			if (bHit0 && bHit1)
+			{
+				if (Distance1 < Distance0)
+				{
+					std::swap(Child0, Child1);
+					std::swap(Distance0, Distance1);
+				}
+
+				// Only hierarchies from corrupted files can be deeper than the stack
+				if (StackSize <= MaxTreeDepth)
+				{
+					Stack[StackSize].NodeIndex = Child1;
+					Stack[StackSize].EntryDistance = Distance1;
+					StackSize++;
+				}
+			}
+
+			if (bHit0 || bHit1)
+			{
+				NodeIndex = bHit0 ? Child0 : Child1;
+				bHasNextNode = true;
+			}
+		}
+
+		while (!bHasNextNode && StackSize > 0)
+		{
+			StackSize--;
+			if (Stack[StackSize].EntryDistance <= ClosestDistance)
+			{
+				NodeIndex = Stack[StackSize].NodeIndex;
+				bHasNextNode = true;
+			}
+		}
+
+		if (!bHasNextNode)
+		{
+			break;
+		}
+	}
+
+	if (!ClosestTriangle)
+	{
+		return false;
+	}
+
+	OutHit.Distance = ClosestDistance;
+	OutHit.MeshElementIndex = (int)ClosestTriangle->MeshElementIndex;
+	OutHit.TriangleIndex = (int)ClosestTriangle->TriangleIndex;
+	OutHit.U = ClosestU;
+	OutHit.V = ClosestV;
+	return true;
+}
+
+void RMeshBVH::Serialize(RSerializer& Serializer)
+{
+	Serializer.SerializeVector(Nodes);
+	Serializer.SerializeVector(Triangles);
+
+	// Node offsets of corrupted data must stay in range, as raycasts don't check them
+	if (Serializer.IsReading())
+	{
+		for (UINT i = 0; i < (UINT)Nodes.size(); i++)
+		{
+			const RNode& Node = Nodes[i];
+			bool bValid = Node.NumTriangles > 0 ?
+				(UINT64)Node.Offset + Node.NumTriangles <= Triangles.size() :
+				(Node.Offset > i + 1 && Node.Offset < Nodes.size() && i + 1 < Nodes.size());
+
+			if (!bValid)
+			{
+				Nodes.clear();
+				Triangles.clear();
+				break;
+			}
+		}
+	}
+}
+
+size_t RMeshBVH::GetMemorySize() const
+{
+	return Nodes.capacity() * sizeof(RNode) + Triangles.capacity() * sizeof(RTriangle);
+}
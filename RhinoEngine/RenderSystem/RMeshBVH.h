@@ -0,0 +1,80 @@
+//=============================================================================
+// RMeshBVH.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Bounding volume hierarchy of mesh triangles for exact raycasts
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+
+class RMeshElement;
+class RSerializer;
+
+struct RMeshRaycastHit
+{
+	// Distance along the ray, in units of ray direction length
+	float	Distance = FLT_MAX;
+
+	int		MeshElementIndex = -1;
+
+	// Triangle in the mesh element, whose vertices are TriangleIndices[TriangleIndex * 3 + 0..2]
+	int		TriangleIndex = -1;
+
+	// Barycentric coordinates of the hit point, weights of the second and the third vertex
+	float	U = 0.0f;
+	float	V = 0.0f;
+};
+
+/// A bounding volume hierarchy of all triangles in the mesh elements of a mesh, built with binned SAH.
+/// Triangles are copied in node order, so raycasts don't touch mesh element data.
+class RMeshBVH
+{
+public:
+	RMeshBVH();
+
+	/// Build hierarchy from positions and triangle indices of mesh elements
+	void Build(const std::vector<std::unique_ptr<RMeshElement>>& MeshElements);
+
+	/// Find the closest triangle hit by a ray within MaxDistance. Both sides of triangles are hit.
+	/// Direction doesn't need to be normalized; distances are in units of its length.
+	bool Raycast(const RVec3& Origin, const RVec3& Direction, float MaxDistance, RMeshRaycastHit& OutHit) const;
+
+	void Serialize(RSerializer& Serializer);
+
+	int GetNumTriangles() const			{ return (int)Triangles.size(); }
+	int GetNumNodes() const				{ return (int)Nodes.size(); }
+	size_t GetMemorySize() const;
+
+	/// Leaves are not split any further once they have this many triangles or fewer
+	static const int MaxTrianglesPerLeaf = 4;
+
+private:
+	struct RNode
+	{
+		float	BoundsMin[3];
+		float	BoundsMax[3];
+
+		// First triangle of a leaf, or the second child of an interior node. The first child directly follows its parent.
+		UINT	Offset;
+
+		// Zero for interior nodes
+		UINT	NumTriangles;
+	};
+
+	/// A triangle stored as a vertex and two edges, ready for ray intersection
+	struct RTriangle
+	{
+		float	Vertex0[3];
+		float	Edge1[3];
+		float	Edge2[3];
+		UINT	MeshElementIndex;
+		UINT	TriangleIndex;
+	};
+
+	struct RBuildTriangle;
+	UINT BuildNode(std::vector<RBuildTriangle>& BuildTriangles, UINT Begin, UINT End, int Depth);
+
+	std::vector<RNode>		Nodes;
+	std::vector<RTriangle>	Triangles;
+};
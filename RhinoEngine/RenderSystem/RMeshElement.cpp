@@ -12,8 +12,13 @@
 
 #include "D3DCommonPrivate.h"
 
+#include <atomic>
+
 namespace
 {
+	// Mesh elements are created on loader threads
+	std::atomic<UINT> NextMeshElementSortId(0);
+
 	// Convert primitive topology types to D3D11 ones
 	D3D11_PRIMITIVE_TOPOLOGY GetD3D11PrimitiveTopology(EPrimitiveTopology Topology)
 	{
@@ -43,6 +48,10 @@ RMeshRenderBuffer::RMeshRenderBuffer()
 	: BufferData(std::make_unique<RBufferData>())
 	, m_InputLayout(nullptr)
 	, m_PrimitiveTopology(EPrimitiveTopology::TriangleList)
+	, m_Stride(0)
+	, m_VertexCount(0)
+	, m_IndexStride(0)
+	, m_IndexCount(0)
 {
 
 }
@@ -74,11 +83,11 @@ void RMeshRenderBuffer::CreateVertexBuffer(void* data, UINT vertexTypeSize, UINT
 		ZeroMemory(&initVertexData, sizeof(initVertexData));
 		initVertexData.pSysMem = data;
 
-		GRenderer.D3DDevice()->CreateBuffer(&vbd, &initVertexData, BufferData->m_VertexBuffer.GetAddressOf());
+		GRenderer.Device()->CreateBuffer(&vbd, &initVertexData, BufferData->m_VertexBuffer.GetAddressOf());
 	}
 	else
 	{
-		GRenderer.D3DDevice()->CreateBuffer(&vbd, NULL, BufferData->m_VertexBuffer.GetAddressOf());
+		GRenderer.Device()->CreateBuffer(&vbd, NULL, BufferData->m_VertexBuffer.GetAddressOf());
 	}
 
 	m_VertexCount = vertexCount;
@@ -97,68 +106,88 @@ void RMeshRenderBuffer::CreateIndexBuffer(void* data, UINT indexTypeSize, UINT i
 	ZeroMemory(&initIndexData, sizeof(initIndexData));
 	initIndexData.pSysMem = data;
 
-	GRenderer.D3DDevice()->CreateBuffer(&ibd, &initIndexData, BufferData->m_IndexBuffer.GetAddressOf());
+	GRenderer.Device()->CreateBuffer(&ibd, &initIndexData, BufferData->m_IndexBuffer.GetAddressOf());
+	m_IndexStride = indexTypeSize;
 	m_IndexCount = indexCount;
 }
 
 void RMeshRenderBuffer::UpdateDynamicVertexBuffer(void* data, UINT vertexTypeSize, UINT vertexCount)
 {
 	D3D11_MAPPED_SUBRESOURCE subres;
-	HRESULT hr = GRenderer.D3DImmediateContext()->Map(BufferData->m_VertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subres);
+	HRESULT hr = GRenderer.Device()->Map(BufferData->m_VertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subres);
 	assert(SUCCEEDED(hr));
 
 	memcpy(subres.pData, data, vertexTypeSize * vertexCount);
-	GRenderer.D3DImmediateContext()->Unmap(BufferData->m_VertexBuffer.Get(), 0);
+	GRenderer.Device()->Unmap(BufferData->m_VertexBuffer.Get(), 0);
 
 	m_VertexCount = vertexCount;
 }
 
-void RMeshRenderBuffer::Draw() const
+void RMeshRenderBuffer::BindBuffers(RRenderStateCache* StateCache) const
+{
+	assert(m_InputLayout);
+	UINT offset = 0;
+
+	if (!StateCache || StateCache->InputLayout != m_InputLayout)
+	{
+		GRenderer.Device()->IASetInputLayout(m_InputLayout);
+	}
+
+	if (!StateCache || StateCache->PrimitiveTopology != (int)m_PrimitiveTopology)
+	{
+		GRenderer.Device()->IASetPrimitiveTopology(GetD3D11PrimitiveTopology(m_PrimitiveTopology));
+	}
+
+	if (!StateCache || StateCache->RenderBuffer != this)
+	{
+		GRenderer.Device()->IASetVertexBuffers(0, 1, BufferData->m_VertexBuffer.GetAddressOf(), &m_Stride, &offset);
+
+		if (BufferData->m_IndexBuffer)
+		{
+			GRenderer.Device()->IASetIndexBuffer(BufferData->m_IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+		}
+	}
+
+	if (StateCache)
+	{
+		StateCache->InputLayout = m_InputLayout;
+		StateCache->PrimitiveTopology = (int)m_PrimitiveTopology;
+		StateCache->RenderBuffer = this;
+	}
+}
+
+void RMeshRenderBuffer::Draw(RRenderStateCache* StateCache /*= nullptr*/) const
 {
 	if (BufferData->m_VertexBuffer)
 	{
-		assert(m_InputLayout);
-		UINT offset = 0;
+		BindBuffers(StateCache);
 
-		GRenderer.D3DImmediateContext()->IASetInputLayout(m_InputLayout);
-		GRenderer.D3DImmediateContext()->IASetVertexBuffers(0, 1, BufferData->m_VertexBuffer.GetAddressOf(), &m_Stride, &offset);
-		GRenderer.D3DImmediateContext()->IASetPrimitiveTopology(GetD3D11PrimitiveTopology(m_PrimitiveTopology));
-		
 		if (BufferData->m_IndexBuffer)
 		{
-			GRenderer.D3DImmediateContext()->IASetIndexBuffer(BufferData->m_IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-			GRenderer.D3DImmediateContext()->DrawIndexed(m_IndexCount, 0, 0);
+			GRenderer.Device()->DrawIndexed(m_IndexCount, 0, 0);
 		}
 		else
 		{
-			GRenderer.D3DImmediateContext()->Draw(m_VertexCount, 0);
+			GRenderer.Device()->Draw(m_VertexCount, 0);
 		}
 
 		GRenderer.Stats.DrawCalls++;
 	}
 }
 
-void RMeshRenderBuffer::DrawInstanced(int instanceCount) const
+void RMeshRenderBuffer::DrawInstanced(int instanceCount, RRenderStateCache* StateCache /*= nullptr*/) const
 {
-	UINT offset = 0;
-
 	if (BufferData->m_VertexBuffer)
 	{
-		assert(m_InputLayout);
-		UINT offset = 0;
-		
-		GRenderer.D3DImmediateContext()->IASetInputLayout(m_InputLayout);
-		GRenderer.D3DImmediateContext()->IASetVertexBuffers(0, 1, BufferData->m_VertexBuffer.GetAddressOf(), &m_Stride, &offset);
-		GRenderer.D3DImmediateContext()->IASetPrimitiveTopology(GetD3D11PrimitiveTopology(m_PrimitiveTopology));
+		BindBuffers(StateCache);
 
 		if (BufferData->m_IndexBuffer)
 		{
-			GRenderer.D3DImmediateContext()->IASetIndexBuffer(BufferData->m_IndexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
-			GRenderer.D3DImmediateContext()->DrawIndexedInstanced(m_IndexCount, instanceCount, 0, 0, 0);
+			GRenderer.Device()->DrawIndexedInstanced(m_IndexCount, instanceCount, 0, 0, 0);
 		}
 		else
 		{
-			GRenderer.D3DImmediateContext()->DrawInstanced(m_VertexCount, instanceCount, 0, 0);
+			GRenderer.Device()->DrawInstanced(m_VertexCount, instanceCount, 0, 0);
 		}
 
 		GRenderer.Stats.DrawCalls++;
@@ -183,6 +212,7 @@ void SetDebuggerObjectName(RMeshRenderBuffer& RenderBuffer, const char* ObjectNa
 
 RMeshElement::RMeshElement()
 	: m_Flag(0)
+	, m_SortId(NextMeshElementSortId++)
 	, m_VertexComponentMask(0)
 	, m_RenderBuffer(std::make_unique<RMeshRenderBuffer>())
 {
@@ -307,13 +337,34 @@ void RMeshElement::UpdateRenderBuffer()
 	}
 }
 
-void RMeshElement::Draw() const
+size_t RMeshElement::GetMemorySize() const
+{
+	size_t Size = sizeof(RMeshElement) + m_Name.capacity();
+
+	Size += TriangleIndices.capacity() * sizeof(UINT);
+	Size += PositionArray.capacity() * sizeof(RVertexType::Vec3Data);
+	Size += UV0Array.capacity() * sizeof(RVertexType::Vec2Data);
+	Size += NormalArray.capacity() * sizeof(RVertexType::Vec3Data);
+	Size += TangentArray.capacity() * sizeof(RVertexType::Vec3Data);
+	Size += UV1Array.capacity() * sizeof(RVertexType::Vec2Data);
+	Size += BoneIdArray.capacity() * sizeof(VBoneIds);
+	Size += BoneWeightArray.capacity() * sizeof(RVertexType::Vec4Data);
+
+	if (m_RenderBuffer)
+	{
+		Size += m_RenderBuffer->GetMemorySize();
+	}
+
+	return Size;
+}
+
+void RMeshElement::Draw(RRenderStateCache* StateCache /*= nullptr*/) const
 {
-	m_RenderBuffer->Draw();
+	m_RenderBuffer->Draw(StateCache);
 }
 
-void RMeshElement::DrawInstanced(int instanceCount) const
+void RMeshElement::DrawInstanced(int instanceCount, RRenderStateCache* StateCache /*= nullptr*/) const
 {
-	m_RenderBuffer->DrawInstanced(instanceCount);
+	m_RenderBuffer->DrawInstanced(instanceCount, StateCache);
 }
 
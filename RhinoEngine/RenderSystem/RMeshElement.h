@@ -11,6 +11,7 @@
 #include <d3d11.h>
 
 class RSerializer;
+struct RRenderStateCache;
 
 enum MeshElementFlag
 {
@@ -38,13 +39,19 @@ public:
 
 	void UpdateDynamicVertexBuffer(void* data, UINT vertexTypeSize, UINT vertexCount);
 
-	void Draw() const;
-	void DrawInstanced(int instanceCount) const;
+	/// Draw the buffers. With a state cache, input assembler states which are already bound are skipped.
+	void Draw(RRenderStateCache* StateCache = nullptr) const;
+	void DrawInstanced(int instanceCount, RRenderStateCache* StateCache = nullptr) const;
 
 	UINT GetVertexCount() const;
 	UINT GetIndexCount() const;
 
+	/// Get number of bytes used by vertex and index buffers
+	size_t GetMemorySize() const;
+
 private:
+	void BindBuffers(RRenderStateCache* StateCache) const;
+
 	struct RBufferData;
 	std::unique_ptr<RBufferData> BufferData;
 
@@ -53,6 +60,7 @@ private:
 
 	UINT				m_Stride;
 	UINT				m_VertexCount;
+	UINT				m_IndexStride;
 	UINT				m_IndexCount;
 };
 
@@ -75,6 +83,11 @@ FORCEINLINE UINT RMeshRenderBuffer::GetIndexCount() const
 	return m_IndexCount;
 }
 
+FORCEINLINE size_t RMeshRenderBuffer::GetMemorySize() const
+{
+	return (size_t)m_Stride * m_VertexCount + (size_t)m_IndexStride * m_IndexCount;
+}
+
 class RMeshElement
 {
 public:
@@ -90,17 +103,23 @@ public:
 	
 	void UpdateRenderBuffer();
 
-	void Draw() const;
-	void DrawInstanced(int instanceCount) const;
+	void Draw(RRenderStateCache* StateCache = nullptr) const;
+	void DrawInstanced(int instanceCount, RRenderStateCache* StateCache = nullptr) const;
 
 	void SetName(const char* name)		{ m_Name = name; }
 	const std::string& GetName() const	{ return m_Name; }
 
 	const RAabb& GetAabb() const		{ return m_Aabb; }
 
+	/// Id unique to this mesh element, for ordering draws by mesh element
+	UINT GetSortId() const				{ return m_SortId; }
+
 	void SetFlag(int flag)				{ m_Flag = flag; }
 	int GetFlag() const					{ return m_Flag; }
 
+	/// Get number of bytes used by vertex arrays and render buffers
+	size_t GetMemorySize() const;
+
 	std::vector<UINT>					TriangleIndices;
 	std::vector<RVertexType::Vec3Data>	PositionArray;
 	std::vector<RVertexType::Vec2Data>	UV0Array;
@@ -114,6 +133,7 @@ private:
 	std::string			m_Name;
 	RAabb				m_Aabb;
 	UINT				m_Flag;
+	UINT				m_SortId;
 
 	std::unique_ptr<RMeshRenderBuffer>	m_RenderBuffer;
 
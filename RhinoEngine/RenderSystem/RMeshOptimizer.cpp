@@ -0,0 +1,532 @@
+//=============================================================================
+// RMeshOptimizer.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RMeshOptimizer.h"
+
+#include <chrono>
+
+namespace
+{
+	const UINT InvalidIndex = 0xFFFFFFFF;
+
+	/// Zero is the only value with two encodings (+0 and -0) that compare equal. Use one of them, so equal
+	/// vertices are also equal in memory.
+	FORCEINLINE float CanonicalFloat(float Value)
+	{
+		return Value == 0.0f ? 0.0f : Value;
+	}
+
+	RVertexType::MeshLoader MakeCanonicalVertex(const RVertexType::MeshLoader& Vertex)
+	{
+		RVertexType::MeshLoader Result = Vertex;
+
+		float* Components[] =
+		{
+			&Result.pos.x, &Result.pos.y, &Result.pos.z,
+			&Result.uv0.x, &Result.uv0.y,
+			&Result.uv1.x, &Result.uv1.y,
+			&Result.normal.x, &Result.normal.y, &Result.normal.z,
+			&Result.tangent.x, &Result.tangent.y, &Result.tangent.z,
+			&Result.weight.x, &Result.weight.y, &Result.weight.z, &Result.weight.w,
+		};
+
+		for (float* Component : Components)
+		{
+			*Component = CanonicalFloat(*Component);
+		}
+
+		return Result;
+	}
+
+	/// Finalizer of MurmurHash3, so all bits of the input affect the low bits used as table slots
+	FORCEINLINE UINT64 MixHash(UINT64 Hash)
+	{
+		Hash ^= Hash >> 33;
+		Hash *= 0xff51afd7ed558ccdULL;
+		Hash ^= Hash >> 33;
+		Hash *= 0xc4ceb9fe1a85ec53ULL;
+		Hash ^= Hash >> 33;
+		return Hash;
+	}
+
+	UINT64 HashVertex(const RVertexType::MeshLoader& Vertex)
+	{
+		static_assert(sizeof(RVertexType::MeshLoader) % sizeof(UINT32) == 0, "Vertex must be made of 32-bit components");
+
+		// FNV-1a over 32-bit words
+		const UINT32* Words = (const UINT32*)&Vertex;
+		UINT64 Hash = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < sizeof(RVertexType::MeshLoader) / sizeof(UINT32); i++)
+		{
+			Hash = (Hash ^ Words[i]) * 0x100000001b3ULL;
+		}
+
+		return MixHash(Hash);
+	}
+
+	FORCEINLINE bool IsNearlyEqual(const RVertexType::Vec3Data& A, const RVertexType::Vec3Data& B, float Epsilon)
+	{
+		return fabsf(A.x - B.x) <= Epsilon && fabsf(A.y - B.y) <= Epsilon && fabsf(A.z - B.z) <= Epsilon;
+	}
+
+	/// Compare vertices with tolerance on positions and normals. Other attributes must be the same.
+	bool CanWeldVertices(const RVertexType::MeshLoader& A, const RVertexType::MeshLoader& B, const RVertexWeldSettings& Settings)
+	{
+		return IsNearlyEqual(A.pos, B.pos, Settings.PositionEpsilon) &&
+			   IsNearlyEqual(A.normal, B.normal, Settings.NormalEpsilon) &&
+			   memcmp(&A.uv0, &B.uv0, sizeof(A.uv0)) == 0 &&
+			   memcmp(&A.uv1, &B.uv1, sizeof(A.uv1)) == 0 &&
+			   memcmp(&A.tangent, &B.tangent, sizeof(A.tangent)) == 0 &&
+			   memcmp(A.boneId, B.boneId, sizeof(A.boneId)) == 0 &&
+			   memcmp(&A.weight, &B.weight, sizeof(A.weight)) == 0;
+	}
+
+	/// Cell of the grid used for welding with tolerance. Cells are as large as the position tolerance,
+	/// so vertices that can be welded are always in the same or neighboring cells.
+	struct RWeldGridCell
+	{
+		INT64 x, y, z;
+
+		bool operator==(const RWeldGridCell& Other) const	{ return x == Other.x && y == Other.y && z == Other.z; }
+
+		UINT64 GetHash() const
+		{
+			return MixHash((UINT64)x * 0x9e3779b97f4a7c15ULL ^ (UINT64)y * 0xc2b2ae3d27d4eb4fULL ^ (UINT64)z * 0x165667b19e3779f9ULL);
+		}
+	};
+
+	/// Welds vertices with an open addressing hash table. In exact mode, the table is keyed by whole vertices.
+	/// With tolerance, it is keyed by grid cells, and vertices in the same cell are linked in a list.
+	class RVertexWelder
+	{
+	public:
+		RVertexWelder(size_t ExpectedVertices, const RVertexWeldSettings& InSettings, std::vector<RVertexType::MeshLoader>& InVertices)
+			: Settings(InSettings)
+			, bUseTolerance(InSettings.PositionEpsilon > 0.0f)
+			, InvCellSize(InSettings.PositionEpsilon > 0.0f ? 1.0 / InSettings.PositionEpsilon : 0.0)
+			, Vertices(InVertices)
+			, NumUsedSlots(0)
+		{
+			UINT Capacity = 16;
+			while (Capacity < ExpectedVertices * 2)
+			{
+				Capacity <<= 1;
+			}
+
+			SlotMask = Capacity - 1;
+			Slots.assign(Capacity, InvalidIndex);
+
+			if (bUseTolerance)
+			{
+				SlotCells.resize(Capacity);
+			}
+		}
+
+		/// Get index of a welded vertex equal to the given one, adding the vertex if there isn't any
+		UINT FindOrAdd(const RVertexType::MeshLoader& SourceVertex)
+		{
+			const RVertexType::MeshLoader Vertex = MakeCanonicalVertex(SourceVertex);
+			return bUseTolerance ? FindOrAddWithTolerance(Vertex) : FindOrAddExact(Vertex);
+		}
+
+	private:
+		UINT FindOrAddExact(const RVertexType::MeshLoader& Vertex)
+		{
+			for (UINT Slot = (UINT)HashVertex(Vertex) & SlotMask; ; Slot = (Slot + 1) & SlotMask)
+			{
+				const UINT Index = Slots[Slot];
+				if (Index == InvalidIndex)
+				{
+					const UINT NewIndex = (UINT)Vertices.size();
+					Slots[Slot] = NewIndex;
+					Vertices.push_back(Vertex);
+
+					OnSlotUsed();
+					return NewIndex;
+				}
+
+				if (memcmp(&Vertices[Index], &Vertex, sizeof(Vertex)) == 0)
+				{
+					return Index;
+				}
+			}
+		}
+
+		UINT FindOrAddWithTolerance(const RVertexType::MeshLoader& Vertex)
+		{
+			const RWeldGridCell Cell = GetCell(Vertex.pos);
+
+			for (INT64 z = -1; z <= 1; z++)
+			{
+				for (INT64 y = -1; y <= 1; y++)
+				{
+					for (INT64 x = -1; x <= 1; x++)
+					{
+						const RWeldGridCell Neighbor = { Cell.x + x, Cell.y + y, Cell.z + z };
+						const UINT Slot = FindCellSlot(Neighbor);
+
+						for (UINT Index = Slots[Slot]; Index != InvalidIndex; Index = NextInCell[Index])
+						{
+							if (CanWeldVertices(Vertices[Index], Vertex, Settings))
+							{
+								return Index;
+							}
+						}
+					}
+				}
+			}
+
+			// Add the vertex to the front of the list of its cell
+			const UINT Slot = FindCellSlot(Cell);
+			const UINT NewIndex = (UINT)Vertices.size();
+			const bool bNewCell = Slots[Slot] == InvalidIndex;
+
+			SlotCells[Slot] = Cell;
+			NextInCell.push_back(Slots[Slot]);
+			Slots[Slot] = NewIndex;
+			Vertices.push_back(Vertex);
+
+			if (bNewCell)
+			{
+				OnSlotUsed();
+			}
+
+			return NewIndex;
+		}
+
+		/// Keep load factor at most 0.5 so probe sequences stay short
+		void OnSlotUsed()
+		{
+			NumUsedSlots++;
+			if (NumUsedSlots * 2 <= Slots.size())
+			{
+				return;
+			}
+
+			std::vector<UINT> OldSlots(Slots.size() * 2, InvalidIndex);
+			std::vector<RWeldGridCell> OldSlotCells(bUseTolerance ? OldSlots.size() : 0);
+			OldSlots.swap(Slots);
+			OldSlotCells.swap(SlotCells);
+			SlotMask = (UINT)Slots.size() - 1;
+
+			for (UINT OldSlot = 0; OldSlot < (UINT)OldSlots.size(); OldSlot++)
+			{
+				if (OldSlots[OldSlot] == InvalidIndex)
+				{
+					continue;
+				}
+
+				if (bUseTolerance)
+				{
+					const UINT Slot = FindCellSlot(OldSlotCells[OldSlot]);
+					Slots[Slot] = OldSlots[OldSlot];
+					SlotCells[Slot] = OldSlotCells[OldSlot];
+				}
+				else
+				{
+					UINT Slot = (UINT)HashVertex(Vertices[OldSlots[OldSlot]]) & SlotMask;
+					while (Slots[Slot] != InvalidIndex)
+					{
+						Slot = (Slot + 1) & SlotMask;
+					}
+					Slots[Slot] = OldSlots[OldSlot];
+				}
+			}
+		}
+
+		RWeldGridCell GetCell(const RVertexType::Vec3Data& Position) const
+		{
+			RWeldGridCell Cell;
+			Cell.x = (INT64)floor((double)Position.x * InvCellSize);
+			Cell.y = (INT64)floor((double)Position.y * InvCellSize);
+			Cell.z = (INT64)floor((double)Position.z * InvCellSize);
+			return Cell;
+		}
+
+		/// Find the slot of a cell, or the empty slot where the cell would be added
+		UINT FindCellSlot(const RWeldGridCell& Cell) const
+		{
+			UINT Slot = (UINT)Cell.GetHash() & SlotMask;
+			while (Slots[Slot] != InvalidIndex && !(SlotCells[Slot] == Cell))
+			{
+				Slot = (Slot + 1) & SlotMask;
+			}
+			return Slot;
+		}
+
+		const RVertexWeldSettings&				Settings;
+		const bool								bUseTolerance;
+		const double							InvCellSize;
+
+		std::vector<RVertexType::MeshLoader>&	Vertices;
+
+		std::vector<UINT>						Slots;
+		UINT									SlotMask;
+		size_t									NumUsedSlots;
+
+		std::vector<RWeldGridCell>				SlotCells;
+		std::vector<UINT>						NextInCell;
+	};
+
+	/// Tipsify: find the next vertex to fan triangles around (Sander et al., "Fast Triangle Reordering for
+	/// Vertex Locality and Reduced Overdraw", 2007)
+	class RTipsify
+	{
+	public:
+		RTipsify(const std::vector<UINT>& InIndexData, int InNumVertices, int InCacheSize)
+			: IndexData(InIndexData)
+			, NumVertices(InNumVertices)
+			, CacheSize(InCacheSize)
+		{}
+
+		void Run(std::vector<UINT>& OutIndexData)
+		{
+			const int NumTriangles = (int)IndexData.size() / 3;
+
+			// Triangles adjacent to each vertex, stored contiguously per vertex
+			AdjacencyOffsets.assign(NumVertices + 1, 0);
+			for (UINT Index : IndexData)
+			{
+				AdjacencyOffsets[Index + 1]++;
+			}
+
+			for (int i = 0; i < NumVertices; i++)
+			{
+				AdjacencyOffsets[i + 1] += AdjacencyOffsets[i];
+			}
+
+			LiveTriangles.resize(NumVertices);
+			for (int i = 0; i < NumVertices; i++)
+			{
+				LiveTriangles[i] = AdjacencyOffsets[i + 1] - AdjacencyOffsets[i];
+			}
+
+			AdjacentTriangles.resize(IndexData.size());
+			{
+				std::vector<int> FillOffsets(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+				for (int i = 0; i < (int)IndexData.size(); i++)
+				{
+					AdjacentTriangles[FillOffsets[IndexData[i]]++] = i / 3;
+				}
+			}
+
+			CacheTimestamps.assign(NumVertices, 0);
+			TriangleEmitted.assign(NumTriangles, false);
+			DeadEndStack.clear();
+			DeadEndStack.reserve(IndexData.size());
+
+			OutIndexData.clear();
+			OutIndexData.reserve(IndexData.size());
+
+			int Timestamp = CacheSize + 1;
+			int Cursor = 0;
+			int FanningVertex = IndexData.size() > 0 ? (int)IndexData[0] : -1;
+
+			std::vector<UINT> Candidates;
+
+			while (FanningVertex >= 0)
+			{
+				Candidates.clear();
+
+				// Emit all remaining triangles around the fanning vertex
+				for (int i = AdjacencyOffsets[FanningVertex]; i < AdjacencyOffsets[FanningVertex + 1]; i++)
+				{
+					const int Triangle = AdjacentTriangles[i];
+					if (TriangleEmitted[Triangle])
+					{
+						continue;
+					}
+
+					for (int Corner = 0; Corner < 3; Corner++)
+					{
+						const UINT Vertex = IndexData[Triangle * 3 + Corner];
+						OutIndexData.push_back(Vertex);
+						DeadEndStack.push_back(Vertex);
+						Candidates.push_back(Vertex);
+						LiveTriangles[Vertex]--;
+
+						// Vertex is not in cache, so it gets loaded now
+						if (Timestamp - CacheTimestamps[Vertex] > CacheSize)
+						{
+							CacheTimestamps[Vertex] = Timestamp++;
+						}
+					}
+
+					TriangleEmitted[Triangle] = true;
+				}
+
+				FanningVertex = GetNextVertex(Candidates, Timestamp, Cursor);
+			}
+		}
+
+	private:
+		/// Pick the candidate that will still be in cache after fanning around it, preferring the oldest one
+		int GetNextVertex(const std::vector<UINT>& Candidates, int Timestamp, int& Cursor)
+		{
+			int BestVertex = -1;
+			int BestPriority = -1;
+
+			for (UINT Vertex : Candidates)
+			{
+				if (LiveTriangles[Vertex] > 0)
+				{
+					int Priority = 0;
+					if (Timestamp - CacheTimestamps[Vertex] + 2 * LiveTriangles[Vertex] <= CacheSize)
+					{
+						Priority = Timestamp - CacheTimestamps[Vertex];
+					}
+
+					if (Priority > BestPriority)
+					{
+						BestPriority = Priority;
+						BestVertex = (int)Vertex;
+					}
+				}
+			}
+
+			return BestVertex != -1 ? BestVertex : SkipDeadEnd(Cursor);
+		}
+
+		/// Continue from recently used vertices, or from the next vertex in input order with triangles left
+		int SkipDeadEnd(int& Cursor)
+		{
+			while (DeadEndStack.size() > 0)
+			{
+				const UINT Vertex = DeadEndStack.back();
+				DeadEndStack.pop_back();
+
+				if (LiveTriangles[Vertex] > 0)
+				{
+					return (int)Vertex;
+				}
+			}
+
+			for (; Cursor < NumVertices; Cursor++)
+			{
+				if (LiveTriangles[Cursor] > 0)
+				{
+					return Cursor;
+				}
+			}
+
+			return -1;
+		}
+
+		const std::vector<UINT>&	IndexData;
+		const int					NumVertices;
+		const int					CacheSize;
+
+		std::vector<int>			AdjacencyOffsets;
+		std::vector<int>			AdjacentTriangles;
+		std::vector<int>			LiveTriangles;
+		std::vector<int>			CacheTimestamps;
+		std::vector<bool>			TriangleEmitted;
+		std::vector<UINT>			DeadEndStack;
+	};
+}
+
+void RMeshOptimizer::WeldVertices(const std::vector<RVertexType::MeshLoader>& SourceVertices, std::vector<UINT>& IndexData,
+								  std::vector<RVertexType::MeshLoader>& OutVertices, const RVertexWeldSettings& Settings /*= RVertexWeldSettings()*/)
+{
+	OutVertices.clear();
+
+	// Imported triangles usually share each vertex with several others
+	RVertexWelder Welder(RMath::Min(SourceVertices.size(), IndexData.size()) / 4, Settings, OutVertices);
+
+	// Indices often refer to the same source vertex. Remember where each one went, so it is only hashed once.
+	std::vector<UINT> SourceToWelded(SourceVertices.size(), InvalidIndex);
+
+	for (UINT& Index : IndexData)
+	{
+		UINT& WeldedIndex = SourceToWelded[Index];
+		if (WeldedIndex == InvalidIndex)
+		{
+			WeldedIndex = Welder.FindOrAdd(SourceVertices[Index]);
+		}
+
+		Index = WeldedIndex;
+	}
+}
+
+void RMeshOptimizer::OptimizeVertexCache(std::vector<UINT>& IndexData, std::vector<RVertexType::MeshLoader>& VertexData, int CacheSize /*= VertexCacheSize*/)
+{
+	if (IndexData.size() < 3)
+	{
+		return;
+	}
+
+	std::vector<UINT> ReorderedIndices;
+	RTipsify Tipsify(IndexData, (int)VertexData.size(), CacheSize);
+	Tipsify.Run(ReorderedIndices);
+
+	// Store vertices in the order triangles use them
+	std::vector<UINT> VertexRemap(VertexData.size(), InvalidIndex);
+	std::vector<RVertexType::MeshLoader> ReorderedVertices;
+	ReorderedVertices.reserve(VertexData.size());
+
+	for (UINT& Index : ReorderedIndices)
+	{
+		if (VertexRemap[Index] == InvalidIndex)
+		{
+			VertexRemap[Index] = (UINT)ReorderedVertices.size();
+			ReorderedVertices.push_back(VertexData[Index]);
+		}
+
+		Index = VertexRemap[Index];
+	}
+
+	IndexData = std::move(ReorderedIndices);
+	VertexData = std::move(ReorderedVertices);
+}
+
+RMeshOptimizationStats RMeshOptimizer::OptimizeMesh(const std::vector<RVertexType::MeshLoader>& SourceVertices, std::vector<UINT>& IndexData,
+													std::vector<RVertexType::MeshLoader>& OutVertices, const RVertexWeldSettings& Settings /*= RVertexWeldSettings()*/)
+{
+	RMeshOptimizationStats Stats;
+	Stats.NumSourceVertices = (int)SourceVertices.size();
+	Stats.NumTriangles = (int)IndexData.size() / 3;
+
+	auto StartTime = std::chrono::high_resolution_clock::now();
+
+	WeldVertices(SourceVertices, IndexData, OutVertices, Settings);
+	Stats.NumWeldedVertices = (int)OutVertices.size();
+
+	auto WeldedTime = std::chrono::high_resolution_clock::now();
+
+	Stats.ACMRBefore = CalculateACMR(IndexData, (int)OutVertices.size());
+	OptimizeVertexCache(IndexData, OutVertices);
+	Stats.ACMRAfter = CalculateACMR(IndexData, (int)OutVertices.size());
+
+	auto EndTime = std::chrono::high_resolution_clock::now();
+
+	Stats.WeldMs = std::chrono::duration<float, std::milli>(WeldedTime - StartTime).count();
+	Stats.ReorderMs = std::chrono::duration<float, std::milli>(EndTime - WeldedTime).count();
+
+	return Stats;
+}
+
+float RMeshOptimizer::CalculateACMR(const std::vector<UINT>& IndexData, int NumVertices, int CacheSize /*= VertexCacheSize*/)
+{
+	const int NumTriangles = (int)IndexData.size() / 3;
+	if (NumTriangles == 0)
+	{
+		return 0.0f;
+	}
+
+	// A vertex is in the FIFO cache if fewer than CacheSize vertices have been loaded since it was
+	std::vector<int> LoadTimes(NumVertices, -CacheSize - 1);
+	int NumMisses = 0;
+
+	for (UINT Index : IndexData)
+	{
+		if (NumMisses - LoadTimes[Index] >= CacheSize)
+		{
+			LoadTimes[Index] = NumMisses++;
+		}
+	}
+
+	return (float)NumMisses / (float)NumTriangles;
+}
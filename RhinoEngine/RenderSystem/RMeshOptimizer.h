@@ -0,0 +1,58 @@
+//=============================================================================
+// RMeshOptimizer.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Vertex welding and vertex cache optimization for imported meshes
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+#include "RenderSystem/RVertexDeclaration.h"
+
+struct RVertexWeldSettings
+{
+	// Vertices with positions closer than this on every axis are welded. Zero welds identical positions only.
+	float PositionEpsilon = 0.0f;
+
+	// Vertices with normals closer than this on every axis are welded. Zero welds identical normals only.
+	// Only used when PositionEpsilon is greater than zero.
+	float NormalEpsilon = 0.0f;
+};
+
+struct RMeshOptimizationStats
+{
+	int		NumSourceVertices = 0;
+	int		NumWeldedVertices = 0;
+	int		NumTriangles = 0;
+
+	// Average cache miss ratio (vertex shader invocations per triangle) before and after reordering triangles
+	float	ACMRBefore = 0.0f;
+	float	ACMRAfter = 0.0f;
+
+	float	WeldMs = 0.0f;
+	float	ReorderMs = 0.0f;
+};
+
+class RMeshOptimizer
+{
+public:
+	/// Size of the post-transform vertex cache that triangle order is optimized for
+	static const int VertexCacheSize = 16;
+
+	/// Weld vertices of triangles into a new vertex array. Indices are remapped to the welded vertices,
+	/// which are stored in order of first use. Source vertices not used by any triangle are dropped.
+	static void WeldVertices(const std::vector<RVertexType::MeshLoader>& SourceVertices, std::vector<UINT>& IndexData,
+							 std::vector<RVertexType::MeshLoader>& OutVertices, const RVertexWeldSettings& Settings = RVertexWeldSettings());
+
+	/// Reorder triangles for the post-transform vertex cache (Tipsify), then reorder vertices in order of
+	/// first use so vertex fetching stays local
+	static void OptimizeVertexCache(std::vector<UINT>& IndexData, std::vector<RVertexType::MeshLoader>& VertexData, int CacheSize = VertexCacheSize);
+
+	/// Weld vertices and optimize triangle order
+	static RMeshOptimizationStats OptimizeMesh(const std::vector<RVertexType::MeshLoader>& SourceVertices, std::vector<UINT>& IndexData,
+											   std::vector<RVertexType::MeshLoader>& OutVertices, const RVertexWeldSettings& Settings = RVertexWeldSettings());
+
+	/// Simulate a FIFO vertex cache and get average number of cache misses per triangle.
+	/// 0.5 is about the best possible for regular grids, 3 means no vertex is ever reused.
+	static float CalculateACMR(const std::vector<UINT>& IndexData, int NumVertices, int CacheSize = VertexCacheSize);
+};
@@ -0,0 +1,649 @@
+//=============================================================================
+// RNullRenderDevice.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RNullRenderDevice.h"
+
+#include "RShaderManager.h"
+
+#include "Core/CoreTypes.h"
+#include "Core/RLog.h"
+
+#include <type_traits>
+
+namespace
+{
+	/// Reference counted placeholder of a D3D11 object, identified by an id in the command log
+	template<typename TInterface>
+	class TNullDeviceChild : public TInterface
+	{
+	public:
+		explicit TNullDeviceChild(UINT InObjectId)
+			: RefCount(1)
+			, ObjectId(InObjectId)
+		{
+		}
+
+		virtual ~TNullDeviceChild() {}
+
+		UINT GetObjectId() const { return ObjectId; }
+
+		virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) override
+		{
+			if (!ppvObject)
+			{
+				return E_POINTER;
+			}
+
+			if (riid == __uuidof(TInterface) || riid == __uuidof(IUnknown) || riid == __uuidof(ID3D11DeviceChild) ||
+				(std::is_base_of<ID3D11Resource, TInterface>::value && riid == __uuidof(ID3D11Resource)) ||
+				(std::is_base_of<ID3D11View, TInterface>::value && riid == __uuidof(ID3D11View)))
+			{
+				*ppvObject = static_cast<TInterface*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppvObject = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		virtual ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++RefCount;
+		}
+
+		virtual ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG NewRefCount = --RefCount;
+			if (NewRefCount == 0)
+			{
+				delete this;
+			}
+
+			return NewRefCount;
+		}
+
+		virtual void STDMETHODCALLTYPE GetDevice(ID3D11Device** ppDevice) override
+		{
+			*ppDevice = nullptr;
+		}
+
+		virtual HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID guid, UINT* pDataSize, void* pData) override
+		{
+			if (pDataSize)
+			{
+				*pDataSize = 0;
+			}
+
+			return DXGI_ERROR_NOT_FOUND;
+		}
+
+		virtual HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID guid, UINT DataSize, const void* pData) override
+		{
+			return S_OK;
+		}
+
+		virtual HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID guid, const IUnknown* pData) override
+		{
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>	RefCount;
+		UINT				ObjectId;
+	};
+
+	template<typename TInterface, typename TDesc, D3D11_RESOURCE_DIMENSION Dimension>
+	class TNullResource : public TNullDeviceChild<TInterface>
+	{
+	public:
+		TNullResource(UINT InObjectId, const TDesc& InDesc)
+			: TNullDeviceChild<TInterface>(InObjectId)
+			, Desc(InDesc)
+			, EvictionPriority(0)
+		{
+		}
+
+		virtual void STDMETHODCALLTYPE GetType(D3D11_RESOURCE_DIMENSION* pResourceDimension) override	{ *pResourceDimension = Dimension; }
+		virtual void STDMETHODCALLTYPE SetEvictionPriority(UINT InEvictionPriority) override			{ EvictionPriority = InEvictionPriority; }
+		virtual UINT STDMETHODCALLTYPE GetEvictionPriority() override									{ return EvictionPriority; }
+		virtual void STDMETHODCALLTYPE GetDesc(TDesc* pDesc) override									{ *pDesc = Desc; }
+
+	protected:
+		TDesc	Desc;
+		UINT	EvictionPriority;
+	};
+
+	/// Buffers writable by CPU keep a copy of their data in system memory for mapping
+	class RNullBuffer : public TNullResource<ID3D11Buffer, D3D11_BUFFER_DESC, D3D11_RESOURCE_DIMENSION_BUFFER>
+	{
+	public:
+		RNullBuffer(UINT InObjectId, const D3D11_BUFFER_DESC& InDesc, const D3D11_SUBRESOURCE_DATA* InitialData)
+			: TNullResource(InObjectId, InDesc)
+		{
+			if (InDesc.CPUAccessFlags & D3D11_CPU_ACCESS_WRITE)
+			{
+				Data.resize(InDesc.ByteWidth);
+				if (InitialData && InitialData->pSysMem)
+				{
+					memcpy(Data.data(), InitialData->pSysMem, InDesc.ByteWidth);
+				}
+			}
+		}
+
+		BYTE* GetData()				{ return Data.size() ? Data.data() : nullptr; }
+		UINT GetByteWidth() const	{ return Desc.ByteWidth; }
+
+	private:
+		std::vector<BYTE>	Data;
+	};
+
+	typedef TNullResource<ID3D11Texture2D, D3D11_TEXTURE2D_DESC, D3D11_RESOURCE_DIMENSION_TEXTURE2D> RNullTexture2D;
+
+	template<typename TInterface, typename TDesc>
+	class TNullView : public TNullDeviceChild<TInterface>
+	{
+	public:
+		TNullView(UINT InObjectId, ID3D11Resource* InResource, const TDesc* InDesc)
+			: TNullDeviceChild<TInterface>(InObjectId)
+			, Resource(InResource)
+		{
+			if (Resource)
+			{
+				Resource->AddRef();
+			}
+
+			if (InDesc)
+			{
+				Desc = *InDesc;
+			}
+			else
+			{
+				ZeroMemory(&Desc, sizeof(Desc));
+			}
+		}
+
+		virtual ~TNullView()
+		{
+			if (Resource)
+			{
+				Resource->Release();
+			}
+		}
+
+		virtual void STDMETHODCALLTYPE GetResource(ID3D11Resource** ppResource) override
+		{
+			*ppResource = Resource;
+			if (Resource)
+			{
+				Resource->AddRef();
+			}
+		}
+
+		virtual void STDMETHODCALLTYPE GetDesc(TDesc* pDesc) override	{ *pDesc = Desc; }
+
+	private:
+		ID3D11Resource*		Resource;
+		TDesc				Desc;
+	};
+
+	template<typename TInterface, typename TDesc>
+	class TNullState : public TNullDeviceChild<TInterface>
+	{
+	public:
+		TNullState(UINT InObjectId, const TDesc& InDesc)
+			: TNullDeviceChild<TInterface>(InObjectId)
+			, Desc(InDesc)
+		{
+		}
+
+		virtual void STDMETHODCALLTYPE GetDesc(TDesc* pDesc) override	{ *pDesc = Desc; }
+
+	private:
+		TDesc	Desc;
+	};
+
+	/// Get id of an object created by the null device
+	template<typename TInterface>
+	UINT GetObjectId(TInterface* Object)
+	{
+		return Object ? static_cast<TNullDeviceChild<TInterface>*>(Object)->GetObjectId() : 0;
+	}
+
+	UINT GetResourceId(ID3D11Resource* Resource)
+	{
+		if (!Resource)
+		{
+			return 0;
+		}
+
+		D3D11_RESOURCE_DIMENSION Dimension;
+		Resource->GetType(&Dimension);
+
+		if (Dimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+		{
+			return GetObjectId(static_cast<ID3D11Buffer*>(Resource));
+		}
+		else if (Dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+		{
+			return GetObjectId(static_cast<ID3D11Texture2D*>(Resource));
+		}
+
+		return 0;
+	}
+
+	template<typename TInterface>
+	UINT GetFirstObjectId(UINT NumObjects, TInterface* const* Objects)
+	{
+		return (NumObjects > 0 && Objects) ? GetObjectId(Objects[0]) : 0;
+	}
+
+	/// Constant buffer ranges must start and end on 16-constant (256-byte) boundaries, as on hardware devices
+	void CheckConstantBufferRanges(UINT NumBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+	{
+		for (UINT i = 0; i < NumBuffers; i++)
+		{
+			assert(pFirstConstant[i] % 16 == 0);
+			assert(pNumConstants[i] % 16 == 0 && pNumConstants[i] > 0 && pNumConstants[i] <= 4096);
+		}
+	}
+}
+
+RRenderCommandLog::RRenderCommandLog()
+	: NumInstancesDrawn(0)
+	, bRecordCommands(true)
+{
+	memset(Counts, 0, sizeof(Counts));
+}
+
+void RRenderCommandLog::Record(ERenderCommand Type, EShaderType Stage, UINT Slot, UINT Count, UINT InstanceCount, UINT ObjectId)
+{
+	std::lock_guard<std::mutex> Lock(LogMutex);
+
+	Counts[(int)Type]++;
+	NumInstancesDrawn += InstanceCount;
+
+	if (bRecordCommands)
+	{
+		Commands.push_back(RRenderCommand{ Type, Stage, Slot, Count, InstanceCount, ObjectId });
+	}
+}
+
+void RRenderCommandLog::Reset()
+{
+	std::lock_guard<std::mutex> Lock(LogMutex);
+
+	Commands.clear();
+	memset(Counts, 0, sizeof(Counts));
+	NumInstancesDrawn = 0;
+}
+
+UINT RRenderCommandLog::GetNumDrawCalls() const
+{
+	return GetCount(ERenderCommand::Draw) + GetCount(ERenderCommand::DrawIndexed);
+}
+
+void RRenderCommandLog::LogSummary() const
+{
+	RLog("Render commands: %u draw calls, %llu instances, %d commands recorded\n", GetNumDrawCalls(), NumInstancesDrawn, (int)Commands.size());
+
+	for (int i = 0; i < (int)ERenderCommand::Count; i++)
+	{
+		if (Counts[i] > 0)
+		{
+			RLog("  %-22s %u\n", GetCommandName((ERenderCommand)i), Counts[i]);
+		}
+	}
+}
+
+const char* RRenderCommandLog::GetCommandName(ERenderCommand Type)
+{
+	static const char* CommandNames[] =
+	{
+		"CreateBuffer",
+		"CreateTexture",
+		"CreateView",
+		"CreateShader",
+		"CreateInputLayout",
+		"CreateState",
+		"MapBuffer",
+		"SetInputLayout",
+		"SetVertexBuffers",
+		"SetIndexBuffer",
+		"SetPrimitiveTopology",
+		"SetShader",
+		"SetConstantBuffers",
+		"SetShaderResources",
+		"SetSamplers",
+		"SetBlendState",
+		"SetRasterizerState",
+		"SetRenderTargets",
+		"SetViewports",
+		"ClearRenderTarget",
+		"ClearDepthStencil",
+		"Draw",
+		"DrawIndexed",
+		"Present",
+	};
+
+	static_assert(ARRAYSIZE(CommandNames) == (int)ERenderCommand::Count, "Command names don't match command types");
+
+	return CommandNames[(int)Type];
+}
+
+RNullRenderDevice::RNullRenderDevice(UINT InBackBufferWidth, UINT InBackBufferHeight)
+	: NextObjectId(1)
+	, BackBufferWidth(InBackBufferWidth)
+	, BackBufferHeight(InBackBufferHeight)
+{
+}
+
+RNullRenderDevice::~RNullRenderDevice()
+{
+}
+
+HRESULT RNullRenderDevice::CreateBuffer(const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Buffer** ppBuffer)
+{
+	RNullBuffer* Buffer = new RNullBuffer(NextObjectId++, *pDesc, pInitialData);
+	CommandLog.Record(ERenderCommand::CreateBuffer, EShaderType::Unknown, 0, pDesc->ByteWidth, 0, Buffer->GetObjectId());
+
+	*ppBuffer = Buffer;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateTexture2D(const D3D11_TEXTURE2D_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Texture2D** ppTexture2D)
+{
+	RNullTexture2D* Texture = new RNullTexture2D(NextObjectId++, *pDesc);
+	CommandLog.Record(ERenderCommand::CreateTexture, EShaderType::Unknown, 0, 0, 0, Texture->GetObjectId());
+
+	*ppTexture2D = Texture;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateShaderResourceView(ID3D11Resource* pResource, const D3D11_SHADER_RESOURCE_VIEW_DESC* pDesc, ID3D11ShaderResourceView** ppSRView)
+{
+	auto View = new TNullView<ID3D11ShaderResourceView, D3D11_SHADER_RESOURCE_VIEW_DESC>(NextObjectId++, pResource, pDesc);
+	CommandLog.Record(ERenderCommand::CreateView, EShaderType::Unknown, 0, 0, 0, View->GetObjectId());
+
+	*ppSRView = View;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateRenderTargetView(ID3D11Resource* pResource, const D3D11_RENDER_TARGET_VIEW_DESC* pDesc, ID3D11RenderTargetView** ppRTView)
+{
+	auto View = new TNullView<ID3D11RenderTargetView, D3D11_RENDER_TARGET_VIEW_DESC>(NextObjectId++, pResource, pDesc);
+	CommandLog.Record(ERenderCommand::CreateView, EShaderType::Unknown, 0, 0, 0, View->GetObjectId());
+
+	*ppRTView = View;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateDepthStencilView(ID3D11Resource* pResource, const D3D11_DEPTH_STENCIL_VIEW_DESC* pDesc, ID3D11DepthStencilView** ppDepthStencilView)
+{
+	auto View = new TNullView<ID3D11DepthStencilView, D3D11_DEPTH_STENCIL_VIEW_DESC>(NextObjectId++, pResource, pDesc);
+	CommandLog.Record(ERenderCommand::CreateView, EShaderType::Unknown, 0, 0, 0, View->GetObjectId());
+
+	*ppDepthStencilView = View;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC* pInputElementDescs, UINT NumElements, const void* pShaderBytecodeWithInputSignature, SIZE_T BytecodeLength, ID3D11InputLayout** ppInputLayout)
+{
+	auto InputLayout = new TNullDeviceChild<ID3D11InputLayout>(NextObjectId++);
+	CommandLog.Record(ERenderCommand::CreateInputLayout, EShaderType::Unknown, 0, NumElements, 0, InputLayout->GetObjectId());
+
+	*ppInputLayout = InputLayout;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateVertexShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11VertexShader** ppVertexShader)
+{
+	auto Shader = new TNullDeviceChild<ID3D11VertexShader>(NextObjectId++);
+	CommandLog.Record(ERenderCommand::CreateShader, EShaderType::VertexShader, 0, (UINT)BytecodeLength, 0, Shader->GetObjectId());
+
+	*ppVertexShader = Shader;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreatePixelShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11PixelShader** ppPixelShader)
+{
+	auto Shader = new TNullDeviceChild<ID3D11PixelShader>(NextObjectId++);
+	CommandLog.Record(ERenderCommand::CreateShader, EShaderType::PixelShader, 0, (UINT)BytecodeLength, 0, Shader->GetObjectId());
+
+	*ppPixelShader = Shader;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateGeometryShader(const void* pShaderBytecode, SIZE_T BytecodeLength, ID3D11GeometryShader** ppGeometryShader)
+{
+	auto Shader = new TNullDeviceChild<ID3D11GeometryShader>(NextObjectId++);
+	CommandLog.Record(ERenderCommand::CreateShader, EShaderType::GeometryShader, 0, (UINT)BytecodeLength, 0, Shader->GetObjectId());
+
+	*ppGeometryShader = Shader;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateBlendState(const D3D11_BLEND_DESC* pBlendStateDesc, ID3D11BlendState** ppBlendState)
+{
+	auto State = new TNullState<ID3D11BlendState, D3D11_BLEND_DESC>(NextObjectId++, *pBlendStateDesc);
+	CommandLog.Record(ERenderCommand::CreateState, EShaderType::Unknown, 0, 0, 0, State->GetObjectId());
+
+	*ppBlendState = State;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateSamplerState(const D3D11_SAMPLER_DESC* pSamplerDesc, ID3D11SamplerState** ppSamplerState)
+{
+	auto State = new TNullState<ID3D11SamplerState, D3D11_SAMPLER_DESC>(NextObjectId++, *pSamplerDesc);
+	CommandLog.Record(ERenderCommand::CreateState, EShaderType::Unknown, 0, 0, 0, State->GetObjectId());
+
+	*ppSamplerState = State;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CreateRasterizerState(const D3D11_RASTERIZER_DESC* pRasterizerDesc, ID3D11RasterizerState** ppRasterizerState)
+{
+	auto State = new TNullState<ID3D11RasterizerState, D3D11_RASTERIZER_DESC>(NextObjectId++, *pRasterizerDesc);
+	CommandLog.Record(ERenderCommand::CreateState, EShaderType::Unknown, 0, 0, 0, State->GetObjectId());
+
+	*ppRasterizerState = State;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CheckFormatSupport(DXGI_FORMAT Format, UINT* pFormatSupport)
+{
+	// Every format can be used for anything, since nothing is ever rendered
+	*pFormatSupport = ~0u;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::CheckMultisampleQualityLevels(DXGI_FORMAT Format, UINT SampleCount, UINT* pNumQualityLevels)
+{
+	*pNumQualityLevels = 1;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::Map(ID3D11Resource* pResource, UINT Subresource, D3D11_MAP MapType, UINT MapFlags, D3D11_MAPPED_SUBRESOURCE* pMappedResource)
+{
+	D3D11_RESOURCE_DIMENSION Dimension;
+	pResource->GetType(&Dimension);
+
+	RNullBuffer* Buffer = (Dimension == D3D11_RESOURCE_DIMENSION_BUFFER) ? static_cast<RNullBuffer*>(static_cast<ID3D11Buffer*>(pResource)) : nullptr;
+	if (!Buffer || !Buffer->GetData())
+	{
+		// Only buffers created with CPU write access can be mapped
+		return E_INVALIDARG;
+	}
+
+	CommandLog.Record(ERenderCommand::MapBuffer, EShaderType::Unknown, 0, Buffer->GetByteWidth(), 0, Buffer->GetObjectId());
+
+	pMappedResource->pData = Buffer->GetData();
+	pMappedResource->RowPitch = Buffer->GetByteWidth();
+	pMappedResource->DepthPitch = Buffer->GetByteWidth();
+	return S_OK;
+}
+
+void RNullRenderDevice::Unmap(ID3D11Resource* pResource, UINT Subresource)
+{
+}
+
+void RNullRenderDevice::IASetInputLayout(ID3D11InputLayout* pInputLayout)
+{
+	CommandLog.Record(ERenderCommand::SetInputLayout, EShaderType::Unknown, 0, 1, 0, GetObjectId(pInputLayout));
+}
+
+void RNullRenderDevice::IASetVertexBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppVertexBuffers, const UINT* pStrides, const UINT* pOffsets)
+{
+	CommandLog.Record(ERenderCommand::SetVertexBuffers, EShaderType::Unknown, StartSlot, NumBuffers, 0, GetFirstObjectId(NumBuffers, ppVertexBuffers));
+}
+
+void RNullRenderDevice::IASetIndexBuffer(ID3D11Buffer* pIndexBuffer, DXGI_FORMAT Format, UINT Offset)
+{
+	CommandLog.Record(ERenderCommand::SetIndexBuffer, EShaderType::Unknown, 0, 1, 0, GetObjectId(pIndexBuffer));
+}
+
+void RNullRenderDevice::IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY Topology)
+{
+	CommandLog.Record(ERenderCommand::SetPrimitiveTopology, EShaderType::Unknown, 0, (UINT)Topology, 0, 0);
+}
+
+void RNullRenderDevice::VSSetShader(ID3D11VertexShader* pVertexShader)
+{
+	CommandLog.Record(ERenderCommand::SetShader, EShaderType::VertexShader, 0, 1, 0, GetObjectId(pVertexShader));
+}
+
+void RNullRenderDevice::PSSetShader(ID3D11PixelShader* pPixelShader)
+{
+	CommandLog.Record(ERenderCommand::SetShader, EShaderType::PixelShader, 0, 1, 0, GetObjectId(pPixelShader));
+}
+
+void RNullRenderDevice::GSSetShader(ID3D11GeometryShader* pGeometryShader)
+{
+	CommandLog.Record(ERenderCommand::SetShader, EShaderType::GeometryShader, 0, 1, 0, GetObjectId(pGeometryShader));
+}
+
+void RNullRenderDevice::VSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+{
+	CommandLog.Record(ERenderCommand::SetConstantBuffers, EShaderType::VertexShader, StartSlot, NumBuffers, 0, GetFirstObjectId(NumBuffers, ppConstantBuffers));
+}
+
+void RNullRenderDevice::PSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+{
+	CommandLog.Record(ERenderCommand::SetConstantBuffers, EShaderType::PixelShader, StartSlot, NumBuffers, 0, GetFirstObjectId(NumBuffers, ppConstantBuffers));
+}
+
+void RNullRenderDevice::GSSetConstantBuffers(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers)
+{
+	CommandLog.Record(ERenderCommand::SetConstantBuffers, EShaderType::GeometryShader, StartSlot, NumBuffers, 0, GetFirstObjectId(NumBuffers, ppConstantBuffers));
+}
+
+void RNullRenderDevice::VSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+{
+	CheckConstantBufferRanges(NumBuffers, pFirstConstant, pNumConstants);
+	CommandLog.Record(ERenderCommand::SetConstantBuffers, EShaderType::VertexShader, StartSlot, NumBuffers, 0, GetFirstObjectId(NumBuffers, ppConstantBuffers));
+}
+
+void RNullRenderDevice::PSSetConstantBuffers1(UINT StartSlot, UINT NumBuffers, ID3D11Buffer* const* ppConstantBuffers, const UINT* pFirstConstant, const UINT* pNumConstants)
+{
+	CheckConstantBufferRanges(NumBuffers, pFirstConstant, pNumConstants);
+	CommandLog.Record(ERenderCommand::SetConstantBuffers, EShaderType::PixelShader, StartSlot, NumBuffers, 0, GetFirstObjectId(NumBuffers, ppConstantBuffers));
+}
+
+void RNullRenderDevice::PSSetShaderResources(UINT StartSlot, UINT NumViews, ID3D11ShaderResourceView* const* ppShaderResourceViews)
+{
+	CommandLog.Record(ERenderCommand::SetShaderResources, EShaderType::PixelShader, StartSlot, NumViews, 0, GetFirstObjectId(NumViews, ppShaderResourceViews));
+}
+
+void RNullRenderDevice::PSSetSamplers(UINT StartSlot, UINT NumSamplers, ID3D11SamplerState* const* ppSamplers)
+{
+	CommandLog.Record(ERenderCommand::SetSamplers, EShaderType::PixelShader, StartSlot, NumSamplers, 0, GetFirstObjectId(NumSamplers, ppSamplers));
+}
+
+void RNullRenderDevice::OMSetRenderTargets(UINT NumViews, ID3D11RenderTargetView* const* ppRenderTargetViews, ID3D11DepthStencilView* pDepthStencilView)
+{
+	CommandLog.Record(ERenderCommand::SetRenderTargets, EShaderType::Unknown, 0, NumViews, 0, GetFirstObjectId(NumViews, ppRenderTargetViews));
+}
+
+void RNullRenderDevice::OMSetBlendState(ID3D11BlendState* pBlendState, const FLOAT BlendFactor[4], UINT SampleMask)
+{
+	CommandLog.Record(ERenderCommand::SetBlendState, EShaderType::Unknown, 0, 1, 0, GetObjectId(pBlendState));
+}
+
+void RNullRenderDevice::RSSetState(ID3D11RasterizerState* pRasterizerState)
+{
+	CommandLog.Record(ERenderCommand::SetRasterizerState, EShaderType::Unknown, 0, 1, 0, GetObjectId(pRasterizerState));
+}
+
+void RNullRenderDevice::RSSetViewports(UINT NumViewports, const D3D11_VIEWPORT* pViewports)
+{
+	CommandLog.Record(ERenderCommand::SetViewports, EShaderType::Unknown, 0, NumViewports, 0, 0);
+}
+
+void RNullRenderDevice::ClearRenderTargetView(ID3D11RenderTargetView* pRenderTargetView, const FLOAT ColorRGBA[4])
+{
+	CommandLog.Record(ERenderCommand::ClearRenderTarget, EShaderType::Unknown, 0, 1, 0, GetObjectId(pRenderTargetView));
+}
+
+void RNullRenderDevice::ClearDepthStencilView(ID3D11DepthStencilView* pDepthStencilView, UINT ClearFlags, FLOAT Depth, UINT8 Stencil)
+{
+	CommandLog.Record(ERenderCommand::ClearDepthStencil, EShaderType::Unknown, 0, 1, 0, GetObjectId(pDepthStencilView));
+}
+
+void RNullRenderDevice::Draw(UINT VertexCount, UINT StartVertexLocation)
+{
+	CommandLog.Record(ERenderCommand::Draw, EShaderType::Unknown, 0, VertexCount, 1, 0);
+}
+
+void RNullRenderDevice::DrawIndexed(UINT IndexCount, UINT StartIndexLocation, INT BaseVertexLocation)
+{
+	CommandLog.Record(ERenderCommand::DrawIndexed, EShaderType::Unknown, 0, IndexCount, 1, 0);
+}
+
+void RNullRenderDevice::DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation)
+{
+	CommandLog.Record(ERenderCommand::Draw, EShaderType::Unknown, 0, VertexCountPerInstance, InstanceCount, 0);
+}
+
+void RNullRenderDevice::DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation)
+{
+	CommandLog.Record(ERenderCommand::DrawIndexed, EShaderType::Unknown, 0, IndexCountPerInstance, InstanceCount, 0);
+}
+
+HRESULT RNullRenderDevice::CreateBackBufferRenderTargetView(ID3D11RenderTargetView** ppRTView)
+{
+	D3D11_TEXTURE2D_DESC BackBufferDesc;
+	ZeroMemory(&BackBufferDesc, sizeof(BackBufferDesc));
+	BackBufferDesc.Width = BackBufferWidth;
+	BackBufferDesc.Height = BackBufferHeight;
+	BackBufferDesc.MipLevels = 1;
+	BackBufferDesc.ArraySize = 1;
+	BackBufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	BackBufferDesc.SampleDesc.Count = 1;
+	BackBufferDesc.Usage = D3D11_USAGE_DEFAULT;
+	BackBufferDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+	ID3D11Texture2D* BackBuffer;
+	CreateTexture2D(&BackBufferDesc, nullptr, &BackBuffer);
+
+	// View keeps a reference to the back buffer
+	HRESULT hr = CreateRenderTargetView(BackBuffer, nullptr, ppRTView);
+	BackBuffer->Release();
+
+	return hr;
+}
+
+HRESULT RNullRenderDevice::ResizeBackBuffer(UINT Width, UINT Height)
+{
+	BackBufferWidth = Width;
+	BackBufferHeight = Height;
+	return S_OK;
+}
+
+HRESULT RNullRenderDevice::Present(UINT SyncInterval)
+{
+	CommandLog.Record(ERenderCommand::Present, EShaderType::Unknown, 0, 0, 0, 0);
+	return S_OK;
+}
@@ -168,7 +168,7 @@ void RPostProcessorManager::SetupRenderTarget()
 
 	// Set the size of viewport as full window buffer
 	D3D11_VIEWPORT vp = { 0.0f, 0.0f, (FLOAT)GRenderer.GetClientWidth(), (FLOAT)GRenderer.GetClientHeight(), 0.0f, 1.0f };
-	GRenderer.D3DImmediateContext()->RSSetViewports(1, &vp);
+	GRenderer.Device()->RSSetViewports(1, &vp);
 }
 
 void RPostProcessorManager::Draw(RPostProcessingEffect* Effect)
@@ -180,9 +180,9 @@ void RPostProcessorManager::Draw(RPostProcessingEffect* Effect)
 		GRenderer.SetGeometryShader(nullptr);
 
 		// Do not set shader resource view in deferred rendering
-		//GRenderer.D3DImmediateContext()->PSSetShaderResources(0, 1, &m_RTSRV);
+		//GRenderer.Device()->PSSetShaderResources(0, 1, &m_RTSRV);
 
-		GRenderer.D3DImmediateContext()->IASetInputLayout(m_InputLayout);
+		GRenderer.Device()->IASetInputLayout(m_InputLayout);
 		m_ScreenQuad.Draw();
 	}
 }
@@ -208,8 +208,8 @@ void RPostProcessorManager::CreateRenderTargetResources()
 	renderTargetTextureDesc.CPUAccessFlags = 0;
 	renderTargetTextureDesc.MiscFlags = 0;
 
-	GRenderer.D3DDevice()->CreateTexture2D(&renderTargetTextureDesc, 0, &m_RTBuffer);
-	GRenderer.D3DDevice()->CreateRenderTargetView(m_RTBuffer, 0, &m_RTView);
+	GRenderer.Device()->CreateTexture2D(&renderTargetTextureDesc, 0, &m_RTBuffer);
+	GRenderer.Device()->CreateRenderTargetView(m_RTBuffer, 0, &m_RTView);
 
 	D3D11_SHADER_RESOURCE_VIEW_DESC rtsrvDesc;
 	rtsrvDesc.Format = renderTargetTextureDesc.Format;
@@ -217,11 +217,11 @@ void RPostProcessorManager::CreateRenderTargetResources()
 	rtsrvDesc.Texture2D.MostDetailedMip = 0;
 	rtsrvDesc.Texture2D.MipLevels = 1;
 
-	GRenderer.D3DDevice()->CreateShaderResourceView(m_RTBuffer, &rtsrvDesc, &m_RTSRV);
+	GRenderer.Device()->CreateShaderResourceView(m_RTBuffer, &rtsrvDesc, &m_RTSRV);
 
 	renderTargetTextureDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
 	renderTargetTextureDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
 
-	GRenderer.D3DDevice()->CreateTexture2D(&renderTargetTextureDesc, 0, &m_RTDepthBuffer);
-	GRenderer.D3DDevice()->CreateDepthStencilView(m_RTDepthBuffer, 0, &m_RTDepthStencilView);
+	GRenderer.Device()->CreateTexture2D(&renderTargetTextureDesc, 0, &m_RTDepthBuffer);
+	GRenderer.Device()->CreateDepthStencilView(m_RTDepthBuffer, 0, &m_RTDepthStencilView);
 }
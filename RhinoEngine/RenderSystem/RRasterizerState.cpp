@@ -57,7 +57,7 @@ void RRasterizerState::Apply(size_t RasterizerStateHash)
 	auto Iter = RasterizerStateMap.find(RasterizerStateHash);
 	if (Iter != RasterizerStateMap.end())
 	{
-		GRenderer.D3DImmediateContext()->RSSetState(Iter->second.RasterizerStateObject.Get());
+		GRenderer.Device()->RSSetState(Iter->second.RasterizerStateObject.Get());
 	}
 	else
 	{
@@ -79,7 +79,7 @@ size_t RRasterizerState::FindOrAddRasterizerStateHash(const D3D11_RASTERIZER_DES
 	}
 
 	ComPtr<ID3D11RasterizerState> RasterizerState;
-	GRenderer.D3DDevice()->CreateRasterizerState(&Desc, RasterizerState.GetAddressOf());
+	GRenderer.Device()->CreateRasterizerState(&Desc, RasterizerState.GetAddressOf());
 	RasterizerStateMap[Hash] = RasterizerStateData(RasterizerState, Desc);
 
 	return Hash;
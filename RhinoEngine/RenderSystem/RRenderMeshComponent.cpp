@@ -10,6 +10,7 @@
 #include "RMesh.h"
 #include "Scene/RSceneObject.h"
 #include "RShaderConstantBuffer.h"
+#include "RRenderQueue.h"
 
 RRenderMeshComponent::RRenderMeshComponent(RSceneObject* InOwner)
 	: Base(InOwner),
@@ -67,7 +68,7 @@ void RRenderMeshComponent::Render(const RenderViewInfo& View) const
 			{
 				const RMeshElement& MeshElement = m_Mesh->GetMeshElement(i);
 				bool bSkinned = MeshElement.GetFlag() & MEF_Skinned;
-				RMaterial* Material = (i < (int)m_Materials.size()) ? m_Materials[i] : nullptr;
+				RMaterial* Material = (i < (int)m_Materials.size()) ? m_Materials[i].Get() : nullptr;
 				GRenderer.BindMaterial(Material, bSkinned);
 
 				m_Mesh->GetMeshElement(i).Draw();
@@ -113,6 +114,46 @@ void RRenderMeshComponent::RenderDepthPass(const RenderViewInfo& View) const
 	}
 }
 
+bool RRenderMeshComponent::GetWorldBounds(RAabb& OutBounds) const
+{
+	if (!m_Mesh || !m_Mesh->IsLoaded())
+	{
+		return false;
+	}
+
+	OutBounds = m_Mesh->GetLocalSpaceAabb().GetTransformedAabb(GetOwner()->GetTransformMatrix());
+	return true;
+}
+
+void RRenderMeshComponent::AddToRenderQueue(RRenderQueue& Queue, bool bDepthPass) const
+{
+	if (!m_Mesh || !m_Mesh->IsLoaded() || (!bDepthPass && m_PostponeLoadMaterials))
+	{
+		return;
+	}
+
+	const UINT ObjectIndex = Queue.AddObject(GetOwner()->GetTransformMatrix());
+	const UINT32 NumMeshElements = (UINT32)m_Mesh->GetMeshElementCount();
+
+	for (UINT32 i = 0; i < NumMeshElements; i++)
+	{
+		const RMeshElement& MeshElement = m_Mesh->GetMeshElement(i);
+		bool bSkinned = MeshElement.GetFlag() & MEF_Skinned;
+
+		RMaterial* Material = nullptr;
+		if (bDepthPass)
+		{
+			Material = RMaterial::GetDepthOnly();
+		}
+		else if (i < (UINT32)m_Materials.size())
+		{
+			Material = m_Materials[i].Get();
+		}
+
+		Queue.AddDrawPacket(ObjectIndex, &MeshElement, Material, bSkinned);
+	}
+}
+
 void RRenderMeshComponent::SetMesh(const RMesh* Mesh)
 {
 	m_Mesh = Mesh;
@@ -163,8 +204,9 @@ void RRenderMeshComponent::LoadMaterialsFromMeshResource()
 	assert(m_Mesh);
 
 	const UINT32 NumMeshElements = (UINT32)m_Mesh->GetMeshElementCount();
+	const std::vector<RMaterial*>& MeshMaterials = m_Mesh->GetMaterials();
 	m_Materials.reserve(NumMeshElements);
-	m_Materials = m_Mesh->GetMaterials();
+	m_Materials.assign(MeshMaterials.begin(), MeshMaterials.end());
 
 	const UINT32 NumMaterials = (UINT32)m_Materials.size();
 
@@ -9,8 +9,10 @@
 
 #include "RRenderSystemTypes.h"
 #include "RMaterial.h"
+#include "Resource/RResourceHandle.h"
 
 class RMesh;
+class RRenderQueue;
 
 struct PendingAssignedMaterial
 {
@@ -32,6 +34,12 @@ public:
 	/// Render the component in depth pass for shadow map
 	void RenderDepthPass(const RenderViewInfo& View) const;
 
+	/// Get world space bounds of the mesh. Returns false if the mesh is not loaded yet.
+	bool GetWorldBounds(RAabb& OutBounds) const;
+
+	/// Add draws of all mesh elements to a render queue. Visibility is tested by the caller.
+	void AddToRenderQueue(RRenderQueue& Queue, bool bDepthPass) const;
+
 	/// Set mesh resource for the component to render
 	void SetMesh(const RMesh* Mesh);
 
@@ -45,8 +53,8 @@ private:
 
 	void LoadMaterialsFromMeshResource();
 
-	const RMesh*			m_Mesh;
-	std::vector<RMaterial*>		m_Materials;
+	RResourceHandle<const RMesh>	m_Mesh;
+	std::vector<RMaterialHandle>	m_Materials;
 
 	bool					m_PostponeLoadMaterials;
 	std::vector<PendingAssignedMaterial>	m_PendingAssignedMaterials;
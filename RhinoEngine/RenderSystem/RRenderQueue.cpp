@@ -0,0 +1,464 @@
+//=============================================================================
+// RRenderQueue.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RRenderQueue.h"
+
+#include "RRenderSystem.h"
+#include "RMaterial.h"
+#include "RMeshElement.h"
+#include "RShaderManager.h"
+#include "RShaderConstantBuffer.h"
+#include "ILight.h"
+#include "Scene/RSceneObject.h"
+
+namespace
+{
+	// Sort key layout, from the highest bit:
+	//   Opaque:      | pass (2) | 0 | shader (15) | skinned (1) | material (21) | depth, front to back (24) |
+	//   Translucent: | pass (2) | 1 | depth, back to front (24) | shader (15) | skinned (1) | material (21) |
+	// Opaque draws which can be instanced replace the highest 12 bits of depth with their mesh element,
+	// so draws of the same mesh element and material are next to each other.
+	const int RenderPassShift	= 62;
+	const int TranslucentShift	= 61;
+
+	const int DepthBits			= 24;
+	const int ShaderBits		= 15;
+	const int MaterialBits		= 21;
+
+	const UINT64 DepthMask		= (1ull << DepthBits) - 1;
+	const UINT64 ShaderMask		= (1ull << ShaderBits) - 1;
+	const UINT64 MaterialMask	= (1ull << MaterialBits) - 1;
+
+	const int InstancedDepthBits	= 12;
+	const UINT64 MeshElementMask	= (1ull << (DepthBits - InstancedDepthBits)) - 1;
+
+	/// Quantize a non-negative depth to its highest 24 bits. Bit patterns of non-negative floats
+	/// are ordered the same way as their values, so no depth range is needed.
+	UINT64 QuantizeDepth(float Depth)
+	{
+		UINT32 Bits;
+		memcpy(&Bits, &Depth, sizeof(Bits));
+		return (Bits & 0x7FFFFFFF) >> (31 - DepthBits);
+	}
+
+	bool IsTranslucent(BlendState BlendMode)
+	{
+		return BlendMode == BlendState::AlphaBlending || BlendMode == BlendState::Additive;
+	}
+}
+
+RRenderQueue::RRenderQueue()
+	: RenderPass(ERenderPass::SceneObject)
+	, ViewPosition(RVec3::Zero())
+	, bInstancingEnabled(true)
+{
+}
+
+void RRenderQueue::Reset(ERenderPass InRenderPass, const RVec3& InViewPosition)
+{
+	RenderPass = InRenderPass;
+	ViewPosition = InViewPosition;
+
+	Objects.clear();
+	DrawPackets.clear();
+	Lights.clear();
+	LightLists.clear();
+}
+
+UINT RRenderQueue::AddObject(const RMatrix4& WorldMatrix, RSceneObject* SceneObject /*= nullptr*/, int LightListIndex /*= -1*/)
+{
+	const bool bHasDrawConstantBuffers = SceneObject && SceneObject->HasDrawConstantBuffers();
+	Objects.push_back({ WorldMatrix, SceneObject, bHasDrawConstantBuffers, LightListIndex });
+	return (UINT)Objects.size() - 1;
+}
+
+int RRenderQueue::AddLightList(const ILight* const* InLights, int NumLights)
+{
+	LightLists.push_back(std::make_pair((int)Lights.size(), NumLights));
+	Lights.insert(Lights.end(), InLights, InLights + NumLights);
+	return (int)LightLists.size() - 1;
+}
+
+void RRenderQueue::AddDrawPacket(UINT ObjectIndex, const RMeshElement* MeshElement, RMaterial* Material, bool bSkinned)
+{
+	assert(ObjectIndex < (UINT)Objects.size());
+
+	RDrawPacket Packet;
+	Packet.MeshElement = MeshElement;
+	Packet.Material = Material ? Material : RMaterial::GetDefault();
+	Packet.ObjectIndex = ObjectIndex;
+	Packet.bSkinned = bSkinned;
+	Packet.bInstanceable = false;
+
+	DrawPackets.push_back(Packet);
+}
+
+void RRenderQueue::Submit()
+{
+	if (DrawPackets.empty())
+	{
+		return;
+	}
+
+	const int NumPackets = (int)DrawPackets.size();
+	SortItems.resize(NumPackets);
+
+	for (int i = 0; i < NumPackets; i++)
+	{
+		RDrawPacket& Packet = DrawPackets[i];
+		RShader* Shader = Packet.Material->GetShader();
+		if (Shader == nullptr)
+		{
+			Shader = GShaderManager.GetDefaultShader();
+		}
+
+		// Skinned draws and objects with constant buffers of their own set up states for each object,
+		// so they are never instanced
+		Packet.bInstanceable = bInstancingEnabled && !Packet.bSkinned && Shader->VertexShader_Instanced &&
+							   !Objects[Packet.ObjectIndex].bHasDrawConstantBuffers;
+
+		const RVec3 Offset = Objects[Packet.ObjectIndex].WorldMatrix.GetTranslation() - ViewPosition;
+		SortItems[i] = std::make_pair(MakeSortKey(Shader, Packet, Offset.SquaredMagitude()), (UINT)i);
+	}
+
+	RadixSort(SortItems, SortScratch);
+	BuildDrawRuns();
+
+	// Constants of all draws are uploaded to the ring at once if they fit
+	RConstantBufferRing* Ring = GRenderer.GetConstantBufferRing();
+	const bool bUseRing = Ring && UploadConstantsToRing(*Ring);
+
+	// Constant buffers are bound to their slots once for the whole queue, and only their data
+	// is updated between draws
+	if (!bUseRing)
+	{
+		RConstantBuffers::cbPerObject.BindBuffer();
+		RConstantBuffers::cbInstance.BindBuffer();
+		RConstantBuffers::cbMaterial.BindBuffer();
+	}
+	RConstantBuffers::cbLight.BindBuffer();
+
+	RRenderStateCache StateCache;
+	StateCache.bMaterialConstantsInRing = bUseRing;
+	int CurrentLightListIndex = -1;
+
+	for (const RDrawRun& Run : DrawRuns)
+	{
+		const RDrawPacket& Packet = DrawPackets[SortItems[Run.FirstItem].second];
+		const RRenderQueueObject& Object = Objects[Packet.ObjectIndex];
+
+		if (Run.NumInstances > 1)
+		{
+			SetupLights(Object.LightListIndex, CurrentLightListIndex);
+
+			if (bUseRing)
+			{
+				RConstantBuffers::cbInstance.BindRingSlice(*Ring, Run.ObjectConstantsOffset, (UINT)sizeof(RMatrix4) * Run.NumInstances);
+			}
+			else
+			{
+				for (int i = 0; i < Run.NumInstances; i++)
+				{
+					const RDrawPacket& Instance = DrawPackets[SortItems[Run.FirstItem + i].second];
+					RConstantBuffers::cbInstance.Data.instancedWorldMatrix[i] = Objects[Instance.ObjectIndex].WorldMatrix;
+				}
+				RConstantBuffers::cbInstance.UpdateBufferData();
+			}
+		}
+		else if (Run.bNewObject)
+		{
+			SetupLights(Object.LightListIndex, CurrentLightListIndex);
+
+			if (bUseRing)
+			{
+				RConstantBuffers::cbPerObject.BindRingSlice(*Ring, Run.ObjectConstantsOffset);
+			}
+			else
+			{
+				RConstantBuffers::cbPerObject.Data.worldMatrix = Object.WorldMatrix;
+				RConstantBuffers::cbPerObject.UpdateBufferData();
+			}
+
+			if (Object.SceneObject)
+			{
+				Object.SceneObject->SetupDrawConstantBuffers();
+			}
+		}
+
+		if (bUseRing && Run.bNewMaterial)
+		{
+			RConstantBuffers::cbMaterial.BindRingSlice(*Ring, Run.MaterialConstantsOffset);
+		}
+
+		if (Run.NumInstances > 1)
+		{
+			GRenderer.BindMaterial(Packet.Material, false, true, &StateCache);
+			Packet.MeshElement->DrawInstanced(Run.NumInstances, &StateCache);
+		}
+		else
+		{
+			GRenderer.BindMaterial(Packet.Material, Packet.bSkinned, false, &StateCache);
+			Packet.MeshElement->Draw(&StateCache);
+		}
+	}
+
+	// Code drawing outside of render queues updates and expects whole constant buffers
+	if (bUseRing)
+	{
+		RConstantBuffers::cbPerObject.BindBuffer();
+		RConstantBuffers::cbInstance.BindBuffer();
+		RConstantBuffers::cbMaterial.BindBuffer();
+	}
+}
+
+void RRenderQueue::BuildDrawRuns()
+{
+	DrawRuns.clear();
+
+	const int NumItems = (int)SortItems.size();
+	UINT CurrentObjectIndex = (UINT)-1;
+	const RMaterial* CurrentMaterial = nullptr;
+
+	for (int ItemIndex = 0; ItemIndex < NumItems; )
+	{
+		const RDrawPacket& Packet = DrawPackets[SortItems[ItemIndex].second];
+
+		// Count the following packets which can be drawn as instances of this one
+		int NumInstances = 1;
+		if (Packet.bInstanceable)
+		{
+			while (ItemIndex + NumInstances < NumItems && NumInstances < MAX_INSTANCE_COUNT &&
+				   IsSameInstance(Packet, DrawPackets[SortItems[ItemIndex + NumInstances].second]))
+			{
+				NumInstances++;
+			}
+		}
+
+		RDrawRun Run;
+		Run.FirstItem = ItemIndex;
+		Run.NumInstances = NumInstances;
+		Run.bNewObject = NumInstances == 1 && Packet.ObjectIndex != CurrentObjectIndex;
+		Run.bNewMaterial = DrawRuns.empty() || Packet.Material != CurrentMaterial;
+		Run.ObjectConstantsOffset = 0;
+		Run.MaterialConstantsOffset = 0;
+
+		DrawRuns.push_back(Run);
+
+		// Instanced draws don't change per-object constants
+		if (Run.bNewObject)
+		{
+			CurrentObjectIndex = Packet.ObjectIndex;
+		}
+		CurrentMaterial = Packet.Material;
+
+		ItemIndex += NumInstances;
+	}
+}
+
+bool RRenderQueue::UploadConstantsToRing(RConstantBufferRing& Ring)
+{
+	const UINT ObjectSliceSize = RConstantBufferRing::AlignSliceSize(sizeof(SHADER_OBJECT_BUFFER));
+	const UINT MaterialSliceSize = RConstantBufferRing::AlignSliceSize(sizeof(SHADER_MATERIAL_BUFFER));
+
+	UINT TotalSize = 0;
+	for (const RDrawRun& Run : DrawRuns)
+	{
+		if (Run.NumInstances > 1)
+		{
+			TotalSize += RConstantBufferRing::AlignSliceSize((UINT)sizeof(RMatrix4) * Run.NumInstances);
+		}
+		else if (Run.bNewObject)
+		{
+			TotalSize += ObjectSliceSize;
+		}
+
+		if (Run.bNewMaterial)
+		{
+			TotalSize += MaterialSliceSize;
+		}
+	}
+
+	UINT BaseOffset;
+	BYTE* MappedData = (BYTE*)Ring.Map(TotalSize, BaseOffset);
+	if (!MappedData)
+	{
+		return false;
+	}
+
+	UINT Offset = 0;
+	for (RDrawRun& Run : DrawRuns)
+	{
+		const RDrawPacket& Packet = DrawPackets[SortItems[Run.FirstItem].second];
+
+		if (Run.NumInstances > 1)
+		{
+			for (int i = 0; i < Run.NumInstances; i++)
+			{
+				const RDrawPacket& Instance = DrawPackets[SortItems[Run.FirstItem + i].second];
+				memcpy(MappedData + Offset + i * sizeof(RMatrix4), &Objects[Instance.ObjectIndex].WorldMatrix, sizeof(RMatrix4));
+			}
+
+			Run.ObjectConstantsOffset = BaseOffset + Offset;
+			Offset += RConstantBufferRing::AlignSliceSize((UINT)sizeof(RMatrix4) * Run.NumInstances);
+		}
+		else if (Run.bNewObject)
+		{
+			memcpy(MappedData + Offset, &Objects[Packet.ObjectIndex].WorldMatrix, sizeof(RMatrix4));
+
+			Run.ObjectConstantsOffset = BaseOffset + Offset;
+			Offset += ObjectSliceSize;
+		}
+
+		// Material constants are made in the same order as binding materials one by one would make them
+		if (Run.bNewMaterial)
+		{
+			GRenderer.UpdateMaterialConstants(Packet.Material);
+			memcpy(MappedData + Offset, &RConstantBuffers::cbMaterial.Data, sizeof(SHADER_MATERIAL_BUFFER));
+
+			Run.MaterialConstantsOffset = BaseOffset + Offset;
+			Offset += MaterialSliceSize;
+		}
+	}
+
+	Ring.Unmap();
+	return true;
+}
+
+void RRenderQueue::RadixSort(std::vector<std::pair<UINT64, UINT>>& Items, std::vector<std::pair<UINT64, UINT>>& Scratch)
+{
+	const size_t NumItems = Items.size();
+	if (NumItems <= 1)
+	{
+		return;
+	}
+
+	// Histograms of all eight digits are built in a single pass
+	UINT Histograms[8][256] = {};
+	for (const auto& Item : Items)
+	{
+		for (int Digit = 0; Digit < 8; Digit++)
+		{
+			Histograms[Digit][(Item.first >> (Digit * 8)) & 0xFF]++;
+		}
+	}
+
+	Scratch.resize(NumItems);
+
+	std::vector<std::pair<UINT64, UINT>>* Source = &Items;
+	std::vector<std::pair<UINT64, UINT>>* Destination = &Scratch;
+
+	for (int Digit = 0; Digit < 8; Digit++)
+	{
+		UINT* Histogram = Histograms[Digit];
+		const int Shift = Digit * 8;
+
+		// All keys have the same digit, order doesn't change
+		if (Histogram[((*Source)[0].first >> Shift) & 0xFF] == (UINT)NumItems)
+		{
+			continue;
+		}
+
+		UINT Offset = 0;
+		for (int i = 0; i < 256; i++)
+		{
+			UINT Count = Histogram[i];
+			Histogram[i] = Offset;
+			Offset += Count;
+		}
+
+		for (const auto& Item : *Source)
+		{
+			(*Destination)[Histogram[(Item.first >> Shift) & 0xFF]++] = Item;
+		}
+
+		std::swap(Source, Destination);
+	}
+
+	if (Source != &Items)
+	{
+		Items.swap(Scratch);
+	}
+}
+
+UINT64 RRenderQueue::MakeSortKey(const RShader* Shader, const RDrawPacket& Packet, float ViewDepth) const
+{
+	// Shaders not owned by the shader manager have no id, and share the first one
+	const UINT64 ShaderId = (UINT64)(Shader->GetId() + 1) & ShaderMask;
+
+	// Ids of materials and mesh elements wrap around in their bits. Draws whose ids collide still sort
+	// correctly, they're just not grouped with others sharing their states.
+	const UINT64 MaterialId = (UINT64)Packet.Material->GetSortId() & MaterialMask;
+	UINT64 Depth = QuantizeDepth(ViewDepth);
+
+	UINT64 Key = (UINT64)RenderPass << RenderPassShift;
+
+	const UINT64 StateBits = (ShaderId << (MaterialBits + 1)) | ((Packet.bSkinned ? 1ull : 0ull) << MaterialBits) | MaterialId;
+
+	if (IsTranslucent(Packet.Material->GetBlendMode()))
+	{
+		// Translucent draws are blended back to front
+		Key |= 1ull << TranslucentShift;
+		Key |= (DepthMask - Depth) << (ShaderBits + 1 + MaterialBits);
+		Key |= StateBits;
+	}
+	else
+	{
+		// Opaque draws are grouped by states, and drawn front to back within a group to reject hidden pixels early
+		if (Packet.bInstanceable)
+		{
+			const UINT64 MeshElementId = (UINT64)Packet.MeshElement->GetSortId() & MeshElementMask;
+			Depth = (MeshElementId << InstancedDepthBits) | (Depth >> (DepthBits - InstancedDepthBits));
+		}
+
+		Key |= StateBits << DepthBits;
+		Key |= Depth;
+	}
+
+	return Key;
+}
+
+bool RRenderQueue::IsSameInstance(const RDrawPacket& Packet, const RDrawPacket& Other) const
+{
+	// Instances share all states except world matrices, including the light constant buffer
+	return Other.bInstanceable &&
+		   Other.MeshElement == Packet.MeshElement &&
+		   Other.Material == Packet.Material &&
+		   IsSameLightList(Objects[Other.ObjectIndex].LightListIndex, Objects[Packet.ObjectIndex].LightListIndex);
+}
+
+void RRenderQueue::SetupLights(int LightListIndex, int& CurrentLightListIndex) const
+{
+	if (LightListIndex < 0 || IsSameLightList(LightListIndex, CurrentLightListIndex))
+	{
+		return;
+	}
+
+	const std::pair<int, int>& LightList = LightLists[LightListIndex];
+
+	RConstantBuffers::cbLight.Data.PointLightCount = 0;
+	for (int i = 0; i < LightList.second; i++)
+	{
+		Lights[LightList.first + i]->SetupConstantBuffer(RConstantBuffers::cbLight.Data.PointLightCount);
+		RConstantBuffers::cbLight.Data.PointLightCount++;
+	}
+
+	RConstantBuffers::cbLight.UpdateBufferData();
+	CurrentLightListIndex = LightListIndex;
+}
+
+bool RRenderQueue::IsSameLightList(int LhsIndex, int RhsIndex) const
+{
+	if (LhsIndex < 0 || RhsIndex < 0)
+	{
+		return LhsIndex == RhsIndex;
+	}
+
+	const std::pair<int, int>& Lhs = LightLists[LhsIndex];
+	const std::pair<int, int>& Rhs = LightLists[RhsIndex];
+
+	return Lhs.second == Rhs.second &&
+		   std::equal(Lights.begin() + Lhs.first, Lights.begin() + Lhs.first + Lhs.second, Lights.begin() + Rhs.first);
+}
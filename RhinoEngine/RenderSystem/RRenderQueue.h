@@ -0,0 +1,134 @@
+//=============================================================================
+// RRenderQueue.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Queue of draw packets sorted by 64-bit keys and submitted with state batching
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+#include "RRenderSystemTypes.h"
+
+class RMeshElement;
+class RMaterial;
+class RSceneObject;
+class ILight;
+class RConstantBufferRing;
+struct RShader;
+
+/// A single mesh element draw with its material
+struct RDrawPacket
+{
+	const RMeshElement*	MeshElement;
+	RMaterial*			Material;
+	UINT				ObjectIndex;
+	bool				bSkinned;
+
+	// Set on submitting. The packet's shader has an instanced vertex shader and the packet can be
+	// drawn in one instanced draw with other packets of the same mesh element and material.
+	bool				bInstanceable;
+};
+
+/// Per-object states shared by all draw packets of an object
+struct RRenderQueueObject
+{
+	RMatrix4			WorldMatrix;
+
+	// Scene object which may set up additional constant buffers before being drawn. Optional.
+	RSceneObject*		SceneObject;
+
+	// The scene object sets up constant buffers of its own, so its packets are never instanced
+	bool				bHasDrawConstantBuffers;
+
+	// Point lights affecting the object, or -1 to leave the light constant buffer unchanged
+	int					LightListIndex;
+};
+
+/// Sorted draw packets submitted with one draw call, and the constants they need
+struct RDrawRun
+{
+	// First sort item and number of packets. Runs of more than one packet are drawn instanced.
+	int					FirstItem;
+	int					NumInstances;
+
+	// Per-object and material constants change before the draw
+	bool				bNewObject;
+	bool				bNewMaterial;
+
+	// Byte offsets of the constants in the constant buffer ring, if it's used
+	UINT				ObjectConstantsOffset;
+	UINT				MaterialConstantsOffset;
+};
+
+/// Collects draw packets of a render pass, sorts them by 64-bit keys and submits them in sorted order.
+/// Keys are made of (from the highest bits) render pass, translucency, shader, material and view depth,
+/// so draws sharing shaders and materials end up next to each other and any bind which matches
+/// the state set by the previous draw is skipped.
+/// Runs of packets with the same mesh element and material are merged into instanced draws, with
+/// world matrices of their objects uploaded to the instance constant buffer. Objects which set up
+/// constant buffers of their own are always drawn individually.
+/// With a constant buffer ring, per-object, instance and material constants of the whole queue are
+/// uploaded with a single map before drawing, and bound with offsets.
+class RRenderQueue
+{
+public:
+	RRenderQueue();
+
+	/// Clear all draw packets and objects for a new pass rendered from a view position
+	void Reset(ERenderPass InRenderPass, const RVec3& InViewPosition);
+
+	/// Add an object with its world matrix. Returns the object index for adding its draw packets.
+	UINT AddObject(const RMatrix4& WorldMatrix, RSceneObject* SceneObject = nullptr, int LightListIndex = -1);
+
+	/// Add a list of point lights which can be shared by objects. Returns the light list index.
+	int AddLightList(const ILight* const* Lights, int NumLights);
+
+	/// Add a draw of a mesh element. A null material draws with the default material.
+	void AddDrawPacket(UINT ObjectIndex, const RMeshElement* MeshElement, RMaterial* Material, bool bSkinned);
+
+	/// Sort draw packets and submit them to the render system
+	void Submit();
+
+	int GetNumDrawPackets() const		{ return (int)DrawPackets.size(); }
+	bool IsEmpty() const				{ return DrawPackets.empty(); }
+
+	/// Merge runs of packets with the same mesh element and material into instanced draws
+	void SetInstancingEnabled(bool bEnabled)	{ bInstancingEnabled = bEnabled; }
+	bool IsInstancingEnabled() const			{ return bInstancingEnabled; }
+
+	/// Sort key and draw packet pairs with a stable LSD radix sort on 8-bit digits.
+	/// Digits which are the same for all keys are skipped.
+	static void RadixSort(std::vector<std::pair<UINT64, UINT>>& Items, std::vector<std::pair<UINT64, UINT>>& Scratch);
+
+private:
+	/// Make a sort key of a draw. View depth is the squared distance from the view position.
+	UINT64 MakeSortKey(const RShader* Shader, const RDrawPacket& Packet, float ViewDepth) const;
+
+	/// Check if a packet can be drawn as an instance in the same draw as another packet
+	bool IsSameInstance(const RDrawPacket& Packet, const RDrawPacket& Other) const;
+
+	/// Split sorted packets into runs drawn with one draw call each
+	void BuildDrawRuns();
+
+	/// Write constants of all draw runs to the ring. Returns false if they don't fit in the ring.
+	bool UploadConstantsToRing(RConstantBufferRing& Ring);
+
+	/// Set up the light constant buffer for an object unless the same lights are set up already
+	void SetupLights(int LightListIndex, int& CurrentLightListIndex) const;
+
+	bool IsSameLightList(int LhsIndex, int RhsIndex) const;
+
+	ERenderPass							RenderPass;
+	RVec3								ViewPosition;
+	bool								bInstancingEnabled;
+
+	std::vector<RRenderQueueObject>		Objects;
+	std::vector<RDrawPacket>			DrawPackets;
+	std::vector<std::pair<UINT64, UINT>>	SortItems;
+	std::vector<std::pair<UINT64, UINT>>	SortScratch;
+	std::vector<RDrawRun>				DrawRuns;
+
+	// Point lights of all light lists, and the first light and number of lights of each list
+	std::vector<const ILight*>			Lights;
+	std::vector<std::pair<int, int>>	LightLists;
+};
@@ -7,6 +7,8 @@
 #include "RRenderSystem.h"
 
 #include "D3DCommonPrivate.h"
+#include "RD3D11RenderDevice.h"
+#include "RNullRenderDevice.h"
 #include "RDirectionalLightComponent.h"
 
 #include "RVertexDeclaration.h"
@@ -19,24 +21,26 @@
 #include "RTexture.h"
 
 #include "Scene/RScene.h"
+#include "Scene/RSceneObject.h"
 #include "Scene/RCamera.h"
 
 #include "Core/CoreTypes.h"
 #include "Core/RLog.h"
+#include "Core/RProfiler.h"
 #include "Core/StdHelper.h"
 
-#include <tchar.h>	// _tcslen, _tcscpy_s
-
 
 ID3D11DepthStencilView* RRenderSystem::DefaultDepthStencilView = nullptr;
 ID3D11RenderTargetView* RRenderSystem::DefaultRenderTargetView = nullptr;
 
 RRenderSystem::RRenderSystem()
 	: bInitialized(false)
-	, m_AdapterName(nullptr)
 	, m_RenderTargetViewNum(0)
 	, RasterizerState(std::make_unique<RRasterizerState>())
 	, m_bIsUsingDeferredShading(false)
+	, m_bRenderQueueEnabled(true)
+	, m_bConstantBufferRingEnabled(true)
+	, m_bLightClusteringEnabled(true)
 	, m_ActiveScene(nullptr)
 {
 }
@@ -51,160 +55,36 @@ RRenderSystem::~RRenderSystem()
 
 bool RRenderSystem::Initialize(HWND hWnd, int client_width, int client_height, bool enable4xMsaa, bool enableGammaCorrection)
 {
-	m_ClientWidth = client_width;
-	m_ClientHeight = client_height;
-	m_Enable4xMsaa = enable4xMsaa;
-	m_UseGammaCorrection = enableGammaCorrection;
-
-	UINT createDeviceFlags = 0;
-
-#if defined(DEBUG) || defined(_DEBUG)
-	createDeviceFlags |= D3D11_CREATE_DEVICE_DEBUG;
-#endif
-
-	// Enumerate adaptors
-	IDXGIFactory1* dxgiFactory = 0;
-	HR(CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void**)&dxgiFactory));
-
-	IDXGIAdapter* dxgiAdapter = 0;
-	std::vector<IDXGIAdapter*> vAdapters;
-
-	// Select best adapter with most VRAM
-	UINT bestAdapterIndex = 0;
-	size_t bestAdapterMem = 0;
-
-	for (UINT i = 0;
-		dxgiFactory->EnumAdapters(i, &dxgiAdapter) != DXGI_ERROR_NOT_FOUND;
-		++i)
+	std::unique_ptr<RD3D11RenderDevice> D3D11Device = std::make_unique<RD3D11RenderDevice>();
+	if (!D3D11Device->Initialize(hWnd, client_width, client_height, enable4xMsaa, enableGammaCorrection))
 	{
-		vAdapters.push_back(dxgiAdapter);
-		DXGI_ADAPTER_DESC desc;
-		dxgiAdapter->GetDesc(&desc);
-
-		if (desc.DedicatedVideoMemory > bestAdapterMem)
-		{
-			bestAdapterIndex = i;
-			bestAdapterMem = desc.DedicatedVideoMemory;
-		}
+		return false;
 	}
 
-	// Store adapter's name
-	DXGI_ADAPTER_DESC desc;
-	vAdapters[bestAdapterIndex]->GetDesc(&desc);
-	size_t desc_len = _tcslen(desc.Description);
-	m_AdapterName = new TCHAR[desc_len + 1];
-	_tcscpy_s(m_AdapterName, desc_len + 1, desc.Description);
-
-	// Create d3d11 device
-	D3D_FEATURE_LEVEL featureLevel;
-	HRESULT hr = D3D11CreateDevice(
-		vAdapters[bestAdapterIndex],
-		D3D_DRIVER_TYPE_UNKNOWN,
-		0,
-		createDeviceFlags,
-		0, 0,
-		D3D11_SDK_VERSION,
-		&m_pD3DDevice,
-		&featureLevel,
-		&m_pD3DImmediateContext);
-
-	if (FAILED(hr))
-	{
-		// D3D11 SDK layers are not present while creating a debug device. Try creating a device without debugging features.
-		if (hr == DXGI_ERROR_SDK_COMPONENT_MISSING)
-		{
-			RLogWarning("D3D11 SDK Layers for Windows 10 is not found on the system. The D3D11 device will be created without debugging features.\n");
-
-			createDeviceFlags = 0;
-
-			hr = D3D11CreateDevice(
-				vAdapters[bestAdapterIndex],
-				D3D_DRIVER_TYPE_UNKNOWN,
-				0,
-				createDeviceFlags,
-				0, 0,
-				D3D11_SDK_VERSION,
-				&m_pD3DDevice,
-				&featureLevel,
-				&m_pD3DImmediateContext);
-		}
-		
-		if (FAILED(hr))
-		{
-			TCHAR* szErrMsg;
-
-			if (FormatMessage(
-				FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM,
-				NULL, hr, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-				(LPTSTR)&szErrMsg, 0, NULL) != 0)
-			{
-				TCHAR buffer[1024];
-				_snwprintf_s(buffer, sizeof(buffer) / sizeof(TCHAR), 1024, L"Failed to create D3D11 device: %s", szErrMsg);
-
-				MessageBox(0, buffer, 0, MB_ICONERROR);
-
-				LocalFree(szErrMsg);
-			}
-			else
-			{
-				MessageBox(0, L"Failed to create D3D11 device: Unknown error.", 0, MB_ICONERROR);
-			}
+	return InitializeWithDevice(std::move(D3D11Device), client_width, client_height, enable4xMsaa, enableGammaCorrection);
+}
 
-			return false;
-		}
-	}
+bool RRenderSystem::InitializeNullDevice(int client_width, int client_height, bool enableGammaCorrection /*= true*/)
+{
+	return InitializeWithDevice(std::make_unique<RNullRenderDevice>(client_width, client_height), client_width, client_height, false, enableGammaCorrection);
+}
 
-#if _DEBUG
-	static const char DeviceContextName[] = "Device Context";
-	m_pD3DImmediateContext->SetPrivateData(WKPDID_D3DDebugObjectName, (UINT)strlen(DeviceContextName), DeviceContextName);
-#endif
+bool RRenderSystem::InitializeWithDevice(std::unique_ptr<IRenderDevice> RenderDevice, int client_width, int client_height, bool enable4xMsaa, bool enableGammaCorrection)
+{
+	m_RenderDevice = std::move(RenderDevice);
 
-	if (featureLevel != D3D_FEATURE_LEVEL_11_0)
-	{
-		MessageBox(0, L"Direct3D Feature Level 11 unsupported.", 0, MB_ICONERROR);
-		return false;
-	}
+	m_ClientWidth = client_width;
+	m_ClientHeight = client_height;
+	m_Enable4xMsaa = enable4xMsaa;
+	m_UseGammaCorrection = enableGammaCorrection;
 
 	DXGI_FORMAT backbuffer_format = m_UseGammaCorrection ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
 
 	// Check 4X MSAA quality support
-	HR(m_pD3DDevice->CheckMultisampleQualityLevels(
+	HR(m_RenderDevice->CheckMultisampleQualityLevels(
 		backbuffer_format, 4, &m_4xMsaaQuality));
 	assert(m_4xMsaaQuality > 0);
 
-	DXGI_SWAP_CHAIN_DESC sd;
-	sd.BufferDesc.Width = client_width;
-	sd.BufferDesc.Height = client_height;
-	sd.BufferDesc.RefreshRate.Numerator = 60;
-	sd.BufferDesc.RefreshRate.Denominator = 1;
-	sd.BufferDesc.Format = backbuffer_format;
-	sd.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;
-	sd.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;
-
-	if (enable4xMsaa)
-	{
-		sd.SampleDesc.Count = 4;
-		sd.SampleDesc.Quality = m_4xMsaaQuality - 1;
-	}
-	else
-	{
-		sd.SampleDesc.Count = 1;
-		sd.SampleDesc.Quality = 0;
-	}
-
-	sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	sd.BufferCount = 1;
-	sd.OutputWindow = hWnd;
-	sd.Windowed = true;
-	sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-	sd.Flags = 0;
-
-	// Create swap chain
-	HR(dxgiFactory->CreateSwapChain(m_pD3DDevice, &sd, &m_SwapChain));
-
-	// Release COM objects
-	dxgiFactory->Release();
-
 	// Create render target view
 	CreateRenderTargetView();
 
@@ -212,7 +92,7 @@ bool RRenderSystem::Initialize(HWND hWnd, int client_width, int client_height, b
 	CreateDepthStencilBufferAndView();
 
 	// Bind views to the output merger stage
-	m_pD3DImmediateContext->OMSetRenderTargets(1, &m_RenderTargetView, m_DepthStencilView);
+	m_RenderDevice->OMSetRenderTargets(1, &m_RenderTargetView, m_DepthStencilView);
 
 	// Setup viewport
 	D3D11_VIEWPORT vp;
@@ -223,7 +103,7 @@ bool RRenderSystem::Initialize(HWND hWnd, int client_width, int client_height, b
 	vp.MinDepth = 0.0f;
 	vp.MaxDepth = 1.0f;
 
-	m_pD3DImmediateContext->RSSetViewports(1, &vp);
+	m_RenderDevice->RSSetViewports(1, &vp);
 
 	RVertexDeclaration::Instance().Initialize();
 
@@ -264,7 +144,7 @@ bool RRenderSystem::Initialize(HWND hWnd, int client_width, int client_height, b
 	samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
 	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	GRenderer.D3DDevice()->CreateSamplerState(&samplerDesc, &m_SamplerState[SamplerState_Texture]);
+	m_RenderDevice->CreateSamplerState(&samplerDesc, &m_SamplerState[SamplerState_Texture]);
 
 #if _DEBUG
 	const char* TextureSamplerName = "Texture2DSampler";
@@ -280,7 +160,7 @@ bool RRenderSystem::Initialize(HWND hWnd, int client_width, int client_height, b
 	samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
 	samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-	GRenderer.D3DDevice()->CreateSamplerState(&samplerDesc, &m_SamplerState[SamplerState_ShadowDepthComparison]);
+	m_RenderDevice->CreateSamplerState(&samplerDesc, &m_SamplerState[SamplerState_ShadowDepthComparison]);
 
 #if _DEBUG
 	const char* ShadowDepthSamplerName = "ShadowDepthSampler";
@@ -289,12 +169,20 @@ bool RRenderSystem::Initialize(HWND hWnd, int client_width, int client_height, b
 
 	RConstantBuffers::Initialize();
 
+	// Ring of per-draw constants, 16384 slices of 256 bytes
+	if (m_RenderDevice->SupportsConstantBufferOffsets())
+	{
+		static const UINT ConstantBufferRingSize = 4 * 1024 * 1024;
+		m_ConstantBufferRing.Initialize(ConstantBufferRingSize);
+	}
+
 	bInitialized = true;
 	return true;
 }
 
 void RRenderSystem::Shutdown()
 {
+	m_ConstantBufferRing.Release();
 	RConstantBuffers::Shutdown();
 
 	for (int i = 0; i < SamplerStateCount; i++)
@@ -312,11 +200,7 @@ void RRenderSystem::Shutdown()
 	m_DepthStencilView->Release();
 	m_DepthStencilBuffer->Release();
 	m_RenderTargetView->Release();
-	m_SwapChain->Release();
-	m_pD3DImmediateContext->Release();
-	m_pD3DDevice->Release();
-
-	delete[] m_AdapterName;
+	m_RenderDevice.reset();
 }
 
 bool RRenderSystem::HasInitialized() const
@@ -336,21 +220,21 @@ void RRenderSystem::ResizeClient(int width, int height)
 		m_ClientWidth = width;
 		m_ClientHeight = height;
 
-		if (m_SwapChain)
+		if (m_RenderDevice)
 		{
-			m_pD3DImmediateContext->OMSetRenderTargets(0, 0, 0);
+			m_RenderDevice->OMSetRenderTargets(0, 0, 0);
 			SAFE_RELEASE(m_DepthStencilBuffer);
 			SAFE_RELEASE(m_DepthStencilView);
 			SAFE_RELEASE(m_RenderTargetView);
 
-			HR(m_SwapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, 0));
+			HR(m_RenderDevice->ResizeBackBuffer(width, height));
 
 			CreateRenderTargetView();
 
 			CreateDepthStencilBufferAndView();
 
 			// Bind views to the output merger stage
-			m_pD3DImmediateContext->OMSetRenderTargets(1, &m_RenderTargetView, m_DepthStencilView);
+			m_RenderDevice->OMSetRenderTargets(1, &m_RenderTargetView, m_DepthStencilView);
 
 			// Setup viewport
 			D3D11_VIEWPORT vp;
@@ -361,20 +245,20 @@ void RRenderSystem::ResizeClient(int width, int height)
 			vp.MinDepth = 0.0f;
 			vp.MaxDepth = 1.0f;
 
-			m_pD3DImmediateContext->RSSetViewports(1, &vp);
+			m_RenderDevice->RSSetViewports(1, &vp);
 		}
 	}
 }
 
 void RRenderSystem::Clear(bool clearColor, const RColor& color, bool clearDepth, float depth, bool clearStencil, UINT8 stencil)
 {
-	assert(m_pD3DImmediateContext);
+	assert(m_RenderDevice);
 
 	if (m_RenderTargetViewNum && m_CurrentRenderTargetViews && clearColor)
 	{
 		for (UINT i = 0; i < m_RenderTargetViewNum; i++)
 		{
-			m_pD3DImmediateContext->ClearRenderTargetView(m_CurrentRenderTargetViews[i],
+			m_RenderDevice->ClearRenderTargetView(m_CurrentRenderTargetViews[i],
 				reinterpret_cast<const float*>(&color));
 		}
 	}
@@ -386,21 +270,21 @@ void RRenderSystem::Clear(bool clearColor, const RColor& color, bool clearDepth,
 		if (clearDepth) clearFlag |= D3D11_CLEAR_DEPTH;
 		if (clearStencil) clearFlag |= D3D11_CLEAR_STENCIL;
 
-		m_pD3DImmediateContext->ClearDepthStencilView(m_CurrentDepthStencilView,
+		m_RenderDevice->ClearDepthStencilView(m_CurrentDepthStencilView,
 			clearFlag, depth, stencil);
 	}
 }
 
 void RRenderSystem::ClearRenderTarget(ID3D11RenderTargetView* rtv, const RColor& color)
 {
-	m_pD3DImmediateContext->ClearRenderTargetView(rtv, reinterpret_cast<const float*>(&color));
+	m_RenderDevice->ClearRenderTargetView(rtv, reinterpret_cast<const float*>(&color));
 }
 
 void RRenderSystem::Present(bool bWaitForVsync /*= true*/)
 {
-	assert(m_SwapChain);
+	assert(m_RenderDevice);
 
-	HR(m_SwapChain->Present(bWaitForVsync ? 1 : 0, 0));
+	HR(m_RenderDevice->Present(bWaitForVsync ? 1 : 0));
 }
 
 void RRenderSystem::SetRenderTargets(UINT numViews, ID3D11RenderTargetView* const* renderTargetView, ID3D11DepthStencilView* depthStencilView)
@@ -415,10 +299,10 @@ void RRenderSystem::SetRenderTargets(UINT numViews, ID3D11RenderTargetView* cons
 	if (renderTargetView == nullptr)
 	{
 		ID3D11RenderTargetView* nullRTV[] = { nullptr };
-		m_pD3DImmediateContext->OMSetRenderTargets(1, nullRTV, depthStencilView);
+		m_RenderDevice->OMSetRenderTargets(1, nullRTV, depthStencilView);
 	}
 	else
-		m_pD3DImmediateContext->OMSetRenderTargets(numViews, renderTargetView, depthStencilView);
+		m_RenderDevice->OMSetRenderTargets(numViews, renderTargetView, depthStencilView);
 }
 
 void RRenderSystem::SetBlendState(BlendState state)
@@ -426,19 +310,42 @@ void RRenderSystem::SetBlendState(BlendState state)
 	if (m_CurrBlendState != state)
 	{
 		float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-		GRenderer.D3DImmediateContext()->OMSetBlendState(m_BlendState[(int)state], blendFactor, 0xFFFFFFFF);
+		m_RenderDevice->OMSetBlendState(m_BlendState[(int)state], blendFactor, 0xFFFFFFFF);
 		m_CurrBlendState = state;
 	}
 }
 
 void RRenderSystem::SetSamplerState(int slot, SamplerState state)
 {
-	GRenderer.D3DImmediateContext()->PSSetSamplers(slot, 1, &m_SamplerState[state]);
+	m_RenderDevice->PSSetSamplers(slot, 1, &m_SamplerState[state]);
 }
 
-void RRenderSystem::BindMaterial(RMaterial* Material, bool bSkinned /*= false*/, bool bInstancing /*= false*/)
+void RRenderSystem::UpdateMaterialConstants(RMaterial* Material)
 {
-	RShader* Shader = Material ? Material->GetShader() : nullptr;
+	RMaterial* RenderMaterial = Material ? Material : RMaterial::GetDefault();
+	RShader* Shader = RenderMaterial->GetShader();
+	if (Shader == nullptr)
+	{
+		Shader = GShaderManager.GetDefaultShader();
+	}
+
+	// Bind radiance map mip levels used by PBR materials
+	if (Shader->bUsePBR)
+	{
+		static const int RadianceMapSlot = 3;
+		RTexture* Texture = RenderMaterial->GetTextureBySlot(RadianceMapSlot);
+		if (Texture)
+		{
+			RConstantBuffers::cbMaterial.Data.NumRadianceMipLevels = Texture->GetMipLevels();
+		}
+	}
+
+	RConstantBuffers::cbMaterial.Data.UVTiling = RenderMaterial->GetUVTiling();
+}
+
+void RRenderSystem::BindMaterial(RMaterial* Material, bool bSkinned /*= false*/, bool bInstancing /*= false*/, RRenderStateCache* StateCache /*= nullptr*/)
+{
+	RShader* Shader = Material ? Material->GetShader() : nullptr;
 	if (Shader == nullptr)
 	{
 		Shader = GShaderManager.GetDefaultShader();
@@ -459,9 +366,15 @@ void RRenderSystem::BindMaterial(RMaterial* Material, bool bSkinned /*= false*/,
 		ShaderFeatureMask |= SFM_Deferred;
 	}
 
+	RMaterial* RenderMaterial = Material ? Material : RMaterial::GetDefault();
+
+	if (StateCache && StateCache->Material == RenderMaterial && StateCache->ShaderFeatureMask == ShaderFeatureMask)
+	{
+		return;
+	}
+
 	Shader->Bind(ShaderFeatureMask);
 
-	RMaterial* RenderMaterial = Material ? Material : RMaterial::GetDefault();
 	SetBlendState(RenderMaterial->GetBlendMode());
 
 	size_t RasterizerStateHash = 0;
@@ -477,46 +390,52 @@ void RRenderSystem::BindMaterial(RMaterial* Material, bool bSkinned /*= false*/,
 		RasterizerStateHash = RenderMaterial->GetRasterizerStateHash();
 	}
 
-	RasterizerState->Apply(RasterizerStateHash);
-
-	int NumTextureSlots = (int)RenderMaterial->GetTextureSlots().size();
+	if (!StateCache || !StateCache->bHasRasterizerState || StateCache->RasterizerStateHash != RasterizerStateHash)
+	{
+		RasterizerState->Apply(RasterizerStateHash);
+	}
 
 	// Note: Increase this number if we need to support more texture slots.
-	//		 Shadow map textures are starting from slot 5 so we may only unbind textures for up to slot 4.
-	static const int NumShaderResourceViews = 5;
+	static const int NumShaderResourceViews = RRenderStateCache::NumMaterialShaderResourceViews;
+	static_assert(NumShaderResourceViews <= RMaterial::MaxTextureSlots, "Materials don't have enough texture slots for all shader resource views");
 
-	// Unbind all unused shader resource slots
-	ID3D11ShaderResourceView* ShaderResourceViewSlots[NumShaderResourceViews] = { nullptr };
+	// Slots without textures unbind their shader resource views
+	ID3D11ShaderResourceView* ShaderResourceViewSlots[NumShaderResourceViews];
 
-	for (int t = 0; t < NumTextureSlots; t++)
+	for (int SlotId = 0; SlotId < NumShaderResourceViews; SlotId++)
 	{
-		int SlotId = RenderMaterial->GetTextureSlots()[t].SlotId;
-		if (SlotId < NumShaderResourceViews)
-		{
-			RTexture* Texture = RenderMaterial->GetTextureSlots()[t].Texture;
-			ShaderResourceViewSlots[SlotId] = Texture ? Texture->GetSRV() : nullptr;
-		}
+		RTexture* Texture = RenderMaterial->GetTextureBySlot(SlotId);
+		ShaderResourceViewSlots[SlotId] = Texture ? Texture->GetSRV() : nullptr;
 	}
 
-	// Bind radiance map mip levels used by PBR materials
-	if (Shader->bUsePBR)
+	UpdateMaterialConstants(RenderMaterial);
+
+	if (!StateCache || !StateCache->bMaterialConstantsInRing)
 	{
-		static const int RadianceMapSlot = 3;
-		if (RadianceMapSlot < NumTextureSlots)
-		{
-			RTexture* Texture = RenderMaterial->GetTextureSlots()[RadianceMapSlot].Texture;
-			if (Texture)
-			{
-				RConstantBuffers::cbMaterial.Data.NumRadianceMipLevels = Texture->GetMipLevels();
-			}
-		}
+		RConstantBuffers::cbMaterial.UpdateBufferData();
 	}
 
-	RConstantBuffers::cbMaterial.Data.UVTiling = RenderMaterial->GetUVTiling();
-	RConstantBuffers::cbMaterial.UpdateBufferData();
-	RConstantBuffers::cbMaterial.BindBuffer();
+	// Batches with a state cache bind the material constant buffer once for all draws
+	if (!StateCache)
+	{
+		RConstantBuffers::cbMaterial.BindBuffer();
+	}
 
-	GRenderer.D3DImmediateContext()->PSSetShaderResources(0, NumShaderResourceViews, ShaderResourceViewSlots);
+	if (!StateCache || !StateCache->bHasShaderResourceViews ||
+		memcmp(StateCache->ShaderResourceViews, ShaderResourceViewSlots, sizeof(ShaderResourceViewSlots)) != 0)
+	{
+		m_RenderDevice->PSSetShaderResources(0, NumShaderResourceViews, ShaderResourceViewSlots);
+	}
+
+	if (StateCache)
+	{
+		StateCache->Material = RenderMaterial;
+		StateCache->ShaderFeatureMask = ShaderFeatureMask;
+		StateCache->bHasRasterizerState = true;
+		StateCache->RasterizerStateHash = RasterizerStateHash;
+		StateCache->bHasShaderResourceViews = true;
+		memcpy(StateCache->ShaderResourceViews, ShaderResourceViewSlots, sizeof(ShaderResourceViewSlots));
+	}
 }
 
 void RRenderSystem::SetVertexShader(ID3D11VertexShader* vertexShader)
@@ -524,7 +443,7 @@ void RRenderSystem::SetVertexShader(ID3D11VertexShader* vertexShader)
 	static ID3D11VertexShader* currentVertexShader = nullptr;
 	if (currentVertexShader != vertexShader)
 	{
-		GRenderer.D3DImmediateContext()->VSSetShader(vertexShader, nullptr, 0);
+		m_RenderDevice->VSSetShader(vertexShader);
 		currentVertexShader = vertexShader;
 	}
 }
@@ -534,7 +453,7 @@ void RRenderSystem::SetPixelShader(ID3D11PixelShader* pixelShader)
 	static ID3D11PixelShader* currentPixelShader = nullptr;
 	if (currentPixelShader != pixelShader)
 	{
-		GRenderer.D3DImmediateContext()->PSSetShader(pixelShader, nullptr, 0);
+		m_RenderDevice->PSSetShader(pixelShader);
 		currentPixelShader = pixelShader;
 	}
 }
@@ -544,7 +463,7 @@ void RRenderSystem::SetGeometryShader(ID3D11GeometryShader* geometryShader)
 	static ID3D11GeometryShader* currentGeometryShader = nullptr;
 	if (currentGeometryShader != geometryShader)
 	{
-		GRenderer.D3DImmediateContext()->GSSetShader(geometryShader, nullptr, 0);
+		m_RenderDevice->GSSetShader(geometryShader);
 		currentGeometryShader = geometryShader;
 	}
 }
@@ -611,8 +530,25 @@ void RRenderSystem::RenderFrame()
 	GRenderer.SetSamplerState(2, SamplerState_ShadowDepthComparison);
 
 	RCamera* RenderCamera = m_ActiveScene ? m_ActiveScene->GetRenderCamera() : nullptr;
+
+	// World bounds of all renderable objects are computed once, and each view below is culled once
+	if (RenderCamera && m_bRenderQueueEnabled)
+	{
+		RPROFILE_SCOPE("Gather visibility objects");
+		GatherVisibilityObjects();
+	}
+
+	// Lights of objects in all render passes of the camera are found from the same clusters
+	if (RenderCamera && m_bLightClusteringEnabled)
+	{
+		RPROFILE_SCOPE("Build light clusters");
+		BuildLightClusters(RenderCamera);
+	}
+
 	if (RenderCamera)
 	{
+		RPROFILE_SCOPE("Shadow depth passes");
+
 		// Prepare shadow map for each shadow caster
 		for (auto ShadowCaster : m_RegisteredShadowCasters)
 		{
@@ -637,16 +573,8 @@ void RRenderSystem::RenderFrame()
 						&ShadowFrustum
 					};
 
-					for (auto MeshComponent : m_RegisteredRenderMeshComponents)
-					{
-						MeshComponent->RenderDepthPass(ShadowView);
-					}
-
-					// Render scene object in depth pass
-					if (m_ActiveScene)
-					{
-						m_ActiveScene->RenderDepthPass(&ShadowFrustum);
-					}
+					const int ShadowViewIndex = m_bRenderQueueEnabled ? m_VisibilitySet.CullView(ShadowFrustum, VOF_CastShadow) : -1;
+					RenderDepthPassObjects(ShadowView, RenderCamera->GetWorldPosition(), ShadowViewIndex);
 
 					// Draw shadow frustum
 					//GDebugRenderer.DrawFrustum(ShadowFrustum, FrustumColors[i]);
@@ -667,7 +595,7 @@ void RRenderSystem::RenderFrame()
 	vp.MinDepth = 0.0f;
 	vp.MaxDepth = 1.0f;
 
-	m_pD3DImmediateContext->RSSetViewports(1, &vp);
+	m_RenderDevice->RSSetViewports(1, &vp);
 
 	Clear();
 
@@ -720,7 +648,7 @@ void RRenderSystem::RenderFrame()
 					shadowMapSRV[i] = ShadowCaster->GetRTDepthSRV(i);
 				}
 
-				GRenderer.D3DImmediateContext()->PSSetShaderResources(RShadowMap::ShaderResourceSlot(), NumDepthPasses, shadowMapSRV);
+				m_RenderDevice->PSSetShaderResources(RShadowMap::ShaderResourceSlot(), NumDepthPasses, shadowMapSRV);
 
 				CascadedShadowsNum = NumDepthPasses;
 				ShadowDepths = ShadowCaster->GetShadowDepth(RenderCamera);
@@ -780,6 +708,9 @@ void RRenderSystem::RenderFrame()
 
 		RFrustum Frustum = RenderCamera->GetFrustum();
 
+		// Visible objects of the camera are shared by all render passes
+		const int CameraViewIndex = m_bRenderQueueEnabled ? m_VisibilitySet.CullView(Frustum) : -1;
+
 		for (int PassIdx = 0; PassIdx < (int)ERenderPass::NumPasses; PassIdx++)
 		{
 			// Clear depth buffer before next pass
@@ -791,15 +722,7 @@ void RRenderSystem::RenderFrame()
 				(ERenderPass)PassIdx,
 			};
 
-			for (auto MeshComponent : m_RegisteredRenderMeshComponents)
-			{
-				MeshComponent->Render(View);
-			}
-
-			if (m_ActiveScene)
-			{
-				m_ActiveScene->Render(View);
-			}
+			RenderPassObjects(View, RenderCamera->GetWorldPosition(), CameraViewIndex);
 
 			if ((ERenderPass)PassIdx == ERenderPass::SceneObject)
 			{
@@ -818,20 +741,18 @@ void RRenderSystem::RenderFrame()
 	{
 		OverlayRenderable->Render();
 	}
+
+	// Code rendering outside of frames gathers lights without clusters
+	m_LightClusters.Reset();
 }
 
 void RRenderSystem::CreateRenderTargetView()
 {
-	ID3D11Texture2D* backBuffer;
-	m_SwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D),
-		reinterpret_cast<void**>(&backBuffer));
-	m_pD3DDevice->CreateRenderTargetView(backBuffer, 0, &m_RenderTargetView);
+	HR(m_RenderDevice->CreateBackBufferRenderTargetView(&m_RenderTargetView));
 
 	DefaultRenderTargetView = m_RenderTargetView;
 	m_CurrentRenderTargetViews[0] = m_RenderTargetView;
 	m_RenderTargetViewNum = 1;
-
-	backBuffer->Release();
 }
 
 void RRenderSystem::CreateDepthStencilBufferAndView()
@@ -859,8 +780,8 @@ void RRenderSystem::CreateDepthStencilBufferAndView()
 	depthStencilDesc.CPUAccessFlags = 0;
 	depthStencilDesc.MiscFlags = 0;
 
-	HR(m_pD3DDevice->CreateTexture2D(&depthStencilDesc, 0, &m_DepthStencilBuffer));
-	HR(m_pD3DDevice->CreateDepthStencilView(m_DepthStencilBuffer, 0, &m_DepthStencilView));
+	HR(m_RenderDevice->CreateTexture2D(&depthStencilDesc, 0, &m_DepthStencilBuffer));
+	HR(m_RenderDevice->CreateDepthStencilView(m_DepthStencilBuffer, 0, &m_DepthStencilView));
 
 	DefaultDepthStencilView = m_DepthStencilView;
 	m_CurrentDepthStencilView = m_DepthStencilView;
@@ -869,13 +790,166 @@ void RRenderSystem::CreateDepthStencilBufferAndView()
 void RRenderSystem::UnbindShadowMapShaderResourceViews()
 {
 	ID3D11ShaderResourceView* EmptySRVs[3] = { nullptr };
-	GRenderer.D3DImmediateContext()->PSSetShaderResources(RShadowMap::ShaderResourceSlot(), 3, EmptySRVs);
+	m_RenderDevice->PSSetShaderResources(RShadowMap::ShaderResourceSlot(), 3, EmptySRVs);
+}
+
+void RRenderSystem::GatherVisibilityObjects()
+{
+	m_VisibilitySet.Reset();
+
+	RAabb WorldBounds;
+	for (auto MeshComponent : m_RegisteredRenderMeshComponents)
+	{
+		RSceneObject* Owner = MeshComponent->GetOwner();
+		if (Owner && !Owner->IsVisible())
+		{
+			continue;
+		}
+
+		if (MeshComponent->GetWorldBounds(WorldBounds))
+		{
+			m_VisibilitySet.AddObject(WorldBounds, MeshComponent, nullptr, Owner->GetRenderPass(), VOF_CastShadow);
+		}
+	}
+
+	if (m_ActiveScene)
+	{
+		m_ActiveScene->GatherVisibilityObjects(m_VisibilitySet);
+	}
+}
+
+void RRenderSystem::RenderPassObjects(const RenderViewInfo& View, const RVec3& ViewPosition, int VisibilityViewIndex)
+{
+	if (!m_bRenderQueueEnabled)
+	{
+		for (auto MeshComponent : m_RegisteredRenderMeshComponents)
+		{
+			MeshComponent->Render(View);
+		}
+
+		if (m_ActiveScene)
+		{
+			m_ActiveScene->Render(View);
+		}
+
+		return;
+	}
+
+	m_RenderQueue.Reset(View.RenderPass, ViewPosition);
+
+	for (UINT ObjectIndex : m_VisibilitySet.GetVisibleObjects(VisibilityViewIndex))
+	{
+		const RVisibilityObject& Object = m_VisibilitySet.GetObject(ObjectIndex);
+		if (Object.RenderPass != View.RenderPass)
+		{
+			continue;
+		}
+
+		if (Object.MeshComponent)
+		{
+			Object.MeshComponent->AddToRenderQueue(m_RenderQueue, false);
+		}
+		else
+		{
+			// Scene objects which can't be added to the queue are drawn here immediately
+			m_ActiveScene->AddSceneObjectToRenderQueue(m_RenderQueue, Object.SceneObject, false);
+		}
+	}
+
+	m_RenderQueue.Submit();
+}
+
+void RRenderSystem::RenderDepthPassObjects(const RenderViewInfo& View, const RVec3& ViewPosition, int VisibilityViewIndex)
+{
+	if (!m_bRenderQueueEnabled)
+	{
+		for (auto MeshComponent : m_RegisteredRenderMeshComponents)
+		{
+			MeshComponent->RenderDepthPass(View);
+		}
+
+		// Render scene object in depth pass
+		if (m_ActiveScene)
+		{
+			m_ActiveScene->RenderDepthPass(View.Frustum);
+		}
+
+		return;
+	}
+
+	m_RenderQueue.Reset(View.RenderPass, ViewPosition);
+
+	for (UINT ObjectIndex : m_VisibilitySet.GetVisibleObjects(VisibilityViewIndex))
+	{
+		const RVisibilityObject& Object = m_VisibilitySet.GetObject(ObjectIndex);
+		if (Object.MeshComponent)
+		{
+			Object.MeshComponent->AddToRenderQueue(m_RenderQueue, true);
+		}
+		else
+		{
+			m_ActiveScene->AddSceneObjectToRenderQueue(m_RenderQueue, Object.SceneObject, true);
+		}
+	}
+
+	m_RenderQueue.Submit();
+}
+
+void RRenderSystem::BuildLightClusters(RCamera* Camera)
+{
+	m_ClusteredLights.clear();
+	m_ClusteredLightSpheres.clear();
+
+	for (auto Light : m_RegisteredLights)
+	{
+		if (Light->GetLightType() != ELightType::PointLight)
+		{
+			continue;
+		}
+
+		// Effective bounds of a point light are the bounding box of its sphere
+		const RAabb Bounds = Light->GetEffectiveLightBounds();
+		m_ClusteredLights.push_back(Light);
+		m_ClusteredLightSpheres.push_back({ Bounds.GetCenter(), (Bounds.pMax.X() - Bounds.pMin.X()) * 0.5f });
+	}
+
+	RLightClusterView View;
+	View.ViewMatrix = Camera->GetViewMatrix();
+	View.FovY = Camera->GetFOV();
+	View.AspectRatio = Camera->GetAspectRatio();
+	View.NearZ = Camera->GetNearPlane();
+	View.FarZ = Camera->GetFarPlane();
+
+	m_LightClusters.Build(View, m_ClusteredLightSpheres.data(), (int)m_ClusteredLightSpheres.size());
+}
+
+bool RRenderSystem::GatherClusteredPointLights(const RAabb& WorldBounds, std::vector<const ILight*>& OutLights)
+{
+	if (!m_LightClusters.IsValid())
+	{
+		return false;
+	}
+
+	OutLights.clear();
+	m_LightClusters.GatherLightsInBounds(WorldBounds, m_ClusterLightScratch);
+
+	// Lights in clusters around the bounds may still miss the bounds themselves
+	for (UINT LightIndex : m_ClusterLightScratch)
+	{
+		RLight* Light = m_ClusteredLights[LightIndex];
+		if (Light->GetEffectiveLightBounds().TestIntersectionWithAabb(WorldBounds))
+		{
+			OutLights.push_back(Light);
+		}
+	}
+
+	return true;
 }
 
 ID3D11BlendState* RRenderSystem::CreateD3DBlendState(const D3D11_BLEND_DESC* Desc, char* DebugObjectName /*= nullptr*/)
 {
 	ID3D11BlendState* BlendState = nullptr;
-	if (FAILED(GRenderer.D3DDevice()->CreateBlendState(Desc, &BlendState)))
+	if (FAILED(m_RenderDevice->CreateBlendState(Desc, &BlendState)))
 	{
 		RLogWarning("Failed to create D3D11 blend state!\n");
 		return nullptr;
@@ -8,6 +8,11 @@
 #include "Core/RSingleton.h"
 #include "RRenderMeshComponent.h"
 #include "BlendState.h"
+#include "IRenderDevice.h"
+#include "RRenderQueue.h"
+#include "RVisibilitySet.h"
+#include "RConstantBufferRing.h"
+#include "RLightClusterGrid.h"
 
 #include <d3d11.h>
 
@@ -20,9 +25,11 @@ class RScene;
 class RRasterizerState;
 
 class RLight;
+class ILight;
 class IShadowCaster;
 
 struct ID3D11RenderTargetView;
+class RMeshRenderBuffer;
 
 enum SamplerState
 {
@@ -39,6 +46,31 @@ struct RenderStats
 	void Reset() { DrawCalls = 0; }
 };
 
+/// States bound by a batch of draws. Binds matching the cached states are skipped, so a cache
+/// is only valid while nothing else changes pipeline states, and should be created for each batch.
+struct RRenderStateCache
+{
+	// Note: Shadow map textures are starting from slot 5 so materials may only bind textures for up to slot 4.
+	static const int NumMaterialShaderResourceViews = 5;
+
+	const RMaterial*			Material = nullptr;
+	int							ShaderFeatureMask = 0;
+
+	bool						bHasRasterizerState = false;
+	size_t						RasterizerStateHash = 0;
+
+	bool						bHasShaderResourceViews = false;
+	ID3D11ShaderResourceView*	ShaderResourceViews[NumMaterialShaderResourceViews] = {};
+
+	// Material constants of the batch are uploaded to a constant buffer ring, so they are not updated when binding materials
+	bool						bMaterialConstantsInRing = false;
+
+	// Input assembler states
+	ID3D11InputLayout*			InputLayout = nullptr;
+	int							PrimitiveTopology = -1;
+	const RMeshRenderBuffer*	RenderBuffer = nullptr;
+};
+
 /// Renderable objects used as UI overlays
 class IOverlayRenderable
 {
@@ -52,6 +84,10 @@ class RRenderSystem : public RSingleton<RRenderSystem>
 	friend class RSingleton<RRenderSystem>;
 public:
 	bool Initialize(HWND hWnd, int client_width, int client_height, bool enable4xMsaa, bool enableGammaCorrection = true);
+
+	/// Initialize on a null device without a window or a GPU. Commands are recorded in the command log of the device.
+	bool InitializeNullDevice(int client_width, int client_height, bool enableGammaCorrection = true);
+
 	void Shutdown();
 
 	bool HasInitialized() const;
@@ -65,12 +101,16 @@ public:
 	// Present current frame. Called by the engine
 	void Present(bool bWaitForVsync = true);
 
-	ID3D11Device*			D3DDevice()						{ return m_pD3DDevice; }
-	ID3D11DeviceContext*	D3DImmediateContext()			{ return m_pD3DImmediateContext; }
+	/// Device all resources and commands of the render system go through
+	IRenderDevice*			Device()						{ return m_RenderDevice.get(); }
+
+	/// Native D3D11 device and context. Null if the render system runs on a null device.
+	ID3D11Device*			D3DDevice()						{ return m_RenderDevice->GetD3DDevice(); }
+	ID3D11DeviceContext*	D3DImmediateContext()			{ return m_RenderDevice->GetD3DDeviceContext(); }
 
 	int	GetClientWidth() const { return m_ClientWidth; }
 	int	GetClientHeight() const { return m_ClientHeight; }
-	const TCHAR* GetAdapterName() const { return m_AdapterName; }
+	const TCHAR* GetAdapterName() const { return m_RenderDevice->GetAdapterName(); }
 
 	void SetRenderTargets(UINT numViews = 1, ID3D11RenderTargetView* const* renderTargetViews = &DefaultRenderTargetView, ID3D11DepthStencilView* depthStencilView = DefaultDepthStencilView);
 
@@ -80,8 +120,12 @@ public:
 	void SetBlendState(BlendState state);
 	void SetSamplerState(int slot, SamplerState state);
 
-	/// Bind a material to the pipeline for rendering
-	void BindMaterial(RMaterial* Material, bool bSkinned = false, bool bInstancing = false);
+	/// Bind a material to the pipeline for rendering. With a state cache, the material is only bound
+	/// if it's different from the cached one, and only states which are different are changed.
+	void BindMaterial(RMaterial* Material, bool bSkinned = false, bool bInstancing = false, RRenderStateCache* StateCache = nullptr);
+
+	/// Write constants of a material to the data of the material constant buffer without uploading it
+	void UpdateMaterialConstants(RMaterial* Material);
 
 	bool UsingGammaCorrection() const { return m_UseGammaCorrection; }
 
@@ -113,10 +157,40 @@ public:
 	/// Render current frame
 	void RenderFrame();
 
+	/// Render mesh components and scene objects through sorted render queues with state batching.
+	/// If disabled, they are drawn in registration order and bind all their states for every draw.
+	void SetRenderQueueEnabled(bool bEnabled)			{ m_bRenderQueueEnabled = bEnabled; }
+	bool IsRenderQueueEnabled() const					{ return m_bRenderQueueEnabled; }
+
+	/// Draw repeated mesh elements with the same material as instanced draws in the render queue
+	void SetInstancingEnabled(bool bEnabled)			{ m_RenderQueue.SetInstancingEnabled(bEnabled); }
+	bool IsInstancingEnabled() const					{ return m_RenderQueue.IsInstancingEnabled(); }
+
+	/// Constant buffer ring which render queues upload per-draw constants of a whole pass to with a single map.
+	/// Null if disabled, or if the device can't bind constant buffers with offsets.
+	RConstantBufferRing* GetConstantBufferRing()		{ return (m_bConstantBufferRingEnabled && m_ConstantBufferRing.IsInitialized()) ? &m_ConstantBufferRing : nullptr; }
+	void SetConstantBufferRingEnabled(bool bEnabled)	{ m_bConstantBufferRingEnabled = bEnabled; }
+	bool IsConstantBufferRingEnabled() const			{ return m_bConstantBufferRingEnabled; }
+
+	/// Bin point lights into clusters of the camera view at the start of each frame, so objects only
+	/// test lights in clusters around them.
+	void SetLightClusteringEnabled(bool bEnabled)		{ m_bLightClusteringEnabled = bEnabled; }
+	bool IsLightClusteringEnabled() const				{ return m_bLightClusteringEnabled; }
+
+	/// Clusters of point lights of the frame being rendered. Invalid outside of rendering a frame.
+	const RLightClusterGrid& GetLightClusters() const	{ return m_LightClusters; }
+
+	/// Find point lights affecting world bounds, from lights in clusters around the bounds.
+	/// Returns false without gathering any lights if clusters haven't been built for the frame.
+	bool GatherClusteredPointLights(const RAabb& WorldBounds, std::vector<const ILight*>& OutLights);
+
 protected:
 	RRenderSystem();
 	~RRenderSystem();
 
+	/// Create render targets and pipeline states on a device which has been created
+	bool InitializeWithDevice(std::unique_ptr<IRenderDevice> RenderDevice, int client_width, int client_height, bool enable4xMsaa, bool enableGammaCorrection);
+
 	void CreateRenderTargetView();
 	void CreateDepthStencilBufferAndView();
 
@@ -124,16 +198,24 @@ protected:
 
 	void UnbindShadowMapShaderResourceViews();
 
+	/// Add visible mesh components and scene objects of the frame to the visibility set
+	void GatherVisibilityObjects();
+
+	/// Render mesh components and scene objects of a pass. With the render queue enabled, objects visible
+	/// in a view of the visibility set are drawn through the queue. Otherwise all objects are culled and drawn immediately.
+	void RenderPassObjects(const RenderViewInfo& View, const RVec3& ViewPosition, int VisibilityViewIndex);
+	void RenderDepthPassObjects(const RenderViewInfo& View, const RVec3& ViewPosition, int VisibilityViewIndex);
+
+	/// Bin registered point lights into clusters of a camera view
+	void BuildLightClusters(RCamera* Camera);
+
 	bool					bInitialized;
 	int						m_ClientWidth, m_ClientHeight;
 	bool					m_Enable4xMsaa;
 	bool					m_UseGammaCorrection;
 	UINT					m_4xMsaaQuality;
-	TCHAR*					m_AdapterName;
 
-	ID3D11Device*			m_pD3DDevice;
-	ID3D11DeviceContext*	m_pD3DImmediateContext;
-	IDXGISwapChain*			m_SwapChain;
+	std::unique_ptr<IRenderDevice>	m_RenderDevice;
 	ID3D11RenderTargetView*	m_RenderTargetView;
 	ID3D11Texture2D*		m_DepthStencilBuffer;
 	ID3D11DepthStencilView*	m_DepthStencilView;
@@ -151,6 +233,19 @@ protected:
 
 	bool					m_bIsUsingDeferredShading;
 
+	bool					m_bRenderQueueEnabled;
+	RRenderQueue			m_RenderQueue;
+	RVisibilitySet			m_VisibilitySet;
+
+	bool					m_bConstantBufferRingEnabled;
+	RConstantBufferRing		m_ConstantBufferRing;
+
+	bool					m_bLightClusteringEnabled;
+	RLightClusterGrid		m_LightClusters;
+	std::vector<RLight*>	m_ClusteredLights;
+	std::vector<RLightSphere>	m_ClusteredLightSpheres;
+	std::vector<UINT>		m_ClusterLightScratch;
+
 	std::vector<RRenderMeshComponent*>	m_RegisteredRenderMeshComponents;
 	std::vector<RLight*>				m_RegisteredLights;
 	std::vector<IShadowCaster*>			m_RegisteredShadowCasters;
@@ -0,0 +1,282 @@
+//=============================================================================
+// RShaderCompileQueue.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RShaderCompileQueue.h"
+
+#include "Core/RThreadPool.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+	const UINT32 ShaderCacheMagic = 0x48435352;		// "RSCH"
+
+	struct RShaderCacheHeader
+	{
+		UINT32	Magic;
+		UINT32	BytecodeSize;
+		UINT64	CacheKey;
+	};
+
+	/// 64-bit FNV-1a, which gives the same keys on every platform and compiler
+	class RCacheKeyHasher
+	{
+	public:
+		RCacheKeyHasher()
+			: Hash(14695981039346656037ULL)
+		{}
+
+		void AddBytes(const void* Data, size_t Size)
+		{
+			const unsigned char* Bytes = (const unsigned char*)Data;
+			for (size_t i = 0; i < Size; i++)
+			{
+				Hash ^= (UINT64)Bytes[i];
+				Hash *= 1099511628211ULL;
+			}
+		}
+
+		/// Strings are hashed with their lengths, so moving characters between neighboring strings changes the key
+		void AddString(const std::string& String)
+		{
+			const UINT64 Length = (UINT64)String.size();
+			AddBytes(&Length, sizeof(Length));
+			AddBytes(String.data(), String.size());
+		}
+
+		UINT64 GetHash() const		{ return Hash; }
+
+	private:
+		UINT64 Hash;
+	};
+}
+
+RStubShaderCompiler::RStubShaderCompiler(int InSimulatedCompileMicroseconds /*= 0*/)
+	: SimulatedCompileMicroseconds(InSimulatedCompileMicroseconds)
+{
+}
+
+bool RStubShaderCompiler::Compile(const RShaderCompileJob& Job, std::vector<char>& OutBytecode, std::string& OutMessages)
+{
+	if (SimulatedCompileMicroseconds > 0)
+	{
+		// Spin instead of sleeping, so compiles keep worker threads busy like a real compiler
+		auto EndTime = std::chrono::high_resolution_clock::now() + std::chrono::microseconds(SimulatedCompileMicroseconds);
+		while (std::chrono::high_resolution_clock::now() < EndTime) {}
+	}
+
+	const UINT64 CacheKey = RShaderCompileQueue::MakeCacheKey(Job, GetIdentifier());
+	const std::string Header = "STUB " + Job.Target + " " + Job.EntryPoint + " ";
+
+	OutBytecode.assign(Header.begin(), Header.end());
+	OutBytecode.insert(OutBytecode.end(), (const char*)&CacheKey, (const char*)&CacheKey + sizeof(CacheKey));
+	OutMessages.clear();
+
+	return true;
+}
+
+RShaderCache::RShaderCache(const std::string& InCacheDirectory)
+	: CacheDirectory(InCacheDirectory)
+{
+}
+
+bool RShaderCache::Load(UINT64 CacheKey, std::vector<char>& OutBytecode) const
+{
+	std::ifstream fin(MakeCacheFilePath(CacheKey), std::ios::binary);
+	if (!fin.is_open())
+	{
+		return false;
+	}
+
+	RShaderCacheHeader Header;
+	if (!fin.read((char*)&Header, sizeof(Header)) || Header.Magic != ShaderCacheMagic || Header.CacheKey != CacheKey || Header.BytecodeSize == 0)
+	{
+		return false;
+	}
+
+	OutBytecode.resize(Header.BytecodeSize);
+	if (!fin.read(OutBytecode.data(), Header.BytecodeSize))
+	{
+		OutBytecode.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool RShaderCache::Save(UINT64 CacheKey, const void* Bytecode, size_t BytecodeSize) const
+{
+	const std::string CacheFilePath = MakeCacheFilePath(CacheKey);
+
+	// Jobs of the same permutation may save the same key from different threads
+	const std::string TempFilePath = CacheFilePath + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+	{
+		std::ofstream fout(TempFilePath, std::ios::binary | std::ios::trunc);
+		if (!fout.is_open())
+		{
+			return false;
+		}
+
+		RShaderCacheHeader Header;
+		Header.Magic = ShaderCacheMagic;
+		Header.BytecodeSize = (UINT32)BytecodeSize;
+		Header.CacheKey = CacheKey;
+
+		fout.write((const char*)&Header, sizeof(Header));
+		fout.write((const char*)Bytecode, BytecodeSize);
+
+		if (!fout)
+		{
+			fout.close();
+			std::remove(TempFilePath.c_str());
+			return false;
+		}
+	}
+
+	// Renaming doesn't replace existing files on every platform
+	std::remove(CacheFilePath.c_str());
+	if (std::rename(TempFilePath.c_str(), CacheFilePath.c_str()) != 0)
+	{
+		std::remove(TempFilePath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void RShaderCache::Remove(UINT64 CacheKey) const
+{
+	std::remove(MakeCacheFilePath(CacheKey).c_str());
+}
+
+std::string RShaderCache::MakeCacheFilePath(UINT64 CacheKey) const
+{
+	char KeyString[17];
+	snprintf(KeyString, sizeof(KeyString), "%016llx", (unsigned long long)CacheKey);
+	return CacheDirectory + KeyString + ".shadercache";
+}
+
+RShaderCompileQueue::RShaderCompileQueue(IShaderCompilerBackend* InBackend, const RShaderCache* InCache)
+	: Backend(InBackend)
+	, Cache(InCache)
+	, NumCacheHits(0)
+	, NumCompiled(0)
+	, NumFailed(0)
+{
+	assert(Backend);
+}
+
+int RShaderCompileQueue::AddJob(RShaderCompileJob&& Job)
+{
+	Jobs.push_back(std::move(Job));
+	return (int)Jobs.size() - 1;
+}
+
+void RShaderCompileQueue::CompileAll(bool bParallel /*= true*/)
+{
+	const int NumJobs = (int)Jobs.size();
+
+	if (bParallel)
+	{
+		// Compiles take milliseconds each, so every job is its own task
+		GThreadPool.ParallelFor(0, NumJobs, 1, [this](int Begin, int End)
+			{
+				for (int i = Begin; i < End; i++)
+				{
+					RunJob(Jobs[i]);
+				}
+			});
+	}
+	else
+	{
+		for (auto& Job : Jobs)
+		{
+			RunJob(Job);
+		}
+	}
+
+	NumCacheHits = 0;
+	NumCompiled = 0;
+	NumFailed = 0;
+
+	for (const auto& Job : Jobs)
+	{
+		if (Job.bLoadedFromCache)
+		{
+			NumCacheHits++;
+		}
+		else if (Job.bSucceeded)
+		{
+			NumCompiled++;
+		}
+		else
+		{
+			NumFailed++;
+		}
+	}
+}
+
+void RShaderCompileQueue::Reset()
+{
+	Jobs.clear();
+	NumCacheHits = 0;
+	NumCompiled = 0;
+	NumFailed = 0;
+}
+
+UINT64 RShaderCompileQueue::MakeCacheKey(const RShaderCompileJob& Job, const std::string& CompilerIdentifier)
+{
+	RCacheKeyHasher Hasher;
+
+	Hasher.AddString(CompilerIdentifier);
+
+	// File names are hashed too, since they appear in debug info and messages
+	Hasher.AddString(Job.SourceName);
+	Hasher.AddString(Job.Source);
+
+	for (const auto& Include : Job.Includes)
+	{
+		Hasher.AddString(Include.Name);
+		Hasher.AddString(Include.Text);
+	}
+
+	for (const auto& Macro : Job.Macros)
+	{
+		Hasher.AddString(Macro.Name);
+		Hasher.AddString(Macro.Definition);
+	}
+
+	Hasher.AddString(Job.EntryPoint);
+	Hasher.AddString(Job.Target);
+	Hasher.AddBytes(&Job.CompileFlags, sizeof(Job.CompileFlags));
+
+	return Hasher.GetHash();
+}
+
+void RShaderCompileQueue::RunJob(RShaderCompileJob& Job) const
+{
+	Job.CacheKey = MakeCacheKey(Job, Backend->GetIdentifier());
+	Job.Bytecode.clear();
+	Job.Messages.clear();
+	Job.bLoadedFromCache = false;
+
+	if (Cache && Cache->Load(Job.CacheKey, Job.Bytecode))
+	{
+		Job.bSucceeded = true;
+		Job.bLoadedFromCache = true;
+		return;
+	}
+
+	Job.bSucceeded = Backend->Compile(Job, Job.Bytecode, Job.Messages);
+
+	if (Job.bSucceeded && Cache && Job.Bytecode.size() > 0)
+	{
+		Cache->Save(Job.CacheKey, Job.Bytecode.data(), Job.Bytecode.size());
+	}
+}
@@ -0,0 +1,135 @@
+//=============================================================================
+// RShaderCompileQueue.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Shader compile jobs run on worker threads, with a disk cache keyed by their inputs
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+
+struct RShaderMacro
+{
+	std::string Name;
+	std::string Definition;
+};
+
+/// A file included by a shader, with the text it's compiled with
+struct RShaderIncludeFile
+{
+	std::string Name;
+	std::string Text;
+};
+
+/// Compile of one shader permutation. All inputs are resolved before the job is queued, so compiling it
+/// doesn't read any files, and its inputs fully determine its bytecode.
+struct RShaderCompileJob
+{
+	std::string						SourceName;
+	std::string						Source;
+	std::vector<RShaderIncludeFile>	Includes;
+	std::vector<RShaderMacro>		Macros;
+	std::string						EntryPoint = "main";
+	std::string						Target;
+	UINT							CompileFlags = 0;
+
+	// Results
+	UINT64							CacheKey = 0;
+	std::vector<char>				Bytecode;
+	std::string						Messages;
+	bool							bSucceeded = false;
+	bool							bLoadedFromCache = false;
+};
+
+/// A shader compiler which compile jobs are run with. Compile is called from worker threads
+/// for different jobs at the same time.
+class IShaderCompilerBackend
+{
+public:
+	virtual ~IShaderCompilerBackend() {}
+
+	/// Compile a job to bytecode. Messages are output for failed compiles, and for warnings of successful ones.
+	virtual bool Compile(const RShaderCompileJob& Job, std::vector<char>& OutBytecode, std::string& OutMessages) = 0;
+
+	/// Name and version of the compiler. Part of cache keys, so bytecode of a different compiler is never loaded.
+	virtual std::string GetIdentifier() const = 0;
+};
+
+/// Compiler which outputs a blob made of the target, entry point and cache key of a job without compiling it.
+/// Used to run the compile queue and cache where no shader compiler is available.
+class RStubShaderCompiler : public IShaderCompilerBackend
+{
+public:
+	/// Optionally spin for some time in each compile to stand in for the cost of a real compiler
+	RStubShaderCompiler(int InSimulatedCompileMicroseconds = 0);
+
+	virtual bool Compile(const RShaderCompileJob& Job, std::vector<char>& OutBytecode, std::string& OutMessages) override;
+	virtual std::string GetIdentifier() const override		{ return "StubShaderCompiler"; }
+
+private:
+	int SimulatedCompileMicroseconds;
+};
+
+/// Compiled bytecode stored on disk in files named after cache keys. A file starts with a header holding its
+/// key and size, so files which are truncated or don't belong to the key are treated as misses.
+class RShaderCache
+{
+public:
+	/// The directory must exist and end with a path separator
+	RShaderCache(const std::string& InCacheDirectory);
+
+	bool Load(UINT64 CacheKey, std::vector<char>& OutBytecode) const;
+
+	/// Write bytecode to a temporary file and rename it, so readers never see a partly written file
+	bool Save(UINT64 CacheKey, const void* Bytecode, size_t BytecodeSize) const;
+
+	/// Delete the file of a key
+	void Remove(UINT64 CacheKey) const;
+
+	std::string MakeCacheFilePath(UINT64 CacheKey) const;
+
+private:
+	std::string CacheDirectory;
+};
+
+/// Runs compile jobs on worker threads of the thread pool. Each job first looks up its cache key in the
+/// shader cache, and is only compiled on a miss.
+class RShaderCompileQueue
+{
+public:
+	/// The cache is optional
+	RShaderCompileQueue(IShaderCompilerBackend* InBackend, const RShaderCache* InCache);
+
+	/// Add a job and return its index
+	int AddJob(RShaderCompileJob&& Job);
+
+	/// Run all jobs and wait for them. Jobs are independent and run in any order.
+	void CompileAll(bool bParallel = true);
+
+	int GetNumJobs() const								{ return (int)Jobs.size(); }
+	const RShaderCompileJob& GetJob(int Index) const	{ return Jobs[Index]; }
+
+	/// Counts of the last run
+	int GetNumCacheHits() const							{ return NumCacheHits; }
+	int GetNumCompiled() const							{ return NumCompiled; }
+	int GetNumFailed() const							{ return NumFailed; }
+
+	/// Remove all jobs
+	void Reset();
+
+	/// Hash all inputs of a job with the compiler identifier
+	static UINT64 MakeCacheKey(const RShaderCompileJob& Job, const std::string& CompilerIdentifier);
+
+private:
+	/// Load or compile a job. Called from worker threads.
+	void RunJob(RShaderCompileJob& Job) const;
+
+	IShaderCompilerBackend*			Backend;
+	const RShaderCache*				Cache;
+
+	std::vector<RShaderCompileJob>	Jobs;
+
+	int								NumCacheHits;
+	int								NumCompiled;
+	int								NumFailed;
+};
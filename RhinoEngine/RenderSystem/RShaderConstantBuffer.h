@@ -11,6 +11,7 @@
 
 #include "D3DUtil.h"
 #include "RRenderSystem.h"
+#include "RConstantBufferRing.h"
 
 enum EConstantBufferShaderType
 {
@@ -38,7 +39,7 @@ public:
 		cbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		cbDesc.Usage = D3D11_USAGE_DYNAMIC;
 
-		GRenderer.D3DDevice()->CreateBuffer(&cbDesc, NULL, &m_ConstBuffer);
+		GRenderer.Device()->CreateBuffer(&cbDesc, NULL, &m_ConstBuffer);
 
 		// Initialize buffer values with zero
 		ClearData();
@@ -55,20 +56,29 @@ public:
 	void UpdateBufferData()
 	{
 		D3D11_MAPPED_SUBRESOURCE subres;
-		GRenderer.D3DImmediateContext()->Map(m_ConstBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subres);
+		GRenderer.Device()->Map(m_ConstBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subres);
 		memcpy(subres.pData, &Data, sizeof(TStructType));
-		GRenderer.D3DImmediateContext()->Unmap(m_ConstBuffer, 0);
+		GRenderer.Device()->Unmap(m_ConstBuffer, 0);
 	}
 
 	/// Bind constant buffer to shader for rendering
 	void BindBuffer()
 	{
 		if (SHADER_TYPE & CBST_VS)
-			GRenderer.D3DImmediateContext()->VSSetConstantBuffers(SLOT, 1, &m_ConstBuffer);
+			GRenderer.Device()->VSSetConstantBuffers(SLOT, 1, &m_ConstBuffer);
 		if (SHADER_TYPE & CBST_PS)
-			GRenderer.D3DImmediateContext()->PSSetConstantBuffers(SLOT, 1, &m_ConstBuffer);
+			GRenderer.Device()->PSSetConstantBuffers(SLOT, 1, &m_ConstBuffer);
 		if (SHADER_TYPE & CBST_GS)
-			GRenderer.D3DImmediateContext()->GSSetConstantBuffers(SLOT, 1, &m_ConstBuffer);
+			GRenderer.Device()->GSSetConstantBuffers(SLOT, 1, &m_ConstBuffer);
+	}
+
+	/// Bind a slice of a constant buffer ring in place of this buffer. The slice holds data written by the caller.
+	void BindRingSlice(RConstantBufferRing& Ring, UINT Offset, UINT SizeInBytes = sizeof(TStructType))
+	{
+		if (SHADER_TYPE & CBST_VS)
+			Ring.BindVS(SLOT, Offset, SizeInBytes);
+		if (SHADER_TYPE & CBST_PS)
+			Ring.BindPS(SLOT, Offset, SizeInBytes);
 	}
 
 	void ClearData()
@@ -88,6 +98,7 @@ public:
 	static RShaderConstantBuffer<SHADER_SCENE_BUFFER,		CBST_VS|CBST_GS|CBST_PS, 0>		cbScene;
 	static RShaderConstantBuffer<SHADER_GLOBAL_BUFFER,		CBST_VS|CBST_PS, 1>				cbGlobal;
 	static RShaderConstantBuffer<SHADER_OBJECT_BUFFER,		CBST_VS, 2>						cbPerObject;
+	static RShaderConstantBuffer<SHADER_INSTANCE_BUFFER,	CBST_VS, 3>						cbInstance;
 	static RShaderConstantBuffer<SHADER_SKINNED_BUFFER,		CBST_VS, 4>						cbBoneMatrices;
 	static RShaderConstantBuffer<SHADER_LIGHT_BUFFER,		CBST_PS, 2>						cbLight;
 	static RShaderConstantBuffer<SHADER_MATERIAL_BUFFER,	CBST_PS, 3>						cbMaterial;
@@ -99,6 +110,7 @@ public:
 FORCEINLINE void RConstantBuffers::Initialize()
 {
 	cbPerObject.Initialize();
+	cbInstance.Initialize();
 	cbScene.Initialize();
 	cbBoneMatrices.Initialize();
 	cbLight.Initialize();
@@ -109,6 +121,7 @@ FORCEINLINE void RConstantBuffers::Initialize()
 FORCEINLINE void RConstantBuffers::Shutdown()
 {
 	cbPerObject.Release();
+	cbInstance.Release();
 	cbScene.Release();
 	cbBoneMatrices.Release();
 	cbLight.Release();
@@ -7,6 +7,7 @@
 #include "RShaderManager.h"
 
 #include "RRenderSystem.h"
+#include "RShaderCompileQueue.h"
 
 #include "Core/RFileUtil.h"
 #include "Core/RLog.h"
@@ -37,6 +38,104 @@ namespace
 		{ EShaderType::PixelShader,		"Deferred",		"ps_4_0", { "USE_DEFERRED_SHADING", "1", nullptr, nullptr}, offsetof(RShader, PixelShader_Deferred) },
 		{ EShaderType::GeometryShader,	"",				"gs_4_0", { nullptr, nullptr },								offsetof(RShader, GeometryShader) },
 	};
+
+	/// Serves included files from the text read for a compile job, so the compiler sees exactly what the job was hashed with
+	class RJobIncludeHandler : public ID3DInclude
+	{
+	public:
+		RJobIncludeHandler(const RShaderCompileJob& InJob)
+			: Job(InJob)
+		{}
+
+		virtual HRESULT STDMETHODCALLTYPE Open(D3D_INCLUDE_TYPE IncludeType, LPCSTR pFileName, LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes) override
+		{
+			for (const auto& Include : Job.Includes)
+			{
+				if (Include.Name == pFileName)
+				{
+					*ppData = Include.Text.data();
+					*pBytes = (UINT)Include.Text.size();
+					return S_OK;
+				}
+			}
+
+			return E_FAIL;
+		}
+
+		virtual HRESULT STDMETHODCALLTYPE Close(LPCVOID pData) override
+		{
+			return S_OK;
+		}
+
+	private:
+		const RShaderCompileJob& Job;
+	};
+
+	/// Compiles shaders with D3DCompile. Jobs don't touch any shared state, so they can be compiled on any thread.
+	class RD3DShaderCompiler : public IShaderCompilerBackend
+	{
+	public:
+		virtual bool Compile(const RShaderCompileJob& Job, std::vector<char>& OutBytecode, std::string& OutMessages) override
+		{
+			std::vector<D3D_SHADER_MACRO> ShaderMacros;
+			for (const auto& Macro : Job.Macros)
+			{
+				ShaderMacros.push_back({ Macro.Name.c_str(), Macro.Definition.c_str() });
+			}
+			ShaderMacros.push_back({ nullptr, nullptr });
+
+			RJobIncludeHandler IncludeHandler(Job);
+			ComPtr<ID3DBlob> pShaderCode;
+			ComPtr<ID3DBlob> pErrorMsg;
+
+			HRESULT hr = D3DCompile(Job.Source.c_str(), Job.Source.size(), Job.SourceName.c_str(), ShaderMacros.data(), &IncludeHandler,
+									Job.EntryPoint.c_str(), Job.Target.c_str(), Job.CompileFlags, 0, &pShaderCode, &pErrorMsg);
+
+			if (pErrorMsg)
+			{
+				OutMessages = (const char*)pErrorMsg->GetBufferPointer();
+			}
+
+			if (FAILED(hr))
+			{
+				return false;
+			}
+
+			const char* Bytecode = (const char*)pShaderCode->GetBufferPointer();
+			OutBytecode.assign(Bytecode, Bytecode + pShaderCode->GetBufferSize());
+			return true;
+		}
+
+		virtual std::string GetIdentifier() const override
+		{
+			return std::string("D3DCompile_") + std::to_string(D3D_COMPILER_VERSION);
+		}
+	};
+
+	/// Replace relative path to absolute path for going to error lines by double-clicking in the output log
+	std::string MakeMessagePathsAbsolute(const std::string& Messages)
+	{
+		std::stringstream StringStream(Messages);
+		std::string Line;
+		std::string Output;
+
+		while (std::getline(StringStream, Line, '\n'))
+		{
+			size_t pos = Line.find_first_of('(');
+			if (pos != std::string::npos)
+			{
+				std::string ErrorFileName = Line.substr(0, pos);
+				ErrorFileName = RFileUtil::GetFullPath(ErrorFileName);
+				Output += ErrorFileName + Line.substr(pos) + '\n';
+			}
+			else
+			{
+				Output += Line + '\n';
+			}
+		}
+
+		return Output.size() > 0 ? Output : Messages;
+	}
 }
 
 const std::string RShaderManager::EmptyShaderName = "";
@@ -133,6 +232,19 @@ void RShaderManager::LoadShaders(const std::string& Path)
 	// Set working directory to shader folder for compiling
 	RFileUtil::PushWorkingPath(Path);
 
+	const std::string ShaderCachePath = GetShaderCachePath();
+	if (!RFileUtil::CheckPathExists(ShaderCachePath))
+	{
+		RFileUtil::CreateDirectory(ShaderCachePath);
+	}
+
+	// Permutations of all shaders are compiled together on worker threads. Shaders are created from
+	// their bytecode afterwards, in the order their jobs were added.
+	RD3DShaderCompiler Compiler;
+	RShaderCache ShaderCache(ShaderCachePath);
+	RShaderCompileQueue CompileQueue(&Compiler, &ShaderCache);
+	std::vector<std::pair<RShader*, int>> JobTargets;
+
 	WIN32_FIND_DATAA FindFileData;
 	HANDLE hFind;
 
@@ -151,63 +263,55 @@ void RShaderManager::LoadShaders(const std::string& Path)
 				// Get actual shader name
 				std::string shaderName = filename.substr(0, filename.length() - 8);
 
-				RShader* Shader = nullptr;
-				auto Iter = m_Shaders.find(shaderName);
-				if (Iter == m_Shaders.end())
-				{
-					auto PairIter = m_Shaders.emplace(shaderName, RShader{});
-					if (PairIter.second == true)
-					{
-						Shader = &PairIter.first->second;
-					}
-				}
-				else
-				{
-					Shader = &Iter->second;
-				}
-
-				if (!Shader)
-				{
-					RLogError("RShaderManager::LoadShaders - Failed to allocate a new shader!");
-					continue;
-				}
+				RShader* Shader = FindOrAddShader(shaderName);
 
 				// Read shader text from .hlsl
 				std::string ShaderBuffer = ReadStringBuffer(filename);
 				if (ShaderBuffer.size() > 0)
 				{
-					RLog("Compiling shader %s\n", filename.c_str());
-					CompileShader(filename, ShaderBuffer, Shader);
+					AddCompileJobs(filename, ShaderBuffer, Shader, CompileQueue, JobTargets);
 				}
 			}
 
 		} while (FindNextFileA(hFind, &FindFileData) != 0);
 	}
 
+	RLog("Compiling %d shader permutations\n", CompileQueue.GetNumJobs());
+	CompileQueue.CompileAll();
+
+	for (int i = 0; i < CompileQueue.GetNumJobs(); i++)
+	{
+		CreateShaderFromJob(CompileQueue.GetJob(i), JobTargets[i].first, JobTargets[i].second);
+	}
+
+	RLog("Shaders: %d loaded from cache, %d compiled, %d failed\n", CompileQueue.GetNumCacheHits(), CompileQueue.GetNumCompiled(), CompileQueue.GetNumFailed());
+
 	// Restore working directory
 	RFileUtil::PopWorkingPath();
 }
 
 void RShaderManager::UnloadAllShaders()
 {
-	for (auto Iter : m_Shaders)
+	for (auto& Shader : m_Shaders)
 	{
-		SAFE_RELEASE(Iter.second.VertexShader);
-		SAFE_RELEASE(Iter.second.VertexShader_Skinned);
-		SAFE_RELEASE(Iter.second.VertexShader_Instanced);
-		SAFE_RELEASE(Iter.second.PixelShader);
-		SAFE_RELEASE(Iter.second.PixelShader_Deferred);
-		SAFE_RELEASE(Iter.second.GeometryShader);
+		SAFE_RELEASE(Shader.VertexShader);
+		SAFE_RELEASE(Shader.VertexShader_Skinned);
+		SAFE_RELEASE(Shader.VertexShader_Instanced);
+		SAFE_RELEASE(Shader.PixelShader);
+		SAFE_RELEASE(Shader.PixelShader_Deferred);
+		SAFE_RELEASE(Shader.GeometryShader);
 	}
 
 	m_Shaders.clear();
+	m_ShaderNames.clear();
+	m_ShaderIds.clear();
 }
 
 const RShader* RShaderManager::FindShaderByName(const std::string& ShaderName) const
 {
-	auto iter = m_Shaders.find(ShaderName);
-	if (iter != m_Shaders.end())
-		return &iter->second;
+	auto iter = m_ShaderIds.find(ShaderName);
+	if (iter != m_ShaderIds.end())
+		return &m_Shaders[iter->second];
 	return nullptr;
 }
 
@@ -228,22 +332,29 @@ RShader* RShaderManager::GetDefaultShader()
 	return DefaultShader;
 }
 
-std::vector<std::string> RShaderManager::EnumerateAllShaderNames() const
+RShader* RShaderManager::GetShaderById(int Id)
 {
-	std::vector<std::string> NameList;
-
-	for (auto& ShaderData : m_Shaders)
+	if (Id >= 0 && Id < (int)m_Shaders.size())
 	{
-		NameList.push_back(ShaderData.first);
+		return &m_Shaders[Id];
 	}
 
+	return nullptr;
+}
+
+std::vector<std::string> RShaderManager::EnumerateAllShaderNames() const
+{
+	// Listed in alphabetical order for tools
+	std::vector<std::string> NameList = m_ShaderNames;
+	std::sort(NameList.begin(), NameList.end());
+
 	return NameList;
 }
 
 ID3D11PixelShader* RShaderManager::CreatePixelShaderFromBytecode(const void* pBytecode, SIZE_T BytecodeSize)
 {
 	ID3D11PixelShader* OutputShader = nullptr;
-	if (FAILED(GRenderer.D3DDevice()->CreatePixelShader(pBytecode, BytecodeSize, 0, &OutputShader)))
+	if (FAILED(GRenderer.Device()->CreatePixelShader(pBytecode, BytecodeSize, &OutputShader)))
 	{
 		RLogWarning("Failed to create pixel shader from bytecode!\n");
 		return nullptr;
@@ -254,45 +365,51 @@ ID3D11PixelShader* RShaderManager::CreatePixelShaderFromBytecode(const void* pBy
 
 const std::string& RShaderManager::GetShaderName(const RShader* shader) const
 {
-	if (shader)
+	// Copies of shaders are not owned by the manager, and have no names
+	if (shader && shader->Id >= 0 && shader->Id < (int)m_Shaders.size() && &m_Shaders[shader->Id] == shader)
 	{
-		auto iter = m_Shaders.begin();
-		for (; iter != m_Shaders.end(); iter++)
-		{
-			if (iter->second == *shader)
-			{
-				return iter->first;
-			}
-		}
+		return m_ShaderNames[shader->Id];
 	}
 
 	return EmptyShaderName;
 }
 
-void RShaderManager::CompileShader(const std::string& SourceName, const std::string& ShaderBuffer, RShader* Shader)
+RShader* RShaderManager::FindOrAddShader(const std::string& ShaderName)
 {
-	HRESULT hr;
-	ComPtr<ID3DBlob> pShaderCode;
-	ComPtr<ID3DBlob> pErrorMsg;
+	auto Iter = m_ShaderIds.find(ShaderName);
+	if (Iter != m_ShaderIds.end())
+	{
+		return &m_Shaders[Iter->second];
+	}
+
+	const int Id = (int)m_Shaders.size();
+	m_Shaders.emplace_back();
+	m_Shaders.back().Id = Id;
+	m_ShaderNames.push_back(ShaderName);
+	m_ShaderIds.emplace(ShaderName, Id);
 
+	return &m_Shaders.back();
+}
+
+void RShaderManager::AddCompileJobs(const std::string& SourceName, const std::string& ShaderBuffer, RShader* Shader,
+									RShaderCompileQueue& Queue, std::vector<std::pair<RShader*, int>>& InOutJobTargets)
+{
 	EShaderType ShaderType = DetectShaderType(SourceName);
 	if (ShaderType == EShaderType::Unknown)
 	{
 		return;
 	}
 
-	// Find all included files for timestamp comparison with the shader cache
-	std::vector<std::string> IncludeFiles;
+	// Included files are part of the cache keys of all permutations
+	std::vector<RShaderIncludeFile> IncludeFiles;
 	FindShaderIncludedFiles(ShaderBuffer, IncludeFiles);
-	IncludeFiles.push_back(SourceName);
 
-	// Remove any engine header files
-	StdRemove(IncludeFiles, "Core/RVector.h");
-	StdRemove(IncludeFiles, "Core/RMatrix.h");
-
-	if (StdContains(IncludeFiles, "BRDF.hlsli"))
+	for (const auto& Include : IncludeFiles)
 	{
-		Shader->bUsePBR = true;
+		if (Include.Name == "BRDF.hlsli")
+		{
+			Shader->bUsePBR = true;
+		}
 	}
 
 	for (int Index = 0; Index < ARRAYSIZE(ShaderCompileOptions); Index++)
@@ -312,122 +429,90 @@ void RShaderManager::CompileShader(const std::string& SourceName, const std::str
 
 		if (bOriginalShader || bIsFeatureUsed)
 		{
-			const std::string SourceNameWithFeaturePrefix = CompileOption.Prefix + SourceName;
-			std::vector<char> ShaderCache;
-
-			void* ShaderCodeBuffer = nullptr;
-			SIZE_T ShaderCodeSize;
-			bool bHasCacheFile = false;
-
-			if (!CheckShaderCacheOutdated(SourceNameWithFeaturePrefix, IncludeFiles) &&
-				(bHasCacheFile = TryLoadShaderFromCache(SourceNameWithFeaturePrefix, SourceName, ShaderCache)))
+			RShaderCompileJob Job;
+			Job.SourceName = SourceName;
+			Job.Source = ShaderBuffer;
+			Job.Includes = IncludeFiles;
+			Job.Target = CompileOption.ShaderTarget;
+			Job.CompileFlags = GetShaderCompileFlag();
+
+			if (!bOriginalShader)
 			{
-				ShaderCodeBuffer = ShaderCache.data();
-				ShaderCodeSize = ShaderCache.size();
+				Job.Macros.push_back({ CompileOption.ShaderMacros[0].Name, CompileOption.ShaderMacros[0].Definition });
 			}
-			else
-			{
-				if (SUCCEEDED(hr = D3DCompile(ShaderBuffer.c_str(), ShaderBuffer.size(), SourceName.c_str(), CompileOption.ShaderMacros, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main", CompileOption.ShaderTarget, GetShaderCompileFlag(), 0, &pShaderCode, &pErrorMsg)))
-				{
-					ShaderCodeBuffer = pShaderCode->GetBufferPointer();
-					ShaderCodeSize = pShaderCode->GetBufferSize();
-				}
 
-				std::string OutputMsgString;
-				if (pErrorMsg)
-				{
-					OutputMsgString = ((char*)pErrorMsg->GetBufferPointer());
-				}
+			Queue.AddJob(std::move(Job));
+			InOutJobTargets.push_back(std::make_pair(Shader, Index));
+		}
+	}
+}
 
-				// Replace relative path to absolute path for going to error lines by double-clicking in the output log
-				{
-					std::stringstream StringStream(OutputMsgString);
-					std::string Line;
-					std::string Output;
-
-					while (std::getline(StringStream, Line, '\n'))
-					{
-						size_t pos = Line.find_first_of('(');
-						if (pos != std::string::npos)
-						{
-							std::string ErrorFileName = Line.substr(0, pos);
-							ErrorFileName = RFileUtil::GetFullPath(ErrorFileName);
-							Output += ErrorFileName + Line.substr(pos) + '\n';
-						}
-						else
-						{
-							Output += Line + '\n';
-						}
-					}
-
-					if (Output.size() > 0)
-					{
-						OutputMsgString = Output;
-					}
-				}
+void RShaderManager::CreateShaderFromJob(const RShaderCompileJob& Job, RShader* Shader, int CompileOptionIndex)
+{
+	const RShaderCompileOption& CompileOption = ShaderCompileOptions[CompileOptionIndex];
+	const std::string SourceNameWithFeaturePrefix = CompileOption.Prefix + Job.SourceName;
 
-				if (SUCCEEDED(hr))
-				{
-					if (OutputMsgString.size() > 0)
-					{
-						// Output any warnings for a successful compile
-						RLog("%s\n", OutputMsgString.c_str());
-					}
-				}
-				else
-				{
-					RLogError("RShaderManager::CompileShader - Failed to compile shader \'%s\'\n", SourceName.c_str());
-					RLog("%s\n", OutputMsgString.c_str());
-					continue;
-				}
-			}
+	std::string OutputMsgString;
+	if (Job.Messages.size() > 0)
+	{
+		OutputMsgString = MakeMessagePathsAbsolute(Job.Messages);
+	}
 
-			switch (ShaderType)
-			{
-			case EShaderType::VertexShader:
-				CreateVertexShader(SourceNameWithFeaturePrefix, ShaderCodeBuffer, ShaderCodeSize, (ID3D11VertexShader**)((char*)Shader + CompileOption.MemberOffset));
-				break;
+	if (!Job.bSucceeded)
+	{
+		RLogError("RShaderManager::CompileShader - Failed to compile shader \'%s\'\n", SourceNameWithFeaturePrefix.c_str());
+		RLog("%s\n", OutputMsgString.c_str());
+		return;
+	}
 
-			case EShaderType::PixelShader:
-				CreatePixelShader(SourceNameWithFeaturePrefix, ShaderCodeBuffer, ShaderCodeSize, (ID3D11PixelShader**)((char*)Shader + CompileOption.MemberOffset));
-				break;
+	if (OutputMsgString.size() > 0)
+	{
+		// Output any warnings for a successful compile
+		RLog("%s\n", OutputMsgString.c_str());
+	}
 
-			case EShaderType::GeometryShader:
-				CreateGeometryShader(SourceNameWithFeaturePrefix, ShaderCodeBuffer, ShaderCodeSize, (ID3D11GeometryShader**)((char*)Shader + CompileOption.MemberOffset));
-				break;
-			}
+	const void* ShaderCodeBuffer = Job.Bytecode.data();
+	const SIZE_T ShaderCodeSize = Job.Bytecode.size();
 
-			// Get texture names through shader reflection
-			if (ShaderType == EShaderType::PixelShader && bOriginalShader)
-			{
-				ID3D11ShaderReflection* pReflector = NULL;
-				D3DReflect(ShaderCodeBuffer, ShaderCodeSize, IID_ID3D11ShaderReflection, (void**)&pReflector);
+	switch (CompileOption.Type)
+	{
+	case EShaderType::VertexShader:
+		CreateVertexShader(SourceNameWithFeaturePrefix, ShaderCodeBuffer, ShaderCodeSize, (ID3D11VertexShader**)((char*)Shader + CompileOption.MemberOffset));
+		break;
 
-				D3D11_SHADER_DESC ShaderDesc;
-				pReflector->GetDesc(&ShaderDesc);
+	case EShaderType::PixelShader:
+		CreatePixelShader(SourceNameWithFeaturePrefix, ShaderCodeBuffer, ShaderCodeSize, (ID3D11PixelShader**)((char*)Shader + CompileOption.MemberOffset));
+		break;
 
-				for (UINT i = 0; i < ShaderDesc.BoundResources; i++)
-				{
-					D3D11_SHADER_INPUT_BIND_DESC ShaderInputBindDesc;
-					pReflector->GetResourceBindingDesc(i, &ShaderInputBindDesc);
-
-					if (ShaderInputBindDesc.Type == D3D_SIT_TEXTURE)
-					{
-						if (ShaderInputBindDesc.Dimension == D3D_SRV_DIMENSION_TEXTURE2D || ShaderInputBindDesc.Dimension == D3D_SRV_DIMENSION_TEXTURECUBE)
-						{
-							EShaderTextureDimension TextureDimension = ShaderInputBindDesc.Dimension == D3D_SRV_DIMENSION_TEXTURE2D ? EShaderTextureDimension::Texture2D : EShaderTextureDimension::CubeTexture;
-							const std::string TextureObjectName = ShaderInputBindDesc.Name;
-
-							Shader->AddTextureSlotMetaData(TextureObjectName, ShaderInputBindDesc.BindPoint, TextureDimension);
-						}
-					}
-				}
-			}
+	case EShaderType::GeometryShader:
+		CreateGeometryShader(SourceNameWithFeaturePrefix, ShaderCodeBuffer, ShaderCodeSize, (ID3D11GeometryShader**)((char*)Shader + CompileOption.MemberOffset));
+		break;
+	}
+
+	// Get texture names through shader reflection
+	const bool bOriginalShader = !CompileOption.ShaderMacros[0].Name;
+	if (CompileOption.Type == EShaderType::PixelShader && bOriginalShader)
+	{
+		ID3D11ShaderReflection* pReflector = NULL;
+		D3DReflect(ShaderCodeBuffer, ShaderCodeSize, IID_ID3D11ShaderReflection, (void**)&pReflector);
+
+		D3D11_SHADER_DESC ShaderDesc;
+		pReflector->GetDesc(&ShaderDesc);
+
+		for (UINT i = 0; i < ShaderDesc.BoundResources; i++)
+		{
+			D3D11_SHADER_INPUT_BIND_DESC ShaderInputBindDesc;
+			pReflector->GetResourceBindingDesc(i, &ShaderInputBindDesc);
 
-			if (!bHasCacheFile)
+			if (ShaderInputBindDesc.Type == D3D_SIT_TEXTURE)
 			{
-				// Create a new cache for shader
-				SaveShaderCache(SourceNameWithFeaturePrefix, ShaderCodeBuffer, ShaderCodeSize);
+				if (ShaderInputBindDesc.Dimension == D3D_SRV_DIMENSION_TEXTURE2D || ShaderInputBindDesc.Dimension == D3D_SRV_DIMENSION_TEXTURECUBE)
+				{
+					EShaderTextureDimension TextureDimension = ShaderInputBindDesc.Dimension == D3D_SRV_DIMENSION_TEXTURE2D ? EShaderTextureDimension::Texture2D : EShaderTextureDimension::CubeTexture;
+					const std::string TextureObjectName = ShaderInputBindDesc.Name;
+
+					Shader->AddTextureSlotMetaData(TextureObjectName, ShaderInputBindDesc.BindPoint, TextureDimension);
+				}
 			}
 		}
 	}
@@ -435,7 +520,7 @@ void RShaderManager::CompileShader(const std::string& SourceName, const std::str
 
 void RShaderManager::CreateVertexShader(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength, ID3D11VertexShader** VertexShader)
 {
-	if (SUCCEEDED(GRenderer.D3DDevice()->CreateVertexShader(ShaderBytecode, BytecodeLength, NULL, VertexShader)))
+	if (SUCCEEDED(GRenderer.Device()->CreateVertexShader(ShaderBytecode, BytecodeLength, VertexShader)))
 	{
 #ifdef _DEBUG
 		// Assign source file name to shader for debugging
@@ -446,7 +531,7 @@ void RShaderManager::CreateVertexShader(const std::string& SourceName, const voi
 
 void RShaderManager::CreatePixelShader(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength, ID3D11PixelShader** PixelShader)
 {
-	if (SUCCEEDED(GRenderer.D3DDevice()->CreatePixelShader(ShaderBytecode, BytecodeLength, NULL, PixelShader)))
+	if (SUCCEEDED(GRenderer.Device()->CreatePixelShader(ShaderBytecode, BytecodeLength, PixelShader)))
 	{
 #ifdef _DEBUG
 		// Assign source file name to shader for debugging
@@ -457,7 +542,7 @@ void RShaderManager::CreatePixelShader(const std::string& SourceName, const void
 
 void RShaderManager::CreateGeometryShader(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength, ID3D11GeometryShader** GeometryShader)
 {
-	if (SUCCEEDED(GRenderer.D3DDevice()->CreateGeometryShader(ShaderBytecode, BytecodeLength, NULL, GeometryShader)))
+	if (SUCCEEDED(GRenderer.Device()->CreateGeometryShader(ShaderBytecode, BytecodeLength, GeometryShader)))
 	{
 #ifdef _DEBUG
 		// Assign source file name to shader for debugging
@@ -466,104 +551,6 @@ void RShaderManager::CreateGeometryShader(const std::string& SourceName, const v
 	}
 }
 
-bool RShaderManager::CheckShaderCacheOutdated(const std::string& SourceName, const std::vector<std::string>& Includes)
-{
-	std::string ShaderCachePath = GetShaderCachePath() + MakeCacheFileName(SourceName);
-
-	if (RFileUtil::CheckPathExists(ShaderCachePath))
-	{
-		for (auto IncludeFile : Includes)
-		{
-			std::string ShaderFilePath = GetShaderRootPath() + "/" + IncludeFile;
-			ETimestampComparison Result = RFileUtil::CompareFileTimestamp(ShaderFilePath, ShaderCachePath);
-			if (Result == ETimestampComparison::EarlierSecond || Result == ETimestampComparison::InvalidFile)
-			{
-				// If any include file has been saved after the shader cache, the cache is outdated.
-				return true;
-			}
-		}
-	}
-
-	return false;
-}
-
-bool RShaderManager::TryLoadShaderFromCache(const std::string& SourceName, const std::string& DiskFileName, std::vector<char>& OutBytecode)
-{
-	std::string ShaderCachePath = GetShaderCachePath() + MakeCacheFileName(SourceName);
-
-	if (RFileUtil::CheckPathExists(ShaderCachePath))
-	{
-		std::string ShaderFilePath = GetShaderRootPath() + "/" + DiskFileName;
-		ETimestampComparison Result = RFileUtil::CompareFileTimestamp(ShaderFilePath, ShaderCachePath);
-		if (Result == ETimestampComparison::EarlierSecond || Result == ETimestampComparison::InvalidFile)
-		{
-			// If shader file has been saved after cache file, regenerate the cache now.
-			return false;
-		}
-
-		// Load compiled shader from cache file
-		std::ifstream fin;
-		fin.open(ShaderCachePath, std::ios::binary);
-
-		if (fin.is_open())
-		{
-			fin.seekg(0, std::ios::end);
-			int fileSize = (int)fin.tellg();
-			OutBytecode.resize(fileSize);
-
-			fin.seekg(0);
-			fin.read(OutBytecode.data(), fileSize);
-			fin.close();
-
-			if (OutBytecode.size() == 0)
-			{
-				return false;
-			}
-
-			return true;
-		}
-	}
-
-	return false;
-}
-
-void RShaderManager::SaveShaderCache(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength)
-{
-	std::string ShaderCachePath = GetShaderCachePath();
-
-	// Create the cache folder if it doesn't exist
-	if (!RFileUtil::CheckPathExists(ShaderCachePath))
-	{
-		if (!RFileUtil::CreateDirectory(ShaderCachePath))
-		{
-			return;
-		}
-	}
-
-	ShaderCachePath += MakeCacheFileName(SourceName);
-	std::ofstream fout;
-	fout.open(ShaderCachePath, std::ios::binary | std::ios::trunc);
-	if (fout.is_open())
-	{
-		fout.write((const char*)ShaderBytecode, BytecodeLength);
-		fout.close();
-		RLog("Shader cache is saved to: %s\n", ShaderCachePath.c_str());
-	}
-	else
-	{
-		RLogError("Failed to write to shader cache: %s\n", ShaderCachePath.c_str());
-	}
-}
-
-std::string RShaderManager::MakeCacheFileName(const std::string& SourceName) const
-{
-	std::string CacheFileName = RFileUtil::StripExtension(SourceName);
-	CacheFileName += "_";
-	CacheFileName += std::to_string(GetShaderCompileFlag());
-	CacheFileName += ".shadercache";
-	return CacheFileName;
-}
-
 std::string RShaderManager::GetShaderCachePath() const
 {
 	return RFileUtil::GetFullPath(GetShaderRootPath() + "/Cache/");
@@ -591,7 +578,7 @@ std::string RShaderManager::ReadStringBuffer(const std::string& filename) const
 	return StringBuffer;
 }
 
-bool RShaderManager::FindShaderIncludedFiles(const std::string& ShaderBuffer, std::vector<std::string>& InOutFileList)
+bool RShaderManager::FindShaderIncludedFiles(const std::string& ShaderBuffer, std::vector<RShaderIncludeFile>& InOutIncludes)
 {
 	std::istringstream StreamStream(ShaderBuffer);
 	std::string Line;
@@ -612,18 +599,21 @@ bool RShaderManager::FindShaderIncludedFiles(const std::string& ShaderBuffer, st
 				// Remove quote marks
 				FileName.erase(std::remove(FileName.begin(), FileName.end(), '\"'), FileName.end());
 
-				if (!StdContains(InOutFileList, FileName))
-				{
-					InOutFileList.push_back(FileName);
+				auto Iter = std::find_if(InOutIncludes.begin(), InOutIncludes.end(),
+					[&FileName](const RShaderIncludeFile& Include) { return Include.Name == FileName; });
 
+				if (Iter == InOutIncludes.end())
+				{
+					// Engine headers included by shared C++ headers can't be read from here, and are kept with empty text
 					std::string StringBuffer = ReadStringBuffer(FileName);
-					FindShaderIncludedFiles(StringBuffer, InOutFileList);
+					InOutIncludes.push_back({ FileName, StringBuffer });
+					FindShaderIncludedFiles(StringBuffer, InOutIncludes);
 				}
 			}
 		}
 	}
 
-	return InOutFileList.size() != 0;
+	return InOutIncludes.size() != 0;
 }
 
 EShaderType RShaderManager::DetectShaderType(const std::string& FileName) const
@@ -9,8 +9,12 @@
 #include "Core/RSingleton.h"
 
 #include <d3d11.h>
+#include <deque>
 
 class RShaderManager;
+class RShaderCompileQueue;
+struct RShaderCompileJob;
+struct RShaderIncludeFile;
 
 enum EShaderFeatureMask
 {
@@ -53,6 +57,9 @@ struct RShader
 	void Bind(int featureMasks = 0) const;
 	const std::string& GetName() const;
 
+	/// Index of the shader in the shader manager. Ids are dense and stay the same until shaders are unloaded.
+	int GetId() const { return Id; }
+
 	/// Get name for the texture slot by id
 	bool QueryTexutreSlotName(int SlotId, std::string& OutSlotName) const;
 
@@ -74,6 +81,8 @@ private:
 	};
 
 	std::vector<RTextureSlotMetaData> TextureSlotMetaData;
+
+	int Id = -1;
 };
 
 class RShaderManager : public RSingleton<RShaderManager>
@@ -94,6 +103,10 @@ public:
 	const RShader* FindShaderByName(const std::string& ShaderName) const;
 	RShader* FindShaderByName(const std::string& ShaderName);
 
+	/// Get a shader by its id
+	RShader* GetShaderById(int Id);
+	int GetNumShaders() const { return (int)m_Shaders.size(); }
+
 	/// Get the default shader for any fallback use cases
 	RShader* GetDefaultShader();
 
@@ -109,39 +122,38 @@ private:
 
 	const std::string& GetShaderName(const RShader* shader) const;
 
-	void CompileShader(const std::string& SourceName, const std::string& ShaderBuffer, RShader* Shader);
+	/// Find a shader by name, or add an empty one with the next id
+	RShader* FindOrAddShader(const std::string& ShaderName);
+
+	/// Add compile jobs of all permutations of a shader file to the queue, with the shader and compile option of each job
+	void AddCompileJobs(const std::string& SourceName, const std::string& ShaderBuffer, RShader* Shader,
+						RShaderCompileQueue& Queue, std::vector<std::pair<RShader*, int>>& InOutJobTargets);
+
+	/// Create the shader of a finished compile job, and read texture slots of original pixel shaders
+	void CreateShaderFromJob(const RShaderCompileJob& Job, RShader* Shader, int CompileOptionIndex);
 
 	void CreateVertexShader(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength, ID3D11VertexShader** VertexShader);
 	void CreatePixelShader(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength, ID3D11PixelShader** PixelShader);
 	void CreateGeometryShader(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength, ID3D11GeometryShader** GeometryShader);
 
-	/// Check if any include files is newer than the shader cache
-	bool CheckShaderCacheOutdated(const std::string& SourceName, const std::vector<std::string>& Includes);
-
-	/// Load a shader from its cache file
-	bool TryLoadShaderFromCache(const std::string& SourceName, const std::string& DiskFileName, std::vector<char>& OutBytecode);
-
-	/// Save cache file for a shader to disk
-	void SaveShaderCache(const std::string& SourceName, const void* ShaderBytecode, SIZE_T BytecodeLength);
-
-	/// Generate cache file name for a shader file
-	std::string MakeCacheFileName(const std::string& SourceName) const;
-
 	/// Get the path of shader cache folder
 	std::string GetShaderCachePath() const;
 
 	/// Read a string buffer from file
 	std::string ReadStringBuffer(const std::string& filename) const;
 
-	/// Find all include file names in the shader buffer (recursively)
-	bool FindShaderIncludedFiles(const std::string& ShaderBuffer, std::vector<std::string>& InOutFileList);
+	/// Find all files included by the shader buffer (recursively) and read them
+	bool FindShaderIncludedFiles(const std::string& ShaderBuffer, std::vector<RShaderIncludeFile>& InOutIncludes);
 
 	/// Guess type of a shader by its file name
 	EShaderType DetectShaderType(const std::string& FileName) const;
 	UINT GetShaderCompileFlag() const;
 
 private:
-	std::map<std::string, RShader>	m_Shaders;
+	// Shaders are stored in order of their ids. A deque never moves its elements, so materials can keep pointers to shaders.
+	std::deque<RShader>						m_Shaders;
+	std::vector<std::string>				m_ShaderNames;
+	std::unordered_map<std::string, int>	m_ShaderIds;
 
 	static const std::string EmptyShaderName;
 };
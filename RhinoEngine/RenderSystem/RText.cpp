@@ -128,6 +128,6 @@ void RText::Render()
 
 	GRenderer.SetBlendState(BlendState::AlphaBlending);
 	m_FontShader->Bind();
-	GRenderer.D3DImmediateContext()->PSSetShaderResources(0, 1, m_FontTexture->GetPtrSRV());
+	GRenderer.Device()->PSSetShaderResources(0, 1, m_FontTexture->GetPtrSRV());
 	m_VertexBuffer.Draw();
 }
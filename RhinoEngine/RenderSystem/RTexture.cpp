@@ -10,6 +10,7 @@
 
 #include "Core/RFileUtil.h"
 #include "Core/RLog.h"
+#include "Core/RVirtualFileSystem.h"
 
 #include "D3DCommonPrivate.h"
 #include "D3DUtil.h"
@@ -20,6 +21,116 @@
 
 const std::string RTexture::InternalTextureName("[Internal]");
 
+namespace
+{
+	/// Read size and mip count from the header of a DDS file
+	bool ReadDDSHeaderDimensions(const uint8_t* Data, size_t Size, UINT& OutWidth, UINT& OutHeight, UINT& OutMipLevels)
+	{
+		// Magic number followed by header size, flags, height, width, pitch, depth and mip count
+		if (Size < 32 || memcmp(Data, "DDS ", 4) != 0)
+		{
+			return false;
+		}
+
+		const UINT* Header = reinterpret_cast<const UINT*>(Data + 4);
+		OutHeight = Header[2];
+		OutWidth = Header[3];
+		OutMipLevels = RMath::Max(Header[6], 1u);
+		return OutWidth > 0 && OutHeight > 0;
+	}
+
+	/// Get number of bytes of a 4x4 block for block compressed formats, or zero for other formats
+	UINT GetBlockSizeInBytes(DXGI_FORMAT Format)
+	{
+		switch (Format)
+		{
+		case DXGI_FORMAT_BC1_TYPELESS:
+		case DXGI_FORMAT_BC1_UNORM:
+		case DXGI_FORMAT_BC1_UNORM_SRGB:
+		case DXGI_FORMAT_BC4_TYPELESS:
+		case DXGI_FORMAT_BC4_UNORM:
+		case DXGI_FORMAT_BC4_SNORM:
+			return 8;
+
+		case DXGI_FORMAT_BC2_TYPELESS:
+		case DXGI_FORMAT_BC2_UNORM:
+		case DXGI_FORMAT_BC2_UNORM_SRGB:
+		case DXGI_FORMAT_BC3_TYPELESS:
+		case DXGI_FORMAT_BC3_UNORM:
+		case DXGI_FORMAT_BC3_UNORM_SRGB:
+		case DXGI_FORMAT_BC5_TYPELESS:
+		case DXGI_FORMAT_BC5_UNORM:
+		case DXGI_FORMAT_BC5_SNORM:
+		case DXGI_FORMAT_BC6H_TYPELESS:
+		case DXGI_FORMAT_BC6H_UF16:
+		case DXGI_FORMAT_BC6H_SF16:
+		case DXGI_FORMAT_BC7_TYPELESS:
+		case DXGI_FORMAT_BC7_UNORM:
+		case DXGI_FORMAT_BC7_UNORM_SRGB:
+			return 16;
+		}
+
+		return 0;
+	}
+
+	/// Get number of bits per pixel for uncompressed formats
+	UINT GetBitsPerPixel(DXGI_FORMAT Format)
+	{
+		switch (Format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		case DXGI_FORMAT_R32G32B32A32_UINT:
+		case DXGI_FORMAT_R32G32B32A32_SINT:
+			return 128;
+
+		case DXGI_FORMAT_R32G32B32_TYPELESS:
+		case DXGI_FORMAT_R32G32B32_FLOAT:
+		case DXGI_FORMAT_R32G32B32_UINT:
+		case DXGI_FORMAT_R32G32B32_SINT:
+			return 96;
+
+		case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+		case DXGI_FORMAT_R16G16B16A16_UINT:
+		case DXGI_FORMAT_R16G16B16A16_SNORM:
+		case DXGI_FORMAT_R16G16B16A16_SINT:
+		case DXGI_FORMAT_R32G32_TYPELESS:
+		case DXGI_FORMAT_R32G32_FLOAT:
+		case DXGI_FORMAT_R32G32_UINT:
+		case DXGI_FORMAT_R32G32_SINT:
+			return 64;
+
+		case DXGI_FORMAT_R8G8_TYPELESS:
+		case DXGI_FORMAT_R8G8_UNORM:
+		case DXGI_FORMAT_R8G8_UINT:
+		case DXGI_FORMAT_R8G8_SNORM:
+		case DXGI_FORMAT_R8G8_SINT:
+		case DXGI_FORMAT_R16_TYPELESS:
+		case DXGI_FORMAT_R16_FLOAT:
+		case DXGI_FORMAT_R16_UNORM:
+		case DXGI_FORMAT_R16_UINT:
+		case DXGI_FORMAT_R16_SNORM:
+		case DXGI_FORMAT_R16_SINT:
+		case DXGI_FORMAT_B5G6R5_UNORM:
+		case DXGI_FORMAT_B5G5R5A1_UNORM:
+			return 16;
+
+		case DXGI_FORMAT_R8_TYPELESS:
+		case DXGI_FORMAT_R8_UNORM:
+		case DXGI_FORMAT_R8_UINT:
+		case DXGI_FORMAT_R8_SNORM:
+		case DXGI_FORMAT_R8_SINT:
+		case DXGI_FORMAT_A8_UNORM:
+			return 8;
+		}
+
+		// Most other formats are 32 bits per pixel
+		return 32;
+	}
+}
+
 RTexture::RTexture(const std::string& Path)
 	: RResourceBase(Path)
 	, m_SRV(nullptr)
@@ -27,6 +138,7 @@ RTexture::RTexture(const std::string& Path)
 	, m_Height(0)
 	, MipLevels(0)
 	, bIsCubeMap(false)
+	, m_MemorySize(0)
 	, bHasOwnershipOfResource(true)
 {
 }
@@ -38,6 +150,7 @@ RTexture::RTexture(ID3D11ShaderResourceView* ShaderResourceView, bool bTakeResou
 	, m_Height(0)
 	, MipLevels(0)
 	, bIsCubeMap(false)
+	, m_MemorySize(0)
 	, bHasOwnershipOfResource(bTakeResourceOwnership)
 {
 	if (ShaderResourceView)
@@ -65,6 +178,7 @@ void RTexture::Reset()
 	m_Width = 0;
 	m_Height = 0;
 	bIsCubeMap = false;
+	m_MemorySize = 0;
 	bHasOwnershipOfResource = false;
 }
 
@@ -78,6 +192,8 @@ bool RTexture::LoadResourceImpl()
 {
 	RLog("Loading texture %s\n", GetAssetPath().c_str());
 	bool bIsSRGBTexture = (GetMetaData()["SRGB"] == "true");
+	bool bFullPrecision = (GetMetaData()["HDRFormat"] == "Float32");
+	bool bPackedHDR = (GetMetaData()["HDRFormat"] == "R11G11B10");
 
 	std::string Ext = RFileUtil::GetExtensionInLowerCase(GetAssetPath());
 	bool Result = false;
@@ -88,11 +204,13 @@ bool RTexture::LoadResourceImpl()
 	}
 	else if (Ext == "hdr")
 	{
-		Result = LoadTextureHDR(bIsSRGBTexture);
+		Result = LoadTextureHDR(bFullPrecision ? HDRPixelFormat::Float32x4 : (bPackedHDR ? HDRPixelFormat::R11G11B10 : HDRPixelFormat::Float16x4));
 	}
 
 	if (Result && m_SRV)
 	{
+		// Reset gives up ownership. Take it again, as the texture may be loaded again after eviction.
+		bHasOwnershipOfResource = true;
 		QueryTextureDesc(*m_SRV);
 	}
 
@@ -101,13 +219,40 @@ bool RTexture::LoadResourceImpl()
 
 bool RTexture::LoadTextureDDS(bool bSRGB)
 {
-	size_t char_len;
-	wchar_t wszName[1024];
-	mbstowcs_s(&char_len, wszName, 1024, GetFileSystemPath().data(), GetFileSystemPath().size());
+	// Textures in asset archives are created directly from mapped memory
+	RFileData FileData = GVirtualFileSystem.ReadFile(GetFileSystemPath());
+	if (!FileData.IsValid())
+	{
+		RLog("*** Failed to load texture [%s] ***\n", GetFileSystemPath().data());
+		return false;
+	}
+
+	if (!GRenderer.D3DDevice())
+	{
+		// DDS loader creates textures on a D3D11 device. Without one, create a texture of the same size through the render device.
+		D3D11_TEXTURE2D_DESC TextureDesc;
+		ZeroMemory(&TextureDesc, sizeof(TextureDesc));
+		if (!ReadDDSHeaderDimensions((const uint8_t*)FileData.GetData(), FileData.GetSize(), TextureDesc.Width, TextureDesc.Height, TextureDesc.MipLevels))
+		{
+			RLog("*** Failed to load texture [%s] ***\n", GetFileSystemPath().data());
+			return false;
+		}
+
+		TextureDesc.ArraySize = 1;
+		TextureDesc.Format = bSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		TextureDesc.SampleDesc.Count = 1;
+		TextureDesc.Usage = D3D11_USAGE_DEFAULT;
+		TextureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		ComPtr<ID3D11Texture2D> pTexture;
+		GRenderer.Device()->CreateTexture2D(&TextureDesc, nullptr, &pTexture);
+		return SUCCEEDED(GRenderer.Device()->CreateShaderResourceView(pTexture.Get(), nullptr, &m_SRV));
+	}
 
 	HRESULT hr;
 	ID3D11ShaderResourceView* ShaderResourceView;
-	hr = DirectX::CreateDDSTextureFromFileEx(GRenderer.D3DDevice(), wszName, 0, D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, bSRGB, nullptr, &ShaderResourceView);
+	hr = DirectX::CreateDDSTextureFromMemoryEx(GRenderer.D3DDevice(), (const uint8_t*)FileData.GetData(), FileData.GetSize(), 0,
+		D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0, bSRGB, nullptr, &ShaderResourceView);
 
 	if (FAILED(hr))
 	{
@@ -119,20 +264,37 @@ bool RTexture::LoadTextureDDS(bool bSRGB)
 	return true;
 }
 
-bool RTexture::LoadTextureHDR(bool bSRGB)
+bool RTexture::LoadTextureHDR(HDRPixelFormat Format)
 {
+	RFileData FileData = GVirtualFileSystem.ReadFile(GetFileSystemPath());
+	if (!FileData.IsValid())
+	{
+		RLog("*** Failed to load texture [%s] ***\n", GetFileSystemPath().data());
+		return false;
+	}
+
 	HDRLoaderResult Result;
-	if (HDRLoader::load(GetFileSystemPath().data(), Result))
+	if (HDRLoader::loadFromMemory(FileData.GetData(), FileData.GetSize(), Result, Format))
 	{
+		DXGI_FORMAT TextureFormat = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		if (Format == HDRPixelFormat::Float16x4)
+		{
+			TextureFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		}
+		else if (Format == HDRPixelFormat::R11G11B10)
+		{
+			TextureFormat = DXGI_FORMAT_R11G11B10_FLOAT;
+		}
+
 		UINT SupportFlags;
-		if (FAILED(GRenderer.D3DDevice()->CheckFormatSupport(DXGI_FORMAT_R32G32B32A32_FLOAT, &SupportFlags)))
+		if (FAILED(GRenderer.Device()->CheckFormatSupport(TextureFormat, &SupportFlags)))
 		{
 			return false;
 		}
 
 		if ((SupportFlags & D3D11_FORMAT_SUPPORT_SHADER_SAMPLE) == 0)
 		{
-			RLogError("Unabled to load RGBE texture: Sampler for R32G32B32A32 is not supported by the hardward!\n");
+			RLogError("Unabled to load RGBE texture: Sampler for texture format %d is not supported by the hardward!\n", (int)TextureFormat);
 			return false;
 		}
 
@@ -140,7 +302,7 @@ bool RTexture::LoadTextureHDR(bool bSRGB)
 		TextureDesc.Width = Result.width;
 		TextureDesc.Height = Result.height;
 		TextureDesc.MipLevels = TextureDesc.ArraySize = 1;
-		TextureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		TextureDesc.Format = TextureFormat;
 		TextureDesc.SampleDesc.Count = 1;
 		TextureDesc.SampleDesc.Quality = 0;
 		TextureDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -148,23 +310,14 @@ bool RTexture::LoadTextureHDR(bool bSRGB)
 		TextureDesc.CPUAccessFlags = 0;
 		TextureDesc.MiscFlags = 0;
 
-		std::vector<float> Pixel;
-		Pixel.resize(Result.width * Result.height * 4);
-		for (int i = 0; i < Result.width * Result.height; i++)
-		{
-			Pixel[i * 4] = Result.cols[i * 3];
-			Pixel[i * 4 + 1] = Result.cols[i * 3 + 1];
-			Pixel[i * 4 + 2] = Result.cols[i * 3 + 2];
-			Pixel[i * 4 + 3] = 1.0f;
-		}
-
+		// Pixels are decoded in the texture format, so they are uploaded without conversion
 		D3D11_SUBRESOURCE_DATA Data;
-		Data.pSysMem = Pixel.data();
-		Data.SysMemPitch = Result.width * 4 * sizeof(float);
+		Data.pSysMem = Result.pixels.data();
+		Data.SysMemPitch = Result.getRowPitch();
 		Data.SysMemSlicePitch = 0;
 
 		ComPtr<ID3D11Texture2D> pTexture;
-		if (FAILED(GRenderer.D3DDevice()->CreateTexture2D(&TextureDesc, &Data, &pTexture)))
+		if (FAILED(GRenderer.Device()->CreateTexture2D(&TextureDesc, &Data, &pTexture)))
 		{
 			RLogError("Failed to create texture 2d resource while loading %s!\n", GetAssetPath().c_str());
 			return false;
@@ -177,7 +330,7 @@ bool RTexture::LoadTextureHDR(bool bSRGB)
 		SrvDesc.Texture2D.MipLevels = -1;
 
 		ID3D11ShaderResourceView* ShaderResourceView;
-		if (FAILED(GRenderer.D3DDevice()->CreateShaderResourceView(pTexture.Get(), &SrvDesc, &ShaderResourceView)))
+		if (FAILED(GRenderer.Device()->CreateShaderResourceView(pTexture.Get(), &SrvDesc, &ShaderResourceView)))
 		{
 			RLogError("Failed to create shader resource view while loading %s!\n", GetAssetPath().c_str());
 			return false;
@@ -212,6 +365,26 @@ void RTexture::QueryTextureDesc(ID3D11ShaderResourceView& ShaderResourceView)
 			m_Height = Desc.Height;
 			MipLevels = Desc.MipLevels;
 			bIsCubeMap = Desc.MiscFlags & D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+			UINT BlockSize = GetBlockSizeInBytes(Desc.Format);
+			UINT BitsPerPixel = GetBitsPerPixel(Desc.Format);
+
+			m_MemorySize = 0;
+			for (UINT Mip = 0; Mip < Desc.MipLevels; Mip++)
+			{
+				size_t MipWidth = RMath::Max(Desc.Width >> Mip, 1u);
+				size_t MipHeight = RMath::Max(Desc.Height >> Mip, 1u);
+
+				if (BlockSize > 0)
+				{
+					m_MemorySize += ((MipWidth + 3) / 4) * ((MipHeight + 3) / 4) * BlockSize;
+				}
+				else
+				{
+					m_MemorySize += MipWidth * MipHeight * BitsPerPixel / 8;
+				}
+			}
+			m_MemorySize *= Desc.ArraySize;
 		}
 	}
 }
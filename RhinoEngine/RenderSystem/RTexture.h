@@ -7,6 +7,7 @@
 #pragma once
 
 #include "Resource/RResourceBase.h"
+#include "RenderSystem/hdrloader.h"
 
 struct ID3D11ShaderResourceView;
 
@@ -33,6 +34,9 @@ public:
 	UINT GetMipLevels() const { return MipLevels; }
 	bool IsCubeMap() const { return bIsCubeMap; }
 
+	/// Get number of bytes used by all mip levels and array slices of the hardware texture
+	virtual size_t GetMemorySize() const override { return m_MemorySize; }
+
 	/// Check if RTexture owns its hardware texture
 	bool HasOwnershipOfResource() const;
 
@@ -43,8 +47,9 @@ protected:
 	/// Load a DDS texture
 	bool LoadTextureDDS(bool bSRGB);
 
-	/// Load a HDR texture
-	bool LoadTextureHDR(bool bSRGB);
+	/// Load a HDR texture. Texture format is set by "HDRFormat" in metadata, which is one of
+	/// "Float32", "Float16" (default) and "R11G11B10".
+	bool LoadTextureHDR(HDRPixelFormat Format);
 	
 private:
 	void QueryTextureDesc(ID3D11ShaderResourceView& ShaderResourceView);
@@ -54,6 +59,7 @@ private:
 	UINT						m_Width, m_Height;
 	UINT	MipLevels;
 	bool	bIsCubeMap;
+	size_t	m_MemorySize;
 
 	/// If a RTexture has ownership of a hardware resource, the RTexture is responsible for releasing the hardware resource on destruction
 	bool	bHasOwnershipOfResource;
@@ -0,0 +1,103 @@
+//=============================================================================
+// RVisibilitySet.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RVisibilitySet.h"
+
+#include "Core/RThreadPool.h"
+
+namespace
+{
+	// Objects tested by each task of parallel culling
+	const int ParallelCullGrainSize = 1024;
+}
+
+RVisibilitySet::RVisibilitySet()
+	: NumUsedViews(0)
+{
+}
+
+void RVisibilitySet::Reset()
+{
+	WorldBounds.clear();
+	ObjectFlags.clear();
+	Objects.clear();
+	NumUsedViews = 0;
+}
+
+UINT RVisibilitySet::AddObject(const RAabb& InWorldBounds, RRenderMeshComponent* MeshComponent, RSceneObject* SceneObject, ERenderPass RenderPass, UINT8 Flags)
+{
+	assert((MeshComponent != nullptr) != (SceneObject != nullptr));
+
+	WorldBounds.push_back(InWorldBounds);
+	ObjectFlags.push_back(Flags);
+	Objects.push_back({ MeshComponent, SceneObject, RenderPass });
+
+	return (UINT)Objects.size() - 1;
+}
+
+int RVisibilitySet::CullView(const RFrustum& Frustum, UINT8 RequiredFlags /*= 0*/)
+{
+	if (NumUsedViews == (int)Views.size())
+	{
+		Views.emplace_back();
+	}
+
+	std::vector<UINT>& VisibleObjects = Views[NumUsedViews];
+	VisibleObjects.clear();
+
+	const int NumObjects = (int)WorldBounds.size();
+	CullBounds(WorldBounds.data(), ObjectFlags.data(), NumObjects, Frustum, RequiredFlags, NumObjects >= ParallelCullThreshold, CullScratch, VisibleObjects);
+
+	return NumUsedViews++;
+}
+
+void RVisibilitySet::CullBounds(const RAabb* Bounds, const UINT8* Flags, int NumObjects, const RFrustum& Frustum, UINT8 RequiredFlags,
+								bool bParallel, std::vector<UINT8>& Scratch, std::vector<UINT>& OutVisibleObjects)
+{
+	auto IsVisible = [&](int Index)
+	{
+		const UINT8 ObjectFlag = Flags[Index];
+		if ((ObjectFlag & RequiredFlags) != RequiredFlags)
+		{
+			return false;
+		}
+
+		return (ObjectFlag & VOF_NoCulling) || RCollision::TestAabbInsideFrustum(Frustum, Bounds[Index]);
+	};
+
+	if (!bParallel)
+	{
+		for (int i = 0; i < NumObjects; i++)
+		{
+			if (IsVisible(i))
+			{
+				OutVisibleObjects.push_back((UINT)i);
+			}
+		}
+
+		return;
+	}
+
+	// Test objects on worker threads, then compact visible indices in order on this thread
+	Scratch.resize(NumObjects);
+	UINT8* VisibleFlags = Scratch.data();
+
+	GThreadPool.ParallelFor(0, NumObjects, ParallelCullGrainSize, [&](int Begin, int End)
+		{
+			for (int i = Begin; i < End; i++)
+			{
+				VisibleFlags[i] = IsVisible(i) ? 1 : 0;
+			}
+		});
+
+	for (int i = 0; i < NumObjects; i++)
+	{
+		if (VisibleFlags[i])
+		{
+			OutVisibleObjects.push_back((UINT)i);
+		}
+	}
+}
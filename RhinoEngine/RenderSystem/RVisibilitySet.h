@@ -0,0 +1,75 @@
+//=============================================================================
+// RVisibilitySet.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// World bounds of renderable objects and objects visible from each view of a frame
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+#include "RRenderSystemTypes.h"
+
+class RRenderMeshComponent;
+class RSceneObject;
+
+enum EVisibilityObjectFlag
+{
+	VOF_NoCulling	= 1 << 0,		// Object is visible in every view which it's not excluded from by other flags
+	VOF_CastShadow	= 1 << 1,		// Object is drawn in shadow depth passes
+};
+
+/// A renderable object gathered for a frame. Either a mesh component or a scene object.
+struct RVisibilityObject
+{
+	RRenderMeshComponent*	MeshComponent;
+	RSceneObject*			SceneObject;
+	ERenderPass				RenderPass;
+};
+
+/// Renderable objects of a frame with their world bounds computed once, and the objects visible
+/// from each view culled once. Render passes and shadow cascades read visible object lists of
+/// their views instead of culling again.
+class RVisibilitySet
+{
+public:
+	RVisibilitySet();
+
+	/// Remove all objects and views for a new frame
+	void Reset();
+
+	/// Add a renderable object with its world bounds. Returns the object index.
+	UINT AddObject(const RAabb& WorldBounds, RRenderMeshComponent* MeshComponent, RSceneObject* SceneObject, ERenderPass RenderPass, UINT8 Flags);
+
+	/// Cull all objects with a frustum and store the visible ones as a new view. Objects are only
+	/// considered if they have all required flags. Returns the view index.
+	int CullView(const RFrustum& Frustum, UINT8 RequiredFlags = 0);
+
+	int GetNumObjects() const									{ return (int)Objects.size(); }
+	int GetNumViews() const										{ return NumUsedViews; }
+
+	const RVisibilityObject& GetObject(UINT Index) const		{ return Objects[Index]; }
+	const RAabb& GetWorldBounds(UINT Index) const				{ return WorldBounds[Index]; }
+
+	/// Indices of objects visible from a view, in the order they were added
+	const std::vector<UINT>& GetVisibleObjects(int ViewIndex) const	{ return Views[ViewIndex]; }
+
+	/// Test bounds of objects against a frustum and append indices of visible ones to a list.
+	/// In parallel, objects are tested on worker threads and the scratch array holds their results.
+	static void CullBounds(const RAabb* Bounds, const UINT8* Flags, int NumObjects, const RFrustum& Frustum, UINT8 RequiredFlags,
+						   bool bParallel, std::vector<UINT8>& Scratch, std::vector<UINT>& OutVisibleObjects);
+
+	/// Object counts from which views are culled on worker threads
+	static const int ParallelCullThreshold = 4096;
+
+private:
+	// Flat arrays indexed by object index
+	std::vector<RAabb>				WorldBounds;
+	std::vector<UINT8>				ObjectFlags;
+	std::vector<RVisibilityObject>	Objects;
+
+	// Visible object lists of views. Lists are kept between frames to reuse their memory.
+	std::vector<std::vector<UINT>>	Views;
+	int								NumUsedViews;
+
+	std::vector<UINT8>				CullScratch;
+};
@@ -5,6 +5,8 @@
 				https://www.flipcode.com/archives/HDR_Image_Reader.shtml
 
 	Info:		Load HDR image and convert to a set of float32 RGB triplet.
+				Reworked to decode from memory with parallel scanlines and SIMD conversion
+				to float32, float16 or R11G11B10 pixels.
 ************************************************************************************/
 
 #include "hdrloader.h"
@@ -14,197 +16,151 @@
 #include <math.h>
 #include <memory.h>
 #include <stdio.h>
+#include <string.h>
+#include <emmintrin.h>
 
 #include "Core/RLog.h"
-#include <string.h>
+#include "Core/RMappedFile.h"
+#include "Core/RThreadPool.h"
 
-typedef unsigned char RGBE[4];
-#define R			0
-#define G			1
-#define B			2
-#define E			3
+// An RGBE pixel in one 32-bit word, with the red mantissa in the lowest byte and the exponent in the highest
+typedef unsigned int RGBE;
 
 #define  MINELEN	8				// minimum scanline length for encoding
 #define  MAXELEN	0x7fff			// maximum scanline length for encoding
 
-static void workOnRGBE(RGBE *scan, int len, float *cols);
-static bool decrunch(RGBE *scanline, int len, FILE *file);
-static bool oldDecrunch(RGBE *scanline, int len, FILE *file);
+#define  ROWS_PER_TASK	16			// scanlines decoded by each parallel task
 
-HDRLoaderResult::HDRLoaderResult()
-	: cols(nullptr)
-{
+namespace {
 
-}
-
-HDRLoaderResult::~HDRLoaderResult()
-{
-	if (cols)
-	{
-		delete[] cols;
+// Component value is mantissa / 256 * 2^(exponent - 128). Exponents too small for a normal float
+// decode to zero, the same as the SIMD path which builds these values directly in float exponent bits.
+struct ExponentTable {
+	ExponentTable() {
+		for (int e = 0; e < 256; e++)
+			scale[e] = e > 9 ? ldexpf(1.0f, e - 136) : 0.0f;
 	}
-}
 
-bool HDRLoader::load(const char *fileName, HDRLoaderResult &res)
-{
-	int i;
-	char str[200];
-	FILE *file;
-
-	file = fopen(fileName, "rb");
-	if (!file)
-	{
-		RLogError("Error: %d (%s)\n", errno, strerror(errno));
-		return false;
-	}
+	float scale[256];
+};
 
-	fread(str, 10, 1, file);
-	if (memcmp(str, "#?RADIANCE", 10)) {
-		fclose(file);
-		return false;
-	}
+const ExponentTable expTable;
 
-	fseek(file, 1, SEEK_CUR);
+bool parseHeader(const unsigned char *data, size_t size, int &w, int &h, size_t &offset)
+{
+	if (size < 10 || (memcmp(data, "#?RADIANCE", 10) && memcmp(data, "#?RGBE", 6)))
+		return false;
 
-	char cmd[200];
-	i = 0;
-	char c = 0, oldc;
+	// header lines end with an empty line
+	size_t pos = 0;
 	while (true) {
-		oldc = c;
-		c = fgetc(file);
-		if (c == 0xa && oldc == 0xa)
-			break;
-		cmd[i++] = c;
-	}
+		const unsigned char *eol = (const unsigned char*)memchr(data + pos, '\n', size - pos);
+		if (!eol)
+			return false;
 
-	char reso[200];
-	i = 0;
-	while (true) {
-		c = fgetc(file);
-		reso[i++] = c;
-		if (c == 0xa)
+		size_t lineLen = eol - (data + pos);
+		pos = eol - data + 1;
+		if (lineLen == 0)
 			break;
 	}
 
-	int w, h;
-	if (!sscanf(reso, "-Y %ld +X %ld", &h, &w)) {
-		fclose(file);
+	const unsigned char *eol = (const unsigned char*)memchr(data + pos, '\n', size - pos);
+	if (!eol)
 		return false;
-	}
 
-	res.width = w;
-	res.height = h;
-
-	float *cols = new float[w * h * 3];
-	res.cols = cols;
-
-	RGBE *scanline = new RGBE[w];
-	if (!scanline) {
-		fclose(file);
+	char reso[200];
+	size_t resoLen = eol - (data + pos);
+	if (resoLen >= sizeof(reso))
 		return false;
-	}
 
-	// convert image 
-	for (int y = h - 1; y >= 0; y--) {
-		if (decrunch(scanline, w, file) == false)
-			break;
-		workOnRGBE(scanline, w, cols);
-		cols += w * 3;
-	}
+	memcpy(reso, data + pos, resoLen);
+	reso[resoLen] = 0;
 
-	delete[] scanline;
-	fclose(file);
+	if (sscanf(reso, "-Y %d +X %d", &h, &w) != 2 || w <= 0 || h <= 0)
+		return false;
 
+	offset = eol - data + 1;
 	return true;
 }
 
-float convertComponent(int expo, int val)
+bool isRLEScanline(const unsigned char *p, const unsigned char *end, int len)
 {
-	float v = val / 256.0f;
-	float d = (float)pow(2, expo);
-	return v * d;
+	return len >= MINELEN && len <= MAXELEN && end - p >= 4 &&
+		p[0] == 2 && p[1] == 2 && (p[2] & 128) == 0 && ((p[2] << 8) | p[3]) == len;
 }
 
-void workOnRGBE(RGBE *scan, int len, float *cols)
+// Move past a run length encoded scanline without decoding it. Returns false if data is corrupted.
+bool skipRLEScanline(const unsigned char *&p, const unsigned char *end, int len)
 {
-	while (len-- > 0) {
-		int expo = scan[0][E] - 128;
-		cols[0] = convertComponent(expo, scan[0][R]);
-		cols[1] = convertComponent(expo, scan[0][G]);
-		cols[2] = convertComponent(expo, scan[0][B]);
-		cols += 3;
-		scan++;
+	p += 4;
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < len; ) {
+			if (p >= end)
+				return false;
+
+			int code = *p++;
+			int count = code > 128 ? code & 127 : code;
+			if (count == 0 || j + count > len)
+				return false;
+
+			p += code > 128 ? 1 : count;
+			j += count;
+		}
 	}
+
+	return p <= end;
 }
 
-bool decrunch(RGBE *scanline, int len, FILE *file)
+// Decode a run length encoded scanline checked by skipRLEScanline
+void decodeRLEScanline(const unsigned char *p, int len, RGBE *scanline)
 {
-	int  i, j;
-
-	if (len < MINELEN || len > MAXELEN)
-		return oldDecrunch(scanline, len, file);
-
-	i = fgetc(file);
-	if (i != 2) {
-		fseek(file, -1, SEEK_CUR);
-		return oldDecrunch(scanline, len, file);
-	}
-
-	scanline[0][G] = fgetc(file);
-	scanline[0][B] = fgetc(file);
-	i = fgetc(file);
+	unsigned char *bytes = (unsigned char*)scanline;
+	p += 4;
 
-	if (scanline[0][G] != 2 || scanline[0][B] & 128) {
-		scanline[0][R] = 2;
-		scanline[0][E] = i;
-		return oldDecrunch(scanline + 1, len - 1, file);
-	}
-
-	// read each component
-	for (i = 0; i < 4; i++) {
-		for (j = 0; j < len; ) {
-			unsigned char code = fgetc(file);
+	// each component is stored separately
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < len; ) {
+			int code = *p++;
 			if (code > 128) { // run
 				code &= 127;
-				unsigned char val = fgetc(file);
+				unsigned char val = *p++;
 				while (code--)
-					scanline[j++][i] = val;
+					bytes[(j++) * 4 + i] = val;
 			}
 			else {	// non-run
 				while (code--)
-					scanline[j++][i] = fgetc(file);
+					bytes[(j++) * 4 + i] = *p++;
 			}
 		}
 	}
-
-	return feof(file) ? false : true;
 }
 
-bool oldDecrunch(RGBE *scanline, int len, FILE *file)
+// Decode a flat or old style run length encoded scanline. Runs repeat the pixel before them,
+// which may be on the previous scanline.
+bool oldDecrunch(const unsigned char *&p, const unsigned char *end, RGBE *scanline, int len, const RGBE *imageStart)
 {
-	int i;
 	int rshift = 0;
 
 	while (len > 0) {
-		scanline[0][R] = fgetc(file);
-		scanline[0][G] = fgetc(file);
-		scanline[0][B] = fgetc(file);
-		scanline[0][E] = fgetc(file);
-		if (feof(file))
+		if (end - p < 4)
 			return false;
 
-		if (scanline[0][R] == 1 &&
-			scanline[0][G] == 1 &&
-			scanline[0][B] == 1) {
-			for (i = scanline[0][E] << rshift; i > 0; i--) {
-				memcpy(&scanline[0][0], &scanline[-1][0], 4);
+		RGBE pixel = p[0] | (p[1] << 8) | (p[2] << 16) | ((RGBE)p[3] << 24);
+		p += 4;
+
+		if ((pixel & 0xffffff) == 0x010101) {
+			if (scanline == imageStart)
+				return false;
+
+			for (int i = p[-1] << rshift; i > 0 && len > 0; i--) {
+				scanline[0] = scanline[-1];
 				scanline++;
 				len--;
 			}
 			rshift += 8;
 		}
 		else {
-			scanline++;
+			*scanline++ = pixel;
 			len--;
 			rshift = 0;
 		}
@@ -212,4 +168,276 @@ bool oldDecrunch(RGBE *scanline, int len, FILE *file)
 	return true;
 }
 
+FORCEINLINE void decodeFloats(__m128i v, __m128 &r, __m128 &g, __m128 &b)
+{
+	const __m128i byteMask = _mm_set1_epi32(0xff);
+	const __m128i minExponent = _mm_set1_epi32(9);
+
+	// 2^(exponent - 136) has float exponent bits (exponent - 9)
+	__m128i e = _mm_srli_epi32(v, 24);
+	__m128i scaleBits = _mm_and_si128(_mm_slli_epi32(_mm_sub_epi32(e, minExponent), 23), _mm_cmpgt_epi32(e, minExponent));
+	__m128 scale = _mm_castsi128_ps(scaleBits);
+
+	r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(v, byteMask)), scale);
+	g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8), byteMask)), scale);
+	b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), byteMask)), scale);
+}
+
+FORCEINLINE void decodeFloats(RGBE v, float &r, float &g, float &b)
+{
+	float scale = expTable.scale[v >> 24];
+	r = (float)(v & 0xff) * scale;
+	g = (float)((v >> 8) & 0xff) * scale;
+	b = (float)((v >> 16) & 0xff) * scale;
+}
+
+// Convert non-negative floats to unsigned floats with a 5-bit exponent, rounding to nearest even.
+// Values too large for the format are clamped to its largest finite value.
+template<int MANTISSA_BITS>
+FORCEINLINE __m128i toSmallFloat(__m128 x)
+{
+	const int shift = 23 - MANTISSA_BITS;
+	const __m128 maxValue = _mm_set1_ps((2.0f - 1.0f / (1 << MANTISSA_BITS)) * 32768.0f);
+	const __m128 minNormal = _mm_set1_ps(1.0f / 16384.0f);
+
+	// adding this moves denormals to the lowest mantissa bits
+	const __m128 denormMagic = _mm_castsi128_ps(_mm_set1_epi32((136 - MANTISSA_BITS) << 23));
+
+	x = _mm_min_ps(x, maxValue);
+	__m128i bits = _mm_castps_si128(x);
+
+	// rebias exponent from 127 to 15 and round mantissa
+	__m128i normal = _mm_add_epi32(bits, _mm_set1_epi32((1 << (shift - 1)) - 1 - (112 << 23)));
+	normal = _mm_add_epi32(normal, _mm_and_si128(_mm_srli_epi32(bits, shift), _mm_set1_epi32(1)));
+	normal = _mm_srli_epi32(normal, shift);
+
+	__m128i denorm = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(x, denormMagic)), _mm_castps_si128(denormMagic));
+	__m128i isDenorm = _mm_castps_si128(_mm_cmplt_ps(x, minNormal));
+
+	return _mm_or_si128(_mm_and_si128(isDenorm, denorm), _mm_andnot_si128(isDenorm, normal));
+}
+
+template<int MANTISSA_BITS>
+FORCEINLINE unsigned int toSmallFloat(float x)
+{
+	return (unsigned int)_mm_cvtsi128_si32(toSmallFloat<MANTISSA_BITS>(_mm_set_ss(x)));
+}
+
+struct Float32x4Writer {
+	static const int bytesPerPixel = 16;
+
+	static FORCEINLINE void write4(__m128 r, __m128 g, __m128 b, unsigned char *out) {
+		__m128 a = _mm_set1_ps(1.0f);
+		_MM_TRANSPOSE4_PS(r, g, b, a);
+		_mm_storeu_ps((float*)out, r);
+		_mm_storeu_ps((float*)out + 4, g);
+		_mm_storeu_ps((float*)out + 8, b);
+		_mm_storeu_ps((float*)out + 12, a);
+	}
+
+	static FORCEINLINE void write1(float r, float g, float b, unsigned char *out) {
+		float pixel[4] = { r, g, b, 1.0f };
+		memcpy(out, pixel, sizeof(pixel));
+	}
+};
+
+struct Float16x4Writer {
+	static const int bytesPerPixel = 8;
+
+	static FORCEINLINE void write4(__m128 r, __m128 g, __m128 b, unsigned char *out) {
+		// half 1.0 as alpha
+		__m128i rg = _mm_or_si128(toSmallFloat<10>(r), _mm_slli_epi32(toSmallFloat<10>(g), 16));
+		__m128i ba = _mm_or_si128(toSmallFloat<10>(b), _mm_set1_epi32(0x3c00 << 16));
+		_mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(rg, ba));
+		_mm_storeu_si128((__m128i*)out + 1, _mm_unpackhi_epi32(rg, ba));
+	}
+
+	static FORCEINLINE void write1(float r, float g, float b, unsigned char *out) {
+		unsigned int pixel[2] = { toSmallFloat<10>(r) | (toSmallFloat<10>(g) << 16), toSmallFloat<10>(b) | (0x3c00 << 16) };
+		memcpy(out, pixel, sizeof(pixel));
+	}
+};
+
+struct R11G11B10Writer {
+	static const int bytesPerPixel = 4;
+
+	static FORCEINLINE void write4(__m128 r, __m128 g, __m128 b, unsigned char *out) {
+		__m128i pixels = _mm_or_si128(toSmallFloat<6>(r), _mm_slli_epi32(toSmallFloat<6>(g), 11));
+		pixels = _mm_or_si128(pixels, _mm_slli_epi32(toSmallFloat<5>(b), 22));
+		_mm_storeu_si128((__m128i*)out, pixels);
+	}
+
+	static FORCEINLINE void write1(float r, float g, float b, unsigned char *out) {
+		unsigned int pixel = toSmallFloat<6>(r) | (toSmallFloat<6>(g) << 11) | (toSmallFloat<5>(b) << 22);
+		memcpy(out, &pixel, sizeof(pixel));
+	}
+};
+
+template<typename Writer>
+void convertScanline(const RGBE *scanline, int len, unsigned char *out)
+{
+	int x = 0;
+	for (; x + 4 <= len; x += 4) {
+		__m128 r, g, b;
+		decodeFloats(_mm_loadu_si128((const __m128i*)(scanline + x)), r, g, b);
+		Writer::write4(r, g, b, out + x * Writer::bytesPerPixel);
+	}
+
+	for (; x < len; x++) {
+		float r, g, b;
+		decodeFloats(scanline[x], r, g, b);
+		Writer::write1(r, g, b, out + x * Writer::bytesPerPixel);
+	}
+}
+
+void convertScanline(const RGBE *scanline, int len, HDRPixelFormat format, unsigned char *out)
+{
+	switch (format) {
+	case HDRPixelFormat::Float32x4:
+		convertScanline<Float32x4Writer>(scanline, len, out);
+		break;
+	case HDRPixelFormat::Float16x4:
+		convertScanline<Float16x4Writer>(scanline, len, out);
+		break;
+	case HDRPixelFormat::R11G11B10:
+		convertScanline<R11G11B10Writer>(scanline, len, out);
+		break;
+	}
+}
+
+}
+
+HDRLoaderResult::HDRLoaderResult()
+	: width(0)
+	, height(0)
+	, format(HDRPixelFormat::Float32x4)
+{
+
+}
+
+int HDRLoaderResult::getBytesPerPixel() const
+{
+	switch (format) {
+	case HDRPixelFormat::Float16x4:
+		return 8;
+	case HDRPixelFormat::R11G11B10:
+		return 4;
+	default:
+		return 16;
+	}
+}
+
+bool HDRLoader::load(const char *fileName, HDRLoaderResult &res, HDRPixelFormat format)
+{
+	RMappedFile file;
+	if (!file.Open(fileName)) {
+		RLogError("Failed to open HDR image %s\n", fileName);
+		return false;
+	}
+
+	return loadFromMemory(file.GetData(), file.GetSize(), res, format);
+}
+
+bool HDRLoader::loadFromMemory(const void *data, size_t size, HDRLoaderResult &res, HDRPixelFormat format, bool parallel)
+{
+	const unsigned char *bytes = (const unsigned char*)data;
+	const unsigned char *end = bytes + size;
+
+	int w, h;
+	size_t offset;
+	if (!data || !parseHeader(bytes, size, w, h, offset)) {
+		RLogError("Invalid HDR image header or unsupported image orientation\n");
+		return false;
+	}
+
+	// Check the header against the data left before allocating anything sized by it. Every scanline
+	// takes at least one 4-byte pixel.
+	if (w > MAXELEN || h > MAXELEN || (size_t)h * 4 > size - offset) {
+		RLogError("HDR image of %dx%d pixels doesn't fit in its data or is too large\n", w, h);
+		return false;
+	}
+
+	res.width = w;
+	res.height = h;
+	res.format = format;
+
+	const size_t rowPitch = res.getRowPitch();
+	unsigned char *pixels = nullptr;
+
+	// Run length encoded scanlines can be decoded independently once we know where they start,
+	// which only takes reading the run codes
+	std::vector<size_t> rowOffsets(h);
+	bool allRLE = true;
+
+	const unsigned char *p = bytes + offset;
+	for (int y = 0; y < h; y++) {
+		if (!isRLEScanline(p, end, w)) {
+			allRLE = false;
+			break;
+		}
+
+		rowOffsets[y] = p - bytes;
+		if (!skipRLEScanline(p, end, w)) {
+			RLogError("HDR image data is corrupted\n");
+			return false;
+		}
+	}
+
+	std::function<void(int, int)> decodeRows;
+	std::vector<RGBE> image;
+
+	if (allRLE) {
+		decodeRows = [&](int first, int last) {
+			std::vector<RGBE> scanline(w);
+			for (int y = first; y < last; y++) {
+				decodeRLEScanline(bytes + rowOffsets[y], w, scanline.data());
+				convertScanline(scanline.data(), w, format, pixels + rowPitch * y);
+			}
+		};
+	}
+	else {
+		// Flat and old style scanlines depend on the ones before them, so they are decoded serially
+		// The image grows with each scanline decoded, so a header claiming more scanlines than the data
+		// holds fails before the whole image is allocated
+		p = bytes + offset;
+
+		for (int y = 0; y < h; y++) {
+			image.resize((size_t)w * (y + 1));
+			RGBE *scanline = image.data() + (size_t)w * y;
+			bool succeeded;
+
+			if (isRLEScanline(p, end, w)) {
+				const unsigned char *scanlineStart = p;
+				succeeded = skipRLEScanline(p, end, w);
+				if (succeeded)
+					decodeRLEScanline(scanlineStart, w, scanline);
+			}
+			else {
+				succeeded = oldDecrunch(p, end, scanline, w, image.data());
+			}
+
+			if (!succeeded) {
+				RLogError("HDR image data is corrupted\n");
+				return false;
+			}
+		}
+
+		decodeRows = [&](int first, int last) {
+			for (int y = first; y < last; y++)
+				convertScanline(image.data() + (size_t)w * y, w, format, pixels + rowPitch * y);
+		};
+	}
+
+	// Output is only allocated once all scanlines are known to be in the data
+	res.pixels.resize(rowPitch * h);
+	pixels = res.pixels.data();
+
+	if (parallel)
+		GThreadPool.ParallelFor(0, h, ROWS_PER_TASK, decodeRows);
+	else
+		decodeRows(0, h);
+
+	return true;
+}
+
 #undef _CRT_SECURE_NO_WARNINGS
@@ -5,19 +5,40 @@
 				https://www.flipcode.com/archives/HDR_Image_Reader.shtml
 
 	Info:		Load HDR image and convert to a set of float32 RGB triplet.
+				Reworked to decode from memory with parallel scanlines and SIMD conversion
+				to float32, float16 or R11G11B10 pixels.
 ************************************************************************************/
 
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+enum class HDRPixelFormat {
+	Float32x4,		// DXGI_FORMAT_R32G32B32A32_FLOAT, 16 bytes per pixel
+	Float16x4,		// DXGI_FORMAT_R16G16B16A16_FLOAT, 8 bytes per pixel. Values are clamped to 65504.
+	R11G11B10,		// DXGI_FORMAT_R11G11B10_FLOAT, 4 bytes per pixel. Values are clamped to the largest finite value of each channel.
+};
+
 class HDRLoaderResult {
 public:
 	HDRLoaderResult();
-	~HDRLoaderResult();
+
+	int getBytesPerPixel() const;
+	int getRowPitch() const { return width * getBytesPerPixel(); }
 
 	int width, height;
-	// each pixel takes 3 float32, each component can be of any value...
-	float *cols;
+	HDRPixelFormat format;
+
+	// rows from top to bottom, alpha is 1 for formats with alpha
+	std::vector<unsigned char> pixels;
 };
 
 class HDRLoader {
 public:
-	static bool load(const char *fileName, HDRLoaderResult &res);
+	static bool load(const char *fileName, HDRLoaderResult &res, HDRPixelFormat format = HDRPixelFormat::Float32x4);
+
+	// Decode an image in memory. Scanlines are decoded on engine worker threads if parallel is true.
+	static bool loadFromMemory(const void *data, size_t size, HDRLoaderResult &res,
+							   HDRPixelFormat format = HDRPixelFormat::Float32x4, bool parallel = true);
 };
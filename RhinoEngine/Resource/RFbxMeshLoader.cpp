@@ -15,6 +15,7 @@
 #include "RenderSystem/RMesh.h"
 
 #include <fbxsdk.h>
+#include <unordered_map>
 
 /// When enabled, meshes and animations will be imported in left-handed coordinate
 /// TODO: Handle fbx coordinate system
@@ -51,6 +52,12 @@ namespace
 }
 
 
+RFbxMeshLoader::RFbxMeshLoader()
+	: bApplyMetaData(true)
+{
+
+}
+
 bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const char* FileName)
 {
 	std::vector<std::unique_ptr<RMeshElement>> meshElements;
@@ -121,6 +128,7 @@ bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const char* Fi
 
 	// Load skinning nodes
 	std::vector<FbxNode*> fbxBoneNodes;
+	std::unordered_map<FbxNode*, int> fbxBoneNodeToId;
 	std::vector<std::string> meshBoneIdToName;
 	int NumFbxNodes = lFbxScene->GetNodeCount();
 
@@ -135,6 +143,7 @@ bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const char* Fi
 			{
 				if (NodeAttribute->GetAttributeType() == FbxNodeAttribute::eSkeleton)
 				{
+					fbxBoneNodeToId[SkeletonNode] = (int)fbxBoneNodes.size();
 					fbxBoneNodes.push_back(SkeletonNode);
 					meshBoneIdToName.push_back(SkeletonNode->GetName());
 
@@ -149,7 +158,7 @@ bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const char* Fi
 	// The skeletal mesh used by the animation of this mesh.
 	// Note: Some fbx meshes only have animation information and their skeletal meshes are specified by meta data.
 	RAnimation* animation = LoadFbxSceneAnimation(MeshResource->GetAssetPath(), lFbxScene);
-	if (animation)
+	if (animation && bApplyMetaData)
 	{
 		animation->InitFromMetaData(MeshResource->GetMetaData());
 	}
@@ -402,7 +411,8 @@ bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const char* Fi
 					if (!LinkNode)
 						continue;
 
-					int boneId = (int)(std::find(fbxBoneNodes.begin(), fbxBoneNodes.end(), LinkNode) - fbxBoneNodes.begin());
+					auto BoneIter = fbxBoneNodeToId.find(LinkNode);
+					int boneId = BoneIter != fbxBoneNodeToId.end() ? BoneIter->second : (int)fbxBoneNodes.size();
 					assert(boneId < MAX_BONE_COUNT);
 
 					if (boneId < (int)fbxBoneNodes.size())
@@ -674,17 +684,9 @@ bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const char* Fi
 
 		for (auto& IndexData : SubmeshIndexArray)
 		{
-			// Make copy of vertex array for optimization
-			auto VertexData = flatVertData;
-
-			int OrignialNumVerts = (int)VertexData.size();
-			int OriginalNumIndices = (int)IndexData.size() / 3;
-
-			// Optimize the mesh
-			OptimizeMesh(IndexData, VertexData);
-
-			int OptimizedNumVerts = (int)VertexData.size();
-			int OptimizedNumIndices = (int)IndexData.size() / 3;
+			// Weld vertices used by this submesh and optimize triangle order
+			std::vector<RVertexType::MeshLoader> VertexData;
+			RMeshOptimizationStats OptimizationStats = RMeshOptimizer::OptimizeMesh(flatVertData, IndexData, VertexData, WeldSettings);
 
 			// Hack: don't use uv1 on skinned mesh
 			if (hasDeformer)
@@ -706,8 +708,10 @@ bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const char* Fi
 				meshElem->SetFlag(flag);
 				meshElements.push_back(std::move(meshElem));
 
-				RLogVerbose("Mesh element loaded with %d vertices and %d triangles (unoptimized: vert %d, triangle %d).\n",
-					OptimizedNumVerts, OptimizedNumIndices, OrignialNumVerts, OriginalNumIndices);
+				RLogVerbose("Mesh element loaded with %d vertices and %d triangles (unoptimized: vert %d).\n",
+					OptimizationStats.NumWeldedVertices, OptimizationStats.NumTriangles, OptimizationStats.NumSourceVertices);
+				RLogDebug("Mesh element optimized: weld %.2f ms, reorder %.2f ms, ACMR %.3f -> %.3f.\n",
+					OptimizationStats.WeldMs, OptimizationStats.ReorderMs, OptimizationStats.ACMRBefore, OptimizationStats.ACMRAfter);
 			}
 			else
 			{
@@ -789,39 +793,6 @@ bool RFbxMeshLoader::LoadDataForMeshResource(RMesh* MeshResource, const std::str
 	return LoadDataForMeshResource(MeshResource, FileName.c_str());
 }
 
-void RFbxMeshLoader::OptimizeMesh(std::vector<UINT>& IndexData, std::vector<RVertexType::MeshLoader>& VertexData) const
-{
-	// Optimize mesh
-	RLogVerbose("Optimizing mesh...\n");
-
-	std::map<RVertexType::MeshLoader, int> meshVertIndexTable;
-	std::vector<RVertexType::MeshLoader> optimizedVertData;
-	std::vector<UINT> optimizedIndexData;
-	UINT Index = 0;
-
-	for (UINT i = 0; i < IndexData.size(); i++)
-	{
-		RVertexType::MeshLoader& v = VertexData[IndexData[i]];
-
-		// Search vertex in index table by running lexicographical comparison
-		auto iterResult = meshVertIndexTable.find(v);
-		if (iterResult == meshVertIndexTable.end())
-		{
-			meshVertIndexTable[v] = Index;
-			optimizedVertData.push_back(v);
-			optimizedIndexData.push_back(Index);
-			Index++;
-		}
-		else
-		{
-			optimizedIndexData.push_back(iterResult->second);
-		}
-	}
-
-	IndexData = optimizedIndexData;
-	VertexData = optimizedVertData;
-}
-
 namespace
 {
 	RAnimation* LoadFbxSceneAnimation(const std::string& AssetPath, FbxScene* Scene)
@@ -860,13 +831,15 @@ namespace
 				(float)animEndTime.GetFrameCountPrecise(animTimeMode),
 				animFrameRate);
 
-			std::map<std::string, int> nodeNameToId;
-			bool bIsFirstNode = true;
-
-			for (FbxTime CurrentFrameTime = animStartTime; CurrentFrameTime <= animEndTime; CurrentFrameTime += TimePerFrame)
+			// Node hierarchy doesn't change between frames. Find parent index of each node and name the bones once.
+			std::vector<int> NodeParentIds(NumFbxNodes, -1);
 			{
-				// Array that holds matrices of each node
-				std::vector<FbxAMatrix> FbxNodeMatrices(NumFbxNodes);
+				std::unordered_map<FbxNode*, int> NodeToIndex;
+				NodeToIndex.reserve(NumFbxNodes);
+				for (int FbxSceneNodeIndex = 0; FbxSceneNodeIndex < NumFbxNodes; FbxSceneNodeIndex++)
+				{
+					NodeToIndex[Scene->GetNode(FbxSceneNodeIndex)] = FbxSceneNodeIndex;
+				}
 
 				for (int FbxSceneNodeIndex = 0; FbxSceneNodeIndex < NumFbxNodes; FbxSceneNodeIndex++)
 				{
@@ -876,30 +849,39 @@ namespace
 						continue;
 					}
 
-					// Find index for parent node
-					int ParentId = -1;
 					if (FbxNode* ParentNode = SceneNode->GetParent())
 					{
-						for (ParentId = 0; ParentId < NumFbxNodes; ParentId++)
+						auto Iter = NodeToIndex.find(ParentNode);
+						if (Iter != NodeToIndex.end())
 						{
-							if (Scene->GetNode(ParentId) == ParentNode)
-							{
-								break;
-							}
+							NodeParentIds[FbxSceneNodeIndex] = Iter->second;
 						}
+					}
 
-						if (ParentId == NumFbxNodes)
-						{
-							ParentId = -1;
-						}
+					animation->SetAnimBoneName(FbxSceneNodeIndex, SceneNode->GetName());
+				}
+			}
+
+			for (FbxTime CurrentFrameTime = animStartTime; CurrentFrameTime <= animEndTime; CurrentFrameTime += TimePerFrame)
+			{
+				// Array that holds matrices of each node
+				std::vector<FbxAMatrix> FbxNodeMatrices(NumFbxNodes);
+
+				for (int FbxSceneNodeIndex = 0; FbxSceneNodeIndex < NumFbxNodes; FbxSceneNodeIndex++)
+				{
+					FbxNode* SceneNode = Scene->GetNode(FbxSceneNodeIndex);
+					if (SceneNode == nullptr)
+					{
+						continue;
 					}
 
+					const int ParentId = NodeParentIds[FbxSceneNodeIndex];
+
 					// Note: We can't skip non-skeletal nodes because some animations have keyframe information that depends on them.
 					//FbxNodeAttribute* NodeAttribute = SceneNode->GetNodeAttribute();
 					//if (NodeAttribute && NodeAttribute->GetAttributeType() == FbxNodeAttribute::eSkeleton)
 					{
 						const char* BoneName = SceneNode->GetName();
-						animation->SetAnimBoneName(FbxSceneNodeIndex, BoneName);
 
 						// Evaluate bone transform in world space of fbx scene, which becomes the mesh space
 						// when playing this animation on a skinned mesh.
@@ -942,8 +924,6 @@ namespace
 						RLog("Bone local matrix:\n");
 						RLog("%s", LocalTransform.ToDisplayString().c_str());
 #endif
-
-						nodeNameToId[BoneName] = FbxSceneNodeIndex;
 					}
 				}
 			}
@@ -1027,7 +1007,7 @@ namespace
 						texture = RResourceManager::Instance().LoadResource<RTexture>(ddsFilename, EResourceLoadMode::Immediate);
 					}
 
-					meshMaterial->GetTextureSlots().push_back(RTextureSlotData(texture, NextTextureSlotIdx));
+					meshMaterial->SetTextureSlot(NextTextureSlotIdx, texture);
 					NextTextureSlotIdx++;
 
 					bHasMaps[idxTexProp] = true;
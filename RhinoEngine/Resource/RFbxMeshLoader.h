@@ -8,17 +8,27 @@
 
 #include "Core/CoreTypes.h"
 #include "RenderSystem/RVertexDeclaration.h"
+#include "RenderSystem/RMeshOptimizer.h"
 
 class RMesh;
 
 class RFbxMeshLoader
 {
 public:
+	RFbxMeshLoader();
+
+	/// Settings in mesh metadata are applied when meshes are loaded at runtime. Offline cooking skips them,
+	/// so meshes referenced by metadata are not loaded.
+	void SetApplyMetaData(bool bApply)		{ bApplyMetaData = bApply; }
+
+	/// Vertices are welded exactly by default. Tolerances also weld vertices with slightly different positions and normals.
+	void SetWeldSettings(const RVertexWeldSettings& Settings)	{ WeldSettings = Settings; }
+
 	/// Load data for mesh resource from file
 	bool LoadDataForMeshResource(RMesh* MeshResource, const char* FileName);
 	bool LoadDataForMeshResource(RMesh* MeshResource, const std::string& FileName);
 
 private:
-	/// Optimize mesh buffer by combining duplicated vertices
-	void OptimizeMesh(std::vector<UINT>& IndexData, std::vector<RVertexType::MeshLoader>& VertexData) const;
+	bool bApplyMetaData;
+	RVertexWeldSettings WeldSettings;
 };
@@ -0,0 +1,53 @@
+//=============================================================================
+// RLoadFuture.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RLoadFuture.h"
+
+#include <atomic>
+
+bool RLoadFutureGroup::IsReady() const
+{
+	for (RResourceBase* Resource : Resources)
+	{
+		if (!Resource->IsLoadCompleted())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void RLoadFutureGroup::Wait() const
+{
+	// Loads still in the queue are taken over by the calling thread
+	for (RResourceBase* Resource : Resources)
+	{
+		Resource->WaitForLoadCompletion();
+	}
+}
+
+void RLoadFutureGroup::Then(std::function<void()> Func) const
+{
+	// One count for each load and one for this call, so Func is not called before all callbacks are added
+	auto NumPendingLoads = std::make_shared<std::atomic<int>>((int)Resources.size() + 1);
+	auto SharedFunc = std::make_shared<std::function<void()>>(std::move(Func));
+
+	auto ReleasePendingLoad = [NumPendingLoads, SharedFunc]()
+	{
+		if (--(*NumPendingLoads) == 0)
+		{
+			(*SharedFunc)();
+		}
+	};
+
+	for (RResourceBase* Resource : Resources)
+	{
+		Resource->AddLoadCompletionCallback([ReleasePendingLoad](RResourceBase*) { ReleasePendingLoad(); });
+	}
+
+	ReleasePendingLoad();
+}
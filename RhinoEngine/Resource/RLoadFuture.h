@@ -0,0 +1,89 @@
+//=============================================================================
+// RLoadFuture.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Handles for waiting on resource loads
+//=============================================================================
+
+#pragma once
+
+#include "RResourceBase.h"
+
+/// A handle to a resource being loaded. It becomes ready once the resource and all resources it references
+/// are loaded, or when loading fails or is cancelled.
+template<typename T>
+class RLoadFuture
+{
+public:
+	RLoadFuture()
+		: Resource(nullptr)
+	{}
+
+	explicit RLoadFuture(T* InResource)
+		: Resource(InResource)
+	{}
+
+	/// Check if the future refers to a resource
+	bool IsValid() const			{ return Resource != nullptr; }
+
+	/// Check if the load has completed. Never blocks.
+	bool IsReady() const			{ return Resource == nullptr || Resource->IsLoadCompleted(); }
+
+	/// Block until the load has completed. Returns the resource, or nullptr if it failed to load.
+	T* Get() const
+	{
+		if (Resource == nullptr)
+		{
+			return nullptr;
+		}
+
+		Resource->WaitForLoadCompletion();
+		return Resource->IsLoaded() ? Resource : nullptr;
+	}
+
+	/// Get the resource without waiting. It may not be loaded yet.
+	T* GetResource() const			{ return Resource; }
+
+	/// Call a function with the resource once the load has completed, or right away if it has.
+	/// The function is called on the thread finishing the last load.
+	template<typename FuncType>
+	const RLoadFuture& Then(FuncType Func) const
+	{
+		if (Resource != nullptr)
+		{
+			Resource->AddLoadCompletionCallback([Func](RResourceBase* CompletedResource) { Func(static_cast<T*>(CompletedResource)); });
+		}
+		return *this;
+	}
+
+private:
+	T*		Resource;
+};
+
+/// A set of loads to wait on together, e.g. all resources of a level
+class RLoadFutureGroup
+{
+public:
+	template<typename T>
+	void Add(const RLoadFuture<T>& Future)
+	{
+		if (Future.IsValid())
+		{
+			Resources.push_back(Future.GetResource());
+		}
+	}
+
+	/// Check if all loads in the group have completed. Never blocks.
+	bool IsReady() const;
+
+	/// Block until all loads in the group have completed
+	void Wait() const;
+
+	/// Call a function once all loads in the group have completed, or right away if they have.
+	/// The function is called on the thread finishing the last load.
+	void Then(std::function<void()> Func) const;
+
+	int GetNumLoads() const			{ return (int)Resources.size(); }
+
+private:
+	std::vector<RResourceBase*>		Resources;
+};
@@ -7,12 +7,33 @@
 #include "RResourceBase.h"
 
 #include "RResourceManager.h"
+#include "Core/RVirtualFileSystem.h"
 
+#include <mutex>
+#include <condition_variable>
+
+// Guards completion callbacks of all resources. Signaled whenever a resource completes loading.
+static std::mutex				LoadCompletionMutex;
+static std::condition_variable	LoadCompletionCondition;
+
+// Serializes eviction of resources against taking the first reference to them
+static std::mutex				ResourceEvictionMutex;
+
+// Incremented whenever a reference to a resource is removed
+static std::atomic<UINT64>		ResourceUseTick(0);
 
 RResourceBase::RResourceBase(const std::string& path)
 	: m_State				(RS_Empty),
 	  m_FileSystemPath		(path),
-	  m_LoadingFinishTime	(0.0f)
+	  m_LoadingFinishTime	(0.0f),
+	  m_NumPendingLoads		(1),
+	  m_bLoadCompleted		(false),
+	  m_bNotifyLoadCompletion(false),
+	  m_RefCount			(0),
+	  m_LastUseTick			(0),
+	  m_bReferencedByHandle	(false),
+	  m_bLoadedFromFile		(false),
+	  m_LoadedMemorySize	(0)
 {
 }
 
@@ -24,11 +45,13 @@ bool RResourceBase::LoadResourceData(bool bIsAsyncLoading)
 
 	if (LoadResourceImpl())
 	{
+		m_bLoadedFromFile = true;
 		OnLoadingFinished(bIsAsyncLoading);
 
 		return true;
 	}
 
+	OnLoadingFailed();
 	return false;
 }
 
@@ -36,8 +59,13 @@ void RResourceBase::Reload()
 {
 	if (m_State == RS_Loaded)
 	{
+		ReleaseLoadedMemorySize();
+		ReleaseReferencedResources();
 		Reset();
 		m_State = RS_Empty;
+		ResetLoadCompletion();
+
+		RResourceManager::Instance().OnResourceUnloaded.Execute(this);
 
 		LoadResourceData(false);
 	}
@@ -49,9 +77,14 @@ bool RResourceBase::SaveToDisk()
 	{
 		std::string MetaFileName = m_FileSystemPath + ".meta";
 		MetaData->SaveToFile(MetaFileName);
+		GVirtualFileSystem.InvalidateLooseFile(MetaFileName);
 	}
 
-	return SaveResourceImpl();
+	// The saved file is now newer than a packed copy of it. Make sure reloading reads it.
+	const bool bSaved = SaveResourceImpl();
+	GVirtualFileSystem.InvalidateLooseFile(m_FileSystemPath);
+
+	return bSaved;
 }
 
 bool RResourceBase::AreReferencedResourcesLoaded() const
@@ -71,11 +104,26 @@ bool RResourceBase::AreReferencedResourcesLoaded() const
 
 void RResourceBase::OnEnqueuedForLoading()
 {
-	assert(m_State == RS_Empty);
+	assert(m_State == RS_Empty || m_State == RS_Cancelled || m_State == RS_Evicted);
+
+	if (m_State == RS_Cancelled || m_State == RS_Evicted)
+	{
+		ResetLoadCompletion();
+	}
 
 	m_State = RS_EnqueuedForLoading;
 }
 
+void RResourceBase::OnLoadingCancelled()
+{
+	assert(m_State == RS_EnqueuedForLoading);
+
+	m_State = RS_Cancelled;
+
+	// Wake up anything waiting for the resource
+	ReleasePendingLoad();
+}
+
 void RResourceBase::OnLoadingFinished(bool bIsAsyncLoading)
 {
 	assert(m_State != RS_Loaded);
@@ -84,10 +132,201 @@ void RResourceBase::OnLoadingFinished(bool bIsAsyncLoading)
 	m_State = RS_Loaded;
 
 	// Notify event listeners when async loading is complete
-	if (bIsAsyncLoading)
+	m_bNotifyLoadCompletion = bIsAsyncLoading;
+
+	const size_t MemorySize = GetMemorySize();
+	m_LoadedMemorySize = MemorySize;
+	RResourceManager::Instance().AddLoadedMemorySize((INT64)MemorySize);
+
+	// Keep referenced resources loaded as long as this one is
+	assert(m_HeldResources.size() == 0);
+	m_HeldResources = EnumerateReferencedResources();
+
+	// Wait for referenced resources which are still loading. Each one releases its pending load when it completes.
+	for (RResourceBase* Resource : m_HeldResources)
+	{
+		Resource->AddRef();
+		m_NumPendingLoads++;
+		Resource->AddLoadCompletionCallback([this](RResourceBase*) { ReleasePendingLoad(); });
+	}
+
+	ReleasePendingLoad();
+}
+
+void RResourceBase::OnLoadingFailed()
+{
+	ReleasePendingLoad();
+}
+
+void RResourceBase::WaitForLoadCompletion()
+{
+	if (m_State == RS_EnqueuedForLoading)
+	{
+		RResourceManager::Instance().WaitForResource(this);
+	}
+
+	std::unique_lock<std::mutex> UniqueLock(LoadCompletionMutex);
+	LoadCompletionCondition.wait(UniqueLock, [this] { return m_bLoadCompleted.load(); });
+}
+
+void RResourceBase::AddLoadCompletionCallback(std::function<void(RResourceBase*)> Callback)
+{
+	{
+		std::unique_lock<std::mutex> UniqueLock(LoadCompletionMutex);
+		if (!m_bLoadCompleted)
+		{
+			m_LoadCompletionCallbacks.push_back(std::move(Callback));
+			return;
+		}
+	}
+
+	Callback(this);
+}
+
+void RResourceBase::AddRef() const
+{
+	if (m_RefCount++ == 0)
+	{
+		// The resource may have been evicted while nothing referenced it. Bring it back.
+		std::unique_lock<std::mutex> UniqueLock(ResourceEvictionMutex);
+		if (m_State == RS_Evicted)
+		{
+			RResourceManager::Instance().GetLoaderPool().Enqueue(const_cast<RResourceBase*>(this), EResourceLoadPriority::High);
+		}
+	}
+}
+
+void RResourceBase::AddHandleRef() const
+{
+	if (!m_bReferencedByHandle)
+	{
+		m_bReferencedByHandle = true;
+	}
+
+	AddRef();
+}
+
+void RResourceBase::Release() const
+{
+	m_LastUseTick = ++ResourceUseTick;
+
+	int RefCount = --m_RefCount;
+	assert(RefCount >= 0);
+	(void)RefCount;
+}
+
+bool RResourceBase::CanEvict() const
+{
+	return m_State == RS_Loaded && m_bLoadedFromFile && m_bReferencedByHandle && m_RefCount == 0 && m_bLoadCompleted;
+}
+
+bool RResourceBase::Evict()
+{
+	{
+		std::unique_lock<std::mutex> UniqueLock(ResourceEvictionMutex);
+		if (!CanEvict())
+		{
+			return false;
+		}
+
+		// Any handle created from now on finds the resource evicted and queues it again
+		m_State = RS_Evicted;
+		Reset();
+	}
+
+	ReleaseLoadedMemorySize();
+	ReleaseReferencedResources();
+
+	RResourceManager::Instance().OnResourceUnloaded.Execute(this);
+
+	return true;
+}
+
+UINT64 RResourceBase::GetCurrentUseTick()
+{
+	return ResourceUseTick.load();
+}
+
+void RResourceBase::UpdateReferencedResources()
+{
+	// References are taken when loading finishes
+	if (m_State != RS_Loaded)
+	{
+		return;
+	}
+
+	std::vector<RResourceBase*> ReferencedResources = EnumerateReferencedResources();
+	for (RResourceBase* Resource : ReferencedResources)
+	{
+		Resource->AddRef();
+	}
+
+	ReleaseReferencedResources();
+	m_HeldResources = std::move(ReferencedResources);
+}
+
+void RResourceBase::ReleaseReferencedResources()
+{
+	for (RResourceBase* Resource : m_HeldResources)
+	{
+		Resource->Release();
+	}
+	m_HeldResources.clear();
+}
+
+void RResourceBase::UpdateLoadedMemorySize()
+{
+	if (m_State != RS_Loaded)
+	{
+		return;
+	}
+
+	const size_t MemorySize = GetMemorySize();
+	const size_t LastMemorySize = m_LoadedMemorySize.exchange(MemorySize);
+	RResourceManager::Instance().AddLoadedMemorySize((INT64)MemorySize - (INT64)LastMemorySize);
+}
+
+void RResourceBase::ReleaseLoadedMemorySize()
+{
+	RResourceManager::Instance().AddLoadedMemorySize(-(INT64)m_LoadedMemorySize.exchange(0));
+}
+
+void RResourceBase::ResetLoadCompletion()
+{
+	std::unique_lock<std::mutex> UniqueLock(LoadCompletionMutex);
+	m_NumPendingLoads = 1;
+	m_bLoadCompleted = false;
+	m_bNotifyLoadCompletion = false;
+}
+
+void RResourceBase::ReleasePendingLoad()
+{
+	if (--m_NumPendingLoads == 0)
+	{
+		CompleteLoad();
+	}
+}
+
+void RResourceBase::CompleteLoad()
+{
+	std::vector<std::function<void(RResourceBase*)>> Callbacks;
+
+	{
+		std::unique_lock<std::mutex> UniqueLock(LoadCompletionMutex);
+		m_bLoadCompleted = true;
+		Callbacks.swap(m_LoadCompletionCallbacks);
+	}
+	LoadCompletionCondition.notify_all();
+
+	if (m_bNotifyLoadCompletion && IsLoaded())
 	{
 		RResourceManager::Instance().AddPendingNotifyResource(this);
 	}
+
+	for (auto& Callback : Callbacks)
+	{
+		Callback(this);
+	}
 }
 
 std::vector<RResourceBase*> RResourceBase::EnumerateReferencedResources() const
@@ -9,11 +9,15 @@
 #include "RResourceMetaData.h"
 #include "Core/RRuntimeTypeObject.h"
 
+#include <atomic>
+
 enum ResourceState
 {
 	RS_Empty,
 	RS_EnqueuedForLoading,
 	RS_Loaded,
+	RS_Cancelled,			// Taken out of the loader queue before loading started. Loading it again queues it again.
+	RS_Evicted,				// Content released to stay within the resource memory budget. Referencing it again queues it again.
 };
 
 
@@ -56,16 +60,76 @@ public:
 	/// Check if all referenced resources have been fully loaded
 	bool AreReferencedResourcesLoaded() const;
 
+	/// Check if loading of the resource and all resources it references has finished or failed
+	bool IsLoadCompleted() const			{ return m_bLoadCompleted.load(); }
+
+	/// Block until the resource and all resources it references are loaded.
+	/// If the resource is still queued, it is loaded on the calling thread.
+	void WaitForLoadCompletion();
+
+	/// Call a function once the resource and all resources it references are loaded, or right away if they are.
+	/// The function is called on the thread finishing the last load. It is also called if loading fails or is cancelled.
+	void AddLoadCompletionCallback(std::function<void(RResourceBase*)> Callback);
+
 	/// Callback when resource has been enqueued for loading
 	virtual void OnEnqueuedForLoading();
 
+	/// Callback when resource has been taken out of the loader queue
+	virtual void OnLoadingCancelled();
+
 	/// Callback when resource loading is complete
 	virtual void OnLoadingFinished(bool bIsAsyncLoading);
 
+	/// Callback when resource failed to load
+	virtual void OnLoadingFailed();
+
 	/// Get the time when resource has been fully loaded
 	float GetResourceTimestamp()			{ return m_LoadingFinishTime; }
 
+	/// Add a counted reference to the resource, keeping it from being evicted.
+	/// Referencing an evicted resource queues it for loading again.
+	void AddRef() const;
+
+	/// Add a counted reference from an RResourceHandle. Only resources which have been referenced by handles can be evicted.
+	void AddHandleRef() const;
+
+	/// Remove a counted reference to the resource
+	void Release() const;
+
+	/// Check if a handle has ever referred to the resource
+	bool IsReferencedByHandle() const		{ return m_bReferencedByHandle.load(); }
+
+	int GetRefCount() const					{ return m_RefCount.load(); }
+
+	/// Get number of bytes used by loaded content of the resource, including video memory
+	virtual size_t GetMemorySize() const	{ return 0; }
+
+	/// Get number of bytes counted against the resource memory budget when loading finished
+	size_t GetLoadedMemorySize() const		{ return m_LoadedMemorySize.load(); }
+
+	/// Check if the resource is loaded from file and nothing references it.
+	/// Resources which have never been referenced by a handle can't be evicted, as raw pointers may still use them.
+	/// References held by other resources don't count as handles.
+	bool CanEvict() const;
+
+	/// Release loaded content of an unreferenced resource. It is loaded again when a handle refers to it.
+	/// Returns false if the resource can't be evicted.
+	bool Evict();
+
+	/// Get the use tick of the resource when its last reference was removed. Lower ticks were used less recently.
+	UINT64 GetLastUseTick() const			{ return m_LastUseTick.load(); }
+
+	/// Get the use tick of the last reference removed from any resource
+	static UINT64 GetCurrentUseTick();
+
 protected:
+	/// Take references to resources returned by EnumerateReferencedResources again.
+	/// Call after changing resources referenced by a loaded resource, so they stay loaded with it.
+	void UpdateReferencedResources();
+
+	/// Count memory size of a loaded resource again. Call after loading data on demand after loading finished.
+	void UpdateLoadedMemorySize();
+
 	/// Enumerate all resources been referenced directly by this resource
 	virtual std::vector<RResourceBase*> EnumerateReferencedResources() const;
 
@@ -75,6 +139,22 @@ protected:
 	// Override this method in a derived class for saving a resource to file
 	virtual bool SaveResourceImpl();
 
+private:
+	/// Start counting outstanding loads again for a new load
+	void ResetLoadCompletion();
+
+	/// Called when the resource itself or a referenced resource is done loading
+	void ReleasePendingLoad();
+
+	/// Mark load as completed and call completion callbacks
+	void CompleteLoad();
+
+	/// Remove references taken to referenced resources when loading finished
+	void ReleaseReferencedResources();
+
+	/// Remove loaded memory size of the resource from the resource manager
+	void ReleaseLoadedMemorySize();
+
 private:
 	ResourceState		m_State;
 
@@ -86,6 +166,31 @@ private:
 	/// Path to the resource file in file system
 	std::string			m_FileSystemPath;
 	float				m_LoadingFinishTime;
+
+	/// Number of loads the resource is waiting for: its own plus those of referenced resources which haven't completed
+	std::atomic<int>	m_NumPendingLoads;
+	std::atomic<bool>	m_bLoadCompleted;
+
+	/// Whether OnResourceFinishedAsyncLoading should be broadcast once the load is completed
+	bool				m_bNotifyLoadCompletion;
+
+	/// Functions to call when the load is completed. Guarded by the load completion mutex.
+	std::vector<std::function<void(RResourceBase*)>>	m_LoadCompletionCallbacks;
+
+	mutable std::atomic<int>	m_RefCount;
+	mutable std::atomic<UINT64>	m_LastUseTick;
+
+	/// Whether a handle has ever referred to the resource
+	mutable std::atomic<bool>	m_bReferencedByHandle;
+
+	/// Whether the content is loaded from file, so it can be loaded again after eviction
+	bool				m_bLoadedFromFile;
+
+	/// Updated by loader threads and by threads loading data on demand
+	std::atomic<size_t>	m_LoadedMemorySize;
+
+	/// Referenced resources kept loaded by this resource
+	std::vector<RResourceBase*>	m_HeldResources;
 };
 
 FORCEINLINE const RResourceMetaData& RResourceBase::GetMetaData() const
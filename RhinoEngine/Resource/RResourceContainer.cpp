@@ -7,6 +7,7 @@
 #include "RResourceContainer.h"
 
 #include <mutex>
+#include <shared_mutex>
 
 int strcasecmp(const char* str1, const char* str2)
 {
@@ -28,6 +29,18 @@ int strcasecmp(const char* str1, const char* str2)
 		return 1;
 }
 
+size_t RCaseInsensitiveHash::operator()(const std::string& Str) const
+{
+	// FNV-1a over lower case characters
+	size_t Hash = (size_t)14695981039346656037ULL;
+	for (char ch : Str)
+	{
+		Hash ^= (size_t)(unsigned char)tolower(ch);
+		Hash *= (size_t)1099511628211ULL;
+	}
+	return Hash;
+}
+
 
 class MutexWrapperImpl : public MutexWrapper
 {
@@ -56,6 +69,32 @@ public:
 	std::unique_lock<std::mutex> UniqueLock;
 };
 
+class SharedMutexWrapperImpl : public SharedMutexWrapper
+{
+public:
+	virtual void Lock() override
+	{
+		Mutex.lock();
+	}
+
+	virtual void Unlock() override
+	{
+		Mutex.unlock();
+	}
+
+	virtual void LockShared() override
+	{
+		Mutex.lock_shared();
+	}
+
+	virtual void UnlockShared() override
+	{
+		Mutex.unlock_shared();
+	}
+
+	std::shared_timed_mutex Mutex;
+};
+
 std::unique_ptr<MutexWrapper> MutexWrapper::Create()
 {
 	return move(std::unique_ptr<MutexWrapper>(new MutexWrapperImpl()));
@@ -66,9 +105,14 @@ std::unique_ptr<UniqueLockWrapper> UniqueLockWrapper::Create(std::unique_ptr<Mut
 	return move(std::unique_ptr<UniqueLockWrapper>(new UniqueLockWrapperImpl(Mutex)));
 }
 
+std::unique_ptr<SharedMutexWrapper> SharedMutexWrapper::Create()
+{
+	return std::unique_ptr<SharedMutexWrapper>(new SharedMutexWrapperImpl());
+}
+
 RResourceContainerBase::RResourceContainerBase()
 {
-	ResourceMutex = MutexWrapper::Create();
+	ResourceMutex = SharedMutexWrapper::Create();
 }
 
 void RResourceContainerBase::Lock()
@@ -80,3 +124,13 @@ void RResourceContainerBase::Unlock()
 {
 	ResourceMutex->Unlock();
 }
+
+void RResourceContainerBase::LockShared()
+{
+	ResourceMutex->LockShared();
+}
+
+void RResourceContainerBase::UnlockShared()
+{
+	ResourceMutex->UnlockShared();
+}
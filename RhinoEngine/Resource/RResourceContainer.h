@@ -8,6 +8,7 @@
 
 #include "Core/CoreTypes.h"
 #include "Core/StdHelper.h"
+#include "Core/RFileUtil.h"
 
 class RResourceBase;
 
@@ -42,6 +43,34 @@ public:
 	static std::unique_ptr<UniqueLockWrapper> Create(std::unique_ptr<MutexWrapper>& Mutex);
 };
 
+/// A wrapper class for std::shared_timed_mutex to avoid including shared_mutex in engine public header files
+class SharedMutexWrapper
+{
+public:
+	virtual ~SharedMutexWrapper() {}
+
+	virtual void Lock()			{}
+	virtual void Unlock()		{}
+	virtual void LockShared()	{}
+	virtual void UnlockShared()	{}
+
+	static std::unique_ptr<SharedMutexWrapper> Create();
+};
+
+/// Case-insensitive hash of a string, consistent with strcasecmp
+struct RCaseInsensitiveHash
+{
+	size_t operator()(const std::string& Str) const;
+};
+
+struct RCaseInsensitiveEqual
+{
+	bool operator()(const std::string& Str1, const std::string& Str2) const
+	{
+		return Str1.size() == Str2.size() && strcasecmp(Str1.c_str(), Str2.c_str()) == 0;
+	}
+};
+
 /// Resource container interface
 class RResourceContainerBase
 {
@@ -53,19 +82,52 @@ public:
 
 	virtual std::vector<RResourceBase*> GetResourceBaseArray() { return std::vector<RResourceBase*>(); }
 
+	/// Get class name of resources in the container
+	virtual const char* GetResourceTypeName() const { return ""; }
+
 protected:
+	/// Exclusive lock for modifying the container
 	void Lock();
 	void Unlock();
 
+	/// Shared lock for reading the container. Multiple readers may hold it at the same time.
+	void LockShared();
+	void UnlockShared();
+
 protected:
-	std::unique_ptr<MutexWrapper>	ResourceMutex;
+	std::unique_ptr<SharedMutexWrapper>	ResourceMutex;
 };
 
+/// A container of resources of one type.
+/// Resources are indexed by asset path and by file name, both case-insensitive, so lookups don't scan the container.
 template<typename T>
 class RResourceContainer : public RResourceContainerBase
 {
 private:
-	std::vector<T*>	Resources;
+	typedef std::unordered_map<std::string, T*, RCaseInsensitiveHash, RCaseInsensitiveEqual>				PathIndexMap;
+	typedef std::unordered_map<std::string, std::vector<T*>, RCaseInsensitiveHash, RCaseInsensitiveEqual>	FileNameIndexMap;
+
+	std::vector<T*>		Resources;
+
+	/// Resources by asset path. If more than one resource has the same path, the first one added is indexed.
+	PathIndexMap		PathIndex;
+
+	/// Resources by file name in asset path, in the order they were added
+	FileNameIndexMap	FileNameIndex;
+
+	/// Add resource to container. Must be called with the container locked.
+	void AddLocked(T* Resource)
+	{
+		Resources.push_back(Resource);
+
+		const std::string& AssetPath = Resource->GetAssetPath();
+		if (AssetPath != "")
+		{
+			PathIndex.emplace(AssetPath, Resource);
+			FileNameIndex[RFileUtil::GetFileNameInPath(AssetPath)].push_back(Resource);
+		}
+	}
+
 public:
 
 	/// Release all resources in the container
@@ -78,79 +140,144 @@ public:
 			delete Resource;
 		}
 		Resources.clear();
+		PathIndex.clear();
+		FileNameIndex.clear();
 
 		Unlock();
 	}
 
-	/// Add resource to container
+	/// Add resource to container. The asset path of the resource must be set before adding it.
 	void Add(T* Resource)
 	{
 		Lock();
-		Resources.push_back(Resource);
+		AddLocked(Resource);
 		Unlock();
 	}
 
+	/// Find a resource by asset path, or create and add one if there is none. Lookup and adding happen under
+	/// one lock, so threads asking for the same path at the same time all get the one resource created.
+	/// CreateFunc is called with the container locked and must not use the container. It must return a resource
+	/// with AssetPath set. bOutCreated is set to true only for the call which created the resource.
+	template<typename CreateFuncType>
+	T* FindOrAdd(const std::string& AssetPath, CreateFuncType CreateFunc, bool& bOutCreated)
+	{
+		Lock();
+
+		T* Resource;
+		auto PathIter = PathIndex.find(AssetPath);
+		bOutCreated = (PathIter == PathIndex.end());
+		if (bOutCreated)
+		{
+			Resource = CreateFunc();
+			AddLocked(Resource);
+		}
+		else
+		{
+			Resource = PathIter->second;
+		}
+
+		Unlock();
+		return Resource;
+	}
+
 	/// Remove resource from container
 	void Remove(T* Resource)
 	{
 		Lock();
+
 		StdRemove(Resources, Resource);
+
+		const std::string& AssetPath = Resource->GetAssetPath();
+		if (AssetPath != "")
+		{
+			auto PathIter = PathIndex.find(AssetPath);
+			if (PathIter != PathIndex.end() && PathIter->second == Resource)
+			{
+				PathIndex.erase(PathIter);
+
+				// Index another resource sharing the same path, if there is one
+				for (auto Iter : Resources)
+				{
+					if (RCaseInsensitiveEqual()(Iter->GetAssetPath(), AssetPath))
+					{
+						PathIndex.emplace(Iter->GetAssetPath(), Iter);
+						break;
+					}
+				}
+			}
+
+			auto NameIter = FileNameIndex.find(RFileUtil::GetFileNameInPath(AssetPath));
+			if (NameIter != FileNameIndex.end())
+			{
+				StdRemove(NameIter->second, Resource);
+				if (NameIter->second.size() == 0)
+				{
+					FileNameIndex.erase(NameIter);
+				}
+			}
+		}
+
 		Unlock();
 	}
 
 	/// Find resource by path
 	T* Find(const std::string& Path, bool bAllowPartialMatch = false)
 	{
-		std::unique_ptr<UniqueLockWrapper> UniqueLock = UniqueLockWrapper::Create(ResourceMutex);
+		T* Result = nullptr;
 
 		if (Path != "")
 		{
-			for (auto Iter : Resources)
-			{
-				if (strcasecmp(Iter->GetAssetPath().c_str(), Path.c_str()) == 0)
-				{
-					return Iter;
-				}
+			LockShared();
 
-				if (bAllowPartialMatch)
+			auto PathIter = PathIndex.find(Path);
+			if (PathIter != PathIndex.end())
+			{
+				Result = PathIter->second;
+			}
+			else if (bAllowPartialMatch)
+			{
+				// If searching path contains file name only, also try matching file names
+				auto NameIter = FileNameIndex.find(Path);
+				if (NameIter != FileNameIndex.end())
 				{
-					// If searching path contains file name only, also try matching file names
-					const std::string ResourceName = RFileUtil::GetFileNameInPath(Iter->GetAssetPath());
-					if (strcasecmp(ResourceName.c_str(), Path.c_str()) == 0)
-					{
-						return Iter;
-					}
+					Result = NameIter->second[0];
 				}
 			}
+
+			UnlockShared();
 		}
 
-		return nullptr;
+		return Result;
 	}
 
 	virtual std::vector<RResourceBase*> GetResourceBaseArray() override
 	{
 		std::vector<RResourceBase*> ArrayCopy;
 
-		Lock();
+		LockShared();
 		for (auto Resource : Resources)
 		{
 			ArrayCopy.push_back(Resource);
 		}
-		Unlock();
+		UnlockShared();
 
 		return ArrayCopy;
 	}
 
+	virtual const char* GetResourceTypeName() const override
+	{
+		return T::_StaticGetClassName();
+	}
+
 	/// Get a copy of resource array
 	std::vector<T*> GetResourceArrayCopy()
 	{
 		std::vector<T*> ArrayCopy;
 
-		Lock();
+		LockShared();
 		ArrayCopy = Resources;
-		Unlock();
+		UnlockShared();
 
 		return ArrayCopy;
 	}
 };
-
@@ -0,0 +1,104 @@
+//=============================================================================
+// RResourceHandle.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Reference counted resource handles
+//=============================================================================
+
+#pragma once
+
+class RMesh;
+class RTexture;
+class RMaterial;
+class RAnimGraph;
+
+/// A counted reference to a resource. Resources referenced by handles are never evicted by the resource manager.
+/// Once the last handle is gone, the resource may be evicted when resource memory exceeds the budget, and is
+/// queued for loading again as soon as a new handle refers to it.
+/// Converts to and from raw pointers, so it can replace a raw pointer member without changing code using it.
+template<typename T>
+class RResourceHandle
+{
+public:
+	RResourceHandle()
+		: Resource(nullptr)
+	{}
+
+	RResourceHandle(T* InResource)
+		: Resource(InResource)
+	{
+		if (Resource)
+		{
+			Resource->AddHandleRef();
+		}
+	}
+
+	RResourceHandle(const RResourceHandle& Other)
+		: RResourceHandle(Other.Resource)
+	{}
+
+	RResourceHandle(RResourceHandle&& Other)
+		: Resource(Other.Resource)
+	{
+		Other.Resource = nullptr;
+	}
+
+	~RResourceHandle()
+	{
+		if (Resource)
+		{
+			Resource->Release();
+		}
+	}
+
+	RResourceHandle& operator=(const RResourceHandle& Other)
+	{
+		Reset(Other.Resource);
+		return *this;
+	}
+
+	RResourceHandle& operator=(RResourceHandle&& Other)
+	{
+		if (this != &Other)
+		{
+			Reset();
+			Resource = Other.Resource;
+			Other.Resource = nullptr;
+		}
+		return *this;
+	}
+
+	RResourceHandle& operator=(T* InResource)
+	{
+		Reset(InResource);
+		return *this;
+	}
+
+	/// Refer to another resource, releasing the current one
+	void Reset(T* InResource = nullptr)
+	{
+		if (InResource)
+		{
+			InResource->AddHandleRef();
+		}
+
+		if (Resource)
+		{
+			Resource->Release();
+		}
+
+		Resource = InResource;
+	}
+
+	T* Get() const					{ return Resource; }
+	T* operator->() const			{ return Resource; }
+	T& operator*() const			{ return *Resource; }
+	operator T*() const				{ return Resource; }
+
+private:
+	T*		Resource;
+};
+
+typedef RResourceHandle<RMesh>		RMeshHandle;
+typedef RResourceHandle<RTexture>	RTextureHandle;
+typedef RResourceHandle<RMaterial>	RMaterialHandle;
+typedef RResourceHandle<RAnimGraph>	RAnimGraphHandle;
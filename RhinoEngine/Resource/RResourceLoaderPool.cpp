@@ -0,0 +1,377 @@
+//=============================================================================
+// RResourceLoaderPool.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+//
+//=============================================================================
+
+#include "RResourceLoaderPool.h"
+
+#include "RResourceBase.h"
+
+#include "Core/RLog.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <unordered_set>
+
+struct RResourceLoaderPoolContext
+{
+	RResourceLoaderPoolContext()
+		: NextSequence(0)
+		, bShouldQuit(false)
+		, bBatchActive(false)
+		, bFirstFrameStarted(false)
+	{}
+
+	/// An entry in the task queue. Entries of the same priority are loaded in the order they were queued.
+	struct TaskEntry
+	{
+		EResourceLoadPriority	Priority;
+		UINT64					Sequence;
+		RResourceBase*			Resource;
+
+		bool operator<(const TaskEntry& Other) const
+		{
+			if (Priority != Other.Priority)
+				return Priority < Other.Priority;
+
+			return Sequence > Other.Sequence;
+		}
+	};
+
+	/// Take the queued resource with the highest priority. Must be called with Mutex locked.
+	RResourceBase* PopTask()
+	{
+		while (TaskQueue.size() != 0)
+		{
+			TaskEntry Entry = TaskQueue.top();
+			TaskQueue.pop();
+
+			// Skip entries of cancelled resources and entries replaced by a higher priority one
+			auto Iter = QueuedResources.find(Entry.Resource);
+			if (Iter != QueuedResources.end() && Iter->second.Sequence == Entry.Sequence)
+			{
+				QueuedResources.erase(Iter);
+				return Entry.Resource;
+			}
+		}
+
+		return nullptr;
+	}
+
+	/// Add an entry for a resource to the task queue. Must be called with Mutex locked.
+	void PushTask(RResourceBase* Resource, EResourceLoadPriority Priority)
+	{
+		TaskEntry Entry = { Priority, NextSequence++, Resource };
+		TaskQueue.push(Entry);
+		QueuedResources[Resource] = Entry;
+	}
+
+	bool IsIdle() const
+	{
+		return QueuedResources.size() == 0 && LoadingResources.size() == 0;
+	}
+
+	float GetBatchTimeMs() const
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - BatchStartTime).count();
+	}
+
+	void StartBatchIfIdle()
+	{
+		if (!bBatchActive && IsIdle())
+		{
+			bBatchActive = true;
+			bFirstFrameStarted = false;
+			BatchStats = RResourceLoadStats();
+			BatchStartTime = std::chrono::steady_clock::now();
+		}
+	}
+
+	void FinishBatchIfIdle()
+	{
+		if (bBatchActive && IsIdle())
+		{
+			bBatchActive = false;
+			BatchStats.TotalLoadTimeMs = GetBatchTimeMs();
+
+			// Nothing in the batch could have delayed a frame which didn't start until it's done
+			if (!bFirstFrameStarted)
+			{
+				BatchStats.TimeToFirstFrameMs = BatchStats.TotalLoadTimeMs;
+			}
+
+			LastBatchStats = BatchStats;
+
+			RLog("Loaded %d resources (%d failed, %d cancelled) on %d threads in %.2f ms, first frame after %.2f ms\n",
+				 BatchStats.NumLoaded, BatchStats.NumFailed, BatchStats.NumCancelled, (int)WorkerThreads.size(),
+				 BatchStats.TotalLoadTimeMs, BatchStats.TimeToFirstFrameMs);
+		}
+	}
+
+	std::vector<std::thread>					WorkerThreads;
+
+	mutable std::mutex							Mutex;
+	std::condition_variable						TaskQueueCondition;
+
+	// Signaled whenever a resource is done loading or taken out of the queue
+	std::condition_variable						FinishedCondition;
+
+	std::priority_queue<TaskEntry>				TaskQueue;
+
+	// Queued resources and their current entry in TaskQueue. Other entries of the same resource are stale.
+	std::unordered_map<RResourceBase*, TaskEntry>	QueuedResources;
+
+	// Resources being loaded by workers or other threads
+	std::unordered_set<RResourceBase*>			LoadingResources;
+
+	UINT64										NextSequence;
+	bool										bShouldQuit;
+
+	bool										bBatchActive;
+	bool										bFirstFrameStarted;
+	std::chrono::steady_clock::time_point		BatchStartTime;
+	RResourceLoadStats							BatchStats;
+	RResourceLoadStats							LastBatchStats;
+};
+
+RResourceLoaderPool::RResourceLoaderPool()
+	: Context(std::make_unique<RResourceLoaderPoolContext>())
+{
+
+}
+
+RResourceLoaderPool::~RResourceLoaderPool()
+{
+	Shutdown();
+}
+
+void RResourceLoaderPool::Initialize(int NumThreads /*= -1*/)
+{
+	assert(Context->WorkerThreads.size() == 0);
+
+	if (NumThreads < 0)
+	{
+		NumThreads = RMath::Max((int)std::thread::hardware_concurrency() - 1, 1);
+	}
+
+	Context->bShouldQuit = false;
+	for (int i = 0; i < NumThreads; i++)
+	{
+		Context->WorkerThreads.emplace_back(&RResourceLoaderPool::WorkerThreadMain, this);
+	}
+}
+
+void RResourceLoaderPool::Shutdown()
+{
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+		Context->bShouldQuit = true;
+		Context->QueuedResources.clear();
+		Context->TaskQueue = std::priority_queue<RResourceLoaderPoolContext::TaskEntry>();
+	}
+	Context->TaskQueueCondition.notify_all();
+	Context->FinishedCondition.notify_all();
+
+	for (auto& Thread : Context->WorkerThreads)
+	{
+		Thread.join();
+	}
+	Context->WorkerThreads.clear();
+}
+
+int RResourceLoaderPool::GetNumWorkerThreads() const
+{
+	return (int)Context->WorkerThreads.size();
+}
+
+void RResourceLoaderPool::Enqueue(RResourceBase* Resource, EResourceLoadPriority Priority /*= EResourceLoadPriority::Normal*/)
+{
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+
+		auto Iter = Context->QueuedResources.find(Resource);
+		if (Iter != Context->QueuedResources.end())
+		{
+			if (Priority > Iter->second.Priority)
+			{
+				Context->PushTask(Resource, Priority);
+			}
+			return;
+		}
+
+		// Put a cancelled or evicted resource back to the enqueued state
+		if (Resource->GetResourceState() == RS_Cancelled || Resource->GetResourceState() == RS_Evicted)
+		{
+			Resource->OnEnqueuedForLoading();
+		}
+
+		Context->StartBatchIfIdle();
+		Context->PushTask(Resource, Priority);
+	}
+
+	Context->TaskQueueCondition.notify_one();
+}
+
+bool RResourceLoaderPool::BoostPriority(RResourceBase* Resource, EResourceLoadPriority Priority)
+{
+	std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+
+	auto Iter = Context->QueuedResources.find(Resource);
+	if (Iter == Context->QueuedResources.end())
+	{
+		return false;
+	}
+
+	if (Priority > Iter->second.Priority)
+	{
+		Context->PushTask(Resource, Priority);
+	}
+
+	return true;
+}
+
+bool RResourceLoaderPool::Cancel(RResourceBase* Resource)
+{
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+
+		auto Iter = Context->QueuedResources.find(Resource);
+		if (Iter == Context->QueuedResources.end())
+		{
+			return false;
+		}
+
+		// The entry left in TaskQueue is skipped when it's popped
+		Context->QueuedResources.erase(Iter);
+		Resource->OnLoadingCancelled();
+		Context->BatchStats.NumCancelled++;
+		Context->FinishBatchIfIdle();
+	}
+
+	Context->FinishedCondition.notify_all();
+	return true;
+}
+
+void RResourceLoaderPool::BeginInlineLoad(RResourceBase* Resource)
+{
+	std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+	Context->LoadingResources.insert(Resource);
+}
+
+void RResourceLoaderPool::EndInlineLoad(RResourceBase* Resource, bool bLoaded)
+{
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+		Context->LoadingResources.erase(Resource);
+
+		if (Context->bBatchActive)
+		{
+			bLoaded ? Context->BatchStats.NumLoaded++ : Context->BatchStats.NumFailed++;
+			Context->FinishBatchIfIdle();
+		}
+	}
+
+	Context->FinishedCondition.notify_all();
+}
+
+void RResourceLoaderPool::WaitForResource(RResourceBase* Resource)
+{
+	std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+
+	// Load the resource here rather than waiting for a worker to get to it
+	auto Iter = Context->QueuedResources.find(Resource);
+	if (Iter != Context->QueuedResources.end())
+	{
+		Context->QueuedResources.erase(Iter);
+		Context->LoadingResources.insert(Resource);
+		UniqueLock.unlock();
+
+		LoadQueuedResource(Resource, true);
+		return;
+	}
+
+	Context->FinishedCondition.wait(UniqueLock, [this, Resource] {
+		return Context->LoadingResources.count(Resource) == 0 && Context->QueuedResources.count(Resource) == 0;
+	});
+}
+
+void RResourceLoaderPool::WaitUntilIdle()
+{
+	std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+	Context->FinishedCondition.wait(UniqueLock, [this] { return Context->IsIdle() || Context->bShouldQuit; });
+}
+
+bool RResourceLoaderPool::IsIdle() const
+{
+	std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+	return Context->IsIdle();
+}
+
+void RResourceLoaderPool::OnFrameStarted()
+{
+	std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+
+	if (Context->bBatchActive && !Context->bFirstFrameStarted)
+	{
+		Context->bFirstFrameStarted = true;
+		Context->BatchStats.TimeToFirstFrameMs = Context->GetBatchTimeMs();
+	}
+}
+
+RResourceLoadStats RResourceLoaderPool::GetLastBatchStats() const
+{
+	std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+	return Context->LastBatchStats;
+}
+
+void RResourceLoaderPool::WorkerThreadMain()
+{
+	while (1)
+	{
+		RResourceBase* Resource = nullptr;
+
+		{
+			std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+
+			// Block thread until we get another task or need to quit
+			Context->TaskQueueCondition.wait(UniqueLock, [this] { return Context->QueuedResources.size() != 0 || Context->bShouldQuit; });
+
+			if (Context->bShouldQuit)
+				break;
+
+			Resource = Context->PopTask();
+			assert(Resource);
+			Context->LoadingResources.insert(Resource);
+		}
+
+		LoadQueuedResource(Resource, true);
+	}
+}
+
+void RResourceLoaderPool::LoadQueuedResource(RResourceBase* Resource, bool bIsAsync)
+{
+	bool bAttempted = false;
+	bool bLoaded = false;
+
+	if (Resource->GetResourceState() == RS_EnqueuedForLoading)
+	{
+		bAttempted = true;
+		bLoaded = Resource->LoadResourceData(bIsAsync);
+	}
+
+	{
+		std::unique_lock<std::mutex> UniqueLock(Context->Mutex);
+		Context->LoadingResources.erase(Resource);
+
+		if (bAttempted)
+		{
+			bLoaded ? Context->BatchStats.NumLoaded++ : Context->BatchStats.NumFailed++;
+		}
+		Context->FinishBatchIfIdle();
+	}
+
+	Context->FinishedCondition.notify_all();
+}
@@ -0,0 +1,93 @@
+//=============================================================================
+// RResourceLoaderPool.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Worker threads loading resources by priority
+//=============================================================================
+
+#pragma once
+
+#include "Core/CoreTypes.h"
+
+class RResourceBase;
+struct RResourceLoaderPoolContext;
+
+/// Priority of a resource loading request. Requests with higher priority are loaded first.
+enum class EResourceLoadPriority : UINT8
+{
+	Low,		// Background loads, e.g. preview thumbnails
+	Normal,
+	High,		// Resources needed for what is on screen
+	Blocking,	// Something is waiting for the resource to finish loading
+};
+
+/// Statistics of a loading batch, which starts when a resource is queued while the pool is idle
+/// and ends when all queued resources are loaded
+struct RResourceLoadStats
+{
+	int NumLoaded = 0;
+	int NumFailed = 0;
+	int NumCancelled = 0;
+
+	// Time from the start of the batch until the next frame started
+	float TimeToFirstFrameMs = 0.0f;
+
+	// Time from the start of the batch until all resources in it were loaded
+	float TotalLoadTimeMs = 0.0f;
+};
+
+/// Loads queued resources on a number of worker threads, highest priority first.
+/// Resources waiting in the queue can be cancelled, or moved up when something blocks on them.
+class RResourceLoaderPool
+{
+public:
+	RResourceLoaderPool();
+	~RResourceLoaderPool();
+
+	/// Create worker threads. If NumThreads is negative, one worker is created for each hardware thread except the calling one.
+	void Initialize(int NumThreads = -1);
+
+	/// Drop queued resources and destroy worker threads after they finish current loads
+	void Shutdown();
+
+	int GetNumWorkerThreads() const;
+
+	/// Queue a resource for loading on worker threads. The resource must be in the enqueued, cancelled or evicted state.
+	/// If the resource is already queued, it is moved up if Priority is higher than before.
+	void Enqueue(RResourceBase* Resource, EResourceLoadPriority Priority = EResourceLoadPriority::Normal);
+
+	/// Raise priority of a queued resource. Returns false if the resource is not in the queue.
+	bool BoostPriority(RResourceBase* Resource, EResourceLoadPriority Priority);
+
+	/// Take a resource out of the queue and put it in the cancelled state. Resources being loaded can't be cancelled.
+	/// Returns true if the resource was in the queue.
+	bool Cancel(RResourceBase* Resource);
+
+	/// Mark a resource as being loaded by the calling thread, so threads calling WaitForResource wait for it.
+	/// Must be paired with a call to EndInlineLoad.
+	void BeginInlineLoad(RResourceBase* Resource);
+	void EndInlineLoad(RResourceBase* Resource, bool bLoaded);
+
+	/// Block until the resource is neither queued nor being loaded.
+	/// A queued resource is taken out of the queue and loaded on the calling thread instead of waiting for a worker.
+	void WaitForResource(RResourceBase* Resource);
+
+	/// Block until all queued resources are loaded
+	void WaitUntilIdle();
+
+	/// Check if there is no resource queued or being loaded
+	bool IsIdle() const;
+
+	/// Called by the resource manager when a new frame starts
+	void OnFrameStarted();
+
+	/// Get statistics of the last finished loading batch
+	RResourceLoadStats GetLastBatchStats() const;
+
+private:
+	void WorkerThreadMain();
+
+	/// Load a resource taken from the queue and update statistics
+	void LoadQueuedResource(RResourceBase* Resource, bool bIsAsync);
+
+	std::unique_ptr<RResourceLoaderPoolContext>	Context;
+};
@@ -13,70 +13,57 @@
 #include "UI/RProgressBar.h"
 
 #include "Core/RLog.h"
+#include "Core/RVirtualFileSystem.h"
 
-#include <thread>
 #include <mutex>
-#include <condition_variable>
+#include <algorithm>
 
 #include "tinyxml2/tinyxml2.h"
 
 // Win32 file system APIs
 #include <Shlwapi.h>
 
-static std::mutex								m_TaskQueueMutex;
-static std::condition_variable					m_TaskQueueCondition;
 static std::mutex								m_PendingNotifyResourceMutex;
 
 static std::mutex	TextureResourcesMutex;
 
 std::string RResourceManager::AssetsBasePathName = "../Assets/";
 
-void ResourceLoaderThread(LoaderThreadData* data)
+namespace
 {
-	while (1)
+	/// Get path of the asset archive packed from an assets folder ("../Assets/" is packed into "../Assets.rpak")
+	std::string GetAssetArchivePath(const std::string& AssetsPath)
 	{
-		LoaderThreadTask task;
-
-		{
-			std::unique_lock<std::mutex> uniqueLock(*data->TaskQueueMutex);
-			if (data->TaskQueue->size() == 0)
-			{
-				RLog("=== Resource loader thread is idle ===\n");
-			}
-
-			// Block thread until we get signal for another task or need to quit thread
-			data->TaskQueueCondition->wait(uniqueLock, [data]{ return data->TaskQueue->size() != 0 || *data->ShouldQuitThread; });
-
-			if (*data->ShouldQuitThread)
-				break;
-
-			task = data->TaskQueue->front();
-			data->TaskQueue->pop();
-		}
+		return RFileUtil::TrimTrailingSeperators(AssetsPath) + ".rpak";
+	}
 
-		// Load resource in this task
-		if (task.Resource->GetResourceState() == RS_EnqueuedForLoading)
-		{
-			task.Resource->LoadResourceData(true);
-		}
+	bool CheckAssetsExist(const std::string& AssetsPath)
+	{
+		return RFileUtil::CheckPathExists(AssetsPath) || RFileUtil::CheckPathExists(GetAssetArchivePath(AssetsPath));
 	}
+}
+
+RResourceManager::RResourceManager()
+	: LoadedMemorySize(0)
+	, MemoryBudget(0)
+	, LastBudgetCheckMemorySize(0)
+	, LastBudgetCheckUseTick(0)
+{
 
-	// Notify main thread that loader thread has quit
-	*data->HasQuitThread = true;
 }
 
-void RResourceManager::Initialize()
+void RResourceManager::Initialize(int NumLoaderThreads /*= -1*/)
 {
 	RegisterResourceTypes();
 
-	// Check if assets folder exists at given path. If not, go to the upper folder and search for it again.
-	if (!RFileUtil::CheckPathExists(AssetsBasePathName))
+	// Check if assets folder or its archive exists at given path. If not, go to the upper folder and search for it again.
+	if (!CheckAssetsExist(AssetsBasePathName))
 	{
 		std::vector<std::string> SearchedPaths;
 		SearchedPaths.push_back(AssetsBasePathName);
 
 		std::string FallbackPath = std::string("../") + AssetsBasePathName;
-		if (RFileUtil::CheckPathExists(FallbackPath))
+		if (CheckAssetsExist(FallbackPath))
 		{
 			AssetsBasePathName = FallbackPath;
 		}
@@ -92,41 +79,30 @@ void RResourceManager::Initialize()
 		}
 	}
 
-	// Create resource loader thread
-	m_ShouldQuitLoaderThread = false;
-	m_HasLoaderThreadQuit = false;
-
-	m_LoaderThreadData.TaskQueue = &m_LoaderThreadTaskQueue;
-	m_LoaderThreadData.TaskQueueMutex = &m_TaskQueueMutex;
-	m_LoaderThreadData.TaskQueueCondition = &m_TaskQueueCondition;
-	m_LoaderThreadData.ShouldQuitThread = &m_ShouldQuitLoaderThread;
-	m_LoaderThreadData.HasQuitThread = &m_HasLoaderThreadQuit;
+	// Assets in the archive are read from mapped memory. Files not packed are still loaded from the assets folder.
+	const std::string ArchivePath = GetAssetArchivePath(AssetsBasePathName);
+	if (RFileUtil::CheckPathExists(ArchivePath))
+	{
+		GVirtualFileSystem.MountArchive(ArchivePath, AssetsBasePathName);
+	}
 
-	std::thread t(ResourceLoaderThread, &m_LoaderThreadData);
-	t.detach();
+	// Create resource loader threads
+	LoaderPool.Initialize(NumLoaderThreads);
 }
 
 void RResourceManager::Destroy()
 {
-	// terminate loader thread
-	{
-		std::unique_lock<std::mutex> uniqueLock(m_TaskQueueMutex);
-		m_ShouldQuitLoaderThread = true;
-	}
-	m_TaskQueueCondition.notify_all();
-
-	// Wait until loader thread has quit
-	while (!m_HasLoaderThreadQuit)
-	{
-		Sleep(1);
-	}
+	// Terminate loader threads. Resources still in the queue are not loaded.
+	LoaderPool.Shutdown();
 
 	UnloadAllResources();
+
+	GVirtualFileSystem.UnmountAll();
 }
 
 void RResourceManager::LoadAllResources(EResourceLoadMode LoadMode /*= EResourceLoadMode::Threaded*/)
 {
-	std::vector<std::string> ResourcePaths = RFileUtil::GetFilesInDirectoryAndSubdirectories(GetAssetsBasePath(), "*.*");
+	std::vector<std::string> ResourcePaths = GVirtualFileSystem.EnumerateFiles(GetAssetsBasePath());
 	int NumResources = (int)ResourcePaths.size();
 	RProgressBar ProgressBar(NumResources, "Loading...");
 	ProgressBar.Start();
@@ -170,22 +146,123 @@ void RResourceManager::AddPendingNotifyResource(RResourceBase* Resource)
 
 void RResourceManager::Update()
 {
-	std::unique_lock<std::mutex> UniqueLock(m_PendingNotifyResourceMutex);
+	LoaderPool.OnFrameStarted();
 
-	for (int i = (int)PendingNotifyResources.size() - 1; i >= 0; i--)
+	// Resources are added once they and all resources they reference are loaded
+	std::vector<RResourceBase*> CompletedResources;
 	{
-		RResourceBase* Resource = PendingNotifyResources[i];
+		std::unique_lock<std::mutex> UniqueLock(m_PendingNotifyResourceMutex);
+		CompletedResources.swap(PendingNotifyResources);
+	}
 
-		if (Resource->IsLoaded() && Resource->AreReferencedResourcesLoaded())
+	for (RResourceBase* Resource : CompletedResources)
+	{
+		OnResourceFinishedAsyncLoading.Execute(Resource);
+	}
+
+	// Enforce memory budget. Skip if nothing has been loaded or released since the last check.
+	if (MemoryBudget > 0)
+	{
+		INT64 MemorySize = LoadedMemorySize.load();
+		UINT64 UseTick = RResourceBase::GetCurrentUseTick();
+		if (MemorySize > (INT64)MemoryBudget &&
+			(MemorySize != LastBudgetCheckMemorySize || UseTick != LastBudgetCheckUseTick))
 		{
-			OnResourceFinishedAsyncLoading.Execute(Resource);
+			EvictUnusedResources((size_t)(MemorySize - (INT64)MemoryBudget));
 
-			auto Index = PendingNotifyResources.begin() + i;
-			PendingNotifyResources.erase(Index);
+			LastBudgetCheckMemorySize = LoadedMemorySize.load();
+			LastBudgetCheckUseTick = RResourceBase::GetCurrentUseTick();
 		}
 	}
 }
 
+void RResourceManager::SetMemoryBudget(size_t BudgetBytes)
+{
+	MemoryBudget = BudgetBytes;
+	LastBudgetCheckMemorySize = 0;
+}
+
+size_t RResourceManager::EvictUnusedResources(size_t BytesToFree)
+{
+	std::vector<RResourceBase*> Candidates;
+	for (auto Container : ResourceContainers)
+	{
+		for (RResourceBase* Resource : Container->GetResourceBaseArray())
+		{
+			if (Resource->CanEvict())
+			{
+				Candidates.push_back(Resource);
+			}
+		}
+	}
+
+	std::sort(Candidates.begin(), Candidates.end(), [](RResourceBase* A, RResourceBase* B)
+	{
+		return A->GetLastUseTick() < B->GetLastUseTick();
+	});
+
+	size_t BytesFreed = 0;
+	int NumEvicted = 0;
+
+	for (RResourceBase* Resource : Candidates)
+	{
+		if (BytesFreed >= BytesToFree)
+			break;
+
+		// Resources only held by raw pointers (or by other resources) must stay loaded
+		assert(Resource->IsReferencedByHandle());
+
+		size_t ResourceSize = Resource->GetLoadedMemorySize();
+		if (Resource->Evict())
+		{
+			BytesFreed += ResourceSize;
+			NumEvicted++;
+		}
+	}
+
+	if (NumEvicted > 0)
+	{
+		RLog("Evicted %d unused resources, freed %.2f MB (%.2f MB loaded, budget %.2f MB)\n", NumEvicted,
+			 BytesFreed / (1024.0f * 1024.0f), GetLoadedMemorySize() / (1024.0f * 1024.0f), MemoryBudget / (1024.0f * 1024.0f));
+	}
+
+	return BytesFreed;
+}
+
+std::vector<RResourceMemoryStats> RResourceManager::GetMemoryStats() const
+{
+	std::vector<RResourceMemoryStats> Stats;
+
+	for (auto Container : ResourceContainers)
+	{
+		RResourceMemoryStats TypeStats = { Container->GetResourceTypeName(), 0, 0, 0, 0, 0 };
+
+		for (RResourceBase* Resource : Container->GetResourceBaseArray())
+		{
+			TypeStats.NumResources++;
+
+			if (Resource->IsLoaded())
+			{
+				TypeStats.NumLoaded++;
+				TypeStats.LoadedBytes += Resource->GetLoadedMemorySize();
+			}
+			else if (Resource->GetResourceState() == RS_Evicted)
+			{
+				TypeStats.NumEvicted++;
+			}
+
+			if (Resource->GetRefCount() > 0)
+			{
+				TypeStats.NumReferenced++;
+			}
+		}
+
+		Stats.push_back(TypeStats);
+	}
+
+	return Stats;
+}
+
 void RResourceManager::RegisterResourceTypes()
 {
 	RegisterResourceType<RMesh>();
@@ -216,19 +293,14 @@ RResourceBase* RResourceManager::LoadResourceAutoDetectType(const std::string& P
 	return nullptr;
 }
 
-void RResourceManager::LockTaskQueue()
-{
-	m_TaskQueueMutex.lock();
-}
-
-void RResourceManager::UnlockTaskQueue()
+bool RResourceManager::CancelLoading(RResourceBase* Resource)
 {
-	m_TaskQueueMutex.unlock();
+	return LoaderPool.Cancel(Resource);
 }
 
-void RResourceManager::NotifyThreadTaskEnqueued()
+void RResourceManager::WaitForResource(RResourceBase* Resource)
 {
-	m_TaskQueueCondition.notify_all();
+	LoaderPool.WaitForResource(Resource);
 }
 
 std::vector<RMesh*> RResourceManager::GetMeshResources()
@@ -253,6 +325,11 @@ const std::string& RResourceManager::GetAssetsBasePath()
 	return AssetsBasePathName;
 }
 
+std::string RResourceManager::GetCacheBasePath()
+{
+	return AssetsBasePathName + "../Cache/";
+}
+
 std::string RResourceManager::GetRelativePathToResource(const std::string& ResourcePath)
 {
 	char currentPath[MAX_PATH];
@@ -7,6 +7,8 @@
 
 #include "RenderSystem/RMaterial.h"
 #include "RResourceContainer.h"
+#include "RResourceLoaderPool.h"
+#include "RLoadFuture.h"
 
 #include "Core/RDelegate.h"
 #include "Core/RFileUtil.h"
@@ -14,48 +16,35 @@
 class RMesh;
 struct ID3D11ShaderResourceView;
 
-namespace std
-{
-	class mutex;
-	class condition_variable;
-}
-
 #define ENABLE_THREADED_LOADING 1
 
-struct LoaderThreadTask
-{
-	/// The asset path for accessing the resource in the engine
-	std::string			AssetPath;
-
-	/// The resource object
-	RResourceBase*	Resource;
-
-	/// Whether this is an asynchronous loading  task
-	bool			bIsAsync;
-};
-
-struct LoaderThreadData
-{
-	std::mutex*						TaskQueueMutex;
-	std::condition_variable*		TaskQueueCondition;
-	std::queue<LoaderThreadTask>*	TaskQueue;
-	bool*							ShouldQuitThread;
-	bool*							HasQuitThread;
-};
-
 enum class EResourceLoadMode : UINT8
 {
 	Immediate,
 	Threaded,
 };
 
+/// Memory used by resources of a type
+struct RResourceMemoryStats
+{
+	const char*	TypeName;
+	int			NumResources;
+	int			NumLoaded;
+	int			NumEvicted;
+
+	// Number of resources currently referenced by handles
+	int			NumReferenced;
+	size_t		LoadedBytes;
+};
+
 /// The resource manager of engine
 class RResourceManager : public RSingleton<RResourceManager>
 {
 	friend class RSingleton<RResourceManager>;
-	friend void ResourceLoaderThread(LoaderThreadData* data);
 public:
-	void Initialize();
+	/// Initialize the resource manager. If NumLoaderThreads is negative, one loader thread is created
+	/// for each hardware thread except the calling one.
+	void Initialize(int NumLoaderThreads = -1);
 
 	void Destroy();
 
@@ -63,18 +52,56 @@ public:
 	void UnloadAllResources();
 	void UnloadSRVWrappers();
 
-	/// Add a resource to pending notify list
+	/// Add a resource to pending notify list. Called when an async loaded resource and all resources it references are loaded.
 	void AddPendingNotifyResource(RResourceBase* Resource);
 
 	/// Delegate called when a resource has finished async loading
 	RDelegate<RResourceBase*> OnResourceFinishedAsyncLoading;
 
+	/// Delegate called on the main thread when a loaded resource releases its content to be evicted or reloaded.
+	/// Data built from the content of the resource is outdated from now on.
+	RDelegate<RResourceBase*> OnResourceUnloaded;
+
 	/// Update the resource manager every frame
 	void Update();
 
-	/// Load resource from path
+	/// Load resource from path.
+	/// If the resource is already queued, a threaded load raises its priority and an immediate load waits for it.
+	template<typename T>
+	T* LoadResource(const std::string& AssetPath, EResourceLoadMode mode = EResourceLoadMode::Threaded,
+					EResourceLoadPriority Priority = EResourceLoadPriority::Normal);
+
+	/// Take a resource which is no longer needed out of the loader queue. Loading it again queues it again.
+	/// Returns false if the resource is not in the queue.
+	bool CancelLoading(RResourceBase* Resource);
+
+	/// Block until a queued resource is loaded, loading it on the calling thread if no loader thread has taken it
+	void WaitForResource(RResourceBase* Resource);
+
+	/// Get the pool of resource loader threads
+	RResourceLoaderPool& GetLoaderPool();
+
+	/// Set number of bytes loaded resources may use before unreferenced ones are evicted, least recently used first.
+	/// Zero means no limit.
+	void SetMemoryBudget(size_t BudgetBytes);
+	size_t GetMemoryBudget() const;
+
+	/// Get number of bytes used by all loaded resources
+	size_t GetLoadedMemorySize() const;
+
+	/// Called by resources when they finish loading or release their content
+	void AddLoadedMemorySize(INT64 DeltaBytes);
+
+	/// Evict unreferenced resources, least recently used first, until at least BytesToFree bytes are freed.
+	/// Returns number of bytes freed.
+	size_t EvictUnusedResources(size_t BytesToFree);
+
+	/// Get memory usage of each resource type
+	std::vector<RResourceMemoryStats> GetMemoryStats() const;
+
+	/// Queue a resource for loading and get a future which is ready once the resource and all resources it references are loaded
 	template<typename T>
-	T* LoadResource(const std::string& AssetPath, EResourceLoadMode mode = EResourceLoadMode::Threaded);
+	RLoadFuture<T> LoadResourceAsync(const std::string& AssetPath, EResourceLoadPriority Priority = EResourceLoadPriority::Normal);
 
 	/// Find resource by path
 	template<typename T>
@@ -95,6 +122,9 @@ public:
 	/// Root path of assets folder
 	static const std::string& GetAssetsBasePath();
 
+	/// Root path of data built from assets (e.g. collision BVHs), next to the assets folder
+	static std::string GetCacheBasePath();
+
 	/// Get relative path to resource from working directory
 	static std::string GetRelativePathToResource(const std::string& ResourcePath);
 
@@ -102,7 +132,7 @@ public:
 	RTexture* WrapShaderResourceViewInTexture(ID3D11ShaderResourceView* ShaderResourceView, bool bTransferOwnership = false);
 
 private:
-	RResourceManager() {}
+	RResourceManager();
 	~RResourceManager() {}
 
 	void RegisterResourceTypes();
@@ -124,10 +154,6 @@ private:
 	template<typename T>
 	const RResourceContainer<T>& GetResourceContainer() const;
 
-	static void LockTaskQueue();
-	static void UnlockTaskQueue();
-	static void NotifyThreadTaskEnqueued();
-
 	static std::string						AssetsBasePathName;
 
 	/// Registered resource containers for resource types
@@ -156,17 +182,21 @@ private:
 	typedef std::map<ID3D11ShaderResourceView*, RTexture*> WrapperTextureMap;
 	WrapperTextureMap					m_WrapperTextureResources;
 
-	bool								m_ShouldQuitLoaderThread;
-	bool								m_HasLoaderThreadQuit;
-	std::queue<LoaderThreadTask>				m_LoaderThreadTaskQueue;
-	LoaderThreadData					m_LoaderThreadData;
+	RResourceLoaderPool					LoaderPool;
 
 	/// A list of loaded resources waiting to notify their states
 	std::vector<RResourceBase*>				PendingNotifyResources;
+
+	std::atomic<INT64>					LoadedMemorySize;
+	size_t								MemoryBudget;
+
+	// Loaded memory size and resource use tick when the budget was last enforced. Nothing can be evicted until either changes.
+	INT64								LastBudgetCheckMemorySize;
+	UINT64								LastBudgetCheckUseTick;
 };
 
 template<typename T>
-T* RResourceManager::LoadResource(const std::string& AssetPath, EResourceLoadMode mode)
+T* RResourceManager::LoadResource(const std::string& AssetPath, EResourceLoadMode mode, EResourceLoadPriority Priority)
 {
 	std::string ActualPath = RFileUtil::UnifyPathSeperators(AssetPath);
 
@@ -184,26 +214,58 @@ T* RResourceManager::LoadResource(const std::string& AssetPath, EResourceLoadMod
 
 	// Find resource in resource container
 	RResourceContainer<T>& ResourceContainer = GetResourceContainer<T>();
-	T* Resource = ResourceContainer.Find(ActualPath);
-	if (Resource != nullptr)
-	{
-		// The resource has been already loaded. Return it now.
-		return Resource;
-	}
-
-	std::string RelativePath = RFileUtil::CombinePath(RResourceManager::GetAssetsBasePath(), ActualPath);
-	Resource = new T(RelativePath);
-	Resource->OnEnqueuedForLoading();
-
-	ResourceContainer.Add(Resource);
-
-	// Assign to asset path
-	Resource->SetAssetPath(ActualPath);
-
 #if (ENABLE_THREADED_LOADING == 0)
 	mode = EResourceLoadMode::Immediate;
 #endif
 
+	// Find the resource or create it in one step. If several threads load the same path, only one creates the resource.
+	bool bCreated;
+	T* Resource = ResourceContainer.FindOrAdd(ActualPath, [this, &ActualPath, mode, Priority]()
+		{
+			T* NewResource = new T(RFileUtil::CombinePath(RResourceManager::GetAssetsBasePath(), ActualPath));
+			NewResource->OnEnqueuedForLoading();
+
+			// Assign to asset path. Containers index resources by path when they are added.
+			NewResource->SetAssetPath(ActualPath);
+
+			// Register the load before the resource can be found, so other threads loading it will wait for it
+			if (mode == EResourceLoadMode::Immediate)
+			{
+				LoaderPool.BeginInlineLoad(NewResource);
+			}
+			else
+			{
+				LoaderPool.Enqueue(NewResource, Priority);
+			}
+
+			return NewResource;
+		}, bCreated);
+
+	if (!bCreated)
+	{
+		if (Resource->GetResourceState() == RS_Cancelled || Resource->GetResourceState() == RS_Evicted)
+		{
+			// Loading was cancelled before, or the resource was evicted. Queue the resource again.
+			LoaderPool.Enqueue(Resource, Priority);
+		}
+
+		if (Resource->GetResourceState() == RS_EnqueuedForLoading)
+		{
+			if (mode == EResourceLoadMode::Immediate)
+			{
+				// The caller needs the resource now. Load it here if no loader thread has taken it yet.
+				LoaderPool.WaitForResource(Resource);
+			}
+			else
+			{
+				LoaderPool.BoostPriority(Resource, Priority);
+			}
+		}
+
+		// The resource has been already loaded or queued. Return it now.
+		return Resource;
+	}
+
 	if (mode == EResourceLoadMode::Immediate)
 	{
 		bool Result = Resource->LoadResourceData(false);
@@ -212,30 +274,47 @@ T* RResourceManager::LoadResource(const std::string& AssetPath, EResourceLoadMod
 		if (!Result)
 		{
 			ResourceContainer.Remove(Resource);
+		}
+
+		LoaderPool.EndInlineLoad(Resource, Result);
+
+		if (!Result)
+		{
 			delete Resource;
 			Resource = nullptr;
 		}
 	}
-	else
-	{
-		LoaderThreadTask task;
-		task.AssetPath = AssetPath;
-		task.Resource = Resource;
-		task.bIsAsync = (mode == EResourceLoadMode::Threaded);
-
-		// Upload task to working queue
-		LockTaskQueue();
-		m_LoaderThreadTaskQueue.push(task);
-		UnlockTaskQueue();
-
-		// Notify loader thread to start working
-		NotifyThreadTaskEnqueued();
-	}
 
 	// TODO: Multi-threaded loading will still return the resource pointer even if the loading may fail
 	return Resource;
 }
 
+template<typename T>
+RLoadFuture<T> RResourceManager::LoadResourceAsync(const std::string& AssetPath, EResourceLoadPriority Priority /*= EResourceLoadPriority::Normal*/)
+{
+	return RLoadFuture<T>(LoadResource<T>(AssetPath, EResourceLoadMode::Threaded, Priority));
+}
+
+FORCEINLINE RResourceLoaderPool& RResourceManager::GetLoaderPool()
+{
+	return LoaderPool;
+}
+
+FORCEINLINE size_t RResourceManager::GetMemoryBudget() const
+{
+	return MemoryBudget;
+}
+
+FORCEINLINE size_t RResourceManager::GetLoadedMemorySize() const
+{
+	return (size_t)RMath::Max(LoadedMemorySize.load(), (INT64)0);
+}
+
+FORCEINLINE void RResourceManager::AddLoadedMemorySize(INT64 DeltaBytes)
+{
+	LoadedMemorySize += DeltaBytes;
+}
+
 template<typename T>
 T* RResourceManager::FindResource(const std::string& Path, bool bAllowPartialMatch /*= false*/)
 {
@@ -254,6 +333,10 @@ T* RResourceManager::CreateNewResource(const std::string& AssetPath)
 {
 	T* NewResource = new T(GetAssetsBasePath() + AssetPath);
 	NewResource->SetAssetPath(AssetPath);
+
+	// A new resource has nothing to load. Resources waiting on it complete right away.
+	NewResource->OnLoadingFinished(false);
+
 	GetResourceContainer<T>().Add(NewResource);
 	return NewResource;
 }
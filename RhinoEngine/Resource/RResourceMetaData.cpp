@@ -7,12 +7,14 @@
 #include "RResourceMetaData.h"
 #include "tinyxml2/tinyxml2.h"
 #include "Core/RFileUtil.h"
+#include "Core/RVirtualFileSystem.h"
 
 void RResourceMetaData::LoadFromFile(const std::string& Filename)
 {
 	std::unique_ptr<tinyxml2::XMLDocument> XmlDoc = std::make_unique<tinyxml2::XMLDocument>();
 
-	if (XmlDoc->LoadFile(Filename.c_str()) == tinyxml2::XML_SUCCESS)
+	RFileData FileData = GVirtualFileSystem.ReadFile(Filename);
+	if (FileData.IsValid() && XmlDoc->Parse(FileData.GetData(), FileData.GetSize()) == tinyxml2::XML_SUCCESS)
 	{
 		tinyxml2::XMLElement* MetaElem = XmlDoc->FirstChildElement("Metadata");
 		if (MetaElem)
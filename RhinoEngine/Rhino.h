@@ -33,12 +33,15 @@
 
 #include "Core/RSerializer.h"
 #include "Core/RTimer.h"
+#include "Core/RFrameTimeStats.h"
 #include "Core/RInput.h"
 #include "Core/RLog.h"
+#include "Core/RProfiler.h"
 #include "Core/IApp.h"
 #include "Core/MathHelper.h"
 #include "Core/RScriptSystem.h"
 #include "Core/RFileUtil.h"
+#include "Core/RThreadPool.h"
 
 #include "Resource/RResourceManager.h"
 
@@ -52,6 +55,11 @@
 #include "RenderSystem/RShaderManager.h"
 #include "RenderSystem/RShaderConstantBuffer.h"
 #include "RenderSystem/RMesh.h"
+#include "RenderSystem/RRenderQueue.h"
+#include "RenderSystem/RConstantBufferRing.h"
+#include "RenderSystem/RLightClusterGrid.h"
+#include "RenderSystem/RShaderCompileQueue.h"
+#include "RenderSystem/RVisibilitySet.h"
 #include "RenderSystem/RTexture.h"
 #include "RenderSystem/RShadowMap.h"
 #include "RenderSystem/RRenderMeshComponent.h"
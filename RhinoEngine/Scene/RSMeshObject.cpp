@@ -9,6 +9,7 @@
 #include "RScene.h"
 #include "RenderSystem/RMesh.h"
 #include "RenderSystem/RRenderSystem.h"
+#include "RenderSystem/RRenderQueue.h"
 
 #include "Resource/RResourceManager.h"
 #include "Core/RFileUtil.h"
@@ -187,7 +188,7 @@ void RSMeshObject::SerializeXmlMaterials_Load(tinyxml2::XMLElement* XmlElemMater
 
 void RSMeshObject::SerializeXmlMaterials_Save(tinyxml2::XMLDocument* XmlDoc, tinyxml2::XMLElement* XmlElemMaterial)
 {
-	::SerializeXmlMaterials_Save(m_Materials, XmlDoc, XmlElemMaterial);
+	::SerializeXmlMaterials_Save(std::vector<RMaterial*>(m_Materials.begin(), m_Materials.end()), XmlDoc, XmlElemMaterial);
 }
 
 const RAabb& RSMeshObject::GetMeshElementAabb(int index) const
@@ -208,12 +209,13 @@ void RSMeshObject::Draw(bool instanced, int instanceCount)
 		return;
 
 	SetupMaterialsFromMeshResource();
+	SetupDrawConstantBuffers();
 
 	for (int i = 0; i < m_Mesh->GetMeshElementCount(); i++)
 	{
 		const RMeshElement& MeshElement = m_Mesh->GetMeshElement(i);
 		bool bSkinned = MeshElement.GetFlag() & MEF_Skinned;
-		RMaterial* Material = (i < (int)m_Materials.size()) ? m_Materials[i] : nullptr;
+		RMaterial* Material = (i < (int)m_Materials.size()) ? m_Materials[i].Get() : nullptr;
 		GRenderer.BindMaterial(Material, bSkinned, instanced);
 
 		if (instanced)
@@ -237,6 +239,8 @@ void RSMeshObject::DrawDepthPass(bool instanced, int instanceCount)
 	if (!m_Mesh || !m_Mesh->IsLoaded())
 		return;
 
+	SetupDrawConstantBuffers();
+
 	for (int i = 0; i < m_Mesh->GetMeshElementCount(); i++)
 	{
 		const RMeshElement& MeshElement = m_Mesh->GetMeshElement(i);
@@ -255,6 +259,39 @@ void RSMeshObject::DrawDepthPass(bool instanced, int instanceCount)
 	}
 }
 
+bool RSMeshObject::AddToRenderQueue(RRenderQueue& Queue, int LightListIndex, bool bDepthPass)
+{
+	if (!m_Mesh || !m_Mesh->IsLoaded())
+		return true;
+
+	if (!bDepthPass)
+	{
+		SetupMaterialsFromMeshResource();
+	}
+
+	const UINT ObjectIndex = Queue.AddObject(GetTransformMatrix(), this, LightListIndex);
+
+	for (int i = 0; i < m_Mesh->GetMeshElementCount(); i++)
+	{
+		const RMeshElement& MeshElement = m_Mesh->GetMeshElement(i);
+		bool bSkinned = MeshElement.GetFlag() & MEF_Skinned;
+
+		RMaterial* Material = nullptr;
+		if (bDepthPass)
+		{
+			Material = RMaterial::GetDepthOnly();
+		}
+		else if (i < (int)m_Materials.size())
+		{
+			Material = m_Materials[i].Get();
+		}
+
+		Queue.AddDrawPacket(ObjectIndex, &MeshElement, Material, bSkinned);
+	}
+
+	return true;
+}
+
 float RSMeshObject::GetResourceTimestamp()
 {
 	if (m_Mesh)
@@ -274,11 +311,44 @@ void RSMeshObject::CalculateBounds()
 	}
 }
 
+bool RSMeshObject::Raycast(const RRay& Ray, RRaycastHit& OutHit)
+{
+	if (!m_Mesh || !m_Mesh->IsLoaded())
+	{
+		return false;
+	}
+
+	float BoundsDistance;
+	if (!Ray.TestSegmentIntersectionWithAabb(GetAabb(), &BoundsDistance) || BoundsDistance >= OutHit.Distance)
+	{
+		return false;
+	}
+
+	// Ray direction is transformed without normalization, so hit distances in mesh space stay in world units
+	RMatrix4 WorldToLocal = GetTransformMatrix().Inverse();
+	RVec3 LocalOrigin = (RVec4(Ray.Origin, 1.0f) * WorldToLocal).ToVec3();
+	RVec3 LocalDirection = (RVec4(Ray.Direction, 0.0f) * WorldToLocal).ToVec3();
+
+	RMeshRaycastHit MeshHit;
+	if (!m_Mesh->Raycast(LocalOrigin, LocalDirection, RMath::Min(Ray.Distance, OutHit.Distance), MeshHit))
+	{
+		return false;
+	}
+
+	OutHit.SceneObject = this;
+	OutHit.Distance = MeshHit.Distance;
+	OutHit.Position = Ray.GetPointAtDistance(MeshHit.Distance);
+	OutHit.MeshElementIndex = MeshHit.MeshElementIndex;
+	OutHit.TriangleIndex = MeshHit.TriangleIndex;
+	return true;
+}
+
 void RSMeshObject::SetupMaterialsFromMeshResource()
 {
 	if (m_bNeedUpdateMaterial)
 	{
-		m_Materials = m_Mesh->GetMaterials();
+		const std::vector<RMaterial*>& MeshMaterials = m_Mesh->GetMaterials();
+		m_Materials.assign(MeshMaterials.begin(), MeshMaterials.end());
 
 		for (unsigned int i = 0; i < m_Materials.size(); i++)
 		{
@@ -6,6 +6,7 @@
 #pragma once
 
 #include "RSceneObject.h"
+#include "Resource/RResourceHandle.h"
 
 class RMesh;
 class RMaterial;
@@ -46,6 +47,9 @@ public:
 
 	const RAabb& GetMeshElementAabb(int index) const;
 
+	/// Raycast against mesh triangles, using the triangle BVH of the mesh
+	virtual bool Raycast(const RRay& Ray, RRaycastHit& OutHit) override;
+
 	// Overrides RSceneObject render methods
 	virtual void Draw() override;
 	virtual void DrawDepthPass() override;
@@ -53,6 +57,8 @@ public:
 	void Draw(bool instanced, int instanceCount);
 	void DrawDepthPass(bool instanced, int instanceCount);
 
+	virtual bool AddToRenderQueue(RRenderQueue& Queue, int LightListIndex, bool bDepthPass) override;
+
 	float GetResourceTimestamp();
 protected:
 	RSMeshObject(const RConstructingParams& Params);
@@ -63,8 +69,8 @@ protected:
 	/// Use default materials defined in mesh resource
 	void SetupMaterialsFromMeshResource();
 
-	RMesh*					m_Mesh;
-	std::vector<RMaterial*>	m_Materials;
+	RMeshHandle						m_Mesh;
+	std::vector<RMaterialHandle>	m_Materials;
 	RAabb					m_MeshAABB;
 	bool					m_bNeedUpdateMaterial;
 };
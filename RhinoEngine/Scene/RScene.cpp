@@ -10,6 +10,8 @@
 #include "RenderSystem/RShaderConstantBuffer.h"
 #include "RenderSystem/RMesh.h"
 #include "RenderSystem/ILight.h"
+#include "RenderSystem/RRenderQueue.h"
+#include "RenderSystem/RVisibilitySet.h"
 
 #include "RSMeshObject.h"
 
@@ -18,6 +20,7 @@
 #include "../tinyxml2/tinyxml2.h"
 #include "Core/StdHelper.h"
 #include "Core/RFileUtil.h"
+#include "Core/RVirtualFileSystem.h"
 
 // If set to 1, rotations saved in local files are in degrees instead of radians
 #define SAVE_ROTATION_IN_DEGREES 0
@@ -393,7 +396,8 @@ void RScene::LoadFromFile(const std::string& MapAssetPath)
 	const std::string MapFilePath = RFileUtil::CombinePath(RResourceManager::GetAssetsBasePath(), MapAssetPath);
 
 	std::unique_ptr<tinyxml2::XMLDocument> doc = std::make_unique<tinyxml2::XMLDocument>();
-	if (doc->LoadFile(MapFilePath.c_str()) == tinyxml2::XML_SUCCESS)
+	RFileData FileData = GVirtualFileSystem.ReadFile(MapFilePath);
+	if (FileData.IsValid() && doc->Parse(FileData.GetData(), FileData.GetSize()) == tinyxml2::XML_SUCCESS)
 	{
 		tinyxml2::XMLElement* root = doc->RootElement();
 		tinyxml2::XMLElement* elem_obj = root->FirstChildElement("SceneObject");
@@ -564,8 +568,59 @@ RVec3 RScene::TestMovingAabbWithScene(const RAabb& aabb, const RVec3& moveVec, s
 	return v;
 }
 
+bool RScene::Raycast(const RRay& Ray, RRaycastHit& OutHit, const std::function<bool(RSceneObject*)>& Filter /*= nullptr*/) const
+{
+	std::vector<RRaycastCandidate> Candidates;
+	GatherRaycastCandidates(Ray, Filter, Candidates);
+
+	RRaycastHit ClosestHit;
+	for (const auto& Candidate : Candidates)
+	{
+		// Candidates are sorted by bounds distance, nothing further away can be any closer than the current hit
+		if (Candidate.BoundsDistance >= ClosestHit.Distance)
+		{
+			break;
+		}
+
+		Candidate.SceneObject->Raycast(Ray, ClosestHit);
+	}
+
+	if (ClosestHit.SceneObject)
+	{
+		OutHit = ClosestHit;
+		return true;
+	}
+
+	return false;
+}
+
+std::vector<RRaycastHit> RScene::RaycastAll(const RRay& Ray, const std::function<bool(RSceneObject*)>& Filter /*= nullptr*/) const
+{
+	std::vector<RRaycastCandidate> Candidates;
+	GatherRaycastCandidates(Ray, Filter, Candidates);
+
+	std::vector<RRaycastHit> Hits;
+	for (const auto& Candidate : Candidates)
+	{
+		RRaycastHit Hit;
+		if (Candidate.SceneObject->Raycast(Ray, Hit))
+		{
+			Hits.push_back(Hit);
+		}
+	}
+
+	std::sort(Hits.begin(), Hits.end(), [](const RRaycastHit& Lhs, const RRaycastHit& Rhs)
+		{
+			return Lhs.Distance < Rhs.Distance;
+		});
+
+	return Hits;
+}
+
 void RScene::Render(const RenderViewInfo& View)
 {
+	std::vector<const ILight*> PointLights;
+
 	for (auto SceneObject : m_SceneObjects)
 	{
 		if (SceneObject->GetRenderPass() != View.RenderPass)
@@ -583,32 +638,8 @@ void RScene::Render(const RenderViewInfo& View)
 			continue;
 		}
 
-		RConstantBuffers::cbLight.Data.PointLightCount = 0;
-		for (auto Light : GRenderer.GetRegisteredLights())
-		{
-			if (Light->GetLightType() == ELightType::DirectionalLight)
-			{
-				// Note: Directional lights are handled in RRenderSystem::RenderFrame()
-				continue;
-			}
-
-			if (Light->GetEffectiveLightBounds().TestIntersectionWithAabb(SceneObject->GetAabb()))
-			{
-				if (Light->GetLightType() == ELightType::PointLight)
-				{
-					Light->SetupConstantBuffer(RConstantBuffers::cbLight.Data.PointLightCount);
-					RConstantBuffers::cbLight.Data.PointLightCount++;
-				}
-			}
-		}
-
-		RConstantBuffers::cbLight.UpdateBufferData();
-		RConstantBuffers::cbLight.BindBuffer();
-
-		RConstantBuffers::cbPerObject.Data.worldMatrix = SceneObject->GetTransformMatrix();
-		RConstantBuffers::cbPerObject.UpdateBufferData();
-		RConstantBuffers::cbPerObject.BindBuffer();
-		SceneObject->Draw();
+		GatherPointLights(SceneObject, PointLights);
+		DrawSceneObject(SceneObject, PointLights);
 	}
 }
 
@@ -638,6 +669,54 @@ void RScene::RenderDepthPass(const RFrustum* pFrustum)
 	}
 }
 
+void RScene::GatherVisibilityObjects(RVisibilitySet& VisibilitySet)
+{
+	for (auto SceneObject : m_SceneObjects)
+	{
+		if (!SceneObject->IsVisible())
+		{
+			continue;
+		}
+
+		UINT8 Flags = 0;
+		if (SceneObject->IsNoCulling())
+		{
+			Flags |= VOF_NoCulling;
+		}
+
+		if (!SceneObject->IsNoShadow())
+		{
+			Flags |= VOF_CastShadow;
+		}
+
+		VisibilitySet.AddObject(SceneObject->GetAabb(), nullptr, SceneObject, SceneObject->GetRenderPass(), Flags);
+	}
+}
+
+void RScene::AddSceneObjectToRenderQueue(RRenderQueue& Queue, RSceneObject* SceneObject, bool bDepthPass)
+{
+	if (bDepthPass)
+	{
+		if (!SceneObject->AddToRenderQueue(Queue, -1, true))
+		{
+			RConstantBuffers::cbPerObject.Data.worldMatrix = SceneObject->GetTransformMatrix();
+			RConstantBuffers::cbPerObject.UpdateBufferData();
+			RConstantBuffers::cbPerObject.BindBuffer();
+			SceneObject->DrawDepthPass();
+		}
+
+		return;
+	}
+
+	GatherPointLights(SceneObject, m_PointLightScratch);
+	int LightListIndex = Queue.AddLightList(m_PointLightScratch.data(), (int)m_PointLightScratch.size());
+
+	if (!SceneObject->AddToRenderQueue(Queue, LightListIndex, false))
+	{
+		DrawSceneObject(SceneObject, m_PointLightScratch);
+	}
+}
+
 void RScene::UpdateScene(float DeltaTime)
 {
 	for (RSceneObject* SceneObject : m_SceneObjects)
@@ -677,6 +756,30 @@ void RScene::AddSceneObjectInternal(RSceneObject* SceneObject)
 	m_SceneObjects.push_back(SceneObject);
 }
 
+void RScene::GatherRaycastCandidates(const RRay& Ray, const std::function<bool(RSceneObject*)>& Filter, std::vector<RRaycastCandidate>& OutCandidates) const
+{
+	OutCandidates.clear();
+
+	for (auto SceneObject : m_SceneObjects)
+	{
+		if (Filter && !Filter(SceneObject))
+		{
+			continue;
+		}
+
+		float BoundsDistance;
+		if (Ray.TestSegmentIntersectionWithAabb(SceneObject->GetAabb(), &BoundsDistance))
+		{
+			OutCandidates.push_back({ SceneObject, BoundsDistance });
+		}
+	}
+
+	std::sort(OutCandidates.begin(), OutCandidates.end(), [](const RRaycastCandidate& Lhs, const RRaycastCandidate& Rhs)
+		{
+			return Lhs.BoundsDistance < Rhs.BoundsDistance;
+		});
+}
+
 bool RScene::IsSceneObjectCulledByFrustum(RSceneObject* SceneObject, const RFrustum* Frustum) const
 {
 	if (!Frustum)
@@ -697,3 +800,49 @@ bool RScene::IsSceneObjectCulledByFrustum(RSceneObject* SceneObject, const RFrus
 
 	return true;
 }
+
+void RScene::GatherPointLights(RSceneObject* SceneObject, std::vector<const ILight*>& OutLights) const
+{
+	// Only lights in clusters around the object are tested if lights have been clustered for the frame
+	if (GRenderer.GatherClusteredPointLights(SceneObject->GetAabb(), OutLights))
+	{
+		return;
+	}
+
+	OutLights.clear();
+
+	for (auto Light : GRenderer.GetRegisteredLights())
+	{
+		if (Light->GetLightType() == ELightType::DirectionalLight)
+		{
+			// Note: Directional lights are handled in RRenderSystem::RenderFrame()
+			continue;
+		}
+
+		if (Light->GetEffectiveLightBounds().TestIntersectionWithAabb(SceneObject->GetAabb()))
+		{
+			if (Light->GetLightType() == ELightType::PointLight)
+			{
+				OutLights.push_back(Light);
+			}
+		}
+	}
+}
+
+void RScene::DrawSceneObject(RSceneObject* SceneObject, const std::vector<const ILight*>& PointLights)
+{
+	RConstantBuffers::cbLight.Data.PointLightCount = 0;
+	for (auto Light : PointLights)
+	{
+		Light->SetupConstantBuffer(RConstantBuffers::cbLight.Data.PointLightCount);
+		RConstantBuffers::cbLight.Data.PointLightCount++;
+	}
+
+	RConstantBuffers::cbLight.UpdateBufferData();
+	RConstantBuffers::cbLight.BindBuffer();
+
+	RConstantBuffers::cbPerObject.Data.worldMatrix = SceneObject->GetTransformMatrix();
+	RConstantBuffers::cbPerObject.UpdateBufferData();
+	RConstantBuffers::cbPerObject.BindBuffer();
+	SceneObject->Draw();
+}
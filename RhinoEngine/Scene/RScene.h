@@ -13,6 +13,9 @@
 class RSMeshObject;
 class RMesh;
 class RCamera;
+class RRenderQueue;
+class RVisibilitySet;
+class ILight;
 struct RenderViewInfo;
 
 class RScene
@@ -83,9 +86,22 @@ public:
 	/// Resolve collisions for a moving bounding box in the scene
 	RVec3 TestMovingAabbWithScene(const RAabb& aabb, const RVec3& moveVec, std::list<RSceneObject*> IgnoredObjects = std::list<RSceneObject*>());
 
+	/// Find the closest scene object hit by a ray within ray distance.
+	/// Objects are skipped if Filter is set and returns false for them.
+	bool Raycast(const RRay& Ray, RRaycastHit& OutHit, const std::function<bool(RSceneObject*)>& Filter = nullptr) const;
+
+	/// Find all scene objects hit by a ray within ray distance, sorted from the closest to the farthest
+	std::vector<RRaycastHit> RaycastAll(const RRay& Ray, const std::function<bool(RSceneObject*)>& Filter = nullptr) const;
+
 	void Render(const RenderViewInfo& View);
 	void RenderDepthPass(const RFrustum* pFrustum = nullptr);
 
+	/// Add all visible objects with their world bounds to a visibility set for culling
+	void GatherVisibilityObjects(RVisibilitySet& VisibilitySet);
+
+	/// Add a scene object which passed culling to a render queue. Objects which can't be added to a queue are drawn immediately.
+	void AddSceneObjectToRenderQueue(RRenderQueue& Queue, RSceneObject* SceneObject, bool bDepthPass);
+
 	void UpdateScene(float DeltaTime);
 	void UpdateScene_PostPhysics(float DeltaTime);
 
@@ -98,9 +114,26 @@ protected:
 	/// If frustum is null, this function returns false
 	bool IsSceneObjectCulledByFrustum(RSceneObject* SceneObject, const RFrustum* Frustum) const;
 
+	/// Find point lights whose bounds intersect with a scene object
+	void GatherPointLights(RSceneObject* SceneObject, std::vector<const ILight*>& OutLights) const;
+
+	/// Set up constant buffers of a scene object with its point lights and draw it immediately
+	void DrawSceneObject(RSceneObject* SceneObject, const std::vector<const ILight*>& PointLights);
+
+	/// Scene object with the distance where a ray enters its bounds
+	struct RRaycastCandidate
+	{
+		RSceneObject*	SceneObject;
+		float			BoundsDistance;
+	};
+
+	/// Find objects whose bounds are hit by a ray, sorted by distance to the bounds
+	void GatherRaycastCandidates(const RRay& Ray, const std::function<bool(RSceneObject*)>& Filter, std::vector<RRaycastCandidate>& OutCandidates) const;
+
 private:
 
 	std::vector<RSceneObject*>		m_SceneObjects;
+	std::vector<const ILight*>		m_PointLightScratch;
 	RCamera*					m_RenderCamera;			// Default camera will be used for frustum culling
 };
 
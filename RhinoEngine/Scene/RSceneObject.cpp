@@ -271,6 +271,22 @@ const RAabb& RSceneObject::GetAabb()
 	return Bounds;
 }
 
+bool RSceneObject::Raycast(const RRay& Ray, RRaycastHit& OutHit)
+{
+	float t;
+	if (!Ray.TestSegmentIntersectionWithAabb(GetAabb(), &t) || t >= OutHit.Distance)
+	{
+		return false;
+	}
+
+	OutHit.SceneObject = this;
+	OutHit.Distance = t;
+	OutHit.Position = Ray.GetPointAtDistance(t);
+	OutHit.MeshElementIndex = -1;
+	OutHit.TriangleIndex = -1;
+	return true;
+}
+
 void RSceneObject::SetRenderPass(ERenderPass NewPass)
 {
 	RenderPass = NewPass;
@@ -11,6 +11,8 @@
 
 class RScene;
 class RSceneComponent;
+class RSceneObject;
+class RRenderQueue;
 
 #define DECLARE_SCENE_OBJECT(type, base)\
 		typedef base Base; friend class RScene;\
@@ -43,6 +45,20 @@ struct RConstructingParams
 	int		Flags;
 };
 
+/// Result of casting a ray against scene objects
+struct RRaycastHit
+{
+	RSceneObject*	SceneObject = nullptr;
+
+	// Distance from ray origin to the hit point
+	float			Distance = FLT_MAX;
+	RVec3			Position;
+
+	// Mesh element and triangle being hit, or -1 if the object was hit by its bounds
+	int				MeshElementIndex = -1;
+	int				TriangleIndex = -1;
+};
+
 /// Base object that can be placed in a scene
 class RSceneObject : public RRuntimeTypeObject
 {
@@ -132,9 +148,25 @@ public:
 
 	/// Get world space AABB for scene object
 	const RAabb& GetAabb();
+
+	/// Find the closest intersection of a ray with this object within ray distance.
+	/// Default implementation hits world space bounds of the object.
+	virtual bool Raycast(const RRay& Ray, RRaycastHit& OutHit);
+
 	virtual void Draw() {}
 	virtual void DrawDepthPass() {}
 
+	/// Add draws of the object to a render queue with the object's point lights (-1 in depth passes).
+	/// Returns false if the object can't be drawn by a render queue, and it will be drawn with Draw() instead.
+	virtual bool AddToRenderQueue(RRenderQueue& Queue, int LightListIndex, bool bDepthPass) { return false; }
+
+	/// Set up constant buffers other than per-object and light buffers before the object is drawn
+	virtual void SetupDrawConstantBuffers() {}
+
+	/// Objects overriding SetupDrawConstantBuffers() return true so render queues never draw them
+	/// as instances of other objects, which would skip their buffers
+	virtual bool HasDrawConstantBuffers() const { return false; }
+
 	void SetRenderPass(ERenderPass NewPass);
 	ERenderPass GetRenderPass() const;
 
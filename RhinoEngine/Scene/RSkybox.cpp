@@ -76,7 +76,7 @@ void RSkybox::Draw()
 {
 	if (m_SkyboxShader && m_SkyboxTexture)
 	{
-		GRenderer.D3DImmediateContext()->PSSetShaderResources(0, 1, m_SkyboxTexture->GetPtrSRV());
+		GRenderer.Device()->PSSetShaderResources(0, 1, m_SkyboxTexture->GetPtrSRV());
 		m_SkyboxShader->Bind();
 		m_SkyboxMesh.Draw();
 	}
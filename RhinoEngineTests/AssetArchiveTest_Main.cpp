@@ -0,0 +1,324 @@
+//=============================================================================
+// AssetArchiveTest_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Packs asset archives and checks lookups, corrupted tables of contents and loose file overrides
+//=============================================================================
+
+#include "RTest.h"
+
+#include "Core/CoreTypes.h"
+#include "Core/RAssetArchive.h"
+#include "Core/RFileUtil.h"
+#include "Core/RVirtualFileSystem.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+
+#if PLATFORM_WINDOWS
+#include <direct.h>
+#include <sys/utime.h>
+#define rmdir _rmdir
+#define utime _utime
+#define utimbuf _utimbuf
+#else
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+namespace
+{
+	const char* const LooseDirectory = "AssetArchiveTestFiles";
+	const char* const ArchivePath = "AssetArchiveTest.rpak";
+	const char* const CorruptedArchivePath = "AssetArchiveTestCorrupted.rpak";
+
+	struct RTestFile
+	{
+		const char*	AssetPath;
+		const char*	LoosePath;
+		std::string	Content;
+	};
+
+	const RTestFile TestFiles[] =
+	{
+		{ "/Models/Hero.rmesh",			"AssetArchiveTestFiles/Hero.rmesh",		"Binary mesh data" },
+		{ "Materials\\Hero.rmtl",		"AssetArchiveTestFiles/Hero.rmtl",		"<Material />" },
+		{ "/Textures//Sky.dds",			"AssetArchiveTestFiles/Sky.dds",		std::string(1000, 'S') },
+		{ "/Empty.txt",					"AssetArchiveTestFiles/Empty.txt",		"" },
+	};
+
+	void WriteWholeFile(const std::string& Filename, const std::vector<char>& Data)
+	{
+		std::ofstream File(Filename, std::ios::binary | std::ios::trunc);
+		File.write(Data.data(), (std::streamsize)Data.size());
+	}
+
+	std::vector<char> ReadWholeFile(const std::string& Filename)
+	{
+		std::ifstream File(Filename, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+	}
+
+	/// Pack the test files, a stripped file and a duplicate differing only in case and separators
+	bool PackTestArchive()
+	{
+		RFileUtil::CreateDirectory(LooseDirectory);
+
+		RAssetArchiveWriter Writer;
+		for (const RTestFile& File : TestFiles)
+		{
+			WriteWholeFile(File.LoosePath, std::vector<char>(File.Content.begin(), File.Content.end()));
+			Writer.AddFile(File.AssetPath, File.LoosePath);
+		}
+
+		Writer.AddStrippedFile("/Models/Hero.fbx");
+		Writer.AddFile("\\models\\HERO.rmesh", TestFiles[1].LoosePath);
+
+		return Writer.Write(ArchivePath);
+	}
+
+	std::string GetEntryContent(const RAssetArchive& Archive, const RAssetArchiveEntry& Entry)
+	{
+		return std::string(Archive.GetEntryData(Entry), (size_t)Entry.DataSize);
+	}
+
+	void TestLookups()
+	{
+		RAssetArchive Archive;
+		RTEST_CHECK(Archive.Open(ArchivePath));
+
+		// Files are packed in order of path, so the duplicate sorting after the original is skipped
+		RTEST_CHECK(Archive.GetNumEntries() == 5);
+
+		for (const RTestFile& File : TestFiles)
+		{
+			std::string LookupPath = File.AssetPath;
+			const RAssetArchiveEntry* Entry = Archive.FindEntry(LookupPath[0] == '/' ? LookupPath : "/" + LookupPath);
+			if (LookupPath == "/Textures//Sky.dds")
+			{
+				// Packed paths have repeated separators collapsed
+				RTEST_CHECK(Entry == nullptr);
+				Entry = Archive.FindEntry("/Textures/Sky.dds");
+			}
+
+			RTEST_CHECK(Entry != nullptr);
+			if (Entry)
+			{
+				RTEST_CHECK(Entry->Flags == 0 && Entry->DataOffset % RAssetArchive::DataAlignment == 0);
+				RTEST_CHECK(GetEntryContent(Archive, *Entry) == File.Content);
+			}
+		}
+
+		// Lookups ignore case and separator style
+		const RAssetArchiveEntry* Hero = Archive.FindEntry("/Models/Hero.rmesh");
+		RTEST_CHECK(Hero != nullptr && Archive.GetEntryPath(*Hero) == "/Models/Hero.rmesh");
+		RTEST_CHECK(Archive.FindEntry("\\MODELS\\hero.RMesh") == Hero);
+		RTEST_CHECK(Archive.FindEntry("/materials/HERO.RMTL") != nullptr);
+		RTEST_CHECK(Archive.FindEntry("\\Materials/Hero.rmtl") == Archive.FindEntry("/materials/HERO.RMTL"));
+
+		// Near misses aren't found
+		RTEST_CHECK(Archive.FindEntry("/Models/Hero.rmes") == nullptr);
+		RTEST_CHECK(Archive.FindEntry("/Models/Hero.rmesh ") == nullptr);
+		RTEST_CHECK(Archive.FindEntry("/Hero.rmesh") == nullptr);
+		RTEST_CHECK(Archive.FindEntry("") == nullptr);
+
+		// Stripped files are found by path but have no content
+		const RAssetArchiveEntry* Stripped = Archive.FindEntry("/models/hero.FBX");
+		RTEST_CHECK(Stripped != nullptr && (Stripped->Flags & AEF_Stripped) && Stripped->DataSize == 0);
+
+		Archive.Close();
+		RTEST_CHECK(!Archive.IsOpen() && Archive.FindEntry("/Models/Hero.rmesh") == nullptr);
+	}
+
+	/// Write a modified copy of the archive and try opening it
+	template<typename ModifyFuncType>
+	bool OpenModified(const std::vector<char>& Data, ModifyFuncType ModifyFunc)
+	{
+		std::vector<char> Modified = Data;
+		ModifyFunc(Modified);
+		WriteWholeFile(CorruptedArchivePath, Modified);
+
+		RAssetArchive Archive;
+		const bool bOpened = Archive.Open(CorruptedArchivePath);
+		RTEST_CHECK(bOpened == Archive.IsOpen());
+		return bOpened;
+	}
+
+	void TestHashCollisions(const std::vector<char>& Data)
+	{
+		// Give every entry the hash of one path, which is the same as all paths colliding. Lookups of that
+		// path have to compare paths of every entry in the run of equal hashes.
+		RAssetArchiveHeader Header;
+		memcpy(&Header, Data.data(), sizeof(Header));
+
+		const std::string TargetPath = "/Textures/Sky.dds";
+		const UINT64 TargetHash = RAssetArchive::HashPath(TargetPath.data(), TargetPath.size());
+
+		auto ShareHash = [&](std::vector<char>& Modified, bool bTargetFirst)
+		{
+			std::vector<RAssetArchiveEntry> Entries(Header.NumEntries);
+			memcpy(Entries.data(), Modified.data() + Header.TocOffset, Entries.size() * sizeof(RAssetArchiveEntry));
+
+			// Move the target to the beginning or the end of the run
+			auto IsTarget = [&](const RAssetArchiveEntry& Entry)
+			{
+				return RAssetArchive::IsSamePath(Modified.data() + Header.PathTableOffset + Entry.PathOffset, Entry.PathLength, TargetPath.data(), TargetPath.size());
+			};
+			std::stable_partition(Entries.begin(), Entries.end(), [&](const RAssetArchiveEntry& Entry) { return IsTarget(Entry) == bTargetFirst; });
+
+			for (RAssetArchiveEntry& Entry : Entries)
+			{
+				Entry.PathHash = TargetHash;
+			}
+
+			memcpy(Modified.data() + Header.TocOffset, Entries.data(), Entries.size() * sizeof(RAssetArchiveEntry));
+		};
+
+		for (bool bTargetFirst : { true, false })
+		{
+			std::vector<char> Modified = Data;
+			ShareHash(Modified, bTargetFirst);
+			WriteWholeFile(CorruptedArchivePath, Modified);
+
+			RAssetArchive Archive;
+			RTEST_CHECK(Archive.Open(CorruptedArchivePath));
+
+			const RAssetArchiveEntry* Entry = Archive.FindEntry("/TEXTURES/sky.dds");
+			RTEST_CHECK(Entry != nullptr && Archive.GetEntryPath(*Entry) == TargetPath);
+			RTEST_CHECK(Entry != nullptr && GetEntryContent(Archive, *Entry) == TestFiles[2].Content);
+
+			// Other paths now have a hash no entry has
+			RTEST_CHECK(Archive.FindEntry("/Models/Hero.rmesh") == nullptr);
+		}
+	}
+
+	void TestCorruptedArchives(const std::vector<char>& Data)
+	{
+		RTEST_CHECK(OpenModified(Data, [](std::vector<char>&) {}));
+
+		// The path table is at the end, so cutting the archive anywhere leaves part of it outside the file
+		bool bAllTruncationsFailed = true;
+		for (size_t Size = 0; Size < Data.size(); Size++)
+		{
+			bAllTruncationsFailed &= !OpenModified(Data, [Size](std::vector<char>& Modified) { Modified.resize(Size); });
+		}
+		RTEST_CHECK(bAllTruncationsFailed);
+
+		RAssetArchiveHeader Header;
+		memcpy(&Header, Data.data(), sizeof(Header));
+		RTEST_CHECK(Header.NumEntries == 5);
+
+		auto SetField = [&Data](size_t Offset, auto Value)
+		{
+			return OpenModified(Data, [Offset, Value](std::vector<char>& Modified) { memcpy(&Modified[Offset], &Value, sizeof(Value)); });
+		};
+
+		// Header fields
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, Magic), 'X'));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, Version), (UINT32)(RAssetArchive::CurrentVersion + 1)));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, NumEntries), (UINT32)0xffffffff));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, NumEntries), Header.NumEntries + 1000));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, TocOffset), Header.TocOffset + 1));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, TocOffset), (UINT64)Data.size() + 8));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, TocOffset), (UINT64)0xfffffffffffffff8ull));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, PathTableOffset), (UINT64)Data.size() + 1));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, PathTableSize), Header.PathTableSize + 1));
+		RTEST_CHECK(!SetField(offsetof(RAssetArchiveHeader, PathTableSize), (UINT64)0xffffffffffffffffull));
+
+		// Entry fields
+		const size_t LastEntry = (size_t)Header.TocOffset + sizeof(RAssetArchiveEntry) * (Header.NumEntries - 1);
+		RTEST_CHECK(!SetField(LastEntry + offsetof(RAssetArchiveEntry, DataOffset), (UINT64)Data.size() + 1));
+		RTEST_CHECK(!SetField(LastEntry + offsetof(RAssetArchiveEntry, DataSize), (UINT64)Data.size()));
+		RTEST_CHECK(!SetField(LastEntry + offsetof(RAssetArchiveEntry, DataSize), (UINT64)0xffffffffffffffffull));
+		RTEST_CHECK(!SetField(LastEntry + offsetof(RAssetArchiveEntry, PathOffset), (UINT32)Header.PathTableSize));
+		RTEST_CHECK(!SetField(LastEntry + offsetof(RAssetArchiveEntry, PathLength), (UINT32)0xffffffff));
+		RTEST_CHECK(!SetField(LastEntry + offsetof(RAssetArchiveEntry, PathHash), (UINT64)0));
+
+		// Entries out of hash order can't be binary searched
+		RTEST_CHECK(!OpenModified(Data, [&Header](std::vector<char>& Modified)
+			{
+				char* FirstEntry = Modified.data() + Header.TocOffset;
+				std::swap_ranges(FirstEntry, FirstEntry + sizeof(RAssetArchiveEntry), FirstEntry + sizeof(RAssetArchiveEntry));
+			}));
+
+		// An archive without entries is valid
+		RTEST_CHECK(SetField(offsetof(RAssetArchiveHeader, NumEntries), (UINT32)0));
+
+		remove(CorruptedArchivePath);
+	}
+
+	/// Move the modification time of a file by some seconds from now
+	void SetFileTime(const char* Filename, int SecondsFromNow)
+	{
+		utimbuf Times;
+		Times.actime = Times.modtime = time(nullptr) + SecondsFromNow;
+		utime(Filename, &Times);
+	}
+
+	void TestLooseFileOverride()
+	{
+		const std::string LooseModelDirectory = std::string(LooseDirectory) + "/Models";
+		const std::string LoosePath = LooseModelDirectory + "/Hero.rmesh";
+
+		RTEST_CHECK(GVirtualFileSystem.MountArchive(ArchivePath, LooseDirectory));
+
+		// Reads of mounted files come from the archive without copying
+		RFileData Packed = GVirtualFileSystem.ReadFile(LoosePath);
+		RTEST_CHECK(GVirtualFileSystem.IsInArchive(LoosePath));
+		RTEST_CHECK(Packed.IsValid() && Packed.IsFromArchive());
+		RTEST_CHECK(std::string(Packed.GetData(), Packed.GetSize()) == TestFiles[0].Content);
+
+		// Stripped files exist, but their content isn't in the archive
+		const std::string StrippedPath = std::string(LooseDirectory) + "/Models/Hero.fbx";
+		RTEST_CHECK(GVirtualFileSystem.FileExists(StrippedPath) && !GVirtualFileSystem.IsInArchive(StrippedPath));
+
+		// A loose file saved after packing is only read once its cached timestamp comparison is dropped
+		const std::string EditedContent = "Edited mesh data";
+		RFileUtil::CreateDirectory(LooseModelDirectory);
+		WriteWholeFile(LoosePath, std::vector<char>(EditedContent.begin(), EditedContent.end()));
+		SetFileTime(LoosePath.c_str(), 3600);
+		RTEST_CHECK(GVirtualFileSystem.IsInArchive(LoosePath));
+
+		GVirtualFileSystem.InvalidateLooseFile(LoosePath);
+		RFileData Edited = GVirtualFileSystem.ReadFile(LoosePath);
+#if defined(RHINO_SHIPPING)
+		RTEST_CHECK(Edited.IsFromArchive());
+#else
+		RTEST_CHECK(!GVirtualFileSystem.IsInArchive(LoosePath));
+		RTEST_CHECK(Edited.IsValid() && !Edited.IsFromArchive());
+		RTEST_CHECK(std::string(Edited.GetData(), Edited.GetSize()) == EditedContent);
+#endif
+
+		GVirtualFileSystem.UnmountAll();
+
+		remove(LoosePath.c_str());
+		rmdir(LooseModelDirectory.c_str());
+	}
+}
+
+int main()
+{
+	RTEST_CHECK(PackTestArchive());
+
+	const std::vector<char> Data = ReadWholeFile(ArchivePath);
+	RTEST_CHECK(Data.size() > sizeof(RAssetArchiveHeader));
+
+	if (Data.size() > sizeof(RAssetArchiveHeader))
+	{
+		TestLookups();
+		TestHashCollisions(Data);
+		TestCorruptedArchives(Data);
+		TestLooseFileOverride();
+	}
+
+	for (const RTestFile& File : TestFiles)
+	{
+		remove(File.LoosePath);
+	}
+	remove(ArchivePath);
+	rmdir(LooseDirectory);
+
+	return RTestReport("AssetArchiveTest");
+}
@@ -0,0 +1,643 @@
+//=============================================================================
+// EngineTests_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Checks results of engine systems which don't need a window or a render device
+//=============================================================================
+
+#include "RTest.h"
+
+#include "Core/CoreTypes.h"
+#include "Core/RFrameTimeStats.h"
+#include "Core/RProfiler.h"
+#include "Core/RThreadPool.h"
+#include "Core/RSerializer.h"
+#include "Core/RChunkedFile.h"
+#include "Collision/RCollision.h"
+#include "RenderSystem/RLightClusterGrid.h"
+#include "RenderSystem/RShaderCompileQueue.h"
+#include "RenderSystem/RVisibilitySet.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+	void TestFrameTimeStats()
+	{
+		RTEST_CHECK(RFrameTimeStats::FromFrameTimes({}).NumFrames == 0);
+
+		// Frame times 100, 99, ..., 1 ms, so nearest-rank percentiles are the percentages themselves
+		std::vector<float> FrameTimesMs;
+		for (int i = 100; i >= 1; i--)
+		{
+			FrameTimesMs.push_back((float)i);
+		}
+
+		const RFrameTimeStats Stats = RFrameTimeStats::FromFrameTimes(FrameTimesMs);
+		RTEST_CHECK(Stats.NumFrames == 100);
+		RTEST_CHECK(Stats.MinMs == 1.0f);
+		RTEST_CHECK(Stats.MaxMs == 100.0f);
+		RTEST_CHECK(Stats.MeanMs == 50.5f);
+		RTEST_CHECK(Stats.P50Ms == 50.0f);
+		RTEST_CHECK(Stats.P90Ms == 90.0f);
+		RTEST_CHECK(Stats.P95Ms == 95.0f);
+		RTEST_CHECK(Stats.P99Ms == 99.0f);
+
+		// With one frame every percentile is that frame
+		const RFrameTimeStats SingleFrame = RFrameTimeStats::FromFrameTimes({ 16.0f });
+		RTEST_CHECK(SingleFrame.NumFrames == 1);
+		RTEST_CHECK(SingleFrame.P50Ms == 16.0f && SingleFrame.P99Ms == 16.0f);
+	}
+
+	void TestThreadPool(int NumThreads)
+	{
+		RThreadPool ThreadPool;
+		ThreadPool.Initialize(NumThreads);
+		RTEST_CHECK(ThreadPool.GetNumWorkerThreads() == NumThreads);
+
+		// Every index is visited exactly once
+		const int NumElements = 10000;
+		std::vector<std::atomic<int>> VisitCounts(NumElements);
+		for (auto& Count : VisitCounts)
+		{
+			Count = 0;
+		}
+
+		ThreadPool.ParallelFor(0, NumElements, 64, [&VisitCounts](int Begin, int End)
+			{
+				for (int i = Begin; i < End; i++)
+				{
+					VisitCounts[i]++;
+				}
+			});
+
+		bool bAllVisitedOnce = true;
+		for (const auto& Count : VisitCounts)
+		{
+			bAllVisitedOnce &= Count == 1;
+		}
+		RTEST_CHECK(bAllVisitedOnce);
+
+		// Shutting down waits for queued tasks
+		std::atomic<int> NumTasksRun(0);
+		for (int i = 0; i < 100; i++)
+		{
+			ThreadPool.EnqueueTask([&NumTasksRun]() { NumTasksRun++; });
+		}
+
+		ThreadPool.Shutdown();
+		RTEST_CHECK(NumTasksRun == 100);
+	}
+
+	const RProfileStatNode* FindChildNode(const RProfileThreadStats& ThreadStats, const std::vector<int>& Nodes, const char* Name)
+	{
+		for (int NodeIndex : Nodes)
+		{
+			if (strcmp(ThreadStats.Nodes[NodeIndex].Name, Name) == 0)
+			{
+				return &ThreadStats.Nodes[NodeIndex];
+			}
+		}
+		return nullptr;
+	}
+
+	void TestProfiler()
+	{
+		GProfiler.SetThreadName("TestMain");
+
+		GProfiler.BeginFrame(1);
+		{
+			RPROFILE_SCOPE("Outer");
+			for (int i = 0; i < 3; i++)
+			{
+				RPROFILE_SCOPE("Inner");
+			}
+		}
+		GProfiler.EndFrame();
+
+		const RProfileFrameStats& Stats = GProfiler.GetLastFrameStats();
+		RTEST_CHECK(Stats.FrameNumber == 1);
+		RTEST_CHECK(Stats.NumDroppedEvents == 0);
+
+		const RProfileThreadStats* MainThread = nullptr;
+		for (const auto& ThreadStats : Stats.Threads)
+		{
+			if (ThreadStats.ThreadName == "TestMain")
+			{
+				MainThread = &ThreadStats;
+			}
+		}
+
+		RTEST_CHECK(MainThread != nullptr);
+		if (!MainThread)
+		{
+			return;
+		}
+
+		// Scopes are nested as Frame > Outer > Inner, with calls of the same scope merged into one node
+		const RProfileStatNode* Frame = FindChildNode(*MainThread, MainThread->Roots, "Frame");
+		RTEST_CHECK(Frame != nullptr);
+		if (!Frame)
+		{
+			return;
+		}
+
+		const RProfileStatNode* Outer = FindChildNode(*MainThread, Frame->Children, "Outer");
+		RTEST_CHECK(Outer != nullptr && Outer->CallCount == 1 && Outer->Depth == 1);
+		if (!Outer)
+		{
+			return;
+		}
+
+		const RProfileStatNode* Inner = FindChildNode(*MainThread, Outer->Children, "Inner");
+		RTEST_CHECK(Inner != nullptr && Inner->CallCount == 3 && Inner->Depth == 2);
+		RTEST_CHECK(Inner != nullptr && Outer->TotalMs >= Inner->TotalMs && Outer->SelfMs >= 0.0);
+	}
+
+	/// Jobs of shaders sharing an include, with a macro for each permutation. The first shader has its own include text.
+	void AddShaderCompileJobs(RShaderCompileQueue& Queue, int NumShaders, int NumPermutations, const std::string& FirstIncludeText)
+	{
+		for (int ShaderIndex = 0; ShaderIndex < NumShaders; ShaderIndex++)
+		{
+			for (int Permutation = 0; Permutation < NumPermutations; Permutation++)
+			{
+				RShaderCompileJob Job;
+				Job.SourceName = "EngineTests" + std::to_string(ShaderIndex) + ".hlsl";
+				Job.Source = "#include \"Common.hlsli\"\nfloat4 main() : SV_Target { return Shade(" + std::to_string(ShaderIndex) + "); }\n";
+				Job.Includes.push_back({ "Common.hlsli", ShaderIndex == 0 ? FirstIncludeText : std::string("float4 Shade(int i) { return i; }") });
+				Job.Macros.push_back({ "PERMUTATION", std::to_string(Permutation) });
+				Job.Target = "ps_4_0";
+				Queue.AddJob(std::move(Job));
+			}
+		}
+	}
+
+	void TestShaderCompileQueue()
+	{
+		GThreadPool.Initialize(3);
+
+		const int NumShaders = 4;
+		const int NumPermutations = 8;
+		const int NumJobs = NumShaders * NumPermutations;
+		const std::string IncludeText = "float4 Shade(int i) { return i; }";
+		const std::string ChangedIncludeText = "float4 Shade(int i) { return -i; }";
+
+		RStubShaderCompiler Compiler;
+		RShaderCache Cache("./");
+
+		// Serial compiles without a cache are the reference bytecode
+		RShaderCompileQueue SerialQueue(&Compiler, nullptr);
+		AddShaderCompileJobs(SerialQueue, NumShaders, NumPermutations, IncludeText);
+		SerialQueue.CompileAll(false);
+		RTEST_CHECK(SerialQueue.GetNumCompiled() == NumJobs);
+		RTEST_CHECK(SerialQueue.GetNumFailed() == 0);
+
+		// The first parallel run compiles every permutation, and a second run loads all of them from the cache
+		RShaderCompileQueue ColdQueue(&Compiler, &Cache);
+		AddShaderCompileJobs(ColdQueue, NumShaders, NumPermutations, IncludeText);
+		for (int i = 0; i < ColdQueue.GetNumJobs(); i++)
+		{
+			Cache.Remove(RShaderCompileQueue::MakeCacheKey(ColdQueue.GetJob(i), Compiler.GetIdentifier()));
+		}
+
+		ColdQueue.CompileAll();
+		RTEST_CHECK(ColdQueue.GetNumCompiled() == NumJobs);
+		RTEST_CHECK(ColdQueue.GetNumCacheHits() == 0);
+		RTEST_CHECK(ColdQueue.GetNumFailed() == 0);
+
+		RShaderCompileQueue WarmQueue(&Compiler, &Cache);
+		AddShaderCompileJobs(WarmQueue, NumShaders, NumPermutations, IncludeText);
+		WarmQueue.CompileAll();
+		RTEST_CHECK(WarmQueue.GetNumCacheHits() == NumJobs);
+		RTEST_CHECK(WarmQueue.GetNumCompiled() == 0);
+
+		// Changing the include of one shader only misses the cache for permutations of that shader
+		RShaderCompileQueue ChangedQueue(&Compiler, &Cache);
+		AddShaderCompileJobs(ChangedQueue, NumShaders, NumPermutations, ChangedIncludeText);
+		ChangedQueue.CompileAll();
+		RTEST_CHECK(ChangedQueue.GetNumCompiled() == NumPermutations);
+		RTEST_CHECK(ChangedQueue.GetNumCacheHits() == NumJobs - NumPermutations);
+		RTEST_CHECK(ChangedQueue.GetNumFailed() == 0);
+
+		for (int i = 0; i < NumJobs; i++)
+		{
+			const RShaderCompileJob& SerialJob = SerialQueue.GetJob(i);
+			const RShaderCompileJob& ColdJob = ColdQueue.GetJob(i);
+			const RShaderCompileJob& WarmJob = WarmQueue.GetJob(i);
+			const RShaderCompileJob& ChangedJob = ChangedQueue.GetJob(i);
+			const bool bChanged = i < NumPermutations;
+
+			// Compiled and loaded bytecode is the same as compiling serially
+			RTEST_CHECK(SerialJob.bSucceeded && ColdJob.bSucceeded && WarmJob.bSucceeded && WarmJob.bLoadedFromCache);
+			RTEST_CHECK(ColdJob.Bytecode == SerialJob.Bytecode);
+			RTEST_CHECK(WarmJob.Bytecode == SerialJob.Bytecode);
+			RTEST_CHECK(ChangedJob.bLoadedFromCache != bChanged);
+			RTEST_CHECK(bChanged ? ChangedJob.CacheKey != WarmJob.CacheKey : ChangedJob.Bytecode == SerialJob.Bytecode);
+
+			// Permutations never share a key
+			RTEST_CHECK(i == 0 || WarmJob.CacheKey != WarmQueue.GetJob(i - 1).CacheKey);
+
+			Cache.Remove(WarmJob.CacheKey);
+			Cache.Remove(ChangedJob.CacheKey);
+		}
+
+		GThreadPool.Shutdown();
+	}
+
+	/// Frustum looking along +Z the same way RCamera::GetFrustum builds it
+	RFrustum MakeFrustum(float NearZ, float FarZ, float NearHalfWidth, float NearHalfHeight, float FarHalfWidth, float FarHalfHeight)
+	{
+		const RVec3 Up(0.0f, 1.0f, 0.0f);
+		const RVec3 Right(1.0f, 0.0f, 0.0f);
+		const RVec3 nc(0.0f, 0.0f, NearZ);
+		const RVec3 fc(0.0f, 0.0f, FarZ);
+
+		RFrustum Frustum;
+		Frustum.corners[FC_FTL] = fc + Up * FarHalfHeight - Right * FarHalfWidth;
+		Frustum.corners[FC_FTR] = fc + Up * FarHalfHeight + Right * FarHalfWidth;
+		Frustum.corners[FC_FBL] = fc - Up * FarHalfHeight - Right * FarHalfWidth;
+		Frustum.corners[FC_FBR] = fc - Up * FarHalfHeight + Right * FarHalfWidth;
+		Frustum.corners[FC_NTL] = nc + Up * NearHalfHeight - Right * NearHalfWidth;
+		Frustum.corners[FC_NTR] = nc + Up * NearHalfHeight + Right * NearHalfWidth;
+		Frustum.corners[FC_NBL] = nc - Up * NearHalfHeight - Right * NearHalfWidth;
+		Frustum.corners[FC_NBR] = nc - Up * NearHalfHeight + Right * NearHalfWidth;
+		Frustum.BuildPlanesFromCorners();
+
+		return Frustum;
+	}
+
+	void TestVisibilityCulling()
+	{
+		GThreadPool.Initialize(3);
+
+		std::mt19937 Random(4321);
+		std::uniform_real_distribution<float> Position(-1000.0f, 1000.0f);
+		std::uniform_real_distribution<float> HalfSize(5.0f, 50.0f);
+		std::uniform_int_distribution<int> FlagRoll(0, 7);
+
+		const int NumObjects = RVisibilitySet::ParallelCullThreshold * 2 + 123;
+		std::vector<RAabb> Bounds(NumObjects);
+		std::vector<UINT8> Flags(NumObjects);
+		for (int i = 0; i < NumObjects; i++)
+		{
+			const RVec3 Center(Position(Random), Position(Random) * 0.2f, Position(Random));
+			const RVec3 Extent(HalfSize(Random), HalfSize(Random), HalfSize(Random));
+			Bounds[i] = RAabb(Center - Extent, Center + Extent);
+
+			const int Roll = FlagRoll(Random);
+			Flags[i] = (Roll == 0 ? VOF_NoCulling : 0) | (Roll >= 4 ? VOF_CastShadow : 0);
+		}
+
+		const float TanHalfFov = tanf(DEG_TO_RAD(60.0f) * 0.5f);
+		const RFrustum Frustums[] =
+		{
+			MakeFrustum(1.0f, 1000.0f, TanHalfFov * 16.0f / 9.0f, TanHalfFov, 1000.0f * TanHalfFov * 16.0f / 9.0f, 1000.0f * TanHalfFov),
+			MakeFrustum(1.0f, 200.0f, 150.0f, 100.0f, 150.0f, 100.0f),
+		};
+
+		for (const RFrustum& Frustum : Frustums)
+		{
+			for (UINT8 RequiredFlags : { (UINT8)0, (UINT8)VOF_CastShadow })
+			{
+				// Testing objects one by one is the reference
+				std::vector<UINT> ExpectedObjects;
+				for (int i = 0; i < NumObjects; i++)
+				{
+					if ((Flags[i] & RequiredFlags) == RequiredFlags &&
+						((Flags[i] & VOF_NoCulling) || RCollision::TestAabbInsideFrustum(Frustum, Bounds[i])))
+					{
+						ExpectedObjects.push_back((UINT)i);
+					}
+				}
+				RTEST_CHECK(ExpectedObjects.size() > 0 && ExpectedObjects.size() < (size_t)NumObjects);
+
+				// Serial and parallel culling find the same objects in the order they were added
+				std::vector<UINT8> Scratch;
+				for (bool bParallel : { false, true })
+				{
+					std::vector<UINT> VisibleObjects;
+					RVisibilitySet::CullBounds(Bounds.data(), Flags.data(), NumObjects, Frustum, RequiredFlags, bParallel, Scratch, VisibleObjects);
+					RTEST_CHECK(VisibleObjects == ExpectedObjects);
+				}
+			}
+		}
+
+		// Views of a visibility set keep their own lists. Scene objects are only stored, never dereferenced.
+		RVisibilitySet VisibilitySet;
+		RSceneObject* const DummyObject = reinterpret_cast<RSceneObject*>(&VisibilitySet);
+		for (int i = 0; i < NumObjects; i++)
+		{
+			RTEST_CHECK(VisibilitySet.AddObject(Bounds[i], nullptr, DummyObject, ERenderPass::SceneObject, Flags[i]) == (UINT)i);
+		}
+
+		const int CameraView = VisibilitySet.CullView(Frustums[0]);
+		const int ShadowView = VisibilitySet.CullView(Frustums[1], VOF_CastShadow);
+		RTEST_CHECK(VisibilitySet.GetNumViews() == 2);
+
+		std::vector<UINT8> Scratch;
+		std::vector<UINT> CameraObjects, ShadowObjects;
+		RVisibilitySet::CullBounds(Bounds.data(), Flags.data(), NumObjects, Frustums[0], 0, false, Scratch, CameraObjects);
+		RVisibilitySet::CullBounds(Bounds.data(), Flags.data(), NumObjects, Frustums[1], VOF_CastShadow, false, Scratch, ShadowObjects);
+		RTEST_CHECK(VisibilitySet.GetVisibleObjects(CameraView) == CameraObjects);
+		RTEST_CHECK(VisibilitySet.GetVisibleObjects(ShadowView) == ShadowObjects);
+
+		GThreadPool.Shutdown();
+	}
+
+	/// Plain data, arrays and strings in the layout RMesh and RAnimation serialize them with
+	struct RSerializedSample
+	{
+		int							Count = 0;
+		float						Scale = 0.0f;
+		std::string					Name;
+		std::vector<float>			Weights;
+		std::vector<std::string>	BoneNames;
+		RSerializedView<RVec3>		Positions;
+
+		void Serialize(RSerializer& Serializer)
+		{
+			Serializer.SerializeData(Count);
+			Serializer.SerializeData(Scale);
+			Serializer.SerializeData(Name);
+			Serializer.SerializeVector(Weights);
+			Serializer.SerializeVector(BoneNames, &RSerializer::SerializeData);
+			Serializer.SerializeView(Positions);
+		}
+	};
+
+	const char* const SerializerTestFile = "EngineTestsSerializer.bin";
+
+	std::vector<char> ReadWholeFile(const char* Filename)
+	{
+		std::ifstream File(Filename, std::ios::binary);
+		return std::vector<char>(std::istreambuf_iterator<char>(File), std::istreambuf_iterator<char>());
+	}
+
+	/// Read a sample from a copy of exactly the data's size, so reads past its end are caught by memory checkers
+	bool ReadSample(const std::vector<char>& Data, size_t Size, RSerializedSample& OutSample)
+	{
+		std::unique_ptr<char[]> Copy(new char[RMath::Max(Size, (size_t)1)]);
+		if (Size)
+		{
+			memcpy(Copy.get(), Data.data(), Size);
+		}
+
+		RSerializer Serializer;
+		Serializer.OpenMemory(Copy.get(), Size);
+		OutSample.Serialize(Serializer);
+
+		// Borrowed views point into the copy, so keep their data
+		std::vector<RVec3> PositionData(OutSample.Positions.GetData(), OutSample.Positions.GetData() + OutSample.Positions.GetSize());
+		OutSample.Positions = RSerializedView<RVec3>();
+
+		return !Serializer.HasError() && Serializer.Tell() == Size && PositionData.size() == 3 && PositionData[2] == RVec3(7.0f, 8.0f, 9.0f);
+	}
+
+	void TestSerializer()
+	{
+		const std::vector<RVec3> Positions = { RVec3(1.0f, 2.0f, 3.0f), RVec3(4.0f, 5.0f, 6.0f), RVec3(7.0f, 8.0f, 9.0f) };
+
+		RSerializedSample Written;
+		Written.Count = 42;
+		Written.Scale = 0.5f;
+		Written.Name = "Sample";
+		Written.Weights = { 0.25f, 0.75f };
+		Written.BoneNames = { "Root", "Spine", "" };
+		Written.Positions = RSerializedView<RVec3>(Positions.data(), (UINT)Positions.size());
+
+		RSerializer Writer;
+		Writer.Open(SerializerTestFile, ESerializeMode::Write);
+		RTEST_CHECK(Writer.IsOpen());
+		Written.Serialize(Writer);
+		Writer.Close();
+
+		// Mapped and streamed files read back the same values
+		for (ESerializeSource Source : { ESerializeSource::MappedFile, ESerializeSource::FileStream })
+		{
+			RSerializer Reader;
+			Reader.Open(SerializerTestFile, ESerializeMode::Read, Source);
+			RTEST_CHECK(Reader.IsOpen());
+
+			RSerializedSample Read;
+			Read.Serialize(Reader);
+			RTEST_CHECK(!Reader.HasError() && Reader.Tell() == Reader.GetReadSize());
+			RTEST_CHECK(Read.Count == 42 && Read.Scale == 0.5f && Read.Name == "Sample");
+			RTEST_CHECK(Read.Weights == Written.Weights && Read.BoneNames == Written.BoneNames);
+			RTEST_CHECK(Read.Positions.GetSize() == 3 && Read.Positions[1] == Positions[1]);
+
+			// Only views of memory are borrowed
+			RTEST_CHECK(Source == ESerializeSource::MappedFile || !Read.Positions.IsBorrowed());
+
+			// Seeking past the end of data fails and makes further reads fail
+			RTEST_CHECK(!Reader.Seek(Reader.GetReadSize() + 1));
+			RTEST_CHECK(Reader.HasError());
+		}
+
+		const std::vector<char> Data = ReadWholeFile(SerializerTestFile);
+		remove(SerializerTestFile);
+
+		RSerializedSample Read;
+		RTEST_CHECK(ReadSample(Data, Data.size(), Read));
+
+		// Data cut anywhere fails to read instead of reading past its end, and nothing is read after the cut
+		bool bAllTruncationsFailed = true;
+		bool bNoValuesPastEnd = true;
+		for (size_t Size = 0; Size < Data.size(); Size++)
+		{
+			RSerializedSample Truncated;
+			bAllTruncationsFailed &= !ReadSample(Data, Size, Truncated);
+			bNoValuesPastEnd &= Size >= sizeof(int) * 2 || Truncated.Scale == 0.0f;
+		}
+		RTEST_CHECK(bAllTruncationsFailed);
+		RTEST_CHECK(bNoValuesPastEnd);
+
+		// A corrupted array size larger than the data reads an empty array instead of allocating for it
+		std::vector<char> Corrupted = Data;
+		const size_t WeightCountOffset = sizeof(int) + sizeof(float) + sizeof(UINT) + Written.Name.size();
+		const UINT HugeCount = 0xffffffff;
+		memcpy(&Corrupted[WeightCountOffset], &HugeCount, sizeof(HugeCount));
+
+		RSerializedSample CorruptedRead;
+		RTEST_CHECK(!ReadSample(Corrupted, Corrupted.size(), CorruptedRead));
+		RTEST_CHECK(CorruptedRead.Name == "Sample" && CorruptedRead.Weights.empty() && CorruptedRead.BoneNames.empty());
+	}
+
+	const char* const ChunkedTestMagic = "TEST";
+
+	/// A chunked file with chunks of different sizes, the last one ending at the end of file
+	std::vector<char> WriteChunkedFile()
+	{
+		RSerializer Serializer;
+		Serializer.Open(SerializerTestFile, ESerializeMode::Write);
+
+		RChunkedFileWriter Writer(Serializer);
+		Writer.Begin(ChunkedTestMagic, 4);
+
+		for (UINT32 i = 0; i < 3; i++)
+		{
+			Writer.BeginChunk(MakeChunkId('C', 'H', 'K', (char)('0' + i)), i + 1);
+			std::vector<UINT32> Values(i * 5 + 1, i);
+			Serializer.SerializeVector(Values);
+			Writer.EndChunk();
+		}
+
+		Writer.End();
+		Serializer.Close();
+
+		std::vector<char> Data = ReadWholeFile(SerializerTestFile);
+		remove(SerializerTestFile);
+		return Data;
+	}
+
+	/// Read the table of contents from a copy of exactly the data's size. A failed read leaves the serializer where it started.
+	bool ReadChunkedHeader(const std::vector<char>& Data, size_t Size, RChunkedFileReader& Reader)
+	{
+		std::unique_ptr<char[]> Copy(new char[RMath::Max(Size, (size_t)1)]);
+		if (Size)
+		{
+			memcpy(Copy.get(), Data.data(), Size);
+		}
+
+		RSerializer Serializer;
+		Serializer.OpenMemory(Copy.get(), Size);
+
+		const bool bSucceeded = Reader.ReadHeader(Serializer, ChunkedTestMagic);
+		RTEST_CHECK(bSucceeded || Serializer.Tell() == 0);
+		return bSucceeded;
+	}
+
+	void TestChunkedFile()
+	{
+		const std::vector<char> Data = WriteChunkedFile();
+
+		// Chunks are found by id and hold what was written to them
+		{
+			RSerializer Serializer;
+			Serializer.OpenMemory(Data.data(), Data.size());
+
+			RChunkedFileReader Reader;
+			RTEST_CHECK(Reader.ReadHeader(Serializer, ChunkedTestMagic));
+			RTEST_CHECK(Reader.GetChunks().size() == 3);
+			RTEST_CHECK(Reader.FindChunk(MakeChunkId('C', 'H', 'K', '3')) == nullptr);
+
+			const RChunkedFileEntry* Chunk = Reader.FindChunk(MakeChunkId('C', 'H', 'K', '1'));
+			RTEST_CHECK(Chunk != nullptr && Chunk->Version == 2 && Chunk->Offset % RChunkedFileWriter::ChunkAlignment == 0);
+			if (Chunk)
+			{
+				std::vector<UINT32> Values;
+				RTEST_CHECK(RChunkedFileReader::SeekToChunk(Serializer, *Chunk));
+				Serializer.SerializeVector(Values);
+				RTEST_CHECK(Values == std::vector<UINT32>(6, 1));
+				RTEST_CHECK(Serializer.Tell() == Chunk->Offset + Chunk->Size);
+			}
+
+			// Files in other formats are left to be read from the start
+			Serializer.Seek(0);
+			RTEST_CHECK(!Reader.ReadHeader(Serializer, "MESH") && Serializer.Tell() == 0);
+		}
+
+		// The last chunk ends at the end of file, so cutting the file anywhere leaves a chunk or the table outside the data
+		bool bAllTruncationsFailed = true;
+		for (size_t Size = 0; Size < Data.size(); Size++)
+		{
+			RChunkedFileReader Reader;
+			bAllTruncationsFailed &= !ReadChunkedHeader(Data, Size, Reader) && Reader.GetChunks().empty();
+		}
+		RTEST_CHECK(bAllTruncationsFailed);
+
+		// Corrupt a field of the header or the table of contents
+		auto Corrupt = [&Data](size_t Offset, auto Value)
+		{
+			std::vector<char> Corrupted = Data;
+			memcpy(&Corrupted[Offset], &Value, sizeof(Value));
+
+			RChunkedFileReader Reader;
+			return ReadChunkedHeader(Corrupted, Corrupted.size(), Reader);
+		};
+
+		const size_t FirstEntry = sizeof(RChunkedFileHeader);
+		const size_t LastEntry = FirstEntry + sizeof(RChunkedFileEntry) * 2;
+
+		RTEST_CHECK(!Corrupt(offsetof(RChunkedFileHeader, FormatVersion), (UINT32)(RChunkedFileWriter::FormatVersion + 1)));
+		RTEST_CHECK(!Corrupt(offsetof(RChunkedFileHeader, NumChunks), (UINT32)5));
+		RTEST_CHECK(!Corrupt(offsetof(RChunkedFileHeader, TocCapacity), (UINT32)0x40000000));
+		RTEST_CHECK(!Corrupt(offsetof(RChunkedFileHeader, NumChunks), (UINT32)0xffffffff));
+		RTEST_CHECK(!Corrupt(FirstEntry + offsetof(RChunkedFileEntry, Offset), (UINT64)Data.size() + 1));
+		RTEST_CHECK(!Corrupt(FirstEntry + offsetof(RChunkedFileEntry, Offset), (UINT64)0xfffffffffffffff0ull));
+		RTEST_CHECK(!Corrupt(LastEntry + offsetof(RChunkedFileEntry, Size), (UINT64)0xffffffffffffffffull));
+
+		std::vector<char> LastChunkSize(Data.begin() + LastEntry + offsetof(RChunkedFileEntry, Size), Data.begin() + LastEntry + sizeof(RChunkedFileEntry));
+		UINT64 Size;
+		memcpy(&Size, LastChunkSize.data(), sizeof(Size));
+		RTEST_CHECK(!Corrupt(LastEntry + offsetof(RChunkedFileEntry, Size), Size + 1));
+
+		// Unused entries of the table and newer chunk versions are for readers of the chunks to check
+		RTEST_CHECK(Corrupt(offsetof(RChunkedFileHeader, NumChunks), (UINT32)2));
+		RTEST_CHECK(Corrupt(FirstEntry + offsetof(RChunkedFileEntry, Version), (UINT32)100));
+	}
+
+	void TestLightClusterGrid()
+	{
+		RLightClusterView View;
+		View.ViewMatrix = RMatrix4::IDENTITY;
+		View.FovY = 65.0f;
+		View.AspectRatio = 16.0f / 9.0f;
+		View.NearZ = 1.0f;
+		View.FarZ = 500.0f;
+
+		std::mt19937 Random(1234);
+		std::uniform_real_distribution<float> Position(-300.0f, 300.0f);
+		std::uniform_real_distribution<float> Depth(-50.0f, 550.0f);
+		std::uniform_real_distribution<float> Radius(1.0f, 40.0f);
+
+		std::vector<RLightSphere> Lights(2000);
+		for (auto& Light : Lights)
+		{
+			Light = { RVec3(Position(Random), Position(Random), Depth(Random)), Radius(Random) };
+		}
+
+		// Binning lights by their bounds gives the same light lists as testing every cluster
+		RLightClusterGrid Grid;
+		Grid.Build(View, Lights.data(), (int)Lights.size());
+		RTEST_CHECK(Grid.IsValid());
+
+		RLightClusterGrid BruteForceGrid;
+		BruteForceGrid.BuildBruteForce(View, Lights.data(), (int)Lights.size());
+
+		RTEST_CHECK(Grid.GetClusterLightOffsets() == BruteForceGrid.GetClusterLightOffsets());
+		RTEST_CHECK(Grid.GetClusterLightIndices() == BruteForceGrid.GetClusterLightIndices());
+		RTEST_CHECK(Grid.GetClusterLightIndices().size() > 0);
+
+		// A light around the camera touches every cluster, and a light behind it touches none
+		const RLightSphere SurroundingLight[] = { { RVec3(0.0f, 0.0f, 0.0f), 2000.0f } };
+		Grid.Build(View, SurroundingLight, 1);
+
+		bool bAllClustersLit = true;
+		for (int i = 0; i < Grid.GetNumClusters(); i++)
+		{
+			bAllClustersLit &= Grid.GetClusterLightCount(i) == 1;
+		}
+		RTEST_CHECK(bAllClustersLit);
+
+		const RLightSphere LightBehindCamera[] = { { RVec3(0.0f, 0.0f, -100.0f), 10.0f } };
+		Grid.Build(View, LightBehindCamera, 1);
+		RTEST_CHECK(Grid.GetClusterLightIndices().size() == 0);
+	}
+}
+
+int main()
+{
+	TestFrameTimeStats();
+	TestThreadPool(0);
+	TestThreadPool(4);
+	TestProfiler();
+	TestSerializer();
+	TestChunkedFile();
+	TestShaderCompileQueue();
+	TestLightClusterGrid();
+	TestVisibilityCulling();
+
+	return RTestReport("EngineTests");
+}
@@ -0,0 +1,332 @@
+//=============================================================================
+// HdrLoaderTest_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Checks decoded HDR pixels and that malformed images fail without reading past their data
+//=============================================================================
+
+#include "RTest.h"
+
+#include "Core/CoreTypes.h"
+#include "Core/RThreadPool.h"
+#include "RenderSystem/hdrloader.h"
+
+#include <random>
+
+namespace
+{
+	/// An encoded image and the RGBE pixels it was made from
+	struct RTestImage
+	{
+		int							Width;
+		int							Height;
+		std::vector<unsigned char>	RGBEPixels;
+		std::vector<unsigned char>	Data;
+	};
+
+	std::vector<unsigned char> MakeHeader(const char* ResolutionLine)
+	{
+		std::string Header = std::string("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n") + ResolutionLine + "\n";
+		return std::vector<unsigned char>(Header.begin(), Header.end());
+	}
+
+	/// Encode one component of a scanline as runs of identical bytes and literal spans
+	void AppendRLEComponent(std::vector<unsigned char>& Out, const unsigned char* Data, int Count)
+	{
+		int Index = 0;
+		while (Index < Count)
+		{
+			// Find the next run long enough to be worth encoding
+			int RunStart = Index;
+			int RunLength = 0;
+			while (RunStart < Count)
+			{
+				RunLength = 1;
+				while (RunStart + RunLength < Count && RunLength < 127 && Data[RunStart + RunLength] == Data[RunStart])
+				{
+					RunLength++;
+				}
+
+				if (RunLength >= 4)
+				{
+					break;
+				}
+
+				RunStart += RunLength;
+			}
+
+			while (Index < RunStart)
+			{
+				int NumLiterals = RMath::Min(RunStart - Index, 128);
+				Out.push_back((unsigned char)NumLiterals);
+				Out.insert(Out.end(), Data + Index, Data + Index + NumLiterals);
+				Index += NumLiterals;
+			}
+
+			if (RunStart < Count)
+			{
+				Out.push_back((unsigned char)(128 + RunLength));
+				Out.push_back(Data[RunStart]);
+				Index = RunStart + RunLength;
+			}
+		}
+	}
+
+	/// Random RGBE pixels with runs of repeated pixels, covering exponents from zero and denormals up to
+	/// values larger than half floats hold. Scanlines are run length encoded if the width allows it,
+	/// otherwise they are stored flat.
+	RTestImage CreateImage(int Width, int Height, unsigned int Seed)
+	{
+		RTestImage Image;
+		Image.Width = Width;
+		Image.Height = Height;
+		Image.RGBEPixels.resize((size_t)Width * Height * 4);
+
+		std::mt19937 Random(Seed);
+		std::uniform_int_distribution<int> Byte(0, 255);
+		std::uniform_int_distribution<int> Exponent(100, 150);
+		std::uniform_int_distribution<int> Roll(0, 15);
+
+		for (size_t i = 0; i < Image.RGBEPixels.size(); i += 4)
+		{
+			unsigned char* Pixel = &Image.RGBEPixels[i];
+			const int PixelRoll = Roll(Random);
+
+			if (i > 0 && PixelRoll < 6)
+			{
+				memcpy(Pixel, Pixel - 4, 4);
+				continue;
+			}
+
+			for (int c = 0; c < 3; c++)
+			{
+				Pixel[c] = (unsigned char)Byte(Random);
+			}
+			Pixel[3] = PixelRoll == 6 ? 0 : (unsigned char)Exponent(Random);
+		}
+
+		char ResolutionLine[64];
+		snprintf(ResolutionLine, sizeof(ResolutionLine), "-Y %d +X %d", Height, Width);
+		Image.Data = MakeHeader(ResolutionLine);
+
+		const bool bEncodeRLE = Width >= 8 && Width <= 0x7fff;
+		std::vector<unsigned char> Component(Width);
+
+		for (int y = 0; y < Height; y++)
+		{
+			const unsigned char* Scanline = &Image.RGBEPixels[(size_t)y * Width * 4];
+
+			if (!bEncodeRLE)
+			{
+				Image.Data.insert(Image.Data.end(), Scanline, Scanline + Width * 4);
+				continue;
+			}
+
+			Image.Data.push_back(2);
+			Image.Data.push_back(2);
+			Image.Data.push_back((unsigned char)(Width >> 8));
+			Image.Data.push_back((unsigned char)(Width & 0xff));
+
+			for (int c = 0; c < 4; c++)
+			{
+				for (int x = 0; x < Width; x++)
+				{
+					Component[x] = Scanline[x * 4 + c];
+				}
+				AppendRLEComponent(Image.Data, Component.data(), Width);
+			}
+		}
+
+		return Image;
+	}
+
+	/// Component value is mantissa / 256 * 2^(exponent - 128), with exponents too small for a normal float decoding to zero
+	float DecodeComponent(unsigned char Mantissa, unsigned char Exponent)
+	{
+		return Exponent > 9 ? ldexpf((float)Mantissa, Exponent - 136) : 0.0f;
+	}
+
+	/// Scalar reference of converting a non-negative float to an unsigned float with a 5-bit exponent,
+	/// rounding to nearest even and clamping to the largest finite value
+	unsigned int ToSmallFloat(float Value, int MantissaBits)
+	{
+		const float MaxValue = (2.0f - 1.0f / (1 << MantissaBits)) * 32768.0f;
+		if (Value >= MaxValue)
+		{
+			return (30u << MantissaBits) | ((1u << MantissaBits) - 1);
+		}
+
+		// Denormals are multiples of 2^(-14 - MantissaBits)
+		if (Value < ldexpf(1.0f, -14))
+		{
+			return (unsigned int)lrintf(ldexpf(Value, 14 + MantissaBits));
+		}
+
+		int Exponent;
+		const float Fraction = frexpf(Value, &Exponent) * 2.0f - 1.0f;
+		unsigned int Mantissa = (unsigned int)lrintf(ldexpf(Fraction, MantissaBits));
+		if (Mantissa == (1u << MantissaBits))
+		{
+			Mantissa = 0;
+			Exponent++;
+		}
+
+		return ((unsigned int)(Exponent - 1 + 15) << MantissaBits) | Mantissa;
+	}
+
+	/// Convert RGBE pixels one at a time, the same way the decoder's scalar path is expected to
+	std::vector<unsigned char> ConvertReference(const RTestImage& Image, HDRPixelFormat Format)
+	{
+		HDRLoaderResult Layout;
+		Layout.format = Format;
+		const int BytesPerPixel = Layout.getBytesPerPixel();
+
+		std::vector<unsigned char> Pixels((size_t)Image.Width * Image.Height * BytesPerPixel);
+		for (size_t i = 0; i < (size_t)Image.Width * Image.Height; i++)
+		{
+			const unsigned char* RGBE = &Image.RGBEPixels[i * 4];
+			const float R = DecodeComponent(RGBE[0], RGBE[3]);
+			const float G = DecodeComponent(RGBE[1], RGBE[3]);
+			const float B = DecodeComponent(RGBE[2], RGBE[3]);
+			unsigned char* Out = &Pixels[i * BytesPerPixel];
+
+			if (Format == HDRPixelFormat::Float32x4)
+			{
+				const float Pixel[4] = { R, G, B, 1.0f };
+				memcpy(Out, Pixel, sizeof(Pixel));
+			}
+			else if (Format == HDRPixelFormat::Float16x4)
+			{
+				const UINT16 Pixel[4] = { (UINT16)ToSmallFloat(R, 10), (UINT16)ToSmallFloat(G, 10), (UINT16)ToSmallFloat(B, 10), 0x3c00 };
+				memcpy(Out, Pixel, sizeof(Pixel));
+			}
+			else
+			{
+				const UINT32 Pixel = ToSmallFloat(R, 6) | (ToSmallFloat(G, 6) << 11) | (ToSmallFloat(B, 5) << 22);
+				memcpy(Out, &Pixel, sizeof(Pixel));
+			}
+		}
+
+		return Pixels;
+	}
+
+	void TestDecode(int Width, int Height)
+	{
+		const RTestImage Image = CreateImage(Width, Height, (unsigned int)(Width * 31 + Height));
+
+		for (HDRPixelFormat Format : { HDRPixelFormat::Float32x4, HDRPixelFormat::Float16x4, HDRPixelFormat::R11G11B10 })
+		{
+			// Widths which aren't multiples of 4 end scanlines with pixels converted one at a time, so
+			// both the SIMD and scalar conversions are compared with the reference
+			const std::vector<unsigned char> Expected = ConvertReference(Image, Format);
+
+			HDRLoaderResult Serial;
+			RTEST_CHECK(HDRLoader::loadFromMemory(Image.Data.data(), Image.Data.size(), Serial, Format, false));
+			RTEST_CHECK(Serial.width == Width && Serial.height == Height && Serial.format == Format);
+			RTEST_CHECK(Serial.pixels == Expected);
+
+			// Scanlines decoded on worker threads are the same as decoding them in order
+			HDRLoaderResult Parallel;
+			RTEST_CHECK(HDRLoader::loadFromMemory(Image.Data.data(), Image.Data.size(), Parallel, Format, true));
+			RTEST_CHECK(Parallel.pixels == Serial.pixels);
+		}
+	}
+
+	bool Decode(const std::vector<unsigned char>& Data)
+	{
+		// Decode from a copy of exactly the data's size, so reads past its end are caught by memory checkers
+		std::unique_ptr<unsigned char[]> Copy(new unsigned char[RMath::Max(Data.size(), (size_t)1)]);
+		if (!Data.empty())
+		{
+			memcpy(Copy.get(), Data.data(), Data.size());
+		}
+
+		HDRLoaderResult Result;
+		return HDRLoader::loadFromMemory(Copy.get(), Data.size(), Result, HDRPixelFormat::Float32x4, false);
+	}
+
+	void TestTruncatedImages()
+	{
+		for (int Width : { 24, 5 })
+		{
+			const RTestImage Image = CreateImage(Width, 6, 7);
+			RTEST_CHECK(Decode(Image.Data));
+
+			// Cutting the data anywhere fails, including in the middle of a run or a literal span
+			bool bAllTruncationsFailed = true;
+			for (size_t Size = 0; Size < Image.Data.size(); Size++)
+			{
+				bAllTruncationsFailed &= !Decode(std::vector<unsigned char>(Image.Data.begin(), Image.Data.begin() + Size));
+			}
+			RTEST_CHECK(bAllTruncationsFailed);
+		}
+
+		// Run codes which overrun the scanline or have a zero count are corrupted
+		const RTestImage Image = CreateImage(24, 6, 7);
+		const size_t FirstScanline = MakeHeader("-Y 6 +X 24").size();
+
+		std::vector<unsigned char> Corrupted = Image.Data;
+		Corrupted[FirstScanline + 4] = 128 + 127;
+		RTEST_CHECK(!Decode(Corrupted));
+
+		Corrupted = Image.Data;
+		Corrupted[FirstScanline + 4] = 0;
+		RTEST_CHECK(!Decode(Corrupted));
+	}
+
+	void TestOversizedHeaders()
+	{
+		const RTestImage Image = CreateImage(16, 4, 3);
+		const size_t PixelDataOffset = MakeHeader("-Y 4 +X 16").size();
+
+		auto WithHeader = [&](const char* ResolutionLine)
+		{
+			std::vector<unsigned char> Data = MakeHeader(ResolutionLine);
+			Data.insert(Data.end(), Image.Data.begin() + PixelDataOffset, Image.Data.end());
+			return Data;
+		};
+
+		RTEST_CHECK(Decode(WithHeader("-Y 4 +X 16")));
+
+		// Sizes past the scanline length limit, or with more scanlines than the data can hold, are rejected
+		// before anything sized by them is allocated
+		RTEST_CHECK(!Decode(WithHeader("-Y 4 +X 40000")));
+		RTEST_CHECK(!Decode(WithHeader("-Y 40000 +X 16")));
+		RTEST_CHECK(!Decode(WithHeader("-Y 2000000000 +X 2000000000")));
+		RTEST_CHECK(!Decode(WithHeader("-Y 1000 +X 16")));
+		RTEST_CHECK(!Decode(WithHeader("-Y 5 +X 16")));
+
+		// Empty, negative and unparsable sizes
+		RTEST_CHECK(!Decode(WithHeader("-Y 0 +X 16")));
+		RTEST_CHECK(!Decode(WithHeader("-Y 4 +X -16")));
+		RTEST_CHECK(!Decode(WithHeader("+Y 4 +X 16")));
+		RTEST_CHECK(!Decode(WithHeader(std::string(300, '1').c_str())));
+
+		// Headers without the magic, the empty line ending them or a resolution line
+		std::vector<unsigned char> NoMagic = Image.Data;
+		NoMagic[1] = 'X';
+		RTEST_CHECK(!Decode(NoMagic));
+
+		const std::string NoEmptyLine = "#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n-Y 4 +X 16\n";
+		RTEST_CHECK(!Decode(std::vector<unsigned char>(NoEmptyLine.begin(), NoEmptyLine.end())));
+
+		const std::string NoResolution = "#?RADIANCE\n\n-Y 4 +X 16";
+		RTEST_CHECK(!Decode(std::vector<unsigned char>(NoResolution.begin(), NoResolution.end())));
+
+		RTEST_CHECK(!Decode({}));
+	}
+}
+
+int main()
+{
+	GThreadPool.Initialize(3);
+
+	TestDecode(64, 40);
+	TestDecode(67, 33);
+	TestDecode(5, 7);
+	TestTruncatedImages();
+	TestOversizedHeaders();
+
+	GThreadPool.Shutdown();
+
+	return RTestReport("HdrLoaderTest");
+}
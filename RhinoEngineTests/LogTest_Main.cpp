@@ -0,0 +1,188 @@
+//=============================================================================
+// LogTest_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Checks async log output writes every record, including ones printed while it stops
+//=============================================================================
+
+#include "RTest.h"
+
+#include "Core/CoreTypes.h"
+#include "Core/RLog.h"
+
+#include <thread>
+
+namespace
+{
+	/// Keeps all text written to it
+	class RTextLogSink : public ILogSink
+	{
+	public:
+		virtual void Write(const char* Text, size_t Length) override
+		{
+			Output.append(Text, Length);
+		}
+
+		std::string Output;
+	};
+
+	/// Log to a sink of our own, without the default debug output
+	void ReplaceSinks(RLogOutputTargets& OutputTargets, const std::shared_ptr<ILogSink>& Sink)
+	{
+		for (const auto& ExistingSink : OutputTargets.GetSinks())
+		{
+			OutputTargets.RemoveSink(ExistingSink);
+		}
+		OutputTargets.AddSink(Sink);
+	}
+
+	/// Check every thread's records show up exactly once
+	bool AreAllRecordsWritten(const std::string& Output, int NumThreads, int NumRecordsPerThread)
+	{
+		std::vector<int> SeenCounts(NumThreads * NumRecordsPerThread, 0);
+
+		std::istringstream Stream(Output);
+		std::string Line;
+		while (std::getline(Stream, Line))
+		{
+			int ThreadIndex, RecordIndex;
+			if (sscanf(Line.c_str(), "Thread %d record %d", &ThreadIndex, &RecordIndex) != 2 ||
+				ThreadIndex < 0 || ThreadIndex >= NumThreads || RecordIndex < 0 || RecordIndex >= NumRecordsPerThread)
+			{
+				return false;
+			}
+
+			SeenCounts[ThreadIndex * NumRecordsPerThread + RecordIndex]++;
+		}
+
+		return std::all_of(SeenCounts.begin(), SeenCounts.end(), [](int Count) { return Count == 1; });
+	}
+
+	void TestAsyncOutput()
+	{
+		RLogOutputTargets OutputTargets;
+		auto Sink = std::make_shared<RTextLogSink>();
+		ReplaceSinks(OutputTargets, Sink);
+
+		OutputTargets.StartAsyncOutput();
+		RTEST_CHECK(OutputTargets.IsAsyncOutput());
+
+		// Integer, float and string arguments, and a record too large for the ring buffer
+		OutputTargets.Print("Int %d, float %.2f, string %s\n", 42, 1.5f, "text");
+		const std::string LongText(64 * 1024, 'x');
+		OutputTargets.Print("%s\n", LongText.c_str());
+		OutputTargets.Flush();
+
+		RTEST_CHECK(Sink->Output == "Int 42, float 1.50, string text\n" + LongText + "\n");
+
+		OutputTargets.StopAsyncOutput();
+		RTEST_CHECK(!OutputTargets.IsAsyncOutput());
+	}
+
+	/// Lets a test hold a thread in the middle of printing a record. Arguments are converted to integers
+	/// while the record is encoded, which is after Print has checked for async output.
+	struct RBlockingLogArg
+	{
+		struct Gate
+		{
+			std::atomic<bool> bInRecord { false };
+			std::atomic<bool> bRelease { false };
+		};
+
+		operator long long() const
+		{
+			State->bInRecord = true;
+			while (!State->bRelease)
+			{
+				std::this_thread::yield();
+			}
+			return 7;
+		}
+
+		Gate* State;
+	};
+
+	/// Stop async output while a record is being written, after Print has decided to queue it
+	void TestStopDuringRecord()
+	{
+		RLogOutputTargets OutputTargets;
+		auto Sink = std::make_shared<RTextLogSink>();
+		ReplaceSinks(OutputTargets, Sink);
+
+		OutputTargets.StartAsyncOutput();
+
+		RBlockingLogArg::Gate Gate;
+		std::thread Writer([&OutputTargets, &Gate]()
+			{
+				OutputTargets.Print("Blocked record %lld\n", RBlockingLogArg{ &Gate });
+			});
+
+		while (!Gate.bInRecord)
+		{
+			std::this_thread::yield();
+		}
+
+		// The output thread and its final drain are gone before the record is committed
+		OutputTargets.StopAsyncOutput();
+		Gate.bRelease = true;
+		Writer.join();
+
+		RTEST_CHECK(Sink->Output == "Blocked record 7\n");
+	}
+
+	/// Stop async output while threads are still printing. Records committed around the stop must not be dropped.
+	void TestStopWhileWriting(int Iteration)
+	{
+		const int NumThreads = 4;
+		const int NumRecordsPerThread = 2000;
+
+		RLogOutputTargets OutputTargets;
+		auto Sink = std::make_shared<RTextLogSink>();
+		ReplaceSinks(OutputTargets, Sink);
+
+		OutputTargets.StartAsyncOutput();
+
+		std::atomic<int> NumRecordsPrinted(0);
+		std::vector<std::thread> Threads;
+		for (int ThreadIndex = 0; ThreadIndex < NumThreads; ThreadIndex++)
+		{
+			Threads.emplace_back([&OutputTargets, &NumRecordsPrinted, ThreadIndex]()
+				{
+					for (int i = 0; i < NumRecordsPerThread; i++)
+					{
+						OutputTargets.Print("Thread %d record %d\n", ThreadIndex, i);
+						NumRecordsPrinted++;
+					}
+				});
+		}
+
+		// Stop at a different point of the writes in each iteration
+		const int StopAfterRecords = (Iteration * 997) % (NumThreads * NumRecordsPerThread);
+		while (NumRecordsPrinted < StopAfterRecords)
+		{
+			std::this_thread::yield();
+		}
+
+		OutputTargets.StopAsyncOutput();
+
+		for (auto& Thread : Threads)
+		{
+			Thread.join();
+		}
+		OutputTargets.Flush();
+
+		RTEST_CHECK(AreAllRecordsWritten(Sink->Output, NumThreads, NumRecordsPerThread));
+	}
+}
+
+int main()
+{
+	TestAsyncOutput();
+	TestStopDuringRecord();
+
+	for (int i = 0; i < 50; i++)
+	{
+		TestStopWhileWriting(i);
+	}
+
+	return RTestReport("LogTest");
+}
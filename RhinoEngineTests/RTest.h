@@ -0,0 +1,40 @@
+//=============================================================================
+// RTest.h by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Minimal checks for engine test executables
+//=============================================================================
+
+#pragma once
+
+#include <cstdio>
+
+/// Number of failed checks. A test executable returns non-zero if any check failed.
+inline int& RTestFailureCount()
+{
+	static int FailureCount = 0;
+	return FailureCount;
+}
+
+/// Check a condition and report it with its location if it doesn't hold
+#define RTEST_CHECK(Condition)\
+	do\
+	{\
+		if (!(Condition))\
+		{\
+			fprintf(stderr, "%s(%d): check failed: %s\n", __FILE__, __LINE__, #Condition);\
+			RTestFailureCount()++;\
+		}\
+	} while (0)
+
+/// Report the result of all checks. Returns the exit code of the test executable.
+inline int RTestReport(const char* TestName)
+{
+	if (RTestFailureCount() == 0)
+	{
+		printf("%s: all checks passed\n", TestName);
+		return 0;
+	}
+
+	fprintf(stderr, "%s: %d check(s) failed\n", TestName, RTestFailureCount());
+	return 1;
+}
@@ -0,0 +1,189 @@
+//=============================================================================
+// RenderQueueTest_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Submits render queues to the null render device and checks the draws it records
+//=============================================================================
+
+#include "RTest.h"
+
+#include "Core/CoreTypes.h"
+#include "RenderSystem/RRenderSystem.h"
+#include "RenderSystem/RNullRenderDevice.h"
+#include "RenderSystem/RMaterial.h"
+#include "RenderSystem/RMeshElement.h"
+#include "RenderSystem/RTexture.h"
+#include "RenderSystem/D3DUtil.h"
+
+#include "../Shaders/ConstBufferVS.h"
+
+namespace
+{
+	/// Commands recorded by the null render device for one submit of a queue
+	struct RSubmitCounts
+	{
+		UINT	NumDrawCalls = 0;
+		UINT	NumInstancesDrawn = 0;
+		UINT	NumBufferMaps = 0;
+	};
+
+	/// A material and a quad shared by every object of a test. The null render device doesn't need
+	/// valid shader bytecode, so the shader is a stand-in with an instanced vertex shader.
+	class RTestScene
+	{
+	public:
+		RTestScene()
+			: Material("RenderQueueTestMaterial")
+		{
+			static const char PlaceholderBytecode[] = "RenderQueueTest";
+			GRenderer.Device()->CreateVertexShader(PlaceholderBytecode, sizeof(PlaceholderBytecode), &Shader.VertexShader);
+			GRenderer.Device()->CreateVertexShader(PlaceholderBytecode, sizeof(PlaceholderBytecode), &Shader.VertexShader_Instanced);
+			Material.SetShader(&Shader);
+
+			MeshElement.SetName("RenderQueueTestQuad");
+			MeshElement.SetVertexComponentMask(VCM_Pos);
+			MeshElement.PositionArray =
+			{
+				RVertexType::Vec3Data(-1.0f, -1.0f, 0.0f),
+				RVertexType::Vec3Data(-1.0f,  1.0f, 0.0f),
+				RVertexType::Vec3Data( 1.0f,  1.0f, 0.0f),
+				RVertexType::Vec3Data( 1.0f, -1.0f, 0.0f),
+			};
+			MeshElement.TriangleIndices = { 0, 1, 2, 0, 2, 3 };
+			MeshElement.UpdateRenderBuffer();
+		}
+
+		~RTestScene()
+		{
+			SAFE_RELEASE(Shader.VertexShader);
+			SAFE_RELEASE(Shader.VertexShader_Instanced);
+		}
+
+		/// Submit identical objects through a render queue and count the commands it records
+		RSubmitCounts Submit(int NumObjects, bool bInstancingEnabled)
+		{
+			RRenderCommandLog* CommandLog = GRenderer.Device()->GetCommandLog();
+
+			RRenderQueue Queue;
+			Queue.SetInstancingEnabled(bInstancingEnabled);
+			Queue.Reset(ERenderPass::SceneObject, RVec3::Zero());
+
+			for (int i = 0; i < NumObjects; i++)
+			{
+				const UINT ObjectIndex = Queue.AddObject(RMatrix4::CreateTranslation((float)(i % 32) * 3.0f, (float)(i / 32) * 3.0f, 10.0f));
+				Queue.AddDrawPacket(ObjectIndex, &MeshElement, &Material, false);
+			}
+
+			const UINT NumDrawCallsBefore = CommandLog->GetNumDrawCalls();
+			const UINT64 NumInstancesBefore = CommandLog->GetNumInstancesDrawn();
+			const UINT NumBufferMapsBefore = CommandLog->GetCount(ERenderCommand::MapBuffer);
+
+			Queue.Submit();
+
+			RSubmitCounts Counts;
+			Counts.NumDrawCalls = CommandLog->GetNumDrawCalls() - NumDrawCallsBefore;
+			Counts.NumInstancesDrawn = (UINT)(CommandLog->GetNumInstancesDrawn() - NumInstancesBefore);
+			Counts.NumBufferMaps = CommandLog->GetCount(ERenderCommand::MapBuffer) - NumBufferMapsBefore;
+			return Counts;
+		}
+
+	private:
+		RShader		Shader;
+		RMaterial	Material;
+		RMeshElement MeshElement;
+	};
+
+	void TestInstancedDrawCounts(RTestScene& Scene, int NumObjects)
+	{
+		// Identical objects are merged into as few draws as the instance constant buffer allows
+		const RSubmitCounts Instanced = Scene.Submit(NumObjects, true);
+		RTEST_CHECK(Instanced.NumDrawCalls == (UINT)((NumObjects + MAX_INSTANCE_COUNT - 1) / MAX_INSTANCE_COUNT));
+		RTEST_CHECK(Instanced.NumInstancesDrawn == (UINT)NumObjects);
+
+		// Without instancing every object is a draw of its own
+		const RSubmitCounts Individual = Scene.Submit(NumObjects, false);
+		RTEST_CHECK(Individual.NumDrawCalls == (UINT)NumObjects);
+		RTEST_CHECK(Individual.NumInstancesDrawn == (UINT)NumObjects);
+	}
+
+	void TestConstantBufferRing(RTestScene& Scene)
+	{
+		const int FewObjects = 10;
+		const int ManyObjects = 200;
+
+		// The null render device supports constant buffer offsets, so the ring is created with it
+		RTEST_CHECK(GRenderer.GetConstantBufferRing() != nullptr);
+
+		// Constants of all draws are written with one map of the ring, so maps don't grow with draws
+		GRenderer.SetConstantBufferRingEnabled(true);
+		const RSubmitCounts RingFew = Scene.Submit(FewObjects, false);
+		const RSubmitCounts RingMany = Scene.Submit(ManyObjects, false);
+		RTEST_CHECK(RingMany.NumDrawCalls == (UINT)ManyObjects);
+		RTEST_CHECK(RingMany.NumBufferMaps == RingFew.NumBufferMaps);
+
+		// Without the ring the per-object constant buffer is mapped for every draw
+		GRenderer.SetConstantBufferRingEnabled(false);
+		const RSubmitCounts PerDrawFew = Scene.Submit(FewObjects, false);
+		const RSubmitCounts PerDrawMany = Scene.Submit(ManyObjects, false);
+		RTEST_CHECK(PerDrawMany.NumDrawCalls == (UINT)ManyObjects);
+		RTEST_CHECK(PerDrawMany.NumBufferMaps - PerDrawFew.NumBufferMaps >= (UINT)(ManyObjects - FewObjects));
+		RTEST_CHECK(PerDrawMany.NumBufferMaps > RingMany.NumBufferMaps);
+
+		GRenderer.SetConstantBufferRingEnabled(true);
+	}
+
+	void TestMaterialTextureSlots()
+	{
+		// Textures are never loaded, they are only looked up
+		RTexture TextureA("RenderQueueTestTextureA");
+		RTexture TextureB("RenderQueueTestTextureB");
+
+		RMaterial Material("RenderQueueTestSlots");
+		Material.SetTextureSlot(3, &TextureB);
+		Material.SetTextureSlot(0, &TextureA);
+		Material.SetTextureSlot(1, nullptr);
+
+		// Slots are listed in order of slot id, including slots set without a texture
+		const std::vector<RTextureSlotData> Slots = Material.GetTextureSlots();
+		RTEST_CHECK(Slots.size() == 3);
+		RTEST_CHECK(Slots.size() == 3 && Slots[0].SlotId == 0 && Slots[0].Texture == &TextureA);
+		RTEST_CHECK(Slots.size() == 3 && Slots[1].SlotId == 1 && Slots[1].Texture == nullptr);
+		RTEST_CHECK(Slots.size() == 3 && Slots[2].SlotId == 3 && Slots[2].Texture == &TextureB);
+
+		RTEST_CHECK(Material.HasTextureSlot(1) && !Material.HasTextureSlot(2));
+		RTEST_CHECK(Material.GetTextureBySlot(3) == &TextureB);
+		RTEST_CHECK(Material.GetTextureBySlot(2) == nullptr);
+
+		// Slot ids out of range are never set
+		RTEST_CHECK(!Material.HasTextureSlot(-1) && !Material.HasTextureSlot(RMaterial::MaxTextureSlots));
+		RTEST_CHECK(Material.GetTextureBySlot(RMaterial::MaxTextureSlots) == nullptr);
+
+		Material.RemoveTextureSlot(0);
+		RTEST_CHECK(!Material.HasTextureSlot(0) && Material.GetTextureBySlot(0) == nullptr);
+		RTEST_CHECK(Material.GetTextureSlots().size() == 2);
+	}
+}
+
+int main()
+{
+	if (!GRenderer.InitializeNullDevice(640, 480))
+	{
+		fprintf(stderr, "Failed to initialize the null render device\n");
+		return 1;
+	}
+
+	{
+		RTestScene Scene;
+
+		TestInstancedDrawCounts(Scene, 1);
+		TestInstancedDrawCounts(Scene, 100);
+		TestInstancedDrawCounts(Scene, MAX_INSTANCE_COUNT * 2 + 1);
+
+		TestConstantBufferRing(Scene);
+	}
+
+	TestMaterialTextureSlots();
+
+	GRenderer.Shutdown();
+
+	return RTestReport("RenderQueueTest");
+}
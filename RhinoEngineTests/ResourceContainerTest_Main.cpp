@@ -0,0 +1,126 @@
+//=============================================================================
+// ResourceContainerTest_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Checks resource containers create one resource per path when loaded from many threads
+//=============================================================================
+
+#include "RTest.h"
+
+#include "Core/CoreTypes.h"
+#include "Resource/RResourceContainer.h"
+
+#include <atomic>
+#include <thread>
+
+// Containers only need their resources to convert to RResourceBase. The engine's resource base pulls in
+// the engine and render device, so this test defines an empty one instead.
+class RResourceBase
+{
+};
+
+namespace
+{
+	/// Stand-in for a resource type, counting how many instances are created
+	class RTestResource : public RResourceBase
+	{
+	public:
+		RTestResource(const std::string& InAssetPath)
+			: AssetPath(InAssetPath)
+		{
+			NumCreated++;
+		}
+
+		const std::string& GetAssetPath() const		{ return AssetPath; }
+
+		static const char* _StaticGetClassName()	{ return "RTestResource"; }
+
+		static std::atomic<int> NumCreated;
+
+	private:
+		std::string AssetPath;
+	};
+
+	std::atomic<int> RTestResource::NumCreated(0);
+
+	void TestFindOrAddFromManyThreads()
+	{
+		RResourceContainer<RTestResource> Container;
+
+		const int NumThreads = 8;
+		const int NumPaths = 64;
+
+		// Every thread asks for every path, starting at the same time to make the lookups race
+		std::atomic<bool> bStart(false);
+		std::atomic<int> NumCreatedByCalls(0);
+		std::vector<std::vector<RTestResource*>> Results(NumThreads, std::vector<RTestResource*>(NumPaths));
+		std::vector<std::thread> Threads;
+
+		for (int ThreadIndex = 0; ThreadIndex < NumThreads; ThreadIndex++)
+		{
+			Threads.emplace_back([&, ThreadIndex]()
+				{
+					while (!bStart)
+					{
+						std::this_thread::yield();
+					}
+
+					for (int i = 0; i < NumPaths; i++)
+					{
+						// Paths only differing in case are the same resource
+						const std::string Path = (ThreadIndex % 2 ? "/Textures/Tex" : "/textures/tex") + std::to_string(i) + ".dds";
+
+						bool bCreated;
+						Results[ThreadIndex][i] = Container.FindOrAdd(Path, [&Path]() { return new RTestResource(Path); }, bCreated);
+						if (bCreated)
+						{
+							NumCreatedByCalls++;
+						}
+					}
+				});
+		}
+
+		bStart = true;
+		for (auto& Thread : Threads)
+		{
+			Thread.join();
+		}
+
+		// Exactly one instance per path, shared by every thread and indexed by the container
+		RTEST_CHECK(RTestResource::NumCreated == NumPaths);
+		RTEST_CHECK(NumCreatedByCalls == NumPaths);
+		RTEST_CHECK((int)Container.GetResourceArrayCopy().size() == NumPaths);
+
+		bool bAllShared = true;
+		for (int i = 0; i < NumPaths; i++)
+		{
+			RTestResource* Resource = Results[0][i];
+			bAllShared &= Resource != nullptr && Container.Find("/TEXTURES/TEX" + std::to_string(i) + ".DDS") == Resource;
+
+			for (int ThreadIndex = 1; ThreadIndex < NumThreads; ThreadIndex++)
+			{
+				bAllShared &= Results[ThreadIndex][i] == Resource;
+			}
+		}
+		RTEST_CHECK(bAllShared);
+
+		// An existing resource is returned without calling the create function
+		bool bCreated = true;
+		bool bCreateFuncCalled = false;
+		RTestResource* Existing = Container.FindOrAdd("/Textures/Tex0.dds", [&bCreateFuncCalled]()
+			{
+				bCreateFuncCalled = true;
+				return new RTestResource("/Textures/Tex0.dds");
+			}, bCreated);
+
+		RTEST_CHECK(Existing == Results[0][0] && !bCreated && !bCreateFuncCalled);
+
+		Container.ReleaseAllResources();
+	}
+}
+
+int main()
+{
+	TestFindOrAddFromManyThreads();
+
+	return RTestReport("ResourceContainerTest");
+}
@@ -0,0 +1,176 @@
+//=============================================================================
+// RhinoMeshCooker_Main.cpp by Shiyang Ao, 2020 All Rights Reserved.
+//
+// Imports all fbx meshes in an assets folder in parallel and saves them as binary meshes (.rmesh)
+//=============================================================================
+
+#include "Core/CoreTypes.h"
+#include "Core/RFileUtil.h"
+#include "Core/RThreadPool.h"
+#include "RenderSystem/RMesh.h"
+#include "RenderSystem/RMaterial.h"
+#include "Resource/RResourceManager.h"
+
+#include <chrono>
+
+namespace
+{
+	struct RCookedMeshInfo
+	{
+		std::string		AssetPath;
+		float			CookMs = 0.0f;
+		UINT64			BinaryMeshSize = 0;
+		bool			bSucceeded = false;
+	};
+
+	UINT64 GetFileSize(const std::string& Path)
+	{
+		std::ifstream FileStream(Path, std::ios::in | std::ios::binary | std::ios::ate);
+		return FileStream.is_open() ? (UINT64)FileStream.tellg() : 0;
+	}
+
+	/// Materials are only referenced by asset path in binary meshes. Add an empty material for each one named
+	/// in .rmtl files, so mesh importing finds them instead of loading materials and their textures.
+	void AddMaterialPlaceholders(const std::vector<std::string>& FbxFiles)
+	{
+		for (const std::string& FbxFile : FbxFiles)
+		{
+			for (const std::string& MaterialPath : RMaterial::LoadNameListFromXml(RFileUtil::ReplaceExtension(FbxFile, "rmtl")))
+			{
+				if (MaterialPath != "" && !RResourceManager::Instance().FindResource<RMaterial>(MaterialPath))
+				{
+					RResourceManager::Instance().CreateNewResource<RMaterial>(MaterialPath);
+				}
+			}
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: RhinoMeshCooker <AssetsFolder> [-j NumThreads] [-f] [-bvh]\n");
+		printf("  Imports fbx meshes without an up-to-date .rmesh and saves binary meshes next to them.\n");
+		printf("  -j  Number of meshes imported at the same time. Uses all hardware threads by default.\n");
+		printf("  -f  Cook all meshes, including the ones with an up-to-date .rmesh.\n");
+		printf("  -bvh  Save triangle BVHs for raycasts in binary meshes, so they aren't built at runtime.\n");
+		return 1;
+	}
+
+	const std::string AssetsPath = RFileUtil::TrimTrailingSeperators(RFileUtil::UnifyPathSeperators(argv[1])) + "/";
+	int NumThreads = -1;
+	bool bForceCook = false;
+	bool bCacheTriangleBVH = false;
+
+	for (int i = 2; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+		{
+			NumThreads = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "-f") == 0)
+		{
+			bForceCook = true;
+		}
+		else if (strcmp(argv[i], "-bvh") == 0)
+		{
+			bCacheTriangleBVH = true;
+		}
+	}
+
+	if (!RFileUtil::CheckPathExists(AssetsPath))
+	{
+		printf("Assets folder %s does not exist.\n", AssetsPath.c_str());
+		return 1;
+	}
+
+	std::vector<RCookedMeshInfo> Meshes;
+	std::vector<std::string> FbxFiles;
+
+	for (const std::string& AssetFile : RFileUtil::GetFilesInDirectoryAndSubdirectories(AssetsPath, "*.*"))
+	{
+		if (RFileUtil::GetExtensionInLowerCase(AssetFile) != "fbx")
+		{
+			continue;
+		}
+
+		const std::string FbxPath = RFileUtil::CombinePath(AssetsPath, AssetFile);
+		const std::string BinaryMeshPath = RFileUtil::ReplaceExtension(FbxPath, "rmesh");
+
+		// Same check as RMesh::TryLoadAsRmesh, so cooked meshes are the ones the engine would load
+		if (!bForceCook && RFileUtil::CheckPathExists(BinaryMeshPath) &&
+			RFileUtil::CompareFileTimestamp(FbxPath, BinaryMeshPath) != ETimestampComparison::EarlierSecond)
+		{
+			continue;
+		}
+
+		RCookedMeshInfo Info;
+		Info.AssetPath = AssetFile;
+		Meshes.push_back(Info);
+		FbxFiles.push_back(FbxPath);
+	}
+
+	if (Meshes.size() == 0)
+	{
+		printf("All binary meshes in %s are up to date.\n", AssetsPath.c_str());
+		return 0;
+	}
+
+	// Shared resources are created before cooking starts, so worker threads only look them up
+	RMaterial::GetDefault();
+	AddMaterialPlaceholders(FbxFiles);
+
+	// The calling thread cooks meshes too
+	GThreadPool.Initialize(NumThreads > 0 ? NumThreads - 1 : -1);
+	printf("Cooking %d meshes on %d threads...\n", (int)Meshes.size(), GThreadPool.GetNumWorkerThreads() + 1);
+
+	auto StartTime = std::chrono::high_resolution_clock::now();
+
+	// Each import creates its own fbx sdk manager and scene, so meshes don't share any fbx state
+	GThreadPool.ParallelFor(0, (int)Meshes.size(), 1, [&Meshes, &FbxFiles, bCacheTriangleBVH](int Begin, int End)
+	{
+		for (int i = Begin; i < End; i++)
+		{
+			RCookedMeshInfo& Info = Meshes[i];
+			auto MeshStartTime = std::chrono::high_resolution_clock::now();
+
+			std::unique_ptr<RMesh> Mesh(new RMesh(FbxFiles[i]));
+			Mesh->SetAssetPath(Info.AssetPath);
+			Info.bSucceeded = Mesh->CookBinaryMesh(bCacheTriangleBVH);
+
+			Info.CookMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - MeshStartTime).count();
+		}
+	});
+
+	const float TotalMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - StartTime).count();
+
+	GThreadPool.Shutdown();
+
+	// Report slowest meshes first
+	std::sort(Meshes.begin(), Meshes.end(), [](const RCookedMeshInfo& A, const RCookedMeshInfo& B) { return A.CookMs > B.CookMs; });
+
+	float SerialMs = 0.0f;
+	int NumFailed = 0;
+
+	for (RCookedMeshInfo& Info : Meshes)
+	{
+		if (Info.bSucceeded)
+		{
+			Info.BinaryMeshSize = GetFileSize(RFileUtil::CombinePath(AssetsPath, RFileUtil::ReplaceExtension(Info.AssetPath, "rmesh")));
+			printf("  %9.1f ms  %8.1f KB  %s\n", Info.CookMs, (double)Info.BinaryMeshSize / 1024.0, Info.AssetPath.c_str());
+		}
+		else
+		{
+			printf("  %9.1f ms    FAILED    %s\n", Info.CookMs, Info.AssetPath.c_str());
+			NumFailed++;
+		}
+
+		SerialMs += Info.CookMs;
+	}
+
+	printf("Cooked %d meshes (%d failed) in %.1f ms, %.1f ms spent on meshes, %.2fx parallel speedup.\n",
+		(int)Meshes.size() - NumFailed, NumFailed, TotalMs, SerialMs, TotalMs > 0.0f ? SerialMs / TotalMs : 0.0f);
+
+	return NumFailed > 0 ? 1 : 0;
+}
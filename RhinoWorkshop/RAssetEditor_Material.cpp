@@ -71,7 +71,7 @@ void RAssetEditor_Material::OnDrawWindow(REditorContext& EditorContext)
 	}
 
 	{
-		auto& Slots = Material->GetTextureSlots();
+		const std::vector<RTextureSlotData> Slots = Material->GetTextureSlots();
 
 		// Button for assert assigning '->'
 		ImGui::BeginGroup();
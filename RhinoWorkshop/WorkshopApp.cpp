@@ -608,54 +608,12 @@ void WorkshopApp::SelectSceneObjectAtCursor(const RVec2& Point)
 
 	if (MouseControlMode == EMouseControlMode::None && !RInput.IsKeyDown(VK_LMENU))
 	{
-		struct RayPickingResult
-		{
-			float t;
-			RSceneObject* obj;
-
-			RayPickingResult(float _t, RSceneObject* _obj)
-				: t(_t), obj(_obj)
-			{}
-
-			bool operator==(RSceneObject* _obj)
-			{
-				return obj == _obj;
-			}
-		};
-
-		// A set of objects hit by the picking ray
-		std::vector<RayPickingResult> rayPickingList;
-		float tmin = FLT_MAX;
-
-		for (auto SceneObject : GetAllSceneObjects())
-		{
-			float t;
-			if (CameraRay.TestIntersectionWithAabb(SceneObject->GetAabb(), &t))
+		// A set of objects hit by the picking ray, sorted by distance. Meshes are tested against their triangles.
+		std::vector<RRaycastHit> rayPickingList = GSceneManager.DefaultScene()->RaycastAll(CameraRay, [](RSceneObject* SceneObject)
 			{
 				// Don't allow picking up a camera or an axis object by click in the scene
-				if (SceneObject->CanCastTo<RCamera>() || SceneObject->CanCastTo<REditorAxis>())
-				{
-					continue;
-				}
-
-				if (SceneObject->CanCastTo<RSMeshObject>())
-				{
-					RSMeshObject* MeshObj = static_cast<RSMeshObject*>(SceneObject);
-					for (int i = 0; i < MeshObj->GetMeshElementCount(); i++)
-					{
-						if (CameraRay.TestIntersectionWithAabb(MeshObj->GetMeshElementAabb(i).GetTransformedAabb(MeshObj->GetTransformMatrix()), &t))
-						{
-							rayPickingList.push_back(RayPickingResult(t, SceneObject));
-							break;
-						}
-					}
-				}
-				else
-				{
-					rayPickingList.push_back(RayPickingResult(t, SceneObject));
-				}
-			}
-		}
+				return !SceneObject->HasFlags(CF_InternalObject) && !SceneObject->CanCastTo<RCamera>() && !SceneObject->CanCastTo<REditorAxis>();
+			});
 
 		if (!rayPickingList.size())
 		{
@@ -665,8 +623,7 @@ void WorkshopApp::SelectSceneObjectAtCursor(const RVec2& Point)
 		else
 		{
 			// When clicking on a same object more than once, loop through objects in the picking list so objects can be selected even if obstructed
-			sort(rayPickingList.begin(), rayPickingList.end(), [](RayPickingResult a, RayPickingResult b) { return a.t < b.t; });
-			auto Iter = find(rayPickingList.begin(), rayPickingList.end(), SelectedObject);
+			auto Iter = std::find_if(rayPickingList.begin(), rayPickingList.end(), [this](const RRaycastHit& Hit) { return Hit.SceneObject == SelectedObject; });
 			if (Iter != rayPickingList.end())
 			{
 				Iter++;
@@ -675,11 +632,11 @@ void WorkshopApp::SelectSceneObjectAtCursor(const RVec2& Point)
 					Iter = rayPickingList.begin();
 				}
 
-				SetSelectedObject(Iter->obj);
+				SetSelectedObject(Iter->SceneObject);
 			}
 			else
 			{
-				SetSelectedObject(rayPickingList[0].obj);
+				SetSelectedObject(rayPickingList[0].SceneObject);
 			}
 		}
 	}